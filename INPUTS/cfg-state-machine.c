@@ -0,0 +1,36 @@
+// A generated state machine: a loop around a switch with 2048 states, each of
+// which reads one of 2048 local variables and writes another. Every variable
+// is live, and possibly uninitialized, around the loop's back edge, which
+// makes this a stress test for the dataflow analyses over large CFGs:
+//
+//   clang -cc1 -fsyntax-only -Wuninitialized INPUTS/cfg-state-machine.c
+//   clang -cc1 -analyze -analyzer-checker=deadcode.DeadStores \
+//     INPUTS/cfg-state-machine.c
+
+#define DECLS_16(p)   int p##0, p##1, p##2, p##3, p##4, p##5, p##6, p##7, p##8, p##9, p##a, p##b, p##c, p##d, p##e, p##f;
+#define DECLS_256(p)  DECLS_16(p##0) DECLS_16(p##1) DECLS_16(p##2) DECLS_16(p##3) DECLS_16(p##4) DECLS_16(p##5) DECLS_16(p##6) DECLS_16(p##7) \
+                      DECLS_16(p##8) DECLS_16(p##9) DECLS_16(p##a) DECLS_16(p##b) DECLS_16(p##c) DECLS_16(p##d) DECLS_16(p##e) DECLS_16(p##f)
+
+#define STATE(v, w) \
+      case __COUNTER__: v = w + input; state = (v & 7) ? state + 1 : 0; break;
+#define STATES_16(p)  STATE(p##0, p##1) STATE(p##1, p##2) STATE(p##2, p##3) STATE(p##3, p##4) \
+                      STATE(p##4, p##5) STATE(p##5, p##6) STATE(p##6, p##7) STATE(p##7, p##8) \
+                      STATE(p##8, p##9) STATE(p##9, p##a) STATE(p##a, p##b) STATE(p##b, p##c) \
+                      STATE(p##c, p##d) STATE(p##d, p##e) STATE(p##e, p##f) STATE(p##f, p##0)
+#define STATES_256(p) STATES_16(p##0) STATES_16(p##1) STATES_16(p##2) STATES_16(p##3) STATES_16(p##4) STATES_16(p##5) STATES_16(p##6) STATES_16(p##7) \
+                      STATES_16(p##8) STATES_16(p##9) STATES_16(p##a) STATES_16(p##b) STATES_16(p##c) STATES_16(p##d) STATES_16(p##e) STATES_16(p##f)
+
+unsigned cfg_state_machine(int input) {
+  DECLS_256(v0) DECLS_256(v1) DECLS_256(v2) DECLS_256(v3)
+  DECLS_256(v4) DECLS_256(v5) DECLS_256(v6) DECLS_256(v7)
+  unsigned state = 0;
+  while (input--) {
+    switch (state) {
+      STATES_256(v0) STATES_256(v1) STATES_256(v2) STATES_256(v3)
+      STATES_256(v4) STATES_256(v5) STATES_256(v6) STATES_256(v7)
+    default:
+      state = 0;
+    }
+  }
+  return v000 + v7ff + state;
+}
@@ -32,7 +32,7 @@
  * compatible, thus CINDEX_VERSION_MAJOR is expected to remain stable.
  */
 #define CINDEX_VERSION_MAJOR 0
-#define CINDEX_VERSION_MINOR 18
+#define CINDEX_VERSION_MINOR 23
 
 #define CINDEX_VERSION_ENCODE(major, minor) ( \
       ((major) * 10000)                       \
@@ -1147,7 +1147,22 @@ enum CXTranslationUnit_Flags {
    * included into the set of code completions returned from this translation
    * unit.
    */
-  CXTranslationUnit_IncludeBriefCommentsInCodeCompletion = 0x80
+  CXTranslationUnit_IncludeBriefCommentsInCodeCompletion = 0x80,
+
+  /**
+   * \brief Used to indicate that an out-of-date precompiled preamble should
+   * be rebuilt in the background.
+   *
+   * With this option, \c clang_reparseTranslationUnit() does not wait for
+   * the precompiled preamble to be rebuilt when the preamble or the headers
+   * it includes change. Until the new preamble is ready, reparsing keeps
+   * using the old one if only the preamble of the main file changed, and
+   * otherwise parses the main file without a preamble.
+   *
+   * This option only has an effect together with
+   * \c CXTranslationUnit_PrecompiledPreamble.
+   */
+  CXTranslationUnit_RebuildPreambleInBackground = 0x100
 };
 
 /**
@@ -4931,6 +4946,37 @@ CXCodeCompleteResults *clang_codeCompleteAt(CXTranslationUnit TU,
 CINDEX_LINKAGE
 void clang_sortCodeCompletionResults(CXCompletionResult *Results,
                                      unsigned NumResults);
+
+/**
+ * \brief Narrow code-completion results down to those matching the text
+ * typed so far, best matches first.
+ *
+ * A result matches when the characters of \p Prefix appear, in order and
+ * ignoring case, in its typed text. Results whose typed text starts with
+ * \p Prefix rank first, followed by abbreviations (e.g., "gbc" for
+ * "getBarCount") and then any other match. Results of equal match quality
+ * are ordered by priority, then alphabetically.
+ *
+ * The results are filtered in place: \c Results->Results and
+ * \c Results->NumResults are updated to describe the matching results. The
+ * complete set is retained, so the same results can be filtered again with
+ * another prefix. When the new prefix extends the previous one, as it does
+ * when the user keeps typing the same token, only the previous matches are
+ * examined.
+ *
+ * \param Results The code-completion results to filter, as returned by
+ * \c clang_codeCompleteAt().
+ *
+ * \param Prefix The text typed so far for the token being completed.
+ *
+ * \param MaxResults If non-zero, the maximum number of results to keep.
+ *
+ * \returns the number of results kept.
+ */
+CINDEX_LINKAGE
+unsigned clang_codeCompleteFilterResults(CXCodeCompleteResults *Results,
+                                         const char *Prefix,
+                                         unsigned MaxResults);
   
 /**
  * \brief Free the given set of code-completion results.
@@ -5645,6 +5691,24 @@ CINDEX_LINKAGE CXIndexAction clang_IndexAction_create(CXIndex CIdx);
  */
 CINDEX_LINKAGE void clang_IndexAction_dispose(CXIndexAction);
 
+/**
+ * \brief Keep the headers skipped by \c CXIndexOpt_SkipIndexedHeadersInSession
+ * across indexing sessions.
+ *
+ * The headers indexed by earlier sessions that used the same file are read
+ * from \p path. They are skipped too, as long as they did not change on disk
+ * and the macros they depend on, the language options and the target are the
+ * same. The headers indexed by this session are written to \p path when the
+ * index action is destroyed.
+ *
+ * Call this before indexing any file with the index action.
+ *
+ * \returns 0 on success, including when \p path does not exist yet, or
+ * non-zero if \p path exists but could not be read.
+ */
+CINDEX_LINKAGE int clang_IndexAction_setIndexedHeadersFile(CXIndexAction,
+                                                           const char *path);
+
 typedef enum {
   /**
    * \brief Used to indicate that no special indexing options are needed.
@@ -5680,7 +5744,16 @@ typedef enum {
    * indexing session assosiated with a \c CXIndexAction object.
    * Bodies in system headers are always skipped.
    */
-  CXIndexOpt_SkipParsedBodiesInSession = 0x10
+  CXIndexOpt_SkipParsedBodiesInSession = 0x10,
+
+  /**
+   * \brief Skip the declarations of a header that was already indexed during
+   * an indexing session assosiated with a \c CXIndexAction object, if the
+   * header did not change on disk and the macros it depends on have the same
+   * definitions as when it was indexed.
+   * Only applies to \c clang_indexSourceFile.
+   */
+  CXIndexOpt_SkipIndexedHeadersInSession = 0x20
 
 } CXIndexOptFlags;
 
@@ -5765,6 +5838,186 @@ CINDEX_LINKAGE void clang_indexLoc_getFileLocation(CXIdxLoc loc,
 CINDEX_LINKAGE
 CXSourceLocation clang_indexLoc_getCXSourceLocation(CXIdxLoc loc);
 
+/**
+ * \brief Collects the entities and references found while indexing
+ * translation units, and writes them out as a compact, memory-mappable
+ * database that can be queried through a \c CXIndexDB.
+ */
+typedef void *CXIndexDBWriter;
+
+/**
+ * \brief A database written by a \c CXIndexDBWriter, queried directly
+ * through the memory-mapped file.
+ */
+typedef void *CXIndexDB;
+
+/**
+ * \brief The ways a symbol occurs in the source code.
+ */
+typedef enum {
+  CXIndexDBRole_Declaration = 0x1,
+  CXIndexDBRole_Definition = 0x2,
+  CXIndexDBRole_Reference = 0x4,
+  CXIndexDBRole_Implicit = 0x8
+} CXIndexDBRoleFlags;
+
+/**
+ * \brief An occurrence of a symbol in the source code.
+ */
+typedef struct {
+  /**
+   * \brief The index of the symbol that occurs.
+   */
+  int symbol;
+  /**
+   * \brief The index of the symbol whose declaration or definition contains
+   * the occurrence, or -1. Together with \c symbol, this is a reference edge.
+   */
+  int container;
+  /**
+   * \brief The file of the occurrence; owned by the \c CXIndexDB.
+   */
+  const char *file;
+  unsigned line;
+  unsigned column;
+  /**
+   * \brief A bitwise OR of the CXIndexDBRole_XXX flags.
+   */
+  unsigned roles;
+} CXIndexDBOccurrence;
+
+/**
+ * \brief Create a writer for an index database.
+ */
+CINDEX_LINKAGE CXIndexDBWriter clang_IndexDBWriter_create(void);
+
+/**
+ * \brief Destroy the given index database writer.
+ */
+CINDEX_LINKAGE void clang_IndexDBWriter_dispose(CXIndexDBWriter writer);
+
+/**
+ * \brief Index the given source file like \c clang_indexSourceFile, and
+ * add the declarations and references it contains to the writer.
+ *
+ * \returns If there is a failure from which the there is no recovery, returns
+ * non-zero, otherwise returns 0.
+ */
+CINDEX_LINKAGE
+int clang_IndexDBWriter_indexSourceFile(CXIndexDBWriter writer,
+                                        CXIndexAction action,
+                                        unsigned index_options,
+                                        const char *source_filename,
+                                        const char * const *command_line_args,
+                                        int num_command_line_args,
+                                        struct CXUnsavedFile *unsaved_files,
+                                        unsigned num_unsaved_files);
+
+/**
+ * \brief Index the given translation unit like
+ * \c clang_indexTranslationUnit, and add the declarations and references it
+ * contains to the writer.
+ *
+ * \returns If there is a failure from which the there is no recovery, returns
+ * non-zero, otherwise returns 0.
+ */
+CINDEX_LINKAGE
+int clang_IndexDBWriter_indexTranslationUnit(CXIndexDBWriter writer,
+                                             CXIndexAction action,
+                                             unsigned index_options,
+                                             CXTranslationUnit TU);
+
+/**
+ * \brief Write out the database of everything indexed so far.
+ *
+ * Symbols are identified by their USR; occurrences coming from headers that
+ * were indexed as part of several translation units are stored only once.
+ *
+ * \returns zero on success, non-zero if the file could not be written.
+ */
+CINDEX_LINKAGE
+int clang_IndexDBWriter_write(CXIndexDBWriter writer, const char *path);
+
+/**
+ * \brief Map the given index database into memory.
+ *
+ * \returns the database, or NULL if the file is not a valid index database.
+ */
+CINDEX_LINKAGE CXIndexDB clang_IndexDB_open(const char *path);
+
+/**
+ * \brief Destroy the given index database. The strings returned from its
+ * queries are no longer valid afterwards.
+ */
+CINDEX_LINKAGE void clang_IndexDB_dispose(CXIndexDB db);
+
+/**
+ * \brief Determine the number of symbols in the database.
+ */
+CINDEX_LINKAGE unsigned clang_IndexDB_getNumSymbols(CXIndexDB db);
+
+/**
+ * \brief Find the symbol with the given USR.
+ *
+ * \returns the index of the symbol, or -1 if there is no such symbol.
+ */
+CINDEX_LINKAGE int clang_IndexDB_findSymbol(CXIndexDB db, const char *USR);
+
+/**
+ * \brief Retrieve the USR of the given symbol.
+ */
+CINDEX_LINKAGE
+const char *clang_IndexDB_getSymbolUSR(CXIndexDB db, unsigned symbol);
+
+/**
+ * \brief Retrieve the name of the given symbol.
+ */
+CINDEX_LINKAGE
+const char *clang_IndexDB_getSymbolName(CXIndexDB db, unsigned symbol);
+
+/**
+ * \brief Retrieve the kind of the given symbol.
+ */
+CINDEX_LINKAGE
+CXIdxEntityKind clang_IndexDB_getSymbolKind(CXIndexDB db, unsigned symbol);
+
+/**
+ * \brief Determine the number of occurrences of the given symbol.
+ */
+CINDEX_LINKAGE
+unsigned clang_IndexDB_getNumSymbolOccurrences(CXIndexDB db, unsigned symbol);
+
+/**
+ * \brief Retrieve an occurrence of the given symbol. Occurrences are sorted
+ * by file and position.
+ */
+CINDEX_LINKAGE
+CXIndexDBOccurrence clang_IndexDB_getSymbolOccurrence(CXIndexDB db,
+                                                      unsigned symbol,
+                                                      unsigned index);
+
+/**
+ * \brief Find the file with the given name, as it was spelled when indexing.
+ *
+ * \returns the index of the file, or -1 if there is no such file.
+ */
+CINDEX_LINKAGE int clang_IndexDB_findFile(CXIndexDB db, const char *filename);
+
+/**
+ * \brief Determine the number of symbol occurrences in the given file.
+ */
+CINDEX_LINKAGE
+unsigned clang_IndexDB_getNumFileOccurrences(CXIndexDB db, unsigned file);
+
+/**
+ * \brief Retrieve a symbol occurrence in the given file. Occurrences are
+ * sorted by position.
+ */
+CINDEX_LINKAGE
+CXIndexDBOccurrence clang_IndexDB_getFileOccurrence(CXIndexDB db,
+                                                    unsigned file,
+                                                    unsigned index);
+
 /**
  * @}
  */
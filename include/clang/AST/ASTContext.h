@@ -36,6 +36,7 @@
 #include "llvm/ADT/FoldingSet.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/PointerUnion.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/Support/Allocator.h"
@@ -163,6 +164,13 @@ class ASTContext : public RefCountedBase<ASTContext> {
   llvm::DenseMap<const FunctionDecl*, FunctionDecl*>
     ClassScopeSpecializationPattern;
 
+  /// \brief Mapping from functions to the declarations in their prototype
+  /// scope that are not parameters, e.g. 'enum Y' in
+  /// 'void f(enum Y {AA} x) {}'. Only C allows these, so they are kept out
+  /// of FunctionDecl.
+  llvm::DenseMap<const FunctionDecl*, ArrayRef<NamedDecl *> >
+    DeclsInPrototypeScope;
+
   /// \brief Representation of a "canonical" template template parameter that
   /// is used in canonical template names.
   class CanonicalTemplateTemplateParm : public llvm::FoldingSetNode {
@@ -387,8 +395,16 @@ public:
   /// \brief Contains parents of a node.
   typedef llvm::SmallVector<ast_type_traits::DynTypedNode, 1> ParentVector;
 
+  /// \brief A parent of a node; only \c Decls and \c Stmts are recorded.
+  typedef llvm::PointerUnion<const Decl *, const Stmt *> ParentRef;
+
   /// \brief Maps from a node to its parents.
-  typedef llvm::DenseMap<const void *, ParentVector> ParentMap;
+  ///
+  /// Holds one (node, parent) pair per parent, sorted by node, so that each
+  /// edge of the AST costs two pointers; a hash map of vectors costs several
+  /// times as much, which adds up to hundreds of megabytes on large
+  /// translation units.
+  typedef std::vector<std::pair<const void *, ParentRef> > ParentMap;
 
   /// \brief Returns the parents of the given node.
   ///
@@ -419,22 +435,7 @@ public:
     return getParents(ast_type_traits::DynTypedNode::create(Node));
   }
 
-  ParentVector getParents(const ast_type_traits::DynTypedNode &Node) {
-    assert(Node.getMemoizationData() &&
-           "Invariant broken: only nodes that support memoization may be "
-           "used in the parent map.");
-    if (!AllParents) {
-      // We always need to run over the whole translation unit, as
-      // hasAncestor can escape any subtree.
-      AllParents.reset(
-          ParentMapASTVisitor::buildMap(*getTranslationUnitDecl()));
-    }
-    ParentMap::const_iterator I = AllParents->find(Node.getMemoizationData());
-    if (I == AllParents->end()) {
-      return ParentVector();
-    }
-    return I->second;
-  }
+  ParentVector getParents(const ast_type_traits::DynTypedNode &Node);
 
   const clang::PrintingPolicy &getPrintingPolicy() const {
     return PrintingPolicy;
@@ -609,6 +610,13 @@ public:
   void setClassScopeSpecializationPattern(FunctionDecl *FD,
                                           FunctionDecl *Pattern);
 
+  /// \brief Retrieve the declarations in the prototype scope of \p FD that
+  /// are not parameters.
+  ArrayRef<NamedDecl *> getDeclsInPrototypeScope(const FunctionDecl *FD) const;
+
+  void setDeclsInPrototypeScope(const FunctionDecl *FD,
+                                ArrayRef<NamedDecl *> Decls);
+
   /// \brief Note that the static data member \p Inst is an instantiation of
   /// the static data member template \p Tmpl of a class template.
   void setInstantiatedFromStaticDataMember(VarDecl *Inst, VarDecl *Tmpl,
@@ -2200,7 +2208,8 @@ private:
   /// FIXME: Currently only builds up the map using \c Stmt and \c Decl nodes.
   class ParentMapASTVisitor : public RecursiveASTVisitor<ParentMapASTVisitor> {
   public:
-    /// \brief Builds and returns the translation unit's parent map.
+    /// \brief Builds and returns the translation unit's parent map, in
+    /// traversal order.
     ///
     ///  The caller takes ownership of the returned \c ParentMap.
     static ParentMap *buildMap(TranslationUnitDecl &TU) {
@@ -2231,17 +2240,12 @@ private:
     bool TraverseNode(T *Node, bool(VisitorBase:: *traverse) (T *)) {
       if (Node == NULL)
         return true;
+      // The same parent may be added several times, for example when we
+      // visit all subexpressions of template instantiations; the duplicates
+      // are dropped once the map is sorted.
       if (ParentStack.size() > 0)
-        // FIXME: Currently we add the same parent multiple times, for example
-        // when we visit all subexpressions of template instantiations; this is
-        // suboptimal, bug benign: the only way to visit those is with
-        // hasAncestor / hasParent, and those do not create new matches.
-        // The plan is to enable DynTypedNode to be storable in a map or hash
-        // map. The main problem there is to implement hash functions /
-        // comparison operators for all types that DynTypedNode supports that
-        // do not have pointer identity.
-        (*Parents)[Node].push_back(ParentStack.back());
-      ParentStack.push_back(ast_type_traits::DynTypedNode::create(*Node));
+        Parents->push_back(std::make_pair(Node, ParentStack.back()));
+      ParentStack.push_back(Node);
       bool Result = (this ->* traverse) (Node);
       ParentStack.pop_back();
       return Result;
@@ -2256,7 +2260,7 @@ private:
     }
 
     ParentMap *Parents;
-    llvm::SmallVector<ast_type_traits::DynTypedNode, 16> ParentStack;
+    llvm::SmallVector<ParentRef, 16> ParentStack;
 
     friend class RecursiveASTVisitor<ParentMapASTVisitor>;
   };
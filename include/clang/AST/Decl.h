@@ -1364,11 +1364,6 @@ private:
   /// no formals.
   ParmVarDecl **ParamInfo;
 
-  /// DeclsInPrototypeScope - Array of pointers to NamedDecls for
-  /// decls defined in the function prototype that are not parameters. E.g.
-  /// 'enum Y' in 'void f(enum Y {AA} x) {}'.
-  ArrayRef<NamedDecl *> DeclsInPrototypeScope;
-
   LazyDeclStmtPtr Body;
 
   // FIXME: This can be packed into the bitfields in Decl.
@@ -1392,6 +1387,10 @@ private:
   /// skipped.
   unsigned HasSkippedBody : 1;
 
+  /// \brief Whether the prototype declares tags or enumerators that are not
+  /// parameters, which are kept in an ASTContext side table.
+  unsigned HasDeclsInPrototypeScope : 1;
+
   /// \brief End part of this FunctionDecl's source range.
   ///
   /// We could compute the full range in getSourceRange(). However, when we're
@@ -1476,7 +1475,7 @@ protected:
       IsDefaulted(false), IsExplicitlyDefaulted(false),
       HasImplicitReturnZero(false), IsLateTemplateParsed(false),
       IsConstexpr(isConstexprSpecified), HasSkippedBody(false),
-      EndRangeLoc(NameInfo.getEndLoc()),
+      HasDeclsInPrototypeScope(false), EndRangeLoc(NameInfo.getEndLoc()),
       TemplateOrSpecialization(),
       DNLoc(NameInfo.getInfo()) {}
 
@@ -1747,9 +1746,9 @@ public:
     setParams(getASTContext(), NewParamInfo);
   }
 
-  const ArrayRef<NamedDecl *> &getDeclsInPrototypeScope() const {
-    return DeclsInPrototypeScope;
-  }
+  /// \brief Retrieve the declarations in the function prototype that are
+  /// not parameters, e.g. 'enum Y' in 'void f(enum Y {AA} x) {}'.
+  ArrayRef<NamedDecl *> getDeclsInPrototypeScope() const;
   void setDeclsInPrototypeScope(ArrayRef<NamedDecl *> NewDecls);
 
   /// getMinRequiredArguments - Returns the minimum number of arguments
@@ -33,30 +33,72 @@ struct StoredDeclsList {
   /// DeclsTy - When in vector form, this is what the Data pointer points to.
   typedef SmallVector<NamedDecl *, 4> DeclsTy;
 
+private:
+  /// \brief Maps each function in the list, and the pattern of each function
+  /// template, to the position of its entry in the list.
+  typedef llvm::DenseMap<const FunctionDecl *, unsigned> FunctionIndexTy;
+
+  /// \brief The vector form of the list.
+  ///
+  /// Once a name has many declarations, e.g. a heavily overloaded function or
+  /// operator, the list also keeps an index of its functions so that adding
+  /// another overload need not check it against every existing one.
+  struct VectorTy {
+    DeclsTy Decls;
+    FunctionIndexTy *FunctionIndex;
+
+    VectorTy() : FunctionIndex(0) {}
+    explicit VectorTy(const DeclsTy &Decls)
+      : Decls(Decls), FunctionIndex(0) {}
+    ~VectorTy() { delete FunctionIndex; }
+
+  private:
+    VectorTy(const VectorTy &) LLVM_DELETED_FUNCTION;
+    void operator=(const VectorTy &) LLVM_DELETED_FUNCTION;
+  };
+
+  /// \brief The number of declarations a list must have before
+  /// redeclarations of functions are looked up in the function index.
+  static const unsigned FunctionIndexThreshold = 16;
+
   /// \brief The stored data, which will be either a pointer to a NamedDecl,
   /// or a pointer to a vector.
-  llvm::PointerUnion<NamedDecl *, DeclsTy *> Data;
+  llvm::PointerUnion<NamedDecl *, VectorTy *> Data;
+
+  /// \brief Retrieve the function through which \p D is indexed, or null if
+  /// \p D is neither a function nor a function template.
+  static const FunctionDecl *getFunctionIndexKey(NamedDecl *D);
+
+  /// \brief Find the function or function template in the vector that
+  /// \p D redeclares using the function index, building it if necessary,
+  /// and replace it with \p D.
+  bool HandleFunctionRedeclaration(NamedDecl *D);
+
+  /// \brief Update the function index after the entries of the vector
+  /// starting at position \p From have moved.
+  void reindexFunctionsFrom(unsigned From);
 
 public:
   StoredDeclsList() {}
 
   StoredDeclsList(const StoredDeclsList &RHS) : Data(RHS.Data) {
-    if (DeclsTy *RHSVec = RHS.getAsVector())
-      Data = new DeclsTy(*RHSVec);
+    // The function index is rebuilt on demand.
+    if (VectorTy *RHSVec = RHS.Data.dyn_cast<VectorTy *>())
+      Data = new VectorTy(RHSVec->Decls);
   }
 
   ~StoredDeclsList() {
     // If this is a vector-form, free the vector.
-    if (DeclsTy *Vector = getAsVector())
+    if (VectorTy *Vector = Data.dyn_cast<VectorTy *>())
       delete Vector;
   }
 
   StoredDeclsList &operator=(const StoredDeclsList &RHS) {
-    if (DeclsTy *Vector = getAsVector())
+    if (VectorTy *Vector = Data.dyn_cast<VectorTy *>())
       delete Vector;
     Data = RHS.Data;
-    if (DeclsTy *RHSVec = RHS.getAsVector())
-      Data = new DeclsTy(*RHSVec);
+    if (VectorTy *RHSVec = RHS.Data.dyn_cast<VectorTy *>())
+      Data = new VectorTy(RHSVec->Decls);
     return *this;
   }
 
@@ -67,7 +109,9 @@ public:
   }
 
   DeclsTy *getAsVector() const {
-    return Data.dyn_cast<DeclsTy *>();
+    if (VectorTy *Vector = Data.dyn_cast<VectorTy *>())
+      return &Vector->Decls;
+    return 0;
   }
 
   void setOnlyValue(NamedDecl *ND) {
@@ -91,10 +135,17 @@ public:
     DeclsTy &Vec = *getAsVector();
     DeclsTy::iterator I = std::find(Vec.begin(), Vec.end(), D);
     assert(I != Vec.end() && "list does not contain decl");
+    unsigned Pos = I - Vec.begin();
     Vec.erase(I);
 
     assert(std::find(Vec.begin(), Vec.end(), D)
              == Vec.end() && "list still contains decl");
+
+    if (FunctionIndexTy *Index = Data.get<VectorTy *>()->FunctionIndex) {
+      if (const FunctionDecl *Key = getFunctionIndexKey(D))
+        Index->erase(Key);
+      reindexFunctionsFrom(Pos);
+    }
   }
 
   /// \brief Remove any declarations which were imported from an external
@@ -106,10 +157,14 @@ public:
       if (Singleton->isFromASTFile())
         *this = StoredDeclsList();
     } else {
-      DeclsTy &Vec = *getAsVector();
-      Vec.erase(std::remove_if(Vec.begin(), Vec.end(),
-                               std::mem_fun(&Decl::isFromASTFile)),
-                Vec.end());
+      VectorTy &Vec = *Data.get<VectorTy *>();
+      Vec.Decls.erase(std::remove_if(Vec.Decls.begin(), Vec.Decls.end(),
+                                     std::mem_fun(&Decl::isFromASTFile)),
+                      Vec.Decls.end());
+
+      // The function index is rebuilt on demand.
+      delete Vec.FunctionIndex;
+      Vec.FunctionIndex = 0;
     }
   }
 
@@ -147,8 +202,16 @@ public:
       return true;
     }
 
-    // Determine if this declaration is actually a redeclaration.
+    // Redeclarations of heavily overloaded functions are found through the
+    // function index rather than by checking every overload. Only functions
+    // can replace indexed declarations, so the index stays up to date.
     DeclsTy &Vec = *getAsVector();
+    if ((Vec.size() >= FunctionIndexThreshold ||
+         Data.get<VectorTy *>()->FunctionIndex) &&
+        getFunctionIndexKey(D))
+      return HandleFunctionRedeclaration(D);
+
+    // Determine if this declaration is actually a redeclaration.
     for (DeclsTy::iterator OD = Vec.begin(), ODEnd = Vec.end();
          OD != ODEnd; ++OD) {
       NamedDecl *OldD = *OD;
@@ -168,12 +231,13 @@ public:
     // If this is the second decl added to the list, convert this to vector
     // form.
     if (NamedDecl *OldD = getAsDecl()) {
-      DeclsTy *VT = new DeclsTy();
-      VT->push_back(OldD);
+      VectorTy *VT = new VectorTy();
+      VT->Decls.push_back(OldD);
       Data = VT;
     }
 
     DeclsTy &Vec = *getAsVector();
+    unsigned Pos;
 
     // Using directives end up in a special entry which contains only
     // other using directives, so all this logic is wasted for them.
@@ -183,20 +247,22 @@ public:
     // Tag declarations always go at the end of the list so that an
     // iterator which points at the first tag will start a span of
     // decls that only contains tags.
-    if (D->hasTagIdentifierNamespace())
+    if (D->hasTagIdentifierNamespace()) {
+      Pos = Vec.size();
       Vec.push_back(D);
 
     // Resolved using declarations go at the front of the list so that
     // they won't show up in other lookup results.  Unresolved using
     // declarations (which are always in IDNS_Using | IDNS_Ordinary)
     // follow that so that the using declarations will be contiguous.
-    else if (D->getIdentifierNamespace() & Decl::IDNS_Using) {
+    } else if (D->getIdentifierNamespace() & Decl::IDNS_Using) {
       DeclsTy::iterator I = Vec.begin();
       if (D->getIdentifierNamespace() != Decl::IDNS_Using) {
         while (I != Vec.end() &&
                (*I)->getIdentifierNamespace() == Decl::IDNS_Using)
           ++I;
       }
+      Pos = I - Vec.begin();
       Vec.insert(I, D);
 
     // All other declarations go at the end of the list, but before any
@@ -204,10 +270,17 @@ public:
     // because there can only ever be one in a scope.
     } else if (!Vec.empty() && Vec.back()->hasTagIdentifierNamespace()) {
       NamedDecl *TagD = Vec.back();
+      Pos = Vec.size() - 1;
       Vec.back() = D;
       Vec.push_back(TagD);
-    } else
+    } else {
+      Pos = Vec.size();
       Vec.push_back(D);
+    }
+
+    // Everything from the new entry on may have moved.
+    if (Data.get<VectorTy *>()->FunctionIndex)
+      reindexFunctionsFrom(Pos);
   }
 };
 
@@ -211,6 +211,37 @@ protected:
     unsigned HasFoundDecl : 1;
     unsigned HadMultipleCandidates : 1;
     unsigned RefersToEnclosingLocal : 1;
+
+    /// \brief The raw encoding of the location of the name. It fills the
+    /// half of the Stmt bits that the pointer-sized Aligner leaves unused
+    /// on 64-bit hosts, which saves 8 bytes in every DeclRefExpr.
+    unsigned Loc;
+  };
+
+  class ArraySubscriptExprBitfields {
+    friend class ArraySubscriptExpr;
+    unsigned : NumExprBits;
+
+    /// \brief The raw encoding of the location of the ']', kept here for the
+    /// same reason as \c DeclRefExprBitfields::Loc.
+    unsigned RBracketLoc;
+  };
+
+  class BinaryOperatorBitfields {
+    friend class BinaryOperator;
+    unsigned : NumExprBits;
+
+    unsigned Opc : 6;
+
+    // Records the FP_CONTRACT pragma status at the point that this binary
+    // operator was parsed. This bit is only meaningful for operations on
+    // floating point types. For all other types it should default to
+    // false.
+    unsigned FPContractable : 1;
+
+    /// \brief The raw encoding of the location of the operator, kept here for
+    /// the same reason as \c DeclRefExprBitfields::Loc.
+    unsigned OpLoc;
   };
 
   class CastExprBitfields {
@@ -299,6 +330,8 @@ protected:
     FloatingLiteralBitfields FloatingLiteralBits;
     UnaryExprOrTypeTraitExprBitfields UnaryExprOrTypeTraitExprBits;
     DeclRefExprBitfields DeclRefExprBits;
+    ArraySubscriptExprBitfields ArraySubscriptExprBits;
+    BinaryOperatorBitfields BinaryOperatorBits;
     CastExprBitfields CastExprBits;
     CallExprBitfields CallExprBits;
     ExprWithCleanupsBitfields ExprWithCleanupsBits;
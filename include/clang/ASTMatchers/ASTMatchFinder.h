@@ -42,11 +42,17 @@
 #define LLVM_CLANG_AST_MATCHERS_AST_MATCH_FINDER_H
 
 #include "clang/ASTMatchers/ASTMatchers.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/Timer.h"
 
 namespace clang {
 
 namespace ast_matchers {
 
+namespace internal {
+class MatchASTVisitor;
+}
+
 /// \brief A class to allow finding matches over the Clang AST.
 ///
 /// After creation, you can add multiple matchers to the MatchFinder via
@@ -147,6 +153,48 @@ public:
              ASTContext &Context);
   /// @}
 
+  /// \brief Records the time spent matching each matcher, and in the
+  /// callback it calls, in \p Records.
+  ///
+  /// \p Records[I] is the time of the I-th matcher added; \p Records grows
+  /// as matchers are added. A callback added with several matchers is timed
+  /// separately for each. Times are added to what \p Records already holds,
+  /// which must outlive the matching. Measuring slows matching down
+  /// noticeably.
+  void enableProfiling(std::vector<llvm::TimeRecord> &Records);
+
+  /// \brief Only match within every \p Count th top-level declaration of a
+  /// translation unit, starting at the \p Index th.
+  ///
+  /// The top-level declarations, each with everything in it, are dealt out
+  /// to \p Count shards in source order, and the translation unit itself
+  /// belongs to shard 0. Running the same matchers over the same translation
+  /// unit once for each shard, e.g. in one process per core, finds every
+  /// match exactly once, in source order within each shard.
+  ///
+  /// Each shard still parses and traverses the whole translation unit; only
+  /// the matching is split, so sharding pays off when matching, not parsing,
+  /// dominates. To use several cores on one parse, see \c setNumThreads().
+  ///
+  /// Does not affect \c match().
+  void setShard(unsigned Index, unsigned Count);
+
+  /// \brief Match the translation units of the consumers made by
+  /// \c newASTConsumer() on \p NumThreads threads.
+  ///
+  /// The top-level declarations of this finder's shard are dealt out to the
+  /// threads the way \c setShard() deals them out to shards. Each thread
+  /// traverses the whole translation unit with its own memoization cache.
+  /// The callbacks are still called on the calling thread, once all threads
+  /// are done, and in the same order as when matching on one thread.
+  ///
+  /// The matchers run concurrently, so matchers implemented outside
+  /// ASTMatchers.h must not modify shared state. Where threads are not
+  /// available, everything is matched on the calling thread.
+  ///
+  /// Does not affect \c match().
+  void setNumThreads(unsigned NumThreads);
+
   /// \brief Registers a callback to notify the end of parsing.
   ///
   /// The provided closure is called after parsing is done, before the AST is
@@ -155,10 +203,13 @@ public:
   void registerTestCallbackAfterParsing(ParsingDoneTestCallback *ParsingDone);
 
 private:
-  /// \brief For each \c DynTypedMatcher a \c MatchCallback that will be called
-  /// when it matches.
-  std::vector<std::pair<const internal::DynTypedMatcher*, MatchCallback*> >
-    MatcherCallbackPairs;
+  friend class internal::MatchASTVisitor;
+
+  struct MatchersByKind;
+
+  /// \brief The registered matchers, grouped by the kind of node they can
+  /// match, and how to match them.
+  OwningPtr<MatchersByKind> Matchers;
 
   /// \brief Called when parsing is done.
   ParsingDoneTestCallback *ParsingDone;
@@ -0,0 +1,130 @@
+//===- BitVectorDataflow.h - Bit-vector dataflow over CFGs --------*- C++ --*-//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a solver for dataflow analyses over CFGs whose values are
+// dense bit vectors, shared by LiveVariables and UninitializedValues.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_BITVECTOR_DATAFLOW
+#define LLVM_CLANG_BITVECTOR_DATAFLOW
+
+#include "clang/Analysis/Analyses/DataflowWorklist.h"
+#include "clang/Analysis/CFG.h"
+#include "llvm/ADT/BitVector.h"
+#include <vector>
+
+namespace clang {
+
+class PostOrderCFGView;
+
+/// \brief Solves a dataflow problem over a CFG whose lattice is a dense bit
+/// vector, joined by union.
+///
+/// The solver keeps, for each block, the value flowing into the block and the
+/// value flowing out of it, in the direction of the analysis: for a backward
+/// analysis, the "in" value is the one at the end of the block. Blocks are
+/// visited in the order of a DataflowWorklist, and a block is visited again
+/// only when its "in" value changes. Joins and comparisons work on whole
+/// words of the bit vectors, so they take time linear in the number of
+/// tracked facts divided by the word size, and vectorize well.
+///
+/// Values may grow while the analysis runs, for analyses that number their
+/// facts as they meet them: bits past the end of a vector are clear.
+class BitVectorDataflow {
+  DataflowWorklist::Direction Dir;
+  DataflowWorklist Worklist;
+  std::vector<llvm::BitVector> InValues, OutValues;
+  llvm::BitVector VisitedBlocks;
+
+public:
+  BitVectorDataflow(const CFG &Cfg, PostOrderCFGView &POV,
+                    DataflowWorklist::Direction Dir, unsigned NumBits);
+
+  /// \brief The value flowing into \p Block, in the direction of the
+  /// analysis, as of its last visit.
+  llvm::BitVector &getInValue(const CFGBlock *Block) {
+    return InValues[Block->getBlockID()];
+  }
+
+  /// \brief The value flowing out of \p Block, in the direction of the
+  /// analysis, as of its last visit.
+  llvm::BitVector &getOutValue(const CFGBlock *Block) {
+    return OutValues[Block->getBlockID()];
+  }
+
+  /// \brief Whether \p Block was visited, or given a fixed value.
+  bool wasVisited(const CFGBlock *Block) const {
+    return VisitedBlocks[Block->getBlockID()];
+  }
+
+  /// \brief Fix the "out" value of \p Block to the value currently stored,
+  /// as for the entry block of a forward analysis. The block is never
+  /// visited.
+  void setBoundaryBlock(const CFGBlock *Block) {
+    VisitedBlocks[Block->getBlockID()] = true;
+  }
+
+  /// \brief Schedule \p Block for a first visit.
+  void enqueueBlock(const CFGBlock *Block) {
+    Worklist.enqueueBlock(Block);
+  }
+
+  /// \brief Run the analysis to a fixed point.
+  ///
+  /// \p Transfer is called as <tt>Transfer(Block, Value)</tt> to turn the "in"
+  /// value of a block into its "out" value, in place.
+  ///
+  /// \returns the number of block visits.
+  template <typename TransferFn>
+  unsigned solve(TransferFn &Transfer);
+
+  /// \brief Store into \p Value the union of the "out" values of the blocks
+  /// that flow into \p Block.
+  void joinInto(const CFGBlock *Block, llvm::BitVector &Value) const;
+
+  /// \brief Whether \p A and \p B hold the same bits, where a bit past the
+  /// end of one of them counts as clear. Both end up the size of the larger.
+  static bool sameBits(llvm::BitVector &A, llvm::BitVector &B);
+
+private:
+  void enqueueDependents(const CFGBlock *Block);
+};
+
+template <typename TransferFn>
+unsigned BitVectorDataflow::solve(TransferFn &Transfer) {
+  unsigned NumVisits = 0;
+  llvm::BitVector In;
+  while (const CFGBlock *Block = Worklist.dequeue()) {
+    unsigned BlockID = Block->getBlockID();
+    joinInto(Block, In);
+
+    // Once a block was visited, only a new "in" value can change its "out"
+    // value.
+    bool FirstVisit = !VisitedBlocks[BlockID];
+    if (!FirstVisit && sameBits(In, InValues[BlockID]))
+      continue;
+    VisitedBlocks[BlockID] = true;
+    InValues[BlockID] = In;
+
+    llvm::BitVector Out(In);
+    Transfer(Block, Out);
+    ++NumVisits;
+
+    if (FirstVisit || !sameBits(Out, OutValues[BlockID])) {
+      OutValues[BlockID].swap(Out);
+      enqueueDependents(Block);
+    }
+  }
+  return NumVisits;
+}
+
+} // end namespace clang
+
+#endif
@@ -0,0 +1,85 @@
+//===- DataflowWorklist.h - Worklist for dataflow over CFGs -------*- C++ --*-//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the worklist shared by the dataflow analyses over CFGs,
+// such as LiveVariables and UninitializedValues.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_DATAFLOW_WORKLIST
+#define LLVM_CLANG_DATAFLOW_WORKLIST
+
+#include "clang/Analysis/CFG.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include <queue>
+#include <vector>
+
+namespace clang {
+
+class PostOrderCFGView;
+
+/// \brief A worklist of CFG blocks that always hands out the enqueued block
+/// that comes first in the direction of the analysis: in reverse post order
+/// for forward analyses, and in post order for backward analyses.
+///
+/// Visiting blocks in that order means that a block is usually visited after
+/// all of the blocks it depends on, so that each block is only visited again
+/// for the back edges it is on. Each block is in the worklist at most once.
+class DataflowWorklist {
+public:
+  enum Direction { Forward, Backward };
+
+private:
+  /// The position of each block, by block ID, in the order of the analysis.
+  /// Blocks that cannot be reached from the entry are at position 0.
+  std::vector<unsigned> BlockOrder;
+
+  llvm::BitVector EnqueuedBlocks;
+
+  struct QueueEntry {
+    unsigned Position;
+    unsigned BlockID;
+    const CFGBlock *Block;
+  };
+
+  /// Orders the queue so that it hands out the lowest position first. Blocks
+  /// at the same position, which are all unreachable, come out by block ID,
+  /// so that the order does not depend on where the blocks were allocated.
+  struct ComesLater {
+    bool operator()(const QueueEntry &A, const QueueEntry &B) const {
+      if (A.Position != B.Position)
+        return A.Position > B.Position;
+      return A.BlockID > B.BlockID;
+    }
+  };
+
+  std::priority_queue<QueueEntry, SmallVector<QueueEntry, 20>,
+                      ComesLater> Queue;
+
+public:
+  DataflowWorklist(const CFG &Cfg, PostOrderCFGView &POV, Direction Dir);
+
+  /// \brief Add \p Block to the worklist, unless it is null or already there.
+  void enqueueBlock(const CFGBlock *Block);
+
+  /// \brief Add the successors of \p Block, for forward analyses.
+  void enqueueSuccessors(const CFGBlock *Block);
+
+  /// \brief Add the predecessors of \p Block, for backward analyses.
+  void enqueuePredecessors(const CFGBlock *Block);
+
+  /// \brief Remove and return the next block to visit, or null if the
+  /// worklist is empty.
+  const CFGBlock *dequeue();
+};
+
+} // end namespace clang
+
+#endif
@@ -16,8 +16,8 @@
 
 #include "clang/AST/Decl.h"
 #include "clang/Analysis/AnalysisContext.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
-#include "llvm/ADT/ImmutableSet.h"
 
 namespace clang {
 
@@ -30,19 +30,21 @@ class SourceManager;
 class LiveVariables : public ManagedAnalysis {
 public:
   class LivenessValues {
+    /// The analysis that numbered the statements and variables.
+    const void *impl;
+
   public:
+    /// The live statements and variables, by the bit the analysis gave
+    /// each of them. Bits past the end are clear.
+    llvm::BitVector live;
 
-    llvm::ImmutableSet<const Stmt *> liveStmts;
-    llvm::ImmutableSet<const VarDecl *> liveDecls;
-    
     bool equals(const LivenessValues &V) const;
 
     LivenessValues()
-      : liveStmts(0), liveDecls(0) {}
+      : impl(0) {}
 
-    LivenessValues(llvm::ImmutableSet<const Stmt *> LiveStmts,
-                   llvm::ImmutableSet<const VarDecl *> LiveDecls)
-      : liveStmts(LiveStmts), liveDecls(LiveDecls) {}
+    LivenessValues(const void *Impl, const llvm::BitVector &Live)
+      : impl(Impl), live(Live) {}
 
     ~LivenessValues() {}
     
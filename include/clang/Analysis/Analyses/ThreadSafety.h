@@ -152,13 +152,25 @@ private:
   bool IssueBetaWarnings;
 };
 
+/// \brief The lock expressions of attributes that have already been parsed,
+/// shared between the analyses of the functions of a translation unit.
+class LockExprCache;
+
 /// \brief Check a function's CFG for thread-safety violations.
 ///
 /// We traverse the blocks in the CFG, compute the set of mutexes that are held
 /// at the end of each block, and issue warnings for thread safety violations.
 /// Each block in the CFG is traversed exactly once.
+///
+/// \param Cache If non-null, the lock expressions parsed for earlier functions
+/// are reused from *Cache, which is created on first use and must be released
+/// with \c threadSafetyCleanup() once the AST is no longer needed.
 void runThreadSafetyAnalysis(AnalysisDeclContext &AC,
-                             ThreadSafetyHandler &Handler);
+                             ThreadSafetyHandler &Handler,
+                             LockExprCache **Cache = 0);
+
+/// \brief Release the lock expressions cached by \c runThreadSafetyAnalysis().
+void threadSafetyCleanup(LockExprCache *Cache);
 
 /// \brief Helper function that returns a LockKind required for the given level
 /// of access.
@@ -74,7 +74,10 @@ class AnalysisDeclContext {
 
   const Decl * const D;
 
-  OwningPtr<CFG> cfg, completeCFG;
+  /// The CFGs of the declaration, with and without trivially false edges
+  /// pruned. They are owned by the manager if it shares them.
+  CFG *cfg, *completeCFG;
+  OwningPtr<CFG> ownedCFG, ownedCompleteCFG;
   OwningPtr<CFGStmtMap> cfgStmtMap;
 
   CFG::BuildOptions cfgBuildOptions;
@@ -91,6 +94,10 @@ class AnalysisDeclContext {
 
   void *ManagedAnalyses;
 
+  /// Build a CFG with the current build options, or retrieve the one the
+  /// manager has built with them.
+  CFG *buildCFG(OwningPtr<CFG> &Owned);
+
 public:
   AnalysisDeclContext(AnalysisDeclContextManager *Mgr,
                   const Decl *D);
@@ -402,6 +409,25 @@ class AnalysisDeclContextManager {
   ContextMap Contexts;
   LocationContextManager LocContexts;
   CFG::BuildOptions cfgBuildOptions;
+
+  /// \brief A CFG built with the manager's build options, and the last round
+  /// of analysis (the span between two calls to clear()) that asked for it.
+  struct SharedCFG {
+    CFG *Graph;
+    unsigned LastRound;
+  };
+
+  /// The CFGs built with the manager's build options, with and without
+  /// trivially false edges pruned. Unlike the contexts, a CFG survives the
+  /// first clear() after it was last used, so that the CFG built for a
+  /// top-level function's statistics also serves its analysis, and a callee
+  /// inlined into consecutive top-level functions is built once. The second
+  /// clear() without a use frees it.
+  typedef llvm::DenseMap<const Decl*, SharedCFG> CFGMap;
+  CFGMap CFGs, UnoptimizedCFGs;
+
+  /// The number of calls to clear() so far.
+  unsigned Round;
   
   /// Flag to indicate whether or not bodies should be synthesized
   /// for well-known functions.
@@ -453,7 +479,8 @@ public:
     return LocContexts.getStackFrame(getContext(D), Parent, S, Blk, Idx);
   }
 
-  /// Discard all previously created AnalysisDeclContexts.
+  /// Discard all previously created AnalysisDeclContexts, and the shared
+  /// CFGs that none of them used.
   void clear();
 
 private:
@@ -462,6 +489,13 @@ private:
   LocationContextManager &getLocationContextManager() {
     return LocContexts;
   }
+
+  /// Retrieve the CFG of the given context's declaration, built with its
+  /// build options, which must be the manager's.
+  CFG *getSharedCFG(AnalysisDeclContext &Ctx);
+
+  /// Free the CFGs in \p Map that were not used since the last clear().
+  void evictSharedCFGs(CFGMap &Map);
 };
 
 } // end clang namespace
@@ -617,6 +617,18 @@ public:
       return *this;
     }
 
+    /// \brief Whether CFGs built with these options and with \p Other can
+    /// only differ in whether trivially false edges are pruned, ignoring the
+    /// expressions forced to be block-level.
+    bool differsOnlyInPruning(const BuildOptions &Other) const {
+      return alwaysAddMask == Other.alwaysAddMask &&
+             AddEHEdges == Other.AddEHEdges &&
+             AddInitializers == Other.AddInitializers &&
+             AddImplicitDtors == Other.AddImplicitDtors &&
+             AddTemporaryDtors == Other.AddTemporaryDtors &&
+             AddStaticInitBranches == Other.AddStaticInitBranches;
+    }
+
     BuildOptions()
     : forcedBlkExprs(0), PruneTriviallyFalseEdges(true)
       ,AddEHEdges(false)
@@ -19,6 +19,7 @@
 #include "clang/Basic/DiagnosticOptions.h"
 #include "clang/Basic/SourceLocation.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/OwningPtr.h"
@@ -257,6 +258,46 @@ private:
   /// so we can get back at it when we 'pop'.
   std::vector<DiagState *> DiagStateOnPushStack;
 
+  /// \brief The diagnostics that map to "ignored" in every DiagState, so that
+  /// their level does not depend on the location.
+  ///
+  /// A bit of \c IgnoredEverywhere is only meaningful if the same bit of
+  /// \c IgnoredEverywhereKnown is set; both are computed lazily. Mapping a
+  /// diagnostic only updates its own bit, while a setting that can upgrade
+  /// any ignored diagnostic drops them all.
+  mutable llvm::BitVector IgnoredEverywhereKnown;
+  mutable llvm::BitVector IgnoredEverywhere;
+
+  /// \brief Number of level queries answered without looking up the
+  /// diagnostic state of their location.
+  mutable unsigned NumFastLevelQueries;
+
+  /// \brief Number of level queries that looked up the diagnostic state of
+  /// their location.
+  mutable unsigned NumSlowLevelQueries;
+
+  void invalidateIgnoredEverywhere() { IgnoredEverywhereKnown.reset(); }
+
+  /// \brief Update whether \p Diag is ignored everywhere, now that some
+  /// diagnostic state maps it according to \p Info.
+  void updateIgnoredEverywhere(diag::kind Diag,
+                               const DiagnosticMappingInfo &Info) {
+    if (Info.getMapping() != diag::MAP_IGNORE) {
+      // Every state is reachable, so this one keeps it from being ignored.
+      IgnoredEverywhereKnown.set(Diag);
+      IgnoredEverywhere.reset(Diag);
+    } else if (!Info.isUser() || !IgnoredEverywhereKnown.test(Diag) ||
+               !IgnoredEverywhere.test(Diag)) {
+      // A user mapping to "ignore" keeps an ignored diagnostic ignored;
+      // anything else needs another look at every state.
+      IgnoredEverywhereKnown.reset(Diag);
+    }
+  }
+
+  /// \brief Whether the builtin diagnostic \p DiagID is ignored at every
+  /// location, whatever its state.
+  bool isIgnoredEverywhere(unsigned DiagID) const;
+
   DiagState *GetCurDiagState() const {
     assert(!DiagStatePoints.empty());
     return DiagStatePoints.back().State;
@@ -435,7 +476,10 @@ public:
   /// ignored.
   ///
   /// If this and IgnoreAllWarnings are both set, then that one wins.
-  void setEnableAllWarnings(bool Val) { EnableAllWarnings = Val; }
+  void setEnableAllWarnings(bool Val) {
+    EnableAllWarnings = Val;
+    invalidateIgnoredEverywhere();
+  }
   bool getEnableAllWarnings() const { return EnableAllWarnings; }
 
   /// \brief When set to true, any warnings reported are issued as errors.
@@ -502,6 +546,7 @@ public:
   /// This corresponds to the GCC -pedantic and -pedantic-errors option.
   void setExtensionHandlingBehavior(ExtensionHandling H) {
     ExtBehavior = H;
+    invalidateIgnoredEverywhere();
   }
   ExtensionHandling getExtensionHandlingBehavior() const { return ExtBehavior; }
 
@@ -621,6 +666,9 @@ public:
   /// \brief Reset the state of the diagnostic object to its initial 
   /// configuration.
   void Reset();
+
+  /// \brief Print statistics about how diagnostic levels were computed.
+  void PrintStats() const;
   
   //===--------------------------------------------------------------------===//
   // DiagnosticsEngine classification and reporting interfaces.
@@ -0,0 +1,84 @@
+//===- TimeTrace.h - Hierarchical Compile-Time Profiler ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Defines a profiler that records nested, named events (entering a
+/// header, instantiating a template, emitting a function, ...) and writes
+/// them in the Chrome trace event format, viewable in chrome://tracing.
+///
+/// Profiling is enabled for the whole process by -ftime-trace. When it is
+/// disabled, a \c TimeTraceScope costs a single pointer comparison.
+///
+//===----------------------------------------------------------------------===//
+#ifndef LLVM_CLANG_BASIC_TIMETRACE_H
+#define LLVM_CLANG_BASIC_TIMETRACE_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compiler.h"
+
+namespace clang {
+
+class TimeTraceProfiler;
+
+/// \brief The active profiler, or null when time tracing is disabled.
+extern TimeTraceProfiler *TimeTraceProfilerInstance;
+
+/// \brief Start recording time-trace events.
+void initTimeTraceProfiler();
+
+/// \brief Stop recording time-trace events and discard the ones recorded.
+void cleanupTimeTraceProfiler();
+
+/// \brief Write the events recorded so far, along with the total time spent
+/// in each kind of event, as Chrome trace event JSON.
+void writeTimeTraceProfile(raw_ostream &OS);
+
+/// \brief Whether time-trace events are being recorded.
+inline bool isTimeTraceProfilerEnabled() {
+  return TimeTraceProfilerInstance != 0;
+}
+
+/// \brief Open an event, which lasts until the matching
+/// \c timeTraceProfilerEnd(). Events must be properly nested.
+///
+/// \param Name The kind of event, e.g. "Source"; events are totalled by name.
+/// \param Detail What the event is about, e.g. the name of the header.
+void timeTraceProfilerBegin(StringRef Name, StringRef Detail);
+
+/// \brief Close the most recently opened event.
+void timeTraceProfilerEnd();
+
+/// \brief Records an event for the lifetime of the object.
+///
+/// Computing the detail string can be expensive; callers that need to build
+/// one should check \c isTimeTraceProfilerEnabled() first and call
+/// \c timeTraceProfilerBegin() directly.
+class TimeTraceScope {
+  bool Active;
+
+  TimeTraceScope(const TimeTraceScope &) LLVM_DELETED_FUNCTION;
+  void operator=(const TimeTraceScope &) LLVM_DELETED_FUNCTION;
+
+public:
+  explicit TimeTraceScope(StringRef Name, StringRef Detail = StringRef())
+    : Active(isTimeTraceProfilerEnabled()) {
+    if (Active)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+
+  ~TimeTraceScope() {
+    if (Active)
+      timeTraceProfilerEnd();
+  }
+};
+
+} // end namespace clang
+
+#endif
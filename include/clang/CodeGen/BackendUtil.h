@@ -35,6 +35,23 @@ namespace clang {
                          const TargetOptions &TOpts, const LangOptions &LOpts,
                          llvm::Module *M,
                          BackendAction Action, raw_ostream *OS);
+
+  /// \brief Like EmitBackendOutput, but split \p M into as many partitions as
+  /// there are streams in \p OS, and optimize and generate code for each on
+  /// its own thread, in its own LLVMContext. The first partition is cut from
+  /// \p M in place, and compiled on the calling thread.
+  ///
+  /// Linking the objects written to \p OS together gives what
+  /// EmitBackendOutput would have written. If \p M can't be split, all of it
+  /// goes to the first stream, and the others get an empty object.
+  ///
+  /// \param Action Backend_EmitObj or Backend_EmitAssembly.
+  void EmitPartitionedBackendOutput(DiagnosticsEngine &Diags,
+                                    const CodeGenOptions &CGOpts,
+                                    const TargetOptions &TOpts,
+                                    const LangOptions &LOpts,
+                                    llvm::Module *M, BackendAction Action,
+                                    ArrayRef<raw_ostream *> OS);
 }
 
 #endif
@@ -248,6 +248,11 @@ private:
   /// \brief A list of the serialization ID numbers for each of the top-level
   /// declarations parsed within the precompiled preamble.
   std::vector<serialization::DeclID> TopLevelDeclsInPreamble;
+
+  struct PreambleRebuild;
+
+  /// \brief The preamble being precompiled in the background, if any.
+  OwningPtr<PreambleRebuild> PendingPreamble;
   
   /// \brief Whether we should be caching code-completion results.
   bool ShouldCacheCodeCompletionResults : 1;
@@ -256,6 +261,10 @@ private:
   /// completions cached.
   bool IncludeBriefCommentsInCodeCompletion : 1;
 
+  /// \brief Whether to precompile an out-of-date preamble on a worker thread
+  /// instead of before reparsing.
+  bool RebuildPreambleInBackground : 1;
+
   /// \brief True if non-system source files should be treated as volatile
   /// (likely to change while trying to use them).
   bool UserFilesAreVolatile : 1;
@@ -391,6 +400,18 @@ private:
                                const CompilerInvocation &PreambleInvocationIn,
                                                      bool AllowRebuild = true,
                                                         unsigned MaxLines = 0);
+  bool startPreambleRebuild(CompilerInvocation &PreambleInvocation,
+                            const std::pair<llvm::MemoryBuffer *,
+                                     std::pair<unsigned, bool> > &NewPreamble);
+  llvm::MemoryBuffer *getMainBufferWithRebuiltPreamble(
+                            CompilerInvocation &PreambleInvocation,
+                            const std::pair<llvm::MemoryBuffer *,
+                                     std::pair<unsigned, bool> > &NewPreamble);
+  llvm::MemoryBuffer *getMainBufferWithStalePreamble(
+                            CompilerInvocation &PreambleInvocation,
+                            const std::pair<llvm::MemoryBuffer *,
+                                     std::pair<unsigned, bool> > &NewPreamble);
+  void sharePrecompiledPreamble(const std::string &Key);
   void RealizeTopLevelDeclsFromPreamble();
 
   /// \brief Transfers ownership of the objects (like SourceManager) from
@@ -483,6 +504,20 @@ public:
   bool getOwnsRemappedFileBuffers() const { return OwnsRemappedFileBuffers; }
   void setOwnsRemappedFileBuffers(bool val) { OwnsRemappedFileBuffers = val; }
 
+  /// \brief Set whether an out-of-date precompiled preamble is rebuilt on a
+  /// worker thread, so that reparsing doesn't wait for it.
+  ///
+  /// Until the new preamble is ready, reparsing keeps using the old one if
+  /// only the main file's preamble changed, and otherwise parses without a
+  /// preamble. Only affects units that already have a preamble.
+  void setRebuildPreambleInBackground(bool Value) {
+    RebuildPreambleInBackground = Value;
+  }
+
+  /// \brief Wait until the preamble being rebuilt in the background, if any,
+  /// is ready; the next reparse uses it.
+  void waitForPreambleRebuild();
+
   StringRef getMainFileName() const;
 
   /// \brief If this ASTUnit came from an AST file, returns the filename for it.
@@ -634,6 +669,12 @@ public:
   /// \brief Get the PCH file if one was included.
   const FileEntry *getPCHFile();
 
+  /// \brief Get the path of the precompiled preamble this unit was parsed
+  /// with, or an empty string if there is none.
+  ///
+  /// Units that share a preamble return the same path.
+  StringRef getPrecompiledPreambleFile() const;
+
   /// \brief Returns true if the ASTUnit was constructed from a serialized
   /// module file.
   bool isModuleFile();
@@ -115,6 +115,14 @@ public:
   /// Path to blacklist file for sanitizers.
   std::string SanitizerBlacklistFile;
 
+  /// The file to list the linkonce_odr functions in whose definitions are
+  /// left to a shared translation unit (-fshared-linkonce-record=).
+  std::string SharedLinkonceRecordFile;
+
+  /// The file listing the linkonce_odr functions to define for the other
+  /// translation units (-fshared-linkonce-emit=).
+  std::string SharedLinkonceEmitFile;
+
   /// If not an empty string, trap intrinsics are lowered to calls to this
   /// function instead of to trap instructions.
   std::string TrapFuncName;
@@ -49,6 +49,9 @@ enum RecordIDs {
 /// \brief Returns a DiagnosticConsumer that serializes diagnostics to
 ///  a bitcode file.
 ///
+/// Diagnostics are written to \p OS in batches as they are reported, so that
+/// memory use doesn't grow with their number.
+///
 /// The created DiagnosticConsumer is designed for quick and lightweight
 /// transfer of of diagnostics to the enclosing build system (e.g., an IDE).
 /// This allows wrapper tools for Clang to get diagnostics from Clang
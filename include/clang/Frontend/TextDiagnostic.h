@@ -17,6 +17,7 @@
 #define LLVM_CLANG_FRONTEND_TEXT_DIAGNOSTIC_H_
 
 #include "clang/Frontend/DiagnosticRenderer.h"
+#include "llvm/ADT/DenseMap.h"
 
 namespace clang {
 
@@ -35,6 +36,20 @@ namespace clang {
 class TextDiagnostic : public DiagnosticRenderer {
   raw_ostream &OS;
 
+  /// \brief A source line shown by emitSnippetAndCaret().
+  struct SnippetLine {
+    unsigned LineNo;
+    unsigned Start; ///< The offset of the first character of the line.
+    unsigned End;   ///< The offset of the end of the line.
+  };
+
+  /// \brief The line last shown from each file of \c SnippetLinesSM.
+  ///
+  /// Diagnostics tend to come in runs that point into the same line, which
+  /// then doesn't need to be looked up in the SourceManager again.
+  llvm::DenseMap<FileID, SnippetLine> SnippetLines;
+  const SourceManager *SnippetLinesSM;
+
 public:
   TextDiagnostic(raw_ostream &OS,
                  const LangOptions &LangOpts,
@@ -19,6 +19,7 @@
 #include "clang/Lex/PPCallbacks.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
+#include "llvm/ADT/PointerIntPair.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/Compiler.h"
@@ -293,9 +294,30 @@ namespace clang {
     /// \brief Allocator used to store preprocessing objects.
     llvm::BumpPtrAllocator BumpAlloc;
 
-    /// \brief The set of preprocessed entities in this record, in order they
-    /// were seen.
-    std::vector<PreprocessedEntity *> PreprocessedEntities;
+    /// \brief How a local preprocessed entity is stored.
+    enum LocalEntityKind {
+      /// \brief The entity has been allocated; the pointer is the
+      /// \c PreprocessedEntity.
+      LEK_Entity,
+      /// \brief A macro expansion that has not been allocated; the pointer is
+      /// the \c MacroDefinition of the macro.
+      LEK_MacroExpansion,
+      /// \brief A builtin macro expansion that has not been allocated; the
+      /// pointer is the \c IdentifierInfo of the macro.
+      LEK_BuiltinMacroExpansion
+    };
+    typedef llvm::PointerIntPair<void *, 2, LocalEntityKind> LocalEntityRef;
+
+    /// \brief The preprocessed entities in this record, in source order.
+    ///
+    /// Records of large translation units are mostly macro expansions, so the
+    /// entities are kept in parallel arrays of their begin locations, of the
+    /// offsets of their end locations from their begin locations, and of what
+    /// they are. Macro expansions are only allocated as \c MacroExpansion
+    /// objects when a client asks for them.
+    std::vector<SourceLocation> LocalEntityBegins;
+    std::vector<unsigned> LocalEntityEndOffsets;
+    std::vector<LocalEntityRef> LocalEntities;
     
     /// \brief The set of preprocessed entities in this record that have been
     /// loaded from external sources.
@@ -336,6 +358,27 @@ namespace clang {
 
     /// \brief Retrieve the loaded preprocessed entity at the given index.
     PreprocessedEntity *getLoadedPreprocessedEntity(unsigned Index);
+
+    /// \brief Retrieve the local preprocessed entity at the given index,
+    /// allocating it if it is a macro expansion that has not been yet.
+    PreprocessedEntity *getLocalPreprocessedEntity(unsigned Index);
+
+    /// \brief Retrieve the source range of the local preprocessed entity at
+    /// the given index.
+    SourceRange getLocalEntityRange(unsigned Index) const {
+      SourceLocation Begin = LocalEntityBegins[Index];
+      return SourceRange(Begin, SourceLocation::getFromRawEncoding(
+                 Begin.getRawEncoding() + LocalEntityEndOffsets[Index]));
+    }
+
+    /// \brief If the local preprocessed entity at the given index is a macro
+    /// expansion, set \p Def to the definition of the macro, or \p BuiltinName
+    /// to its name if it is builtin, without allocating the expansion.
+    bool getLocalMacroExpansion(unsigned Index, MacroDefinition *&Def,
+                                const IdentifierInfo *&BuiltinName) const;
+
+    /// \brief Add a local preprocessed entity covering \p Range.
+    PPEntityID addLocalEntity(SourceRange Range, LocalEntityRef Ref);
     
     /// \brief Determine the number of preprocessed entities that were
     /// loaded (or can be loaded) from an external source.
@@ -502,7 +545,7 @@ namespace clang {
 
     /// \brief End iterator for all preprocessed entities.
     iterator end() {
-      return iterator(this, PreprocessedEntities.size());
+      return iterator(this, LocalEntities.size());
     }
 
     /// \brief Begin iterator for local, non-loaded, preprocessed entities.
@@ -512,7 +555,7 @@ namespace clang {
 
     /// \brief End iterator for local, non-loaded, preprocessed entities.
     iterator local_end() {
-      return iterator(this, PreprocessedEntities.size());
+      return iterator(this, LocalEntities.size());
     }
 
     /// \brief begin/end iterator pair for the given range of loaded
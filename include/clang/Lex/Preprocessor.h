@@ -30,6 +30,7 @@
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Allocator.h"
 #include <vector>
 
@@ -325,6 +326,48 @@ class Preprocessor : public RefCountedBase<Preprocessor> {
   MacroArgs *MacroArgCache;
   friend class MacroArgs;
 
+  /// \brief A string literal made by the # operator, in the scratch buffer.
+  struct StringifiedArgument {
+    SourceLocation Loc;
+    const char *Data;
+    unsigned Length;
+  };
+
+  /// StringifyCache - The results of stringifying macro arguments, keyed by
+  /// the spelling locations, kinds and spacing of the argument tokens, which
+  /// is all the result depends on.  Lets arguments that are stringified over
+  /// and over, e.g. by X-macros, share their spelling in the scratch buffer.
+  llvm::StringMap<StringifiedArgument> StringifyCache;
+
+  /// \brief A token of a pre-expanded macro argument, with where it came
+  /// from in terms of the argument's tokens.
+  struct PreExpandedToken {
+    /// \brief The token. If it came from a macro expanded in the argument,
+    /// its location is its spelling location.
+    Token Tok;
+
+    /// \brief The index of the argument token this token is, or of the first
+    /// token of the macro invocation in the argument it was expanded from.
+    unsigned First;
+
+    /// \brief The index of the last token of that macro invocation, or ~0U
+    /// if the token came straight from the argument.
+    unsigned Last;
+  };
+
+  /// PreExpArgCache - The results of pre-expanding macro arguments, keyed by
+  /// the spelling locations, kinds and flags of the argument tokens, plus the
+  /// macros that were disabled at the time.  Since the result also depends on every
+  /// macro definition, the cache is flushed whenever one changes.  Only used
+  /// when there are no PPCallbacks, because reusing an expansion skips the
+  /// MacroExpands callbacks of the macros expanded in the argument.
+  llvm::StringMap<std::vector<PreExpandedToken> > PreExpArgCache;
+
+  /// NumDiagnostics - The number of diagnostics issued through Diag(),
+  /// including those that turn out to be ignored.  Work that issued a
+  /// diagnostic is not cached, so that the diagnostic is issued again.
+  mutable unsigned NumDiagnostics;
+
   /// PragmaPushMacroInfo - For each IdentifierInfo used in a #pragma
   /// push_macro directive, we keep a MacroInfo stack used to restore
   /// previous macro value.
@@ -337,6 +380,8 @@ class Preprocessor : public RefCountedBase<Preprocessor> {
   unsigned NumMacroExpanded, NumFnMacroExpanded, NumBuiltinMacroExpanded;
   unsigned NumFastMacroExpanded, NumTokenPaste, NumFastTokenPaste;
   unsigned NumSkipped;
+  unsigned NumStringifiedArgHits, NumStringifiedArgMisses;
+  unsigned NumPreExpArgHits, NumPreExpArgMisses;
 
   /// Predefines - This string is the predefined macros that preprocessor
   /// should use from the command line etc.
@@ -555,6 +600,10 @@ public:
   /// \brief Set a MacroDirective that was loaded from a PCH file.
   void setLoadedMacroDirective(IdentifierInfo *II, MacroDirective *MD);
 
+  /// \brief Collect the macros that are currently being expanded, and so are
+  /// not expanded again, innermost first.
+  void getDisabledMacros(SmallVectorImpl<const MacroInfo *> &MIs) const;
+
   /// macro_iterator/macro_begin/macro_end - This allows you to walk the macro
   /// history table. Currently defined macros have
   /// IdentifierInfo::hasMacroDefinition() set and an empty
@@ -926,10 +975,12 @@ public:
   /// the specified Token's location, translating the token's start
   /// position in the current buffer into a SourcePosition object for rendering.
   DiagnosticBuilder Diag(SourceLocation Loc, unsigned DiagID) const {
+    ++NumDiagnostics;
     return Diags->Report(Loc, DiagID);
   }
 
   DiagnosticBuilder Diag(const Token &Tok, unsigned DiagID) const {
+    ++NumDiagnostics;
     return Diags->Report(Tok.getLocation(), DiagID);
   }
 
@@ -81,6 +81,13 @@ public:
   /// The boolean indicates whether the preamble ends at the start of a new
   /// line.
   std::pair<unsigned, bool> PrecompiledPreambleBytes;
+
+  /// \brief The main source file that the precompiled preamble is applied to.
+  ///
+  /// A precompiled preamble can be shared by every main file that starts with
+  /// the same preamble text. When this is non-empty, the main file that the
+  /// preamble was built from is read as this file instead.
+  std::string PrecompiledPreambleMainFile;
   
   /// The implicit PTH input included at the start of the translation unit, or
   /// empty.
@@ -225,6 +232,7 @@ public:
     RetainRemappedFileBuffers = true;
     PrecompiledPreambleBytes.first = 0;
     PrecompiledPreambleBytes.second = 0;
+    PrecompiledPreambleMainFile.clear();
   }
 };
 
@@ -18,6 +18,7 @@
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Rewrite/Core/DeltaTree.h"
 #include "clang/Rewrite/Core/RewriteRope.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include <cstring>
 #include <map>
@@ -91,6 +92,24 @@ public:
   void ReplaceText(unsigned OrigOffset, unsigned OrigLength,
                    StringRef NewStr);
 
+  /// Edit - A range of characters in the input buffer, and the string that
+  /// replaces it.
+  struct Edit {
+    unsigned OrigOffset;
+    unsigned OrigLength;
+    StringRef NewStr;
+
+    Edit(unsigned OrigOffset, unsigned OrigLength, StringRef NewStr)
+      : OrigOffset(OrigOffset), OrigLength(OrigLength), NewStr(NewStr) {}
+  };
+
+  /// ReplaceTexts - Apply many replacements at once, copying the buffer a
+  /// single time instead of splicing each replacement into it.  The edits
+  /// must be sorted by offset and must not overlap, except that insertions
+  /// (edits of length 0) may precede other edits at the same offset; each
+  /// edit is positioned as if it were the only one.
+  void ReplaceTexts(ArrayRef<Edit> Edits);
+
 private:  // Methods only usable by Rewriter.
 
   /// Initialize - Start this rewrite buffer out with a copy of the unmodified
@@ -27,6 +27,9 @@ class Sema;
 namespace sema {
   class FunctionScopeInfo;
 }
+namespace thread_safety {
+  class LockExprCache;
+}
 
 namespace sema {
 
@@ -50,6 +53,10 @@ private:
   enum VisitFlag { NotVisited = 0, Visited = 1, Pending = 2 };
   llvm::DenseMap<const FunctionDecl*, VisitFlag> VisitedFD;
 
+  /// \brief The lock expressions parsed by the thread safety analysis of
+  /// earlier functions.
+  thread_safety::LockExprCache *ThreadSafetyCache;
+
   /// \name Statistics
   /// @{
 
@@ -88,6 +95,7 @@ private:
 
 public:
   AnalysisBasedWarnings(Sema &s);
+  ~AnalysisBasedWarnings();
 
   void IssueWarnings(Policy P, FunctionScopeInfo *fscope,
                      const Decl *D, const BlockExpr *blkExpr);
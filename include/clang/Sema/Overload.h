@@ -22,6 +22,7 @@
 #include "clang/AST/Type.h"
 #include "clang/AST/UnresolvedSet.h"
 #include "clang/Sema/SemaFixItUtils.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Allocator.h"
@@ -753,6 +754,18 @@ namespace clang {
     unsigned NumInlineSequences;
     char InlineSpace[16 * sizeof(ImplicitConversionSequence)];
 
+  public:
+    /// \brief Identifies the conversion of an argument to a parameter type,
+    /// along with the flags the conversion was computed with.
+    typedef std::pair<std::pair<Expr *, void *>, unsigned> ConversionKey;
+
+  private:
+    /// \brief The conversion sequences computed so far for the arguments of
+    /// this call. Candidates often share parameter types (e.g. the stream
+    /// parameter of every operator<<), so the sequence computed for one
+    /// candidate is reused for the others.
+    llvm::DenseMap<ConversionKey, ImplicitConversionSequence> Conversions;
+
     OverloadCandidateSet(const OverloadCandidateSet &) LLVM_DELETED_FUNCTION;
     void operator=(const OverloadCandidateSet &) LLVM_DELETED_FUNCTION;
 
@@ -773,6 +786,23 @@ namespace clang {
     /// \brief Clear out all of the candidates.
     void clear();
 
+    /// \brief Retrieve the conversion sequence computed earlier for \p Key,
+    /// or null if there is none.
+    const ImplicitConversionSequence *
+    getCachedConversion(const ConversionKey &Key) const {
+      llvm::DenseMap<ConversionKey, ImplicitConversionSequence>::const_iterator
+        Known = Conversions.find(Key);
+      if (Known == Conversions.end())
+        return 0;
+      return &Known->second;
+    }
+
+    /// \brief Remember the conversion sequence computed for \p Key.
+    void setCachedConversion(const ConversionKey &Key,
+                             const ImplicitConversionSequence &ICS) {
+      Conversions[Key] = ICS;
+    }
+
     typedef SmallVector<OverloadCandidate, 16>::iterator iterator;
     iterator begin() { return Candidates.begin(); }
     iterator end() { return Candidates.end(); }
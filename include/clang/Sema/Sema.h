@@ -146,12 +146,14 @@ namespace clang {
   class StandardConversionSequence;
   class Stmt;
   class StringLiteral;
+  class SubstTypeCache;
   class SwitchStmt;
   class TargetAttributesSema;
   class TemplateArgument;
   class TemplateArgumentList;
   class TemplateArgumentLoc;
   class TemplateDecl;
+  class TemplateInstantiationStats;
   class TemplateParameterList;
   class TemplatePartialOrderingContext;
   class TemplateTemplateParmDecl;
@@ -739,6 +741,11 @@ public:
   /// \brief The number of SFINAE diagnostics that have been trapped.
   unsigned NumSFINAEErrors;
 
+  /// \brief The number of conversion sequences computed for overload
+  /// candidates, and how many of them were reused from another candidate
+  /// for the same call.
+  unsigned NumConversionSequenceLookups, NumConversionSequenceHits;
+
   typedef llvm::DenseMap<ParmVarDecl *, SmallVector<ParmVarDecl *, 1> >
     UnparsedDefaultArgInstantiationsMap;
 
@@ -852,6 +859,14 @@ public:
 
   void PrintStats() const;
 
+  /// \brief Start collecting the per-template statistics reported by
+  /// \c PrintTemplateStats().
+  void enableTemplateStats();
+
+  /// \brief Print the templates that were instantiated most often and that
+  /// took the longest to instantiate (-ftemplate-stats).
+  void PrintTemplateStats() const;
+
   /// \brief Helper class that creates diagnostics with optional
   /// template instantiation stacks.
   ///
@@ -5834,6 +5849,14 @@ public:
   /// to implement it anywhere else.
   ActiveTemplateInstantiation LastTemplateInstantiationErrorContext;
 
+  /// \brief Counts and times template instantiations, or null if
+  /// -ftemplate-stats is not in effect.
+  OwningPtr<TemplateInstantiationStats> TemplateStats;
+
+  /// \brief Memoized results of substituting template arguments into types,
+  /// created on first use.
+  OwningPtr<SubstTypeCache> SubstTypes;
+
   /// \brief The current index into pack expansion arguments that will be
   /// used for substitution of parameter packs.
   ///
@@ -15,6 +15,8 @@
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/DeclVisitor.h"
 #include "clang/Sema/Sema.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/FoldingSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include <cassert>
 #include <utility>
@@ -110,6 +112,12 @@ namespace clang {
     const ArgList &getInnermost() const { 
       return TemplateArgumentLists.front(); 
     }
+
+    /// \brief Retrieve the template argument list at the given depth.
+    const ArgList &getLevel(unsigned Depth) const {
+      assert(Depth < TemplateArgumentLists.size());
+      return TemplateArgumentLists[getNumLevels() - Depth - 1];
+    }
   };
   
   /// \brief The context in which partial ordering of function templates occurs.
@@ -502,6 +510,92 @@ namespace clang {
                            ClassTemplatePartialSpecializationDecl *PartialSpec);
     void InstantiateEnumDefinition(EnumDecl *Enum, EnumDecl *Pattern);
   };  
+
+  /// \brief Memoizes the result of substituting a set of template arguments
+  /// into a type.
+  ///
+  /// The same dependent type is often substituted with the same arguments
+  /// along different paths, e.g. the type of a non-type template parameter
+  /// during every deduction or the pattern of an alias template at every
+  /// use. Only types whose substitution depends on nothing but the template
+  /// arguments are memoized; see \c Sema::SubstType().
+  class SubstTypeCache {
+    struct Entry : llvm::FastFoldingSetNode {
+      QualType Result;
+
+      explicit Entry(const llvm::FoldingSetNodeID &ID)
+        : llvm::FastFoldingSetNode(ID) { }
+    };
+
+    llvm::FoldingSet<Entry> Entries;
+
+    SubstTypeCache(const SubstTypeCache &) LLVM_DELETED_FUNCTION;
+    void operator=(const SubstTypeCache &) LLVM_DELETED_FUNCTION;
+
+  public:
+    /// \brief The number of lookups, and how many of them found a result.
+    unsigned NumLookups, NumHits;
+
+    SubstTypeCache() : NumLookups(0), NumHits(0) { }
+    ~SubstTypeCache();
+
+    /// \brief Compute the key for substituting \p TemplateArgs into \p T.
+    static void Profile(llvm::FoldingSetNodeID &ID, ASTContext &Context,
+                        QualType T,
+                        const MultiLevelTemplateArgumentList &TemplateArgs);
+
+    /// \brief Retrieve the memoized result for \p ID, or a null type.
+    QualType lookup(const llvm::FoldingSetNodeID &ID);
+
+    /// \brief Remember that substitution for \p ID produced \p Result.
+    void insert(const llvm::FoldingSetNodeID &ID, QualType Result);
+
+    unsigned size() const { return Entries.size(); }
+  };
+
+  /// \brief Counts and times template instantiations by the template they
+  /// were instantiated from, for -ftemplate-stats.
+  class TemplateInstantiationStats {
+  public:
+    struct TemplateInfo {
+      /// \brief The number of instantiations.
+      unsigned Count;
+
+      /// \brief The deepest point on the instantiation stack at which the
+      /// template was instantiated.
+      unsigned MaxDepth;
+
+      /// \brief The time spent instantiating, in seconds, including nested
+      /// instantiations but counting recursive ones only once.
+      double Time;
+
+      /// \brief How many instantiations of this template are in progress.
+      unsigned Active;
+
+      TemplateInfo() : Count(0), MaxDepth(0), Time(0), Active(0) { }
+    };
+
+  private:
+    /// \brief The template and start time of every active instantiation,
+    /// parallel to \c Sema::ActiveTemplateInstantiations. The template is
+    /// null for entries that are not counted.
+    SmallVector<std::pair<const Decl *, double>, 16> Stack;
+
+  public:
+    llvm::DenseMap<const Decl *, TemplateInfo> Templates;
+
+    /// \brief The total number of instantiations and the deepest point on
+    /// the instantiation stack that was reached.
+    unsigned NumInstantiations, MaxDepth;
+
+    TemplateInstantiationStats() : NumInstantiations(0), MaxDepth(0) { }
+
+    /// \brief Note that \p Inst was pushed onto the instantiation stack.
+    void begin(const Sema::ActiveTemplateInstantiation &Inst, unsigned Depth);
+
+    /// \brief Note that the innermost instantiation has finished.
+    void end();
+  };
 }
 
 #endif // LLVM_CLANG_SEMA_TEMPLATE_H
@@ -21,9 +21,8 @@
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/MemoryBuffer.h"
-#include "llvm/Support/SourceMgr.h"
-#include "llvm/Support/YAMLParser.h"
 #include <string>
 #include <vector>
 
@@ -47,6 +46,9 @@ namespace tooling {
 ///
 /// JSON compilation databases can for example be generated in CMake projects
 /// by setting the flag -DCMAKE_EXPORT_COMPILE_COMMANDS.
+///
+/// Loading only indexes the database by file; a command line is unescaped
+/// and split into arguments when it is requested.
 class JSONCompilationDatabase : public CompilationDatabase {
 public:
   /// \brief Loads a JSON compilation database from the specified file.
@@ -56,6 +58,22 @@ public:
   static JSONCompilationDatabase *loadFromFile(StringRef FilePath,
                                                std::string &ErrorMessage);
 
+  /// \brief Loads a JSON compilation database from the specified file,
+  /// using the index of it cached in \p IndexPath.
+  ///
+  /// The index records the file of every command and where the command is
+  /// in the database. It is only used if it was written for a database of
+  /// the size and modification time \p FilePath has now; otherwise the
+  /// database is parsed and the index written anew. With an up-to-date
+  /// index the database is not scanned at all, and only the commands that
+  /// are requested are ever read from it.
+  ///
+  /// Returns NULL and sets ErrorMessage if the database could not be
+  /// loaded; an index that cannot be read or written is not an error.
+  static JSONCompilationDatabase *loadFromFile(StringRef FilePath,
+                                               StringRef IndexPath,
+                                               std::string &ErrorMessage);
+
   /// \brief Loads a JSON compilation database from a data buffer.
   ///
   /// Returns NULL and sets ErrorMessage if the database could not be loaded.
@@ -82,7 +100,7 @@ public:
 private:
   /// \brief Constructs a JSON compilation database on a memory buffer.
   JSONCompilationDatabase(llvm::MemoryBuffer *Database)
-    : Database(Database), YAMLStream(Database->getBuffer(), SM) {}
+    : Database(Database) {}
 
   /// \brief Parses the database file and creates the index.
   ///
@@ -90,10 +108,55 @@ private:
   /// failed.
   bool parse(std::string &ErrorMessage);
 
-  // Tuple (directory, commandline) where 'commandline' pointing to the
-  // corresponding nodes in the YAML stream.
-  typedef std::pair<llvm::yaml::ScalarNode*,
-                    llvm::yaml::ScalarNode*> CompileCommandRef;
+  /// \brief Indexes the database in a single pass over the buffer, without
+  /// building a document tree or copying the command lines.
+  ///
+  /// Only accepts a plain array of objects with string values, which is what
+  /// generators write. Returns false, having indexed nothing, on anything
+  /// else; \c parse() then falls back to \c parseYAML().
+  bool parseFast();
+
+  /// \brief Indexes the database with the YAML parser, which also accepts
+  /// the YAML extensions of JSON and diagnoses malformed databases.
+  bool parseYAML(std::string &ErrorMessage);
+
+  /// \brief The directory and the command line of a compile command.
+  struct CompileCommandRef {
+    StringRef Directory;
+    StringRef CommandLine;
+
+    /// \brief Whether \c Directory and \c CommandLine are the raw contents
+    /// of JSON strings in the database, rather than their values.
+    bool Escaped;
+  };
+
+  /// \brief Indexes the database from \p Index, the contents of an index
+  /// file written by \c writeIndex() for a database of \p Size bytes last
+  /// modified at \p ModTime.
+  ///
+  /// Returns false, having indexed nothing, if \p Index was written for
+  /// another database or is damaged.
+  bool readIndex(StringRef Index, uint64_t ModTime, uint64_t Size);
+
+  /// \brief Writes the index to \p IndexPath, for a database of \p Size
+  /// bytes last modified at \p ModTime.
+  ///
+  /// Does nothing unless every command is in the database buffer, i.e. it
+  /// was indexed by \c parseFast().
+  void writeIndex(StringRef IndexPath, uint64_t ModTime, uint64_t Size) const;
+
+  /// \brief Adds a compile command for \p FileName, which is relative to
+  /// \p Directory unless absolute, to the index.
+  void addCommand(StringRef FileName, StringRef Directory,
+                  const CompileCommandRef &Command);
+
+  /// \brief Adds a compile command for the absolute, native path
+  /// \p NativeFilePath to the index.
+  void addNativeCommand(StringRef NativeFilePath,
+                        const CompileCommandRef &Command);
+
+  /// \brief Copies \p Str into \c Strings.
+  StringRef copyString(StringRef Str);
 
   /// \brief Converts the given array of CompileCommandRefs to CompileCommands.
   void getCommands(ArrayRef<CompileCommandRef> CommandsRef,
@@ -105,8 +168,9 @@ private:
   FileMatchTrie MatchTrie;
 
   OwningPtr<llvm::MemoryBuffer> Database;
-  llvm::SourceMgr SM;
-  llvm::yaml::Stream YAMLStream;
+
+  /// \brief Holds the values of the compile commands read by \c parseYAML().
+  llvm::BumpPtrAllocator Strings;
 };
 
 } // end namespace tooling
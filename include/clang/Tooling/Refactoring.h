@@ -108,7 +108,11 @@ typedef std::set<Replacement, Replacement::Less> Replacements;
 /// \brief Apply all replacements in \p Replaces to the Rewriter \p Rewrite.
 ///
 /// Replacement applications happen independently of the success of
-/// other applications.
+/// other applications.  The replacements of each file are applied together
+/// in a single pass over the file.  Replacements that reach past the end of
+/// their file, or that overlap an earlier replacement in the same file, are
+/// not applied.  Insertions at the offset of another replacement are applied
+/// before it.
 ///
 /// \returns true if all replacements apply. false otherwise.
 bool applyAllReplacements(Replacements &Replaces, Rewriter &Rewrite);
@@ -35,6 +35,8 @@
 #include "llvm/Support/Capacity.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <functional>
 #include <map>
 
 using namespace clang;
@@ -765,6 +767,13 @@ void ASTContext::PrintStats() const {
                << NumImplicitDestructors
                << " implicit destructors created\n";
 
+  llvm::errs() << getASTAllocatedMemory() << " bytes allocated for AST nodes, "
+               << getSideTableAllocatedMemory() << " bytes for side tables\n";
+
+  if (AllParents)
+    llvm::errs() << AllParents->size() << " parent map entries, "
+                 << llvm::capacity_in_bytes(*AllParents) << " bytes\n";
+
   if (ExternalSource.get()) {
     llvm::errs() << "\n";
     ExternalSource->PrintStats();
@@ -773,6 +782,76 @@ void ASTContext::PrintStats() const {
   BumpAlloc.PrintStats();
 }
 
+namespace {
+/// \brief Orders the entries of a parent map by node only, so that a stable
+/// sort keeps the parents of each node in traversal order.
+struct ParentMapEntryLess {
+  typedef ASTContext::ParentMap::value_type Entry;
+
+  bool operator()(const Entry &X, const Entry &Y) const {
+    return std::less<const void *>()(X.first, Y.first);
+  }
+  bool operator()(const Entry &X, const void *Y) const {
+    return std::less<const void *>()(X.first, Y);
+  }
+  bool operator()(const void *X, const Entry &Y) const {
+    return std::less<const void *>()(X, Y.first);
+  }
+};
+} // end anonymous namespace
+
+/// \brief Sort a parent map built in traversal order by node, and drop the
+/// parents recorded more than once for the same node.
+static void sortParentMap(ASTContext::ParentMap &Map) {
+  std::stable_sort(Map.begin(), Map.end(), ParentMapEntryLess());
+
+  unsigned Out = 0;
+  for (unsigned I = 0, N = Map.size(); I != N;) {
+    unsigned RunStart = Out;
+    const void *Node = Map[I].first;
+    for (; I != N && Map[I].first == Node; ++I) {
+      bool Seen = false;
+      for (unsigned J = RunStart; J != Out && !Seen; ++J)
+        Seen = Map[J].second.getOpaqueValue() ==
+               Map[I].second.getOpaqueValue();
+      if (!Seen)
+        Map[Out++] = Map[I];
+    }
+  }
+  Map.resize(Out);
+
+  // Give back the slack left by growing the vector and by the duplicates.
+  ASTContext::ParentMap(Map).swap(Map);
+}
+
+ASTContext::ParentVector
+ASTContext::getParents(const ast_type_traits::DynTypedNode &Node) {
+  assert(Node.getMemoizationData() &&
+         "Invariant broken: only nodes that support memoization may be "
+         "used in the parent map.");
+  if (!AllParents) {
+    // We always need to run over the whole translation unit, as
+    // hasAncestor can escape any subtree.
+    AllParents.reset(
+        ParentMapASTVisitor::buildMap(*getTranslationUnitDecl()));
+    sortParentMap(*AllParents);
+  }
+
+  std::pair<ParentMap::const_iterator, ParentMap::const_iterator> Range =
+    std::equal_range(AllParents->begin(), AllParents->end(),
+                     Node.getMemoizationData(), ParentMapEntryLess());
+  ParentVector Result;
+  for (; Range.first != Range.second; ++Range.first) {
+    ParentRef Parent = Range.first->second;
+    if (const Decl *D = Parent.dyn_cast<const Decl *>())
+      Result.push_back(ast_type_traits::DynTypedNode::create(*D));
+    else
+      Result.push_back(
+          ast_type_traits::DynTypedNode::create(*Parent.get<const Stmt *>()));
+  }
+  return Result;
+}
+
 TypedefDecl *ASTContext::getInt128Decl() const {
   if (!Int128Decl) {
     TypeSourceInfo *TInfo = getTrivialTypeSourceInfo(Int128Ty);
@@ -1002,6 +1081,24 @@ void ASTContext::setClassScopeSpecializationPattern(FunctionDecl *FD,
   ClassScopeSpecializationPattern[FD] = Pattern;
 }
 
+ArrayRef<NamedDecl *>
+ASTContext::getDeclsInPrototypeScope(const FunctionDecl *FD) const {
+  llvm::DenseMap<const FunctionDecl*, ArrayRef<NamedDecl *> >::const_iterator
+    Pos = DeclsInPrototypeScope.find(FD);
+  if (Pos == DeclsInPrototypeScope.end())
+    return ArrayRef<NamedDecl *>();
+
+  return Pos->second;
+}
+
+void ASTContext::setDeclsInPrototypeScope(const FunctionDecl *FD,
+                                          ArrayRef<NamedDecl *> Decls) {
+  assert(FD && "Function is 0");
+  NamedDecl **A = new (*this) NamedDecl*[Decls.size()];
+  std::copy(Decls.begin(), Decls.end(), A);
+  DeclsInPrototypeScope[FD] = ArrayRef<NamedDecl *>(A, Decls.size());
+}
+
 NamedDecl *
 ASTContext::getInstantiatedFromUsingDecl(UsingDecl *UUD) {
   llvm::DenseMap<UsingDecl *, NamedDecl *>::const_iterator Pos
@@ -7800,7 +7897,8 @@ size_t ASTContext::getSideTableAllocatedMemory() const {
     + llvm::capacity_in_bytes(OverriddenMethods)
     + llvm::capacity_in_bytes(Types)
     + llvm::capacity_in_bytes(VariableArrayTypes)
-    + llvm::capacity_in_bytes(ClassScopeSpecializationPattern);
+    + llvm::capacity_in_bytes(ClassScopeSpecializationPattern)
+    + llvm::capacity_in_bytes(DeclsInPrototypeScope);
 }
 
 void ASTContext::addUnnamedTag(const TagDecl *Tag) {
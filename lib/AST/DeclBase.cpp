@@ -41,6 +41,11 @@ using namespace clang;
 #define ABSTRACT_DECL(DECL)
 #include "clang/AST/DeclNodes.inc"
 
+/// \brief The number of lookup lists that built a function index, and the
+/// number of redeclarations looked up through one.
+static unsigned NumFunctionIndexes = 0;
+static unsigned NumIndexedRedeclarationChecks = 0;
+
 void Decl::updateOutOfDate(IdentifierInfo &II) const {
   getASTContext().getExternalSource()->updateOutOfDateIdentifier(II);
 }
@@ -124,6 +129,10 @@ void Decl::PrintStats() {
 #include "clang/AST/DeclNodes.inc"
 
   llvm::errs() << "Total bytes = " << totalBytes << "\n";
+
+  llvm::errs() << NumFunctionIndexes << " lookup lists indexed by function, "
+               << NumIndexedRedeclarationChecks
+               << " redeclarations found through the index.\n";
 }
 
 void Decl::add(Kind k) {
@@ -1461,6 +1470,54 @@ void ASTContext::ReleaseDeclContextMaps() {
   StoredDeclsMap::DestroyAll(LastSDM.getPointer(), LastSDM.getInt());
 }
 
+const FunctionDecl *StoredDeclsList::getFunctionIndexKey(NamedDecl *D) {
+  if (const FunctionDecl *FD = dyn_cast<FunctionDecl>(D))
+    return FD;
+  if (const FunctionTemplateDecl *FTD = dyn_cast<FunctionTemplateDecl>(D))
+    return FTD->getTemplatedDecl();
+  return 0;
+}
+
+bool StoredDeclsList::HandleFunctionRedeclaration(NamedDecl *D) {
+  VectorTy &Vec = *Data.get<VectorTy *>();
+  if (!Vec.FunctionIndex) {
+    Vec.FunctionIndex = new FunctionIndexTy();
+    reindexFunctionsFrom(0);
+    ++NumFunctionIndexes;
+  }
+  ++NumIndexedRedeclarationChecks;
+
+  // A function replaces its previous declaration, and a function template
+  // replaces the template whose pattern its pattern redeclares; see
+  // NamedDecl::declarationReplaces.
+  const FunctionDecl *Key = getFunctionIndexKey(D);
+  const FunctionDecl *Previous = Key->getPreviousDecl();
+  if (!Previous)
+    return false;
+  FunctionIndexTy::iterator Known = Vec.FunctionIndex->find(Previous);
+  if (Known == Vec.FunctionIndex->end())
+    return false;
+  unsigned Pos = Known->second;
+  NamedDecl *OldD = Vec.Decls[Pos];
+  assert(getFunctionIndexKey(OldD) == Previous &&
+         "function index is out of date");
+  if (isa<FunctionTemplateDecl>(D) != isa<FunctionTemplateDecl>(OldD))
+    return false;
+  assert(D->declarationReplaces(OldD) && "function index is out of date");
+
+  Vec.Decls[Pos] = D;
+  Vec.FunctionIndex->erase(Known);
+  (*Vec.FunctionIndex)[Key] = Pos;
+  return true;
+}
+
+void StoredDeclsList::reindexFunctionsFrom(unsigned From) {
+  VectorTy &Vec = *Data.get<VectorTy *>();
+  for (unsigned I = From, N = Vec.Decls.size(); I != N; ++I)
+    if (const FunctionDecl *Key = getFunctionIndexKey(Vec.Decls[I]))
+      (*Vec.FunctionIndex)[Key] = I;
+}
+
 void StoredDeclsMap::DestroyAll(StoredDeclsMap *Map, bool Dependent) {
   while (Map) {
     // Advance the iteration before we invalidate memory.
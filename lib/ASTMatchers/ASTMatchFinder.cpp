@@ -20,11 +20,65 @@
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/Support/Threading.h"
 #include <deque>
 #include <set>
 
+#if defined(LLVM_ON_UNIX)
+#include <pthread.h>
+#endif
+
 namespace clang {
 namespace ast_matchers {
+
+struct MatchFinder::MatchersByKind {
+  MatchersByKind()
+    : ProfileRecords(NULL), ShardIndex(0), ShardCount(1), NumThreads(1) {}
+
+  ~MatchersByKind() {
+    for (MatcherCallbackList::const_iterator It = All.begin(), End = All.end();
+         It != End; ++It)
+      delete It->first;
+  }
+
+  // Takes ownership of 'NodeMatch' and adds it to the matchers of 'Kind'.
+  void add(const internal::DynTypedMatcher *NodeMatch, MatchCallback *Action,
+           std::vector<unsigned> &Kind) {
+    Kind.push_back(All.size());
+    All.push_back(std::make_pair(NodeMatch, Action));
+    if (ProfileRecords && ProfileRecords->size() < All.size())
+      ProfileRecords->resize(All.size());
+  }
+
+  // For each DynTypedMatcher a MatchCallback that will be called when it
+  // matches.
+  typedef std::vector<std::pair<const internal::DynTypedMatcher*,
+                                MatchCallback*> > MatcherCallbackList;
+
+  // All matchers, in the order they were added. Owns the matchers.
+  MatcherCallbackList All;
+
+  // The indices into 'All' of the matchers of each kind, in the order they
+  // were added.
+  std::vector<unsigned> Decls;
+  std::vector<unsigned> Stmts;
+  std::vector<unsigned> Types;
+  std::vector<unsigned> TypeLocs;
+  std::vector<unsigned> NestedNameSpecifiers;
+  std::vector<unsigned> NestedNameSpecifierLocs;
+
+  // Where to record the time spent per matcher, indexed like 'All', or null.
+  std::vector<llvm::TimeRecord> *ProfileRecords;
+
+  // The shard of the top-level declarations to match in, and the number of
+  // shards; see setShard().
+  unsigned ShardIndex;
+  unsigned ShardCount;
+
+  // The number of threads to match on; see setNumThreads().
+  unsigned NumThreads;
+};
+
 namespace internal {
 namespace {
 
@@ -49,6 +103,22 @@ struct MemoizedMatchResult {
   BoundNodesTree Nodes;
 };
 
+// A match found on a matching thread, kept until its callback can be called
+// on the thread that started the matching.
+struct DeferredMatch {
+  DeferredMatch(unsigned TopLevelDecl, const BoundNodes &Nodes,
+                unsigned Matcher)
+    : TopLevelDecl(TopLevelDecl), Nodes(Nodes), Matcher(Matcher) {}
+
+  // The number of the top-level declaration the match was found in, counting
+  // from 1, or 0 for the translation unit itself.
+  unsigned TopLevelDecl;
+  BoundNodes Nodes;
+
+  // The index of the matcher that matched, in the order they were added.
+  unsigned Matcher;
+};
+
 // A RecursiveASTVisitor that traverses all children or all descendants of
 // a node.
 class MatchChildASTVisitor
@@ -258,26 +328,61 @@ private:
   bool Matches;
 };
 
+} // end namespace
+
 // Controls the outermost traversal of the AST and allows to match multiple
 // matchers.
+//
+// Not in the anonymous namespace, so that MatchFinder can befriend it.
 class MatchASTVisitor : public RecursiveASTVisitor<MatchASTVisitor>,
                         public ASTMatchFinder {
 public:
-  MatchASTVisitor(std::vector<std::pair<const internal::DynTypedMatcher*,
-                                        MatchCallback*> > *MatcherCallbackPairs)
-     : MatcherCallbackPairs(MatcherCallbackPairs),
-       ActiveASTContext(NULL) {
+  MatchASTVisitor(const MatchFinder &Finder)
+     : Finder(Finder),
+       Matchers(Finder.Matchers.get()),
+       ActiveASTContext(NULL),
+       ProfileRecords(Matchers->ProfileRecords),
+       DeferredMatches(NULL),
+       ShardIndex(Matchers->ShardIndex),
+       ShardCount(Matchers->ShardCount),
+       DeclDepth(0),
+       NumTopLevelDecls(0),
+       InShard(ShardIndex == 0) {
+  }
+
+  // Matches in the given shard instead of the finder's.
+  void setShard(unsigned Index, unsigned Count) {
+    ShardIndex = Index;
+    ShardCount = Count;
+    InShard = ShardIndex == 0;
+  }
+
+  // Collects the matches in 'Matches' instead of calling their callbacks,
+  // and records the time spent matching in 'Records' if profiling.
+  void deferMatches(std::vector<DeferredMatch> *Matches,
+                    std::vector<llvm::TimeRecord> *Records) {
+    DeferredMatches = Matches;
+    if (ProfileRecords) {
+      ProfileRecords = Records;
+      ProfileRecords->resize(Matchers->All.size());
+    }
   }
 
   void onStartOfTranslationUnit() {
-    for (std::vector<std::pair<const internal::DynTypedMatcher*,
-                               MatchCallback*> >::const_iterator
-             I = MatcherCallbackPairs->begin(), E = MatcherCallbackPairs->end();
+    NumTopLevelDecls = 0;
+    InShard = ShardIndex == 0;
+    for (MatchFinder::MatchersByKind::MatcherCallbackList::const_iterator
+             I = Matchers->All.begin(), E = Matchers->All.end();
          I != E; ++I) {
       I->second->onStartOfTranslationUnit();
     }
   }
 
+  // Matches the translation unit on the finder's number of threads, and
+  // then calls the callbacks in the order matching on one thread would
+  // have. Returns false if it is to be matched on this thread instead.
+  bool matchOnThreads(ASTContext &Context);
+
   void set_active_ast_context(ASTContext *NewActiveASTContext) {
     ActiveASTContext = NewActiveASTContext;
   }
@@ -396,21 +501,53 @@ public:
   // Matches all registered matchers on the given node and calls the
   // result callback for every node that matches.
   void match(const ast_type_traits::DynTypedNode& Node) {
-    for (std::vector<std::pair<const internal::DynTypedMatcher*,
-                               MatchCallback*> >::const_iterator
-             I = MatcherCallbackPairs->begin(), E = MatcherCallbackPairs->end();
-         I != E; ++I) {
-      BoundNodesTreeBuilder Builder;
-      if (I->first->matches(Node, this, &Builder)) {
-        BoundNodesTree BoundNodes = Builder.build();
-        MatchVisitor Visitor(ActiveASTContext, I->second);
-        BoundNodes.visitMatches(&Visitor);
-      }
-    }
+    for (unsigned I = 0, E = Matchers->All.size(); I != E; ++I)
+      matchWith(Node, I);
   }
 
-  template <typename T> void match(const T &Node) {
-    match(ast_type_traits::DynTypedNode::create(Node));
+  // Matches the registered matchers of the node's kind on the given node;
+  // the matchers of other kinds cannot match it.
+  void match(const Decl &Node) { matchWith(Node, Matchers->Decls); }
+  void match(const Stmt &Node) { matchWith(Node, Matchers->Stmts); }
+  void match(const QualType &Node) { matchWith(Node, Matchers->Types); }
+  void match(const TypeLoc &Node) { matchWith(Node, Matchers->TypeLocs); }
+  void match(const NestedNameSpecifier &Node) {
+    matchWith(Node, Matchers->NestedNameSpecifiers);
+  }
+  void match(const NestedNameSpecifierLoc &Node) {
+    matchWith(Node, Matchers->NestedNameSpecifierLocs);
+  }
+
+  template <typename T>
+  void matchWith(const T &Node, const std::vector<unsigned> &Kind) {
+    if (!InShard || Kind.empty())
+      return;
+    ast_type_traits::DynTypedNode DynNode =
+      ast_type_traits::DynTypedNode::create(Node);
+    for (unsigned I = 0, E = Kind.size(); I != E; ++I)
+      matchWith(DynNode, Kind[I]);
+  }
+
+  // Matches the 'Index'th matcher added on 'Node'.
+  void matchWith(const ast_type_traits::DynTypedNode &Node, unsigned Index) {
+    llvm::TimeRecord Start;
+    if (ProfileRecords)
+      Start = llvm::TimeRecord::getCurrentTime(/*Start=*/true);
+
+    BoundNodesTreeBuilder Builder;
+    if (Matchers->All[Index].first->matches(Node, this, &Builder)) {
+      BoundNodesTree BoundNodes = Builder.build();
+      MatchVisitor Visitor(ActiveASTContext, Matchers->All[Index].second,
+                           Index, DeferredMatches, NumTopLevelDecls);
+      BoundNodes.visitMatches(&Visitor);
+    }
+
+    if (ProfileRecords) {
+      llvm::TimeRecord Elapsed =
+        llvm::TimeRecord::getCurrentTime(/*Start=*/false);
+      Elapsed -= Start;
+      (*ProfileRecords)[Index] += Elapsed;
+    }
   }
 
   // Implements ASTMatchFinder::getASTContext.
@@ -502,26 +639,39 @@ private:
   }
 
   // Implements a BoundNodesTree::Visitor that calls a MatchCallback with
-  // the aggregated bound nodes for each match.
+  // the aggregated bound nodes for each match, or defers the call.
   class MatchVisitor : public BoundNodesTree::Visitor {
   public:
     MatchVisitor(ASTContext* Context,
-                 MatchFinder::MatchCallback* Callback)
+                 MatchFinder::MatchCallback* Callback,
+                 unsigned Matcher,
+                 std::vector<DeferredMatch> *DeferredMatches,
+                 unsigned TopLevelDecl)
       : Context(Context),
-        Callback(Callback) {}
+        Callback(Callback),
+        Matcher(Matcher),
+        DeferredMatches(DeferredMatches),
+        TopLevelDecl(TopLevelDecl) {}
 
     virtual void visitMatch(const BoundNodes& BoundNodesView) {
-      Callback->run(MatchFinder::MatchResult(BoundNodesView, Context));
+      if (DeferredMatches)
+        DeferredMatches->push_back(
+          DeferredMatch(TopLevelDecl, BoundNodesView, Matcher));
+      else
+        Callback->run(MatchFinder::MatchResult(BoundNodesView, Context));
     }
 
   private:
     ASTContext* Context;
     MatchFinder::MatchCallback* Callback;
+    unsigned Matcher;
+    std::vector<DeferredMatch> *DeferredMatches;
+    unsigned TopLevelDecl;
   };
 
   // Returns true if 'TypeNode' has an alias that matches the given matcher.
   bool typeHasMatchingAlias(const Type *TypeNode,
-                            const Matcher<NamedDecl> Matcher,
+                            const Matcher<NamedDecl> &Matcher,
                             BoundNodesTreeBuilder *Builder) {
     const Type *const CanonicalType =
       ActiveASTContext->getCanonicalType(TypeNode);
@@ -535,10 +685,33 @@ private:
     return false;
   }
 
-  std::vector<std::pair<const internal::DynTypedMatcher*,
-                        MatchCallback*> > *const MatcherCallbackPairs;
+  const MatchFinder &Finder;
+  const MatchFinder::MatchersByKind *const Matchers;
   ASTContext *ActiveASTContext;
 
+  // Where to record the time spent per matcher, or null.
+  std::vector<llvm::TimeRecord> *ProfileRecords;
+
+  // Where to collect the matches, or null to call their callbacks at once.
+  std::vector<DeferredMatch> *DeferredMatches;
+
+  // The shard of the top-level declarations to match in, and the number of
+  // shards.
+  unsigned ShardIndex;
+  unsigned ShardCount;
+
+  // The number of declarations being traversed; the translation unit is at
+  // depth 0, so top-level declarations are at depth 1.
+  unsigned DeclDepth;
+
+  // The number of top-level declarations seen so far.
+  unsigned NumTopLevelDecls;
+
+  // Whether the nodes being traversed belong to the shard being matched.
+  // Everything is still traversed, so that e.g. all typedefs are known to
+  // isDerivedFrom.
+  bool InShard;
+
   // Maps a canonical type to its TypedefDecls.
   llvm::DenseMap<const Type*, std::set<const TypedefDecl*> > TypeAliases;
 
@@ -619,8 +792,21 @@ bool MatchASTVisitor::TraverseDecl(Decl *DeclNode) {
   if (DeclNode == NULL) {
     return true;
   }
+  if (ShardCount == 1 && !DeferredMatches) {
+    match(*DeclNode);
+    return RecursiveASTVisitor<MatchASTVisitor>::TraverseDecl(DeclNode);
+  }
+
+  // Deal the top-level declarations out to the shards in turn.
+  bool WasInShard = InShard;
+  if (DeclDepth == 1)
+    InShard = NumTopLevelDecls++ % ShardCount == ShardIndex;
+  ++DeclDepth;
   match(*DeclNode);
-  return RecursiveASTVisitor<MatchASTVisitor>::TraverseDecl(DeclNode);
+  bool Result = RecursiveASTVisitor<MatchASTVisitor>::TraverseDecl(DeclNode);
+  --DeclDepth;
+  InShard = WasInShard;
+  return Result;
 }
 
 bool MatchASTVisitor::TraverseStmt(Stmt *StmtNode) {
@@ -662,13 +848,50 @@ bool MatchASTVisitor::TraverseNestedNameSpecifierLoc(
       RecursiveASTVisitor<MatchASTVisitor>::TraverseNestedNameSpecifierLoc(NNS);
 }
 
+namespace {
+
+// Matches one of the shards a translation unit is split into when matching
+// on several threads.
+class MatchThread {
+public:
+  MatchThread(const MatchFinder &Finder, ASTContext &Context,
+              unsigned ShardIndex, unsigned ShardCount)
+    : Next(0), Visitor(Finder), Context(Context) {
+    Visitor.setShard(ShardIndex, ShardCount);
+    Visitor.deferMatches(&Matches, &ProfileRecords);
+  }
+
+  static void *run(void *Thread) {
+    MatchThread *T = static_cast<MatchThread *>(Thread);
+    T->Visitor.set_active_ast_context(&T->Context);
+    T->Visitor.TraverseDecl(T->Context.getTranslationUnitDecl());
+    T->Visitor.set_active_ast_context(NULL);
+    return 0;
+  }
+
+  // The matches found, in traversal order.
+  std::vector<DeferredMatch> Matches;
+
+  // The time spent matching, per matcher, if profiling.
+  std::vector<llvm::TimeRecord> ProfileRecords;
+
+  // The first match whose callback has not been called yet.
+  unsigned Next;
+
+#if defined(LLVM_ON_UNIX)
+  pthread_t Handle;
+#endif
+
+private:
+  MatchASTVisitor Visitor;
+  ASTContext &Context;
+};
+
 class MatchASTConsumer : public ASTConsumer {
 public:
-  MatchASTConsumer(
-    std::vector<std::pair<const internal::DynTypedMatcher*,
-                          MatchCallback*> > *MatcherCallbackPairs,
-    MatchFinder::ParsingDoneTestCallback *ParsingDone)
-    : Visitor(MatcherCallbackPairs),
+  MatchASTConsumer(const MatchFinder &Finder,
+                   MatchFinder::ParsingDoneTestCallback *ParsingDone)
+    : Visitor(Finder),
       ParsingDone(ParsingDone) {}
 
 private:
@@ -678,7 +901,8 @@ private:
     }
     Visitor.set_active_ast_context(&Context);
     Visitor.onStartOfTranslationUnit();
-    Visitor.TraverseDecl(Context.getTranslationUnitDecl());
+    if (!Visitor.matchOnThreads(Context))
+      Visitor.TraverseDecl(Context.getTranslationUnitDecl());
     Visitor.set_active_ast_context(NULL);
   }
 
@@ -687,6 +911,99 @@ private:
 };
 
 } // end namespace
+
+// Splits the finder's shard into one shard per thread, matches them
+// concurrently, and then calls the callbacks in the order matching on one
+// thread would have.
+bool MatchASTVisitor::matchOnThreads(ASTContext &Context) {
+  if (Matchers->NumThreads <= 1)
+    return false;
+#if defined(LLVM_ON_UNIX)
+  // LLVM's own state, e.g. its allocators' statistics and ManagedStatics,
+  // is only guarded in multithreaded mode.
+  if (!llvm_is_multithreaded() && !llvm_start_multithreaded())
+    return false;
+
+  // Nothing the threads share may change while they run. Building the
+  // parent map that hasAncestor and hasParent use walks the whole
+  // translation unit, the way the threads will; that walk also deserializes
+  // every declaration, body and base specifier they can reach from an AST
+  // file, which would otherwise happen lazily on whichever thread gets there
+  // first.
+  Context.getParents(*Context.getTranslationUnitDecl());
+
+  unsigned NumThreads = Matchers->NumThreads;
+  std::vector<MatchThread *> Threads;
+  for (unsigned I = 0; I != NumThreads; ++I)
+    Threads.push_back(new MatchThread(Finder, Context,
+                                      ShardIndex + I * ShardCount,
+                                      NumThreads * ShardCount));
+
+  pthread_attr_t Attr;
+  pthread_attr_init(&Attr);
+  // Ask for the same 8MB of stack as the other threads clang starts; the
+  // traversal recurses as deeply as the AST is nested.
+  pthread_attr_setstacksize(&Attr, 8 << 20);
+  unsigned NumStarted = 0;
+  for (; NumStarted != NumThreads; ++NumStarted)
+    if (pthread_create(&Threads[NumStarted]->Handle, &Attr, MatchThread::run,
+                       Threads[NumStarted]))
+      break;
+  pthread_attr_destroy(&Attr);
+
+  // Shards whose thread didn't start are matched here.
+  for (unsigned I = NumStarted; I != NumThreads; ++I)
+    MatchThread::run(Threads[I]);
+  for (unsigned I = 0; I != NumStarted; ++I)
+    pthread_join(Threads[I]->Handle, 0);
+
+  // Each top-level declaration was matched by exactly one thread, and each
+  // thread found its matches in source order, so merging the matches by
+  // top-level declaration restores the single-threaded order.
+  while (true) {
+    MatchThread *First = NULL;
+    for (unsigned I = 0; I != NumThreads; ++I) {
+      MatchThread *T = Threads[I];
+      if (T->Next != T->Matches.size() &&
+          (!First || T->Matches[T->Next].TopLevelDecl <
+                       First->Matches[First->Next].TopLevelDecl))
+        First = T;
+    }
+    if (!First)
+      break;
+
+    unsigned TopLevelDecl = First->Matches[First->Next].TopLevelDecl;
+    for (; First->Next != First->Matches.size() &&
+           First->Matches[First->Next].TopLevelDecl == TopLevelDecl;
+         ++First->Next) {
+      const DeferredMatch &Match = First->Matches[First->Next];
+      llvm::TimeRecord Start;
+      if (ProfileRecords)
+        Start = llvm::TimeRecord::getCurrentTime(/*Start=*/true);
+      Matchers->All[Match.Matcher].second->run(
+        MatchFinder::MatchResult(Match.Nodes, &Context));
+      if (ProfileRecords) {
+        llvm::TimeRecord Elapsed =
+          llvm::TimeRecord::getCurrentTime(/*Start=*/false);
+        Elapsed -= Start;
+        (*ProfileRecords)[Match.Matcher] += Elapsed;
+      }
+    }
+  }
+
+  for (unsigned I = 0; I != NumThreads; ++I) {
+    if (ProfileRecords)
+      for (unsigned M = 0, ME = Threads[I]->ProfileRecords.size(); M != ME;
+           ++M)
+        (*ProfileRecords)[M] += Threads[I]->ProfileRecords[M];
+    delete Threads[I];
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
 } // end namespace internal
 
 MatchFinder::MatchResult::MatchResult(const BoundNodes &Nodes,
@@ -697,64 +1014,74 @@ MatchFinder::MatchResult::MatchResult(const BoundNodes &Nodes,
 MatchFinder::MatchCallback::~MatchCallback() {}
 MatchFinder::ParsingDoneTestCallback::~ParsingDoneTestCallback() {}
 
-MatchFinder::MatchFinder() : ParsingDone(NULL) {}
+MatchFinder::MatchFinder()
+  : Matchers(new MatchersByKind()), ParsingDone(NULL) {}
 
-MatchFinder::~MatchFinder() {
-  for (std::vector<std::pair<const internal::DynTypedMatcher*,
-                             MatchCallback*> >::const_iterator
-           It = MatcherCallbackPairs.begin(), End = MatcherCallbackPairs.end();
-       It != End; ++It) {
-    delete It->first;
-  }
-}
+MatchFinder::~MatchFinder() {}
 
 void MatchFinder::addMatcher(const DeclarationMatcher &NodeMatch,
                              MatchCallback *Action) {
-  MatcherCallbackPairs.push_back(std::make_pair(
-    new internal::Matcher<Decl>(NodeMatch), Action));
+  Matchers->add(new internal::Matcher<Decl>(NodeMatch), Action,
+                Matchers->Decls);
 }
 
 void MatchFinder::addMatcher(const TypeMatcher &NodeMatch,
                              MatchCallback *Action) {
-  MatcherCallbackPairs.push_back(std::make_pair(
-    new internal::Matcher<QualType>(NodeMatch), Action));
+  Matchers->add(new internal::Matcher<QualType>(NodeMatch), Action,
+                Matchers->Types);
 }
 
 void MatchFinder::addMatcher(const StatementMatcher &NodeMatch,
                              MatchCallback *Action) {
-  MatcherCallbackPairs.push_back(std::make_pair(
-    new internal::Matcher<Stmt>(NodeMatch), Action));
+  Matchers->add(new internal::Matcher<Stmt>(NodeMatch), Action,
+                Matchers->Stmts);
 }
 
 void MatchFinder::addMatcher(const NestedNameSpecifierMatcher &NodeMatch,
                              MatchCallback *Action) {
-  MatcherCallbackPairs.push_back(std::make_pair(
-    new NestedNameSpecifierMatcher(NodeMatch), Action));
+  Matchers->add(new NestedNameSpecifierMatcher(NodeMatch), Action,
+                Matchers->NestedNameSpecifiers);
 }
 
 void MatchFinder::addMatcher(const NestedNameSpecifierLocMatcher &NodeMatch,
                              MatchCallback *Action) {
-  MatcherCallbackPairs.push_back(std::make_pair(
-    new NestedNameSpecifierLocMatcher(NodeMatch), Action));
+  Matchers->add(new NestedNameSpecifierLocMatcher(NodeMatch), Action,
+                Matchers->NestedNameSpecifierLocs);
 }
 
 void MatchFinder::addMatcher(const TypeLocMatcher &NodeMatch,
                              MatchCallback *Action) {
-  MatcherCallbackPairs.push_back(std::make_pair(
-    new TypeLocMatcher(NodeMatch), Action));
+  Matchers->add(new TypeLocMatcher(NodeMatch), Action, Matchers->TypeLocs);
 }
 
 ASTConsumer *MatchFinder::newASTConsumer() {
-  return new internal::MatchASTConsumer(&MatcherCallbackPairs, ParsingDone);
+  return new internal::MatchASTConsumer(*this, ParsingDone);
 }
 
 void MatchFinder::match(const clang::ast_type_traits::DynTypedNode &Node,
                         ASTContext &Context) {
-  internal::MatchASTVisitor Visitor(&MatcherCallbackPairs);
+  internal::MatchASTVisitor Visitor(*this);
   Visitor.set_active_ast_context(&Context);
   Visitor.match(Node);
 }
 
+void MatchFinder::enableProfiling(std::vector<llvm::TimeRecord> &Records) {
+  Matchers->ProfileRecords = &Records;
+  if (Records.size() < Matchers->All.size())
+    Records.resize(Matchers->All.size());
+}
+
+void MatchFinder::setShard(unsigned Index, unsigned Count) {
+  assert(Index < Count && "Shard index out of range");
+  Matchers->ShardIndex = Index;
+  Matchers->ShardCount = Count;
+}
+
+void MatchFinder::setNumThreads(unsigned NumThreads) {
+  assert(NumThreads > 0 && "Matching needs at least one thread");
+  Matchers->NumThreads = NumThreads;
+}
+
 void MatchFinder::registerTestCallbackAfterParsing(
     MatchFinder::ParsingDoneTestCallback *NewParsingDone) {
   ParsingDone = NewParsingDone;
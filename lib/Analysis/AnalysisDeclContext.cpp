@@ -12,6 +12,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#define DEBUG_TYPE "AnalysisDeclContext"
+
 #include "clang/Analysis/AnalysisContext.h"
 #include "BodyFarm.h"
 #include "clang/AST/ASTContext.h"
@@ -27,12 +29,16 @@
 #include "clang/Analysis/CFGStmtMap.h"
 #include "clang/Analysis/Support/BumpVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/SaveAndRestore.h"
 
 using namespace clang;
 
+STATISTIC(NumSharedCFGsReused,
+          "The # of times a CFG built for another context was reused");
+
 typedef llvm::DenseMap<const void *, ManagedAnalysis *> ManagedAnalysisMap;
 
 AnalysisDeclContext::AnalysisDeclContext(AnalysisDeclContextManager *Mgr,
@@ -40,6 +46,8 @@ AnalysisDeclContext::AnalysisDeclContext(AnalysisDeclContextManager *Mgr,
                                          const CFG::BuildOptions &buildOptions)
   : Manager(Mgr),
     D(d),
+    cfg(0),
+    completeCFG(0),
     cfgBuildOptions(buildOptions),
     forcedBlkExprs(0),
     builtCFG(false),
@@ -54,6 +62,8 @@ AnalysisDeclContext::AnalysisDeclContext(AnalysisDeclContextManager *Mgr,
                                          const Decl *d)
 : Manager(Mgr),
   D(d),
+  cfg(0),
+  completeCFG(0),
   forcedBlkExprs(0),
   builtCFG(false),
   builtCompleteCFG(false),
@@ -69,7 +79,7 @@ AnalysisDeclContextManager::AnalysisDeclContextManager(bool useUnoptimizedCFG,
                                                        bool addTemporaryDtors,
                                                        bool synthesizeBodies,
                                                        bool addStaticInitBranch)
-  : SynthesizeBodies(synthesizeBodies)
+  : Round(0), SynthesizeBodies(synthesizeBodies)
 {
   cfgBuildOptions.PruneTriviallyFalseEdges = !useUnoptimizedCFG;
   cfgBuildOptions.AddImplicitDtors = addImplicitDtors;
@@ -78,10 +88,23 @@ AnalysisDeclContextManager::AnalysisDeclContextManager(bool useUnoptimizedCFG,
   cfgBuildOptions.AddStaticInitBranches = addStaticInitBranch;
 }
 
+void AnalysisDeclContextManager::evictSharedCFGs(CFGMap &Map) {
+  for (CFGMap::iterator I = Map.begin(), E = Map.end(); I != E; ++I) {
+    if (I->second.LastRound == Round)
+      continue;
+    delete I->second.Graph;
+    Map.erase(I);
+  }
+}
+
 void AnalysisDeclContextManager::clear() {
   for (ContextMap::iterator I = Contexts.begin(), E = Contexts.end(); I!=E; ++I)
     delete I->second;
   Contexts.clear();
+
+  evictSharedCFGs(CFGs);
+  evictSharedCFGs(UnoptimizedCFGs);
+  ++Round;
 }
 
 static BodyFarm &getBodyFarm(ASTContext &C) {
@@ -162,26 +185,37 @@ CFG *AnalysisDeclContext::getCFG() {
     return getUnoptimizedCFG();
 
   if (!builtCFG) {
-    cfg.reset(CFG::buildCFG(D, getBody(),
-                            &D->getASTContext(), cfgBuildOptions));
+    cfg = buildCFG(ownedCFG);
     // Even when the cfg is not successfully built, we don't
     // want to try building it again.
     builtCFG = true;
   }
-  return cfg.get();
+  return cfg;
 }
 
 CFG *AnalysisDeclContext::getUnoptimizedCFG() {
   if (!builtCompleteCFG) {
     SaveAndRestore<bool> NotPrune(cfgBuildOptions.PruneTriviallyFalseEdges,
                                   false);
-    completeCFG.reset(CFG::buildCFG(D, getBody(), &D->getASTContext(),
-                                    cfgBuildOptions));
+    completeCFG = buildCFG(ownedCompleteCFG);
     // Even when the cfg is not successfully built, we don't
     // want to try building it again.
     builtCompleteCFG = true;
   }
-  return completeCFG.get();
+  return completeCFG;
+}
+
+CFG *AnalysisDeclContext::buildCFG(OwningPtr<CFG> &Owned) {
+  // A CFG can be shared with other contexts for the same declaration unless
+  // this context has its own build options. Forced block expressions are
+  // looked up in the CFG's blocks, so a CFG built with them isn't shared.
+  if (Manager && (!forcedBlkExprs || forcedBlkExprs->empty()) &&
+      cfgBuildOptions.differsOnlyInPruning(Manager->cfgBuildOptions))
+    return Manager->getSharedCFG(*this);
+
+  Owned.reset(CFG::buildCFG(D, getBody(), &D->getASTContext(),
+                            cfgBuildOptions));
+  return Owned.get();
 }
 
 CFGStmtMap *AnalysisDeclContext::getCFGStmtMap() {
@@ -530,6 +564,28 @@ AnalysisDeclContext::~AnalysisDeclContext() {
 AnalysisDeclContextManager::~AnalysisDeclContextManager() {
   for (ContextMap::iterator I = Contexts.begin(), E = Contexts.end(); I!=E; ++I)
     delete I->second;
+  for (CFGMap::iterator I = CFGs.begin(), E = CFGs.end(); I != E; ++I)
+    delete I->second.Graph;
+  for (CFGMap::iterator I = UnoptimizedCFGs.begin(), E = UnoptimizedCFGs.end();
+       I != E; ++I)
+    delete I->second.Graph;
+}
+
+CFG *AnalysisDeclContextManager::getSharedCFG(AnalysisDeclContext &Ctx) {
+  const CFG::BuildOptions &Options = Ctx.getCFGBuildOptions();
+  CFGMap &Map = Options.PruneTriviallyFalseEdges ? CFGs : UnoptimizedCFGs;
+  const Decl *D = Ctx.getDecl();
+  CFGMap::iterator Known = Map.find(D);
+  if (Known != Map.end()) {
+    ++NumSharedCFGsReused;
+    Known->second.LastRound = Round;
+    return Known->second.Graph;
+  }
+  // Remember failures too, so that they aren't retried.
+  SharedCFG &Entry = Map[D];
+  Entry.Graph = CFG::buildCFG(D, Ctx.getBody(), &D->getASTContext(), Options);
+  Entry.LastRound = Round;
+  return Entry.Graph;
 }
 
 LocationContext::~LocationContext() {}
@@ -0,0 +1,68 @@
+//===- BitVectorDataflow.cpp - Bit-vector dataflow over CFGs --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the solver for dataflow analyses over CFGs whose
+// values are dense bit vectors.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Analysis/Analyses/BitVectorDataflow.h"
+#include "clang/Analysis/Analyses/PostOrderCFGView.h"
+
+using namespace clang;
+
+BitVectorDataflow::BitVectorDataflow(const CFG &Cfg, PostOrderCFGView &POV,
+                                     DataflowWorklist::Direction Dir,
+                                     unsigned NumBits)
+  : Dir(Dir), Worklist(Cfg, POV, Dir),
+    InValues(Cfg.getNumBlockIDs(), llvm::BitVector(NumBits)),
+    OutValues(Cfg.getNumBlockIDs(), llvm::BitVector(NumBits)),
+    VisitedBlocks(Cfg.getNumBlockIDs()) {}
+
+void BitVectorDataflow::joinInto(const CFGBlock *Block,
+                                 llvm::BitVector &Value) const {
+  Value.reset();
+  if (Dir == DataflowWorklist::Forward) {
+    for (CFGBlock::const_pred_iterator I = Block->pred_begin(),
+         E = Block->pred_end(); I != E; ++I) {
+      if (!*I)
+        continue;
+      const llvm::BitVector &Pred = OutValues[(*I)->getBlockID()];
+      if (Value.size() < Pred.size())
+        Value.resize(Pred.size());
+      Value |= Pred;
+    }
+    return;
+  }
+
+  for (CFGBlock::const_succ_iterator I = Block->succ_begin(),
+       E = Block->succ_end(); I != E; ++I) {
+    if (!*I)
+      continue;
+    const llvm::BitVector &Succ = OutValues[(*I)->getBlockID()];
+    if (Value.size() < Succ.size())
+      Value.resize(Succ.size());
+    Value |= Succ;
+  }
+}
+
+bool BitVectorDataflow::sameBits(llvm::BitVector &A, llvm::BitVector &B) {
+  if (A.size() < B.size())
+    A.resize(B.size());
+  else if (B.size() < A.size())
+    B.resize(A.size());
+  return A == B;
+}
+
+void BitVectorDataflow::enqueueDependents(const CFGBlock *Block) {
+  if (Dir == DataflowWorklist::Forward)
+    Worklist.enqueueSuccessors(Block);
+  else
+    Worklist.enqueuePredecessors(Block);
+}
@@ -12,6 +12,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#define DEBUG_TYPE "CFG"
+
 #include "clang/Analysis/CFG.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Attr.h"
@@ -19,9 +21,11 @@
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/PrettyPrinter.h"
 #include "clang/AST/StmtVisitor.h"
+#include "clang/Basic/TimeTrace.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/GraphWriter.h"
@@ -29,6 +33,8 @@
 
 using namespace clang;
 
+STATISTIC(NumCFGsBuilt, "The # of CFGs built");
+
 namespace {
 
 static SourceLocation GetEndLoc(Decl *D) {
@@ -3355,6 +3361,8 @@ CFGBlock *CFG::createBlock() {
 ///  CFG is returned to the caller.
 CFG* CFG::buildCFG(const Decl *D, Stmt *Statement, ASTContext *C,
     const BuildOptions &BO) {
+  TimeTraceScope TimeScope("BuildCFG");
+  ++NumCFGsBuilt;
   CFGBuilder Builder(C, BO);
   return Builder.buildCFG(D, Statement);
 }
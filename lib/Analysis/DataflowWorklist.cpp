@@ -0,0 +1,63 @@
+//===- DataflowWorklist.cpp - Worklist for dataflow over CFGs -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the worklist shared by the dataflow analyses over CFGs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Analysis/Analyses/DataflowWorklist.h"
+#include "clang/Analysis/Analyses/PostOrderCFGView.h"
+
+using namespace clang;
+
+DataflowWorklist::DataflowWorklist(const CFG &Cfg, PostOrderCFGView &POV,
+                                   Direction Dir)
+  : BlockOrder(Cfg.getNumBlockIDs()),
+    EnqueuedBlocks(Cfg.getNumBlockIDs()) {
+  // The view iterates in reverse post order. Number the blocks once, rather
+  // than looking them up in the view on every comparison.
+  unsigned NumReachable = POV.end() - POV.begin();
+  unsigned Position = 0;
+  for (PostOrderCFGView::iterator I = POV.begin(), E = POV.end(); I != E; ++I) {
+    ++Position;
+    BlockOrder[(*I)->getBlockID()] =
+      Dir == Forward ? Position : NumReachable + 1 - Position;
+  }
+}
+
+void DataflowWorklist::enqueueBlock(const CFGBlock *Block) {
+  if (!Block || EnqueuedBlocks[Block->getBlockID()])
+    return;
+  unsigned BlockID = Block->getBlockID();
+  EnqueuedBlocks[BlockID] = true;
+  QueueEntry Entry = { BlockOrder[BlockID], BlockID, Block };
+  Queue.push(Entry);
+}
+
+void DataflowWorklist::enqueueSuccessors(const CFGBlock *Block) {
+  for (CFGBlock::const_succ_iterator I = Block->succ_begin(),
+       E = Block->succ_end(); I != E; ++I)
+    enqueueBlock(*I);
+}
+
+void DataflowWorklist::enqueuePredecessors(const CFGBlock *Block) {
+  for (CFGBlock::const_pred_iterator I = Block->pred_begin(),
+       E = Block->pred_end(); I != E; ++I)
+    enqueueBlock(*I);
+}
+
+const CFGBlock *DataflowWorklist::dequeue() {
+  if (Queue.empty())
+    return 0;
+  const QueueEntry &Top = Queue.top();
+  const CFGBlock *Block = Top.Block;
+  EnqueuedBlocks[Top.BlockID] = false;
+  Queue.pop();
+  return Block;
+}
@@ -14,6 +14,7 @@
 #include "clang/Analysis/Analyses/LiveVariables.h"
 #include "clang/AST/Stmt.h"
 #include "clang/AST/StmtVisitor.h"
+#include "clang/Analysis/Analyses/BitVectorDataflow.h"
 #include "clang/Analysis/Analyses/PostOrderCFGView.h"
 #include "clang/Analysis/AnalysisContext.h"
 #include "clang/Analysis/CFG.h"
@@ -26,106 +27,107 @@
 using namespace clang;
 
 namespace {
+class LiveVariablesImpl {
+public:  
+  AnalysisDeclContext &analysisContext;
+  llvm::DenseMap<const CFGBlock *, LiveVariables::LivenessValues> blocksEndToLiveness;
+  llvm::DenseMap<const Stmt *, LiveVariables::LivenessValues> stmtsToLiveness;
+  llvm::DenseMap<const DeclRefExpr *, unsigned> inAssignment;
+  const bool killAtAssign;
 
-class DataflowWorklist {
-  SmallVector<const CFGBlock *, 20> worklist;
-  llvm::BitVector enqueuedBlocks;
-  PostOrderCFGView *POV;
-public:
-  DataflowWorklist(const CFG &cfg, AnalysisDeclContext &Ctx)
-    : enqueuedBlocks(cfg.getNumBlockIDs()),
-      POV(Ctx.getAnalysis<PostOrderCFGView>()) {}
-  
-  void enqueueBlock(const CFGBlock *block);
-  void enqueueSuccessors(const CFGBlock *block);
-  void enqueuePredecessors(const CFGBlock *block);
+  /// The bits of the statements and variables that were found live
+  /// somewhere. Both kinds share one numbering, given out as they are met.
+  llvm::DenseMap<const Stmt *, unsigned> stmtBits;
+  llvm::DenseMap<const VarDecl *, unsigned> declBits;
+  unsigned numBits;
+
+  void setLive(llvm::BitVector &live, const Stmt *S);
+  void setLive(llvm::BitVector &live, const VarDecl *D);
+  void setDead(llvm::BitVector &live, const Stmt *S);
+  void setDead(llvm::BitVector &live, const VarDecl *D);
+  bool isLive(const llvm::BitVector &live, const Stmt *S) const;
+  bool isLive(const llvm::BitVector &live, const VarDecl *D) const;
 
-  const CFGBlock *dequeue();
+  void runOnBlock(const CFGBlock *block, llvm::BitVector &val,
+                  LiveVariables::Observer *obs = 0,
+                  bool recordStmts = false);
 
-  void sortWorklist();
+  void dumpBlockLiveness(const SourceManager& M);
+
+  LiveVariablesImpl(AnalysisDeclContext &ac, bool KillAtAssign)
+    : analysisContext(ac), killAtAssign(KillAtAssign), numBits(0) {}
 };
+}
 
+static LiveVariablesImpl &getImpl(void *x) {
+  return *((LiveVariablesImpl *) x);
 }
 
-void DataflowWorklist::enqueueBlock(const clang::CFGBlock *block) {
-  if (block && !enqueuedBlocks[block->getBlockID()]) {
-    enqueuedBlocks[block->getBlockID()] = true;
-    worklist.push_back(block);
-  }
+static const LiveVariablesImpl &getImpl(const void *x) {
+  return *((const LiveVariablesImpl *) x);
 }
-  
-void DataflowWorklist::enqueueSuccessors(const clang::CFGBlock *block) {
-  const unsigned OldWorklistSize = worklist.size();
-  for (CFGBlock::const_succ_iterator I = block->succ_begin(),
-       E = block->succ_end(); I != E; ++I) {
-    enqueueBlock(*I);
-  }
 
-  if (OldWorklistSize == 0 || OldWorklistSize == worklist.size())
-    return;
+//===----------------------------------------------------------------------===//
+// Operations on the bit vectors of live statements and variables.
+//===----------------------------------------------------------------------===//
 
-  sortWorklist();
+template <typename T>
+static void setBit(llvm::BitVector &live,
+                   llvm::DenseMap<const T *, unsigned> &bits,
+                   unsigned &numBits, const T *X) {
+  std::pair<typename llvm::DenseMap<const T *, unsigned>::iterator, bool> I =
+    bits.insert(std::make_pair(X, numBits));
+  if (I.second)
+    ++numBits;
+  unsigned bit = I.first->second;
+  if (bit >= live.size())
+    live.resize(bit + 1);
+  live.set(bit);
 }
 
-void DataflowWorklist::enqueuePredecessors(const clang::CFGBlock *block) {
-  const unsigned OldWorklistSize = worklist.size();
-  for (CFGBlock::const_pred_iterator I = block->pred_begin(),
-       E = block->pred_end(); I != E; ++I) {
-    enqueueBlock(*I);
-  }
-  
-  if (OldWorklistSize == 0 || OldWorklistSize == worklist.size())
-    return;
+template <typename T>
+static void resetBit(llvm::BitVector &live,
+                     const llvm::DenseMap<const T *, unsigned> &bits,
+                     const T *X) {
+  typename llvm::DenseMap<const T *, unsigned>::const_iterator I =
+    bits.find(X);
+  if (I != bits.end() && I->second < live.size())
+    live.reset(I->second);
+}
 
-  sortWorklist();
+template <typename T>
+static bool testBit(const llvm::BitVector &live,
+                    const llvm::DenseMap<const T *, unsigned> &bits,
+                    const T *X) {
+  typename llvm::DenseMap<const T *, unsigned>::const_iterator I =
+    bits.find(X);
+  return I != bits.end() && I->second < live.size() && live[I->second];
 }
 
-void DataflowWorklist::sortWorklist() {
-  std::sort(worklist.begin(), worklist.end(), POV->getComparator());
+void LiveVariablesImpl::setLive(llvm::BitVector &live, const Stmt *S) {
+  setBit(live, stmtBits, numBits, S);
 }
 
-const CFGBlock *DataflowWorklist::dequeue() {
-  if (worklist.empty())
-    return 0;
-  const CFGBlock *b = worklist.back();
-  worklist.pop_back();
-  enqueuedBlocks[b->getBlockID()] = false;
-  return b;
+void LiveVariablesImpl::setLive(llvm::BitVector &live, const VarDecl *D) {
+  setBit(live, declBits, numBits, D);
 }
 
-namespace {
-class LiveVariablesImpl {
-public:  
-  AnalysisDeclContext &analysisContext;
-  std::vector<LiveVariables::LivenessValues> cfgBlockValues;
-  llvm::ImmutableSet<const Stmt *>::Factory SSetFact;
-  llvm::ImmutableSet<const VarDecl *>::Factory DSetFact;
-  llvm::DenseMap<const CFGBlock *, LiveVariables::LivenessValues> blocksEndToLiveness;
-  llvm::DenseMap<const CFGBlock *, LiveVariables::LivenessValues> blocksBeginToLiveness;
-  llvm::DenseMap<const Stmt *, LiveVariables::LivenessValues> stmtsToLiveness;
-  llvm::DenseMap<const DeclRefExpr *, unsigned> inAssignment;
-  const bool killAtAssign;
-  
-  LiveVariables::LivenessValues
-  merge(LiveVariables::LivenessValues valsA,
-        LiveVariables::LivenessValues valsB);
-      
-  LiveVariables::LivenessValues runOnBlock(const CFGBlock *block,
-                                           LiveVariables::LivenessValues val,
-                                           LiveVariables::Observer *obs = 0);
+void LiveVariablesImpl::setDead(llvm::BitVector &live, const Stmt *S) {
+  resetBit(live, stmtBits, S);
+}
 
-  void dumpBlockLiveness(const SourceManager& M);
+void LiveVariablesImpl::setDead(llvm::BitVector &live, const VarDecl *D) {
+  resetBit(live, declBits, D);
+}
 
-  LiveVariablesImpl(AnalysisDeclContext &ac, bool KillAtAssign)
-    : analysisContext(ac),
-      SSetFact(false), // Do not canonicalize ImmutableSets by default.
-      DSetFact(false), // This is a *major* performance win.
-      killAtAssign(KillAtAssign) {}
-};
+bool LiveVariablesImpl::isLive(const llvm::BitVector &live,
+                               const Stmt *S) const {
+  return testBit(live, stmtBits, S);
 }
 
-static LiveVariablesImpl &getImpl(void *x) {
-  return *((LiveVariablesImpl *) x);
+bool LiveVariablesImpl::isLive(const llvm::BitVector &live,
+                               const VarDecl *D) const {
+  return testBit(live, declBits, D);
 }
 
 //===----------------------------------------------------------------------===//
@@ -133,53 +135,18 @@ static LiveVariablesImpl &getImpl(void *x) {
 //===----------------------------------------------------------------------===//
 
 bool LiveVariables::LivenessValues::isLive(const Stmt *S) const {
-  return liveStmts.contains(S);
+  return impl && getImpl(impl).isLive(live, S);
 }
 
 bool LiveVariables::LivenessValues::isLive(const VarDecl *D) const {
-  return liveDecls.contains(D);
-}
-
-namespace {
-  template <typename SET>
-  SET mergeSets(SET A, SET B) {
-    if (A.isEmpty())
-      return B;
-    
-    for (typename SET::iterator it = B.begin(), ei = B.end(); it != ei; ++it) {
-      A = A.add(*it);
-    }
-    return A;
-  }
+  return impl && getImpl(impl).isLive(live, D);
 }
 
 void LiveVariables::Observer::anchor() { }
 
-LiveVariables::LivenessValues
-LiveVariablesImpl::merge(LiveVariables::LivenessValues valsA,
-                         LiveVariables::LivenessValues valsB) {  
-  
-  llvm::ImmutableSetRef<const Stmt *>
-    SSetRefA(valsA.liveStmts.getRootWithoutRetain(), SSetFact.getTreeFactory()),
-    SSetRefB(valsB.liveStmts.getRootWithoutRetain(), SSetFact.getTreeFactory());
-                                                
-  
-  llvm::ImmutableSetRef<const VarDecl *>
-    DSetRefA(valsA.liveDecls.getRootWithoutRetain(), DSetFact.getTreeFactory()),
-    DSetRefB(valsB.liveDecls.getRootWithoutRetain(), DSetFact.getTreeFactory());
-  
-
-  SSetRefA = mergeSets(SSetRefA, SSetRefB);
-  DSetRefA = mergeSets(DSetRefA, DSetRefB);
-  
-  // asImmutableSet() canonicalizes the tree, allowing us to do an easy
-  // comparison afterwards.
-  return LiveVariables::LivenessValues(SSetRefA.asImmutableSet(),
-                                       DSetRefA.asImmutableSet());  
-}
-
 bool LiveVariables::LivenessValues::equals(const LivenessValues &V) const {
-  return liveStmts == V.liveStmts && liveDecls == V.liveDecls;
+  llvm::BitVector A(live), B(V.live);
+  return impl == V.impl && BitVectorDataflow::sameBits(A, B);
 }
 
 //===----------------------------------------------------------------------===//
@@ -209,12 +176,12 @@ bool LiveVariables::isLive(const Stmt *Loc, const Stmt *S) {
 namespace {
 class TransferFunctions : public StmtVisitor<TransferFunctions> {
   LiveVariablesImpl &LV;
-  LiveVariables::LivenessValues &val;
+  llvm::BitVector &val;
   LiveVariables::Observer *observer;
   const CFGBlock *currentBlock;
 public:
   TransferFunctions(LiveVariablesImpl &im,
-                    LiveVariables::LivenessValues &Val,
+                    llvm::BitVector &Val,
                     LiveVariables::Observer *Observer,
                     const CFGBlock *CurrentBlock)
   : LV(im), val(Val), observer(Observer), currentBlock(CurrentBlock) {}
@@ -260,20 +227,20 @@ static const Stmt *LookThroughStmt(const Stmt *S) {
   return S;
 }
 
-static void AddLiveStmt(llvm::ImmutableSet<const Stmt *> &Set,
-                        llvm::ImmutableSet<const Stmt *>::Factory &F,
+static void AddLiveStmt(LiveVariablesImpl &LV, llvm::BitVector &live,
                         const Stmt *S) {
-  Set = F.add(Set, LookThroughStmt(S));
+  LV.setLive(live, LookThroughStmt(S));
 }
 
 void TransferFunctions::Visit(Stmt *S) {
   if (observer)
-    observer->observeStmt(S, currentBlock, val);
+    observer->observeStmt(S, currentBlock,
+                          LiveVariables::LivenessValues(&LV, val));
   
   StmtVisitor<TransferFunctions>::Visit(S);
   
   if (isa<Expr>(S)) {
-    val.liveStmts = LV.SSetFact.remove(val.liveStmts, S);
+    LV.setDead(val, S);
   }
 
   // Mark all children expressions live.
@@ -290,7 +257,7 @@ void TransferFunctions::Visit(Stmt *S) {
       // Include the implicit "this" pointer as being live.
       CXXMemberCallExpr *CE = cast<CXXMemberCallExpr>(S);
       if (Expr *ImplicitObj = CE->getImplicitObjectArgument()) {
-        AddLiveStmt(val.liveStmts, LV.SSetFact, ImplicitObj);
+        AddLiveStmt(LV, val, ImplicitObj);
       }
       break;
     }
@@ -298,8 +265,7 @@ void TransferFunctions::Visit(Stmt *S) {
       // In calls to super, include the implicit "self" pointer as being live.
       ObjCMessageExpr *CE = cast<ObjCMessageExpr>(S);
       if (CE->getReceiverKind() == ObjCMessageExpr::SuperInstance)
-        val.liveDecls = LV.DSetFact.add(val.liveDecls,
-                                        LV.analysisContext.getSelfDecl());
+        LV.setLive(val, LV.analysisContext.getSelfDecl());
       break;
     }
     case Stmt::DeclStmtClass: {
@@ -307,7 +273,7 @@ void TransferFunctions::Visit(Stmt *S) {
       if (const VarDecl *VD = dyn_cast<VarDecl>(DS->getSingleDecl())) {
         for (const VariableArrayType* VA = FindVA(VD->getType());
              VA != 0; VA = FindVA(VA->getElementType())) {
-          AddLiveStmt(val.liveStmts, LV.SSetFact, VA->getSizeExpr());
+          AddLiveStmt(LV, val, VA->getSizeExpr());
         }
       }
       break;
@@ -320,7 +286,7 @@ void TransferFunctions::Visit(Stmt *S) {
       if (OpaqueValueExpr *OV = dyn_cast<OpaqueValueExpr>(child))
         child = OV->getSourceExpr();
       child = child->IgnoreParens();
-      val.liveStmts = LV.SSetFact.add(val.liveStmts, child);
+      LV.setLive(val, child);
       return;
     }
 
@@ -342,7 +308,7 @@ void TransferFunctions::Visit(Stmt *S) {
   for (Stmt::child_iterator it = S->child_begin(), ei = S->child_end();
        it != ei; ++it) {
     if (Stmt *child = *it)
-      AddLiveStmt(val.liveStmts, LV.SSetFact, child);
+      AddLiveStmt(LV, val, child);
   }
 }
 
@@ -362,7 +328,7 @@ void TransferFunctions::VisitBinaryOperator(BinaryOperator *B) {
 
         if (!isAlwaysAlive(VD)) {
           // The variable is now dead.
-          val.liveDecls = LV.DSetFact.remove(val.liveDecls, VD);
+          LV.setDead(val, VD);
         }
 
         if (observer)
@@ -379,14 +345,14 @@ void TransferFunctions::VisitBlockExpr(BlockExpr *BE) {
     const VarDecl *VD = *I;
     if (isAlwaysAlive(VD))
       continue;
-    val.liveDecls = LV.DSetFact.add(val.liveDecls, VD);
+    LV.setLive(val, VD);
   }
 }
 
 void TransferFunctions::VisitDeclRefExpr(DeclRefExpr *DR) {
   if (const VarDecl *D = dyn_cast<VarDecl>(DR->getDecl()))
     if (!isAlwaysAlive(D) && LV.inAssignment.find(DR) == LV.inAssignment.end())
-      val.liveDecls = LV.DSetFact.add(val.liveDecls, D);
+      LV.setLive(val, D);
 }
 
 void TransferFunctions::VisitDeclStmt(DeclStmt *DS) {
@@ -394,7 +360,7 @@ void TransferFunctions::VisitDeclStmt(DeclStmt *DS) {
        DI != DE; ++DI)
     if (VarDecl *VD = dyn_cast<VarDecl>(*DI)) {
       if (!isAlwaysAlive(VD))
-        val.liveDecls = LV.DSetFact.remove(val.liveDecls, VD);
+        LV.setDead(val, VD);
     }
 }
 
@@ -412,7 +378,7 @@ void TransferFunctions::VisitObjCForCollectionStmt(ObjCForCollectionStmt *OS) {
   }
   
   if (VD) {
-    val.liveDecls = LV.DSetFact.remove(val.liveDecls, VD);
+    LV.setDead(val, VD);
     if (observer && DR)
       observer->observerKill(DR);
   }
@@ -430,7 +396,7 @@ VisitUnaryExprOrTypeTraitExpr(UnaryExprOrTypeTraitExpr *UE)
   const Expr *subEx = UE->getArgumentExpr();
   if (subEx->getType()->isVariableArrayType()) {
     assert(subEx->isLValue());
-    val.liveStmts = LV.SSetFact.add(val.liveStmts, subEx->IgnoreParens());
+    LV.setLive(val, subEx->IgnoreParens());
   }
 }
 
@@ -458,10 +424,10 @@ void TransferFunctions::VisitUnaryOperator(UnaryOperator *UO) {
     }
 }
 
-LiveVariables::LivenessValues
-LiveVariablesImpl::runOnBlock(const CFGBlock *block,
-                              LiveVariables::LivenessValues val,
-                              LiveVariables::Observer *obs) {
+void LiveVariablesImpl::runOnBlock(const CFGBlock *block,
+                                   llvm::BitVector &val,
+                                   LiveVariables::Observer *obs,
+                                   bool recordStmts) {
 
   TransferFunctions TF(*this, val, obs, block);
   
@@ -476,7 +442,7 @@ LiveVariablesImpl::runOnBlock(const CFGBlock *block,
 
     if (Optional<CFGAutomaticObjDtor> Dtor =
             elem.getAs<CFGAutomaticObjDtor>()) {
-      val.liveDecls = DSetFact.add(val.liveDecls, Dtor->getVarDecl());
+      setLive(val, Dtor->getVarDecl());
       continue;
     }
 
@@ -485,15 +451,31 @@ LiveVariablesImpl::runOnBlock(const CFGBlock *block,
     
     const Stmt *S = elem.castAs<CFGStmt>().getStmt();
     TF.Visit(const_cast<Stmt*>(S));
-    stmtsToLiveness[S] = val;
+    if (recordStmts)
+      stmtsToLiveness[S] = LiveVariables::LivenessValues(this, val);
   }
-  return val;
 }
 
 void LiveVariables::runOnAllBlocks(LiveVariables::Observer &obs) {
   const CFG *cfg = getImpl(impl).analysisContext.getCFG();
-  for (CFG::const_iterator it = cfg->begin(), ei = cfg->end(); it != ei; ++it)
-    getImpl(impl).runOnBlock(*it, getImpl(impl).blocksEndToLiveness[*it], &obs);    
+  for (CFG::const_iterator it = cfg->begin(), ei = cfg->end(); it != ei; ++it) {
+    llvm::BitVector val(getImpl(impl).blocksEndToLiveness[*it].live);
+    getImpl(impl).runOnBlock(*it, val, &obs);
+  }
+}
+
+namespace {
+/// \brief Turns the liveness at the end of a block into the liveness at its
+/// start, for the dataflow solver.
+class LivenessTransfer {
+  LiveVariablesImpl &LV;
+public:
+  explicit LivenessTransfer(LiveVariablesImpl &LV) : LV(LV) {}
+
+  void operator()(const CFGBlock *block, llvm::BitVector &val) {
+    LV.runOnBlock(block, val);
+  }
+};
 }
 
 LiveVariables::LiveVariables(void *im) : impl(im) {} 
@@ -518,15 +500,14 @@ LiveVariables::computeLiveness(AnalysisDeclContext &AC,
 
   LiveVariablesImpl *LV = new LiveVariablesImpl(AC, killAtAssign);
 
-  // Construct the dataflow worklist.  Enqueue the exit block as the
-  // start of the analysis.
-  DataflowWorklist worklist(*cfg, AC);
-  llvm::BitVector everAnalyzedBlock(cfg->getNumBlockIDs());
+  // Visit every block at least once, starting from the exit block. The live
+  // sets start out empty, and grow as statements and variables are numbered.
+  BitVectorDataflow dataflow(*cfg, *AC.getAnalysis<PostOrderCFGView>(),
+                             DataflowWorklist::Backward, 0);
 
-  // FIXME: we should enqueue using post order.
   for (CFG::const_iterator it = cfg->begin(), ei = cfg->end(); it != ei; ++it) {
     const CFGBlock *block = *it;
-    worklist.enqueueBlock(block);
+    dataflow.enqueueBlock(block);
     
     // FIXME: Scan for DeclRefExprs using in the LHS of an assignment.
     // We need to do this because we lack context in the reverse analysis
@@ -549,34 +530,17 @@ LiveVariables::computeLiveness(AnalysisDeclContext &AC,
       }
   }
   
-  worklist.sortWorklist();
-  
-  while (const CFGBlock *block = worklist.dequeue()) {
-    // Determine if the block's end value has changed.  If not, we
-    // have nothing left to do for this block.
-    LivenessValues &prevVal = LV->blocksEndToLiveness[block];
-    
-    // Merge the values of all successor blocks.
-    LivenessValues val;
-    for (CFGBlock::const_succ_iterator it = block->succ_begin(),
-                                       ei = block->succ_end(); it != ei; ++it) {
-      if (const CFGBlock *succ = *it) {     
-        val = LV->merge(val, LV->blocksBeginToLiveness[succ]);
-      }
-    }
-    
-    if (!everAnalyzedBlock[block->getBlockID()])
-      everAnalyzedBlock[block->getBlockID()] = true;
-    else if (prevVal.equals(val))
-      continue;
+  LivenessTransfer transfer(*LV);
+  dataflow.solve(transfer);
 
-    prevVal = val;
-    
-    // Update the dataflow value for the start of this block.
-    LV->blocksBeginToLiveness[block] = LV->runOnBlock(block, val);
-    
-    // Enqueue the value to the predecessors.
-    worklist.enqueuePredecessors(block);
+  // Keep the liveness at the end of each block. Now that it is final, replay
+  // each block once to record the liveness at each statement, rather than
+  // copying it for every statement on every visit of the solver.
+  for (CFG::const_iterator it = cfg->begin(), ei = cfg->end(); it != ei; ++it) {
+    const llvm::BitVector &endLive = dataflow.getInValue(*it);
+    LV->blocksEndToLiveness[*it] = LivenessValues(LV, endLive);
+    llvm::BitVector val(endLive);
+    LV->runOnBlock(*it, val, 0, /*recordStmts=*/true);
   }
   
   return new LiveVariables(LV);
@@ -615,10 +579,10 @@ void LiveVariablesImpl::dumpBlockLiveness(const SourceManager &M) {
     LiveVariables::LivenessValues vals = blocksEndToLiveness[*it];
     declVec.clear();
     
-    for (llvm::ImmutableSet<const VarDecl *>::iterator si =
-          vals.liveDecls.begin(),
-          se = vals.liveDecls.end(); si != se; ++si) {
-      declVec.push_back(*si);      
+    for (llvm::DenseMap<const VarDecl *, unsigned>::iterator
+          di = declBits.begin(), de = declBits.end(); di != de; ++di) {
+      if (vals.isLive(di->first))
+        declVec.push_back(di->first);
     }
     
     std::sort(declVec.begin(), declVec.end(), compare_vd_entries);
@@ -29,6 +29,7 @@
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/SourceManager.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/FoldingSet.h"
 #include "llvm/ADT/ImmutableMap.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -572,6 +573,66 @@ public:
     return NodeVec[0].kind() == EOP_Universal;
   }
 
+  /// \brief What a lock expression may refer to that is substituted when it
+  /// is built in the context of a call.
+  enum ContextRefKind {
+    CR_This   = 1, ///< 'this', written or implicit.
+    CR_Params = 2  ///< A function parameter.
+  };
+
+  /// \brief Return the ContextRefKinds of everything under S.  Parameters of
+  /// any function count, not only those of the function with the attribute.
+  static unsigned getContextRefs(const Stmt *S) {
+    if (!S)
+      return 0;
+    unsigned Refs = 0;
+    if (isa<CXXThisExpr>(S))
+      Refs |= CR_This;
+    else if (const DeclRefExpr *DRE = dyn_cast<DeclRefExpr>(S))
+      if (isa<ParmVarDecl>(DRE->getDecl()))
+        Refs |= CR_Params;
+    for (Stmt::const_child_range C = S->children(); C; ++C)
+      Refs |= getContextRefs(*C);
+    return Refs;
+  }
+
+  /// \brief Return true if an attribute argument that refers to \p Refs
+  /// builds the same SExpr in the context of DeclExp as it does on its own,
+  /// i.e. if buildSExprFromExpr has nothing to substitute into it.
+  static bool isContextFree(unsigned Refs, const Expr *DeclExp,
+                            const NamedDecl *D, VarDecl *SelfDecl) {
+    if (!DeclExp || !Refs)
+      return true;
+
+    // Find SelfArg and FunArgs as buildSExprFromExpr does.
+    const Expr *SelfArg = 0;
+    bool SelfArrow = false;
+    bool HasArgs = false;
+    if (const MemberExpr *ME = dyn_cast<MemberExpr>(DeclExp)) {
+      SelfArg   = ME->getBase();
+      SelfArrow = ME->isArrow();
+    } else if (const CXXMemberCallExpr *CE =
+               dyn_cast<CXXMemberCallExpr>(DeclExp)) {
+      const MemberExpr *Callee = dyn_cast<MemberExpr>(CE->getCallee());
+      SelfArg   = CE->getImplicitObjectArgument();
+      SelfArrow = Callee && Callee->isArrow();
+      HasArgs   = true;
+    } else if (isa<CallExpr>(DeclExp) || isa<CXXConstructExpr>(DeclExp)) {
+      HasArgs = true;
+    } else if (D && isa<CXXDestructorDecl>(D)) {
+      SelfArg = DeclExp;
+    }
+
+    if ((Refs & CR_Params) && HasArgs)
+      return false;
+    if (!(Refs & CR_This))
+      return true;
+    if (!SelfArg)
+      return !SelfDecl;
+    // Substituting this-> for 'this' changes nothing.
+    return SelfArrow && isa<CXXThisExpr>(SelfArg->IgnoreParenImpCasts());
+  }
+
   /// Issue a warning about an invalid lock expression
   static void warnInvalidLock(ThreadSafetyHandler &Handler,
                               const Expr *MutexExp,
@@ -734,6 +795,32 @@ public:
   }
 };
 
+} // end anonymous namespace
+
+namespace clang {
+namespace thread_safety {
+
+/// \brief The attribute arguments that have been parsed, along with what they
+/// refer to.  Attributes are shared by all the calls to a function and all the
+/// uses of a guarded variable, so most arguments are parsed only once.
+class LockExprCache {
+public:
+  struct Entry {
+    SExpr    Exp;          // Built without a calling context.
+    unsigned ContextRefs;  // SExpr::ContextRefKinds
+    bool     Parsed;
+
+    Entry() : Exp(Decl::EmptyShell()), ContextRefs(0), Parsed(false) { }
+  };
+
+  llvm::DenseMap<const Expr *, Entry> Entries;
+};
+
+} // end namespace thread_safety
+} // end namespace clang
+
+namespace {
+
 
 
 /// \brief This is a helper class that stores info about the most recent
@@ -839,6 +926,16 @@ public:
 
   bool isEmpty() const { return FactIDs.size() == 0; }
 
+  /// \brief Return true if both sets hold the same facts, in any order.
+  bool hasSameFacts(const FactSet &Other) const {
+    if (FactIDs.size() != Other.FactIDs.size())
+      return false;
+    for (const_iterator I = begin(), E = end(); I != E; ++I)
+      if (std::find(Other.begin(), Other.end(), *I) == Other.end())
+        return false;
+    return true;
+  }
+
   FactID addLock(FactManager& FM, const SExpr& M, const LockData& L) {
     FactID F = FM.newLock(M, L);
     FactIDs.push_back(F);
@@ -1430,12 +1527,17 @@ class ThreadSafetyAnalyzer {
   friend class BuildLockset;
 
   ThreadSafetyHandler       &Handler;
+  LockExprCache             *Cache;
   LocalVariableMap          LocalVarMap;
   FactManager               FactMan;
   std::vector<CFGBlockInfo> BlockInfo;
 
 public:
-  ThreadSafetyAnalyzer(ThreadSafetyHandler &H) : Handler(H) {}
+  ThreadSafetyAnalyzer(ThreadSafetyHandler &H, LockExprCache *C)
+    : Handler(H), Cache(C) {}
+
+  SExpr buildLockExpr(const Expr *MutexExp, const Expr *DeclExp,
+                      const NamedDecl *D, VarDecl *SelfDecl = 0);
 
   void addLock(FactSet &FSet, const SExpr &Mutex, const LockData &LDat);
   void removeLock(FactSet &FSet, const SExpr &Mutex,
@@ -1529,6 +1631,28 @@ void ThreadSafetyAnalyzer::removeLock(FactSet &FSet,
 }
 
 
+/// \brief Build the SExpr for MutexExp, an argument of an attribute on D, in
+/// the context of DeclExp.  Arguments that have nothing to substitute in that
+/// context are taken from the cache rather than parsed again.
+SExpr ThreadSafetyAnalyzer::buildLockExpr(const Expr *MutexExp,
+                                          const Expr *DeclExp,
+                                          const NamedDecl *D,
+                                          VarDecl *SelfDecl) {
+  if (!MutexExp || !Cache)
+    return SExpr(MutexExp, DeclExp, D, SelfDecl);
+
+  LockExprCache::Entry &Cached = Cache->Entries[MutexExp];
+  if (!Cached.Parsed) {
+    Cached.Exp = SExpr(MutexExp, 0, D);
+    Cached.ContextRefs = SExpr::getContextRefs(MutexExp);
+    Cached.Parsed = true;
+  }
+  if (SExpr::isContextFree(Cached.ContextRefs, DeclExp, D, SelfDecl))
+    return Cached.Exp;
+  return SExpr(MutexExp, DeclExp, D, SelfDecl);
+}
+
+
 /// \brief Extract the list of mutexIDs from the attribute on an expression,
 /// and push them onto Mtxs, discarding any duplicates.
 template <typename AttrType>
@@ -1548,7 +1672,7 @@ void ThreadSafetyAnalyzer::getMutexIDs(MutexIDList &Mtxs, AttrType *Attr,
   }
 
   for (iterator_type I=Attr->args_begin(), E=Attr->args_end(); I != E; ++I) {
-    SExpr Mu(*I, Exp, D, SelfDecl);
+    SExpr Mu = buildLockExpr(*I, Exp, D, SelfDecl);
     if (!Mu.isValid())
       SExpr::warnInvalidLock(Handler, *I, Exp, D);
     else
@@ -1791,7 +1915,7 @@ void BuildLockset::warnIfMutexNotHeld(const NamedDecl *D, const Expr *Exp,
                                       ProtectedOperationKind POK) {
   LockKind LK = getLockKindFromAccessKind(AK);
 
-  SExpr Mutex(MutexExp, Exp, D);
+  SExpr Mutex = Analyzer->buildLockExpr(MutexExp, Exp, D);
   if (!Mutex.isValid()) {
     SExpr::warnInvalidLock(Analyzer->Handler, MutexExp, Exp, D);
     return;
@@ -1827,7 +1951,7 @@ void BuildLockset::warnIfMutexNotHeld(const NamedDecl *D, const Expr *Exp,
 /// \brief Warn if the LSet contains the given lock.
 void BuildLockset::warnIfMutexHeld(const NamedDecl *D, const Expr* Exp,
                                    Expr *MutexExp) {
-  SExpr Mutex(MutexExp, Exp, D);
+  SExpr Mutex = Analyzer->buildLockExpr(MutexExp, Exp, D);
   if (!Mutex.isValid()) {
     SExpr::warnInvalidLock(Analyzer->Handler, MutexExp, Exp, D);
     return;
@@ -2158,6 +2282,11 @@ void ThreadSafetyAnalyzer::intersectAndWarn(FactSet &FSet1,
                                             LockErrorKind LEK1,
                                             LockErrorKind LEK2,
                                             bool Modify) {
+  // Joining a lockset with itself, e.g. at the end of an if statement that
+  // neither takes nor releases a lock, cannot warn or change anything.
+  if (FSet1.hasSameFacts(FSet2))
+    return;
+
   FactSet FSet1Orig = FSet1;
 
   for (FactSet::const_iterator I = FSet2.begin(), E = FSet2.end();
@@ -2549,11 +2678,18 @@ namespace thread_safety {
 /// at the end of each block, and issue warnings for thread safety violations.
 /// Each block in the CFG is traversed exactly once.
 void runThreadSafetyAnalysis(AnalysisDeclContext &AC,
-                             ThreadSafetyHandler &Handler) {
-  ThreadSafetyAnalyzer Analyzer(Handler);
+                             ThreadSafetyHandler &Handler,
+                             LockExprCache **Cache) {
+  if (Cache && !*Cache)
+    *Cache = new LockExprCache();
+  ThreadSafetyAnalyzer Analyzer(Handler, Cache ? *Cache : 0);
   Analyzer.runAnalysis(AC);
 }
 
+void threadSafetyCleanup(LockExprCache *Cache) {
+  delete Cache;
+}
+
 /// \brief Helper function that returns a LockKind required for the given level
 /// of access.
 LockKind getLockKindFromAccessKind(AccessKind AK) {
@@ -14,24 +14,22 @@
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Attr.h"
 #include "clang/AST/Decl.h"
+#include "clang/Analysis/Analyses/BitVectorDataflow.h"
 #include "clang/Analysis/Analyses/PostOrderCFGView.h"
 #include "clang/Analysis/Analyses/UninitializedValues.h"
 #include "clang/Analysis/AnalysisContext.h"
 #include "clang/Analysis/CFG.h"
 #include "clang/Analysis/DomainSpecific/ObjCNoReturn.h"
 #include "clang/Analysis/Visitors/CFGRecStmtDeclVisitor.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
-#include "llvm/ADT/PackedVector.h"
-#include "llvm/ADT/SmallBitVector.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/SaveAndRestore.h"
 #include <utility>
 
 using namespace clang;
 
-#define DEBUG_LOGGING 0
-
 static bool isTrackedVar(const VarDecl *vd, const DeclContext *dc) {
   if (vd->isLocalVarDecl() && !vd->hasGlobalStorage() &&
       !vd->isExceptionVariable() &&
@@ -101,162 +99,75 @@ static bool isAlwaysUninit(const Value v) {
 
 namespace {
 
-typedef llvm::PackedVector<Value, 2, llvm::SmallBitVector> ValueVector;
+/// \brief A reference to the Value of one variable in a bit vector that packs
+/// the Values of all of them, two bits each. The packing keeps a merge a
+/// word-wide bitwise OR.
+class ValueRef {
+  llvm::BitVector &bits;
+  unsigned idx;
+public:
+  ValueRef(llvm::BitVector &bits, unsigned idx) : bits(bits), idx(idx) {}
+
+  operator Value() const {
+    return Value((bits[2 * idx] ? 0x1 : 0) | (bits[2 * idx + 1] ? 0x2 : 0));
+  }
+
+  ValueRef &operator=(Value v) {
+    bits[2 * idx] = (v & 0x1) != 0;
+    bits[2 * idx + 1] = (v & 0x2) != 0;
+    return *this;
+  }
+};
 
 class CFGBlockValues {
-  const CFG &cfg;
-  SmallVector<ValueVector, 8> vals;
-  ValueVector scratch;
+  BitVectorDataflow *dataflow;
+  llvm::BitVector *current;
   DeclToIndex declToIndex;
 public:
-  CFGBlockValues(const CFG &cfg);
+  CFGBlockValues();
 
   unsigned getNumEntries() const { return declToIndex.size(); }
   
   void computeSetOfDeclarations(const DeclContext &dc);  
-  ValueVector &getValueVector(const CFGBlock *block) {
-    return vals[block->getBlockID()];
-  }
 
-  void setAllScratchValues(Value V);
-  void mergeIntoScratch(ValueVector const &source, bool isFirst);
-  bool updateValueVectorWithScratch(const CFGBlock *block);
+  /// Use the values that \p DF computes for each block.
+  void setDataflow(BitVectorDataflow &DF) { dataflow = &DF; }
+
+  /// Make \p V the values that the transfer functions update.
+  void setCurrentValues(llvm::BitVector &V) { current = &V; }
+
+  void setAllCurrentValues(Value V);
   
   bool hasNoDeclarations() const {
     return declToIndex.size() == 0;
   }
 
-  void resetScratch();
-  
-  ValueVector::reference operator[](const VarDecl *vd);
+  ValueRef operator[](const VarDecl *vd);
 
   Value getValue(const CFGBlock *block, const CFGBlock *dstBlock,
                  const VarDecl *vd) {
     const Optional<unsigned> &idx = declToIndex.getValueIndex(vd);
     assert(idx.hasValue());
-    return getValueVector(block)[idx.getValue()];
+    return ValueRef(dataflow->getOutValue(block), idx.getValue());
   }
 };  
 } // end anonymous namespace
 
-CFGBlockValues::CFGBlockValues(const CFG &c) : cfg(c), vals(0) {}
+CFGBlockValues::CFGBlockValues() : dataflow(0), current(0) {}
 
 void CFGBlockValues::computeSetOfDeclarations(const DeclContext &dc) {
   declToIndex.computeMap(dc);
-  unsigned decls = declToIndex.size();
-  scratch.resize(decls);
-  unsigned n = cfg.getNumBlockIDs();
-  if (!n)
-    return;
-  vals.resize(n);
-  for (unsigned i = 0; i < n; ++i)
-    vals[i].resize(decls);
-}
-
-#if DEBUG_LOGGING
-static void printVector(const CFGBlock *block, ValueVector &bv,
-                        unsigned num) {
-  llvm::errs() << block->getBlockID() << " :";
-  for (unsigned i = 0; i < bv.size(); ++i) {
-    llvm::errs() << ' ' << bv[i];
-  }
-  llvm::errs() << " : " << num << '\n';
 }
-#endif
 
-void CFGBlockValues::setAllScratchValues(Value V) {
-  for (unsigned I = 0, E = scratch.size(); I != E; ++I)
-    scratch[I] = V;
+void CFGBlockValues::setAllCurrentValues(Value V) {
+  for (unsigned I = 0, E = declToIndex.size(); I != E; ++I)
+    ValueRef(*current, I) = V;
 }
 
-void CFGBlockValues::mergeIntoScratch(ValueVector const &source,
-                                      bool isFirst) {
-  if (isFirst)
-    scratch = source;
-  else
-    scratch |= source;
-}
-
-bool CFGBlockValues::updateValueVectorWithScratch(const CFGBlock *block) {
-  ValueVector &dst = getValueVector(block);
-  bool changed = (dst != scratch);
-  if (changed)
-    dst = scratch;
-#if DEBUG_LOGGING
-  printVector(block, scratch, 0);
-#endif
-  return changed;
-}
-
-void CFGBlockValues::resetScratch() {
-  scratch.reset();
-}
-
-ValueVector::reference CFGBlockValues::operator[](const VarDecl *vd) {
+ValueRef CFGBlockValues::operator[](const VarDecl *vd) {
   const Optional<unsigned> &idx = declToIndex.getValueIndex(vd);
   assert(idx.hasValue());
-  return scratch[idx.getValue()];
-}
-
-//------------------------------------------------------------------------====//
-// Worklist: worklist for dataflow analysis.
-//====------------------------------------------------------------------------//
-
-namespace {
-class DataflowWorklist {
-  PostOrderCFGView::iterator PO_I, PO_E;
-  SmallVector<const CFGBlock *, 20> worklist;
-  llvm::BitVector enqueuedBlocks;
-public:
-  DataflowWorklist(const CFG &cfg, PostOrderCFGView &view)
-    : PO_I(view.begin()), PO_E(view.end()),
-      enqueuedBlocks(cfg.getNumBlockIDs(), true) {
-        // Treat the first block as already analyzed.
-        if (PO_I != PO_E) {
-          assert(*PO_I == &cfg.getEntry());
-          enqueuedBlocks[(*PO_I)->getBlockID()] = false;
-          ++PO_I;
-        }
-      }
-  
-  void enqueueSuccessors(const CFGBlock *block);
-  const CFGBlock *dequeue();
-};
-}
-
-void DataflowWorklist::enqueueSuccessors(const clang::CFGBlock *block) {
-  for (CFGBlock::const_succ_iterator I = block->succ_begin(),
-       E = block->succ_end(); I != E; ++I) {
-    const CFGBlock *Successor = *I;
-    if (!Successor || enqueuedBlocks[Successor->getBlockID()])
-      continue;
-    worklist.push_back(Successor);
-    enqueuedBlocks[Successor->getBlockID()] = true;
-  }
-}
-
-const CFGBlock *DataflowWorklist::dequeue() {
-  const CFGBlock *B = 0;
-
-  // First dequeue from the worklist.  This can represent
-  // updates along backedges that we want propagated as quickly as possible.
-  if (!worklist.empty()) {
-    B = worklist.back();
-    worklist.pop_back();
-  }
-  // Next dequeue from the initial reverse post order.  This is the
-  // theoretical ideal in the presence of no back edges.
-  else if (PO_I != PO_E) {
-    B = *PO_I;
-    ++PO_I;
-  }
-  else {
-    return 0;
-  }
-
-  assert(enqueuedBlocks[B->getBlockID()] == true);
-  enqueuedBlocks[B->getBlockID()] = false;
-  return B;
+  return ValueRef(*current, idx.getValue());
 }
 
 //------------------------------------------------------------------------====//
@@ -637,7 +548,7 @@ void TransferFunctions::VisitCallExpr(CallExpr *ce) {
       // now, just assume such a call initializes all variables.  FIXME: Only
       // mark variables as initialized if they have an initializer which is
       // reachable from here.
-      vals.setAllScratchValues(Initialized);
+      vals.setAllCurrentValues(Initialized);
     }
     else if (Callee->hasAttr<AnalyzerNoReturnAttr>()) {
       // Functions labeled like "analyzer_noreturn" are often used to denote
@@ -647,7 +558,7 @@ void TransferFunctions::VisitCallExpr(CallExpr *ce) {
       // suppressing branch-specific false positives when we call one of these
       // functions but keep pretending the path continues (when in reality the
       // user doesn't care).
-      vals.setAllScratchValues(Unknown);
+      vals.setAllCurrentValues(Unknown);
     }
   }
 }
@@ -717,7 +628,7 @@ void TransferFunctions::VisitObjCMessageExpr(ObjCMessageExpr *ME) {
   // If the Objective-C message expression is an implicit no-return that
   // is not modeled in the CFG, set the tracked dataflow values to Unknown.
   if (objCNoRet.isImplicitNoReturn(ME)) {
-    vals.setAllScratchValues(Unknown);
+    vals.setAllCurrentValues(Unknown);
   }
 }
 
@@ -725,31 +636,20 @@ void TransferFunctions::VisitObjCMessageExpr(ObjCMessageExpr *ME) {
 // High-level "driver" logic for uninitialized values analysis.
 //====------------------------------------------------------------------------//
 
-static bool runOnBlock(const CFGBlock *block, const CFG &cfg,
+/// Apply the transfer functions to \p block, turning \p val from the values
+/// at its start into those at its end.
+static void runOnBlock(const CFGBlock *block, const CFG &cfg,
                        AnalysisDeclContext &ac, CFGBlockValues &vals,
                        const ClassifyRefs &classification,
-                       llvm::BitVector &wasAnalyzed,
+                       llvm::BitVector &val,
                        UninitVariablesHandler &handler) {
-  wasAnalyzed[block->getBlockID()] = true;
-  vals.resetScratch();
-  // Merge in values of predecessor blocks.
-  bool isFirst = true;
-  for (CFGBlock::const_pred_iterator I = block->pred_begin(),
-       E = block->pred_end(); I != E; ++I) {
-    const CFGBlock *pred = *I;
-    if (wasAnalyzed[pred->getBlockID()]) {
-      vals.mergeIntoScratch(vals.getValueVector(pred), isFirst);
-      isFirst = false;
-    }
-  }
-  // Apply the transfer function.
+  vals.setCurrentValues(val);
   TransferFunctions tf(vals, cfg, block, ac, classification, handler);
   for (CFGBlock::const_iterator I = block->begin(), E = block->end(); 
        I != E; ++I) {
     if (Optional<CFGStmt> cs = I->getAs<CFGStmt>())
       tf.Visit(const_cast<Stmt*>(cs->getStmt()));
   }
-  return vals.updateValueVectorWithScratch(block);
 }
 
 /// PruneBlocksHandler is a special UninitVariablesHandler that is used
@@ -787,6 +687,27 @@ struct PruneBlocksHandler : public UninitVariablesHandler {
     hadAnyUse = true;
   }
 };
+
+/// \brief Runs the transfer functions over a block for the dataflow solver,
+/// recording whether the block may use an uninitialized variable.
+class PruningTransfer {
+  const CFG &cfg;
+  AnalysisDeclContext &ac;
+  CFGBlockValues &vals;
+  const ClassifyRefs &classification;
+  PruneBlocksHandler &handler;
+public:
+  PruningTransfer(const CFG &cfg, AnalysisDeclContext &ac,
+                  CFGBlockValues &vals, const ClassifyRefs &classification,
+                  PruneBlocksHandler &handler)
+    : cfg(cfg), ac(ac), vals(vals), classification(classification),
+      handler(handler) {}
+
+  void operator()(const CFGBlock *block, llvm::BitVector &val) {
+    handler.currentBlock = block->getBlockID();
+    runOnBlock(block, cfg, ac, vals, classification, val, handler);
+  }
+};
 }
 
 void clang::runUninitializedVariablesAnalysis(
@@ -795,7 +716,7 @@ void clang::runUninitializedVariablesAnalysis(
     AnalysisDeclContext &ac,
     UninitVariablesHandler &handler,
     UninitVariablesAnalysisStats &stats) {
-  CFGBlockValues vals(cfg);
+  CFGBlockValues vals;
   vals.computeSetOfDeclarations(dc);
   if (vals.hasNoDeclarations())
     return;
@@ -806,42 +727,39 @@ void clang::runUninitializedVariablesAnalysis(
   ClassifyRefs classification(ac);
   cfg.VisitBlockStmts(classification);
 
-  // Mark all variables uninitialized at the entry.
-  const CFGBlock &entry = cfg.getEntry();
-  ValueVector &vec = vals.getValueVector(&entry);
+  // Each variable takes two bits. Blocks that were not analyzed yet hold
+  // Unknown for every variable, which is the identity of the merge.
   const unsigned n = vals.getNumEntries();
-  for (unsigned j = 0; j < n ; ++j) {
-    vec[j] = Uninitialized;
-  }
+  PostOrderCFGView &POV = *ac.getAnalysis<PostOrderCFGView>();
+  BitVectorDataflow dataflow(cfg, POV, DataflowWorklist::Forward, 2 * n);
+  vals.setDataflow(dataflow);
 
-  // Proceed with the workist.
-  DataflowWorklist worklist(cfg, *ac.getAnalysis<PostOrderCFGView>());
-  llvm::BitVector previouslyVisited(cfg.getNumBlockIDs());
-  worklist.enqueueSuccessors(&cfg.getEntry());
-  llvm::BitVector wasAnalyzed(cfg.getNumBlockIDs(), false);
-  wasAnalyzed[cfg.getEntry().getBlockID()] = true;
-  PruneBlocksHandler PBH(cfg.getNumBlockIDs());
+  // Mark all variables uninitialized at the entry.
+  const CFGBlock &entry = cfg.getEntry();
+  vals.setCurrentValues(dataflow.getOutValue(&entry));
+  vals.setAllCurrentValues(Uninitialized);
+  dataflow.setBoundaryBlock(&entry);
 
-  while (const CFGBlock *block = worklist.dequeue()) {
-    PBH.currentBlock = block->getBlockID();
+  // Start with every reachable block but the entry, so that each of them is
+  // visited at least once, in reverse post order.
+  for (PostOrderCFGView::iterator I = POV.begin(), E = POV.end(); I != E; ++I)
+    if (*I != &entry)
+      dataflow.enqueueBlock(*I);
 
-    // Did the block change?
-    bool changed = runOnBlock(block, cfg, ac, vals,
-                              classification, wasAnalyzed, PBH);
-    ++stats.NumBlockVisits;
-    if (changed || !previouslyVisited[block->getBlockID()])
-      worklist.enqueueSuccessors(block);    
-    previouslyVisited[block->getBlockID()] = true;
-  }
+  PruneBlocksHandler PBH(cfg.getNumBlockIDs());
+  PruningTransfer transfer(cfg, ac, vals, classification, PBH);
+  stats.NumBlockVisits += dataflow.solve(transfer);
 
   if (!PBH.hadAnyUse)
     return;
 
   // Run through the blocks one more time, and report uninitialized variables.
+  llvm::BitVector val;
   for (CFG::const_iterator BI = cfg.begin(), BE = cfg.end(); BI != BE; ++BI) {
     const CFGBlock *block = *BI;
     if (PBH.hadUse[block->getBlockID()]) {
-      runOnBlock(block, cfg, ac, vals, classification, wasAnalyzed, handler);
+      val = dataflow.getInValue(block);
+      runOnBlock(block, cfg, ac, vals, classification, val, handler);
       ++stats.NumBlockVisits;
     }
   }
@@ -58,6 +58,11 @@ DiagnosticsEngine::DiagnosticsEngine(
   ShowOverloads = Ovl_All;
   ExtBehavior = Ext_Ignore;
 
+  IgnoredEverywhereKnown.resize(diag::DIAG_UPPER_LIMIT);
+  IgnoredEverywhere.resize(diag::DIAG_UPPER_LIMIT);
+  NumFastLevelQueries = 0;
+  NumSlowLevelQueries = 0;
+
   ErrorLimit = 0;
   TemplateBacktraceLimit = 0;
   ConstexprBacktraceLimit = 0;
@@ -115,6 +120,7 @@ void DiagnosticsEngine::Reset() {
   DiagStates.clear();
   DiagStatePoints.clear();
   DiagStateOnPushStack.clear();
+  invalidateIgnoredEverywhere();
 
   // Create a DiagState and DiagStatePoint representing diagnostic changes
   // through command-line.
@@ -122,6 +128,17 @@ void DiagnosticsEngine::Reset() {
   DiagStatePoints.push_back(DiagStatePoint(&DiagStates.back(), FullSourceLoc()));
 }
 
+void DiagnosticsEngine::PrintStats() const {
+  llvm::errs() << "\n*** Diagnostic Stats:\n";
+  llvm::errs() << "  " << DiagStates.size() << " diagnostic states, "
+               << DiagStatePoints.size() << " state changes.\n";
+  llvm::errs() << "  " << NumFastLevelQueries << "/"
+               << (NumFastLevelQueries + NumSlowLevelQueries)
+               << " level queries for diagnostics ignored everywhere.\n";
+  llvm::errs() << "  " << NumSlowLevelQueries
+               << " level queries looked up the state of their location.\n";
+}
+
 void DiagnosticsEngine::SetDelayedDiagnostic(unsigned DiagID, StringRef Arg1,
                                              StringRef Arg2) {
   if (DelayedDiagID)
@@ -162,6 +179,40 @@ DiagnosticsEngine::GetDiagStatePointForLoc(SourceLocation L) const {
   return Pos;
 }
 
+bool DiagnosticsEngine::isIgnoredEverywhere(unsigned DiagID) const {
+  assert(DiagID < diag::DIAG_UPPER_LIMIT && "Can only map builtin diagnostics");
+  if (IgnoredEverywhereKnown.test(DiagID))
+    return IgnoredEverywhere.test(DiagID);
+
+  bool EnabledByDefault = false;
+  bool IsExtensionDiag =
+    DiagnosticIDs::isBuiltinExtensionDiag(DiagID, EnabledByDefault);
+
+  // Every state is reachable from some point, so it is enough to look at the
+  // points. Unless the mapping came from the user, an ignored diagnostic may
+  // still be upgraded by -Weverything or -pedantic; __extension__ only ever
+  // silences diagnostics, so it cannot invalidate the answer.
+  bool Ignored = true;
+  for (DiagStatePointsTy::iterator I = DiagStatePoints.begin(),
+                                   E = DiagStatePoints.end();
+       I != E && Ignored; ++I) {
+    const DiagnosticMappingInfo &Info =
+      I->State->getOrAddMappingInfo((diag::kind)DiagID);
+    if (Info.getMapping() != diag::MAP_IGNORE)
+      Ignored = false;
+    else if (!Info.isUser())
+      Ignored = !EnableAllWarnings &&
+                (!IsExtensionDiag || ExtBehavior == Ext_Ignore);
+  }
+
+  IgnoredEverywhereKnown.set(DiagID);
+  if (Ignored)
+    IgnoredEverywhere.set(DiagID);
+  else
+    IgnoredEverywhere.reset(DiagID);
+  return Ignored;
+}
+
 void DiagnosticsEngine::setDiagnosticMapping(diag::kind Diag, diag::Mapping Map,
                                              SourceLocation L) {
   assert(Diag < diag::DIAG_UPPER_LIMIT &&
@@ -182,6 +233,7 @@ void DiagnosticsEngine::setDiagnosticMapping(diag::kind Diag, diag::Mapping Map,
       Map = Info.getMapping();
   }
   DiagnosticMappingInfo MappingInfo = makeMappingInfo(Map, L);
+  updateIgnoredEverywhere(Diag, MappingInfo);
 
   // Common case; setting all the diagnostics of a group in one place.
   if (Loc.isInvalid() || Loc == LastStateChangePos) {
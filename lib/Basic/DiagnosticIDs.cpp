@@ -406,6 +406,14 @@ DiagnosticIDs::Level
 DiagnosticIDs::getDiagnosticLevel(unsigned DiagID, unsigned DiagClass,
                                   SourceLocation Loc,
                                   const DiagnosticsEngine &Diag) const {
+  // Most of the diagnostics Sema asks about are warnings that are off; answer
+  // those without looking for the state of the location.
+  if (DiagID < diag::DIAG_UPPER_LIMIT && Diag.isIgnoredEverywhere(DiagID)) {
+    ++Diag.NumFastLevelQueries;
+    return DiagnosticIDs::Ignored;
+  }
+  ++Diag.NumSlowLevelQueries;
+
   // Specific non-error diagnostics may be mapped to various levels from ignored
   // to error.  Errors can only be mapped to fatal.
   DiagnosticIDs::Level Result = DiagnosticIDs::Fatal;
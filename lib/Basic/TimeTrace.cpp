@@ -0,0 +1,196 @@
+//===- TimeTrace.cpp - Hierarchical Compile-Time Profiler -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the time-trace profiler behind -ftime-trace.
+//
+//===----------------------------------------------------------------------===//
+#include "clang/Basic/TimeTrace.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+TimeTraceProfiler *clang::TimeTraceProfilerInstance = 0;
+
+/// \brief Events shorter than this many microseconds are only counted in the
+/// totals; writing every header and instantiation of a large translation unit
+/// would produce traces too big to load.
+static const double TimeTraceGranularity = 500;
+
+namespace {
+struct TimeTraceEntry {
+  double Start;
+  double Duration;
+  std::string Name;
+  std::string Detail;
+};
+
+struct TimeTraceTotal {
+  std::string Name;
+  unsigned Count;
+  double Duration;
+};
+
+struct OrderTotalsByDuration {
+  bool operator()(const TimeTraceTotal &X, const TimeTraceTotal &Y) const {
+    return X.Duration > Y.Duration;
+  }
+};
+} // end anonymous namespace
+
+namespace clang {
+class TimeTraceProfiler {
+public:
+  /// \brief The events that are currently open, innermost last.
+  SmallVector<TimeTraceEntry, 16> Stack;
+
+  /// \brief The closed events that are long enough to be written.
+  std::vector<TimeTraceEntry> Entries;
+
+  /// \brief The number of events and the time spent in them, by name.
+  llvm::StringMap<std::pair<unsigned, double> > Totals;
+
+  /// \brief The time at which profiling started, in microseconds.
+  double StartTime;
+
+  TimeTraceProfiler() : StartTime(now()) { }
+
+  static double now() {
+    return llvm::TimeRecord::getCurrentTime(true).getWallTime() * 1e6;
+  }
+
+  void begin(StringRef Name, StringRef Detail) {
+    Stack.push_back(TimeTraceEntry());
+    TimeTraceEntry &E = Stack.back();
+    E.Start = now();
+    E.Duration = 0;
+    E.Name = Name;
+    E.Detail = Detail;
+  }
+
+  void end() {
+    if (Stack.empty())
+      return;
+    TimeTraceEntry E = Stack.pop_back_val();
+    E.Duration = now() - E.Start;
+
+    // Recursive events (e.g. a header including a header) only count once
+    // towards the total of their kind.
+    bool Nested = false;
+    for (unsigned I = 0, N = Stack.size(); I != N && !Nested; ++I)
+      Nested = Stack[I].Name == E.Name;
+    std::pair<unsigned, double> &Total = Totals[E.Name];
+    ++Total.first;
+    if (!Nested)
+      Total.second += E.Duration;
+
+    if (E.Duration >= TimeTraceGranularity)
+      Entries.push_back(E);
+  }
+
+  void write(raw_ostream &OS);
+};
+} // end namespace clang
+
+/// \brief Write \p Str as a JSON string literal.
+static void writeJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned I = 0, N = Str.size(); I != N; ++I) {
+    unsigned char C = Str[I];
+    switch (C) {
+    case '"':  OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    case '\n': OS << "\\n"; break;
+    case '\t': OS << "\\t"; break;
+    default:
+      if (C < 0x20)
+        OS << llvm::format("\\u%04x", C);
+      else
+        OS << C;
+    }
+  }
+  OS << '"';
+}
+
+static void writeEvent(raw_ostream &OS, unsigned TID, double Start,
+                       double Duration, StringRef Name) {
+  OS << "{\"pid\":1,\"tid\":" << TID << ",\"ph\":\"X\",\"ts\":"
+     << static_cast<uint64_t>(Start) << ",\"dur\":"
+     << static_cast<uint64_t>(Duration) << ",\"name\":";
+  writeJSONString(OS, Name);
+}
+
+void TimeTraceProfiler::write(raw_ostream &OS) {
+  // Close whatever is still open, e.g. if compilation was cut short.
+  while (!Stack.empty())
+    end();
+
+  OS << "{\"traceEvents\":[\n";
+  for (unsigned I = 0, N = Entries.size(); I != N; ++I) {
+    const TimeTraceEntry &E = Entries[I];
+    writeEvent(OS, 0, E.Start - StartTime, E.Duration, E.Name);
+    OS << ",\"args\":{\"detail\":";
+    writeJSONString(OS, E.Detail);
+    OS << "}},\n";
+  }
+
+  // Emit the totals on their own track, longest first, so that they stack
+  // up like a bar chart.
+  std::vector<TimeTraceTotal> SortedTotals;
+  for (llvm::StringMap<std::pair<unsigned, double> >::iterator
+         I = Totals.begin(), E = Totals.end(); I != E; ++I) {
+    TimeTraceTotal T;
+    T.Name = I->getKey();
+    T.Count = I->getValue().first;
+    T.Duration = I->getValue().second;
+    SortedTotals.push_back(T);
+  }
+  std::sort(SortedTotals.begin(), SortedTotals.end(), OrderTotalsByDuration());
+  for (unsigned I = 0, N = SortedTotals.size(); I != N; ++I) {
+    const TimeTraceTotal &T = SortedTotals[I];
+    writeEvent(OS, 1, 0, T.Duration, "Total " + T.Name);
+    OS << ",\"args\":{\"count\":" << T.Count << ",\"avg ms\":"
+       << static_cast<uint64_t>(T.Duration / T.Count / 1000) << "}},\n";
+  }
+
+  OS << "{\"cat\":\"\",\"pid\":1,\"tid\":0,\"ts\":0,\"ph\":\"M\","
+        "\"name\":\"process_name\",\"args\":{\"name\":\"clang\"}}\n";
+  OS << "]}\n";
+}
+
+void clang::initTimeTraceProfiler() {
+  if (!TimeTraceProfilerInstance)
+    TimeTraceProfilerInstance = new TimeTraceProfiler();
+}
+
+void clang::cleanupTimeTraceProfiler() {
+  delete TimeTraceProfilerInstance;
+  TimeTraceProfilerInstance = 0;
+}
+
+void clang::writeTimeTraceProfile(raw_ostream &OS) {
+  if (TimeTraceProfilerInstance)
+    TimeTraceProfilerInstance->write(OS);
+}
+
+void clang::timeTraceProfilerBegin(StringRef Name, StringRef Detail) {
+  if (TimeTraceProfilerInstance)
+    TimeTraceProfilerInstance->begin(Name, Detail);
+}
+
+void clang::timeTraceProfilerEnd() {
+  if (TimeTraceProfilerInstance)
+    TimeTraceProfilerInstance->end();
+}
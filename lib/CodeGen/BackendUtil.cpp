@@ -8,24 +8,33 @@
 //===----------------------------------------------------------------------===//
 
 #include "clang/CodeGen/BackendUtil.h"
+#include "ModulePartitioning.h"
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/LangOptions.h"
 #include "clang/Basic/TargetOptions.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Frontend/CodeGenOptions.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Assembly/PrintModulePass.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/CodeGen/RegAllocRegistry.h"
 #include "llvm/CodeGen/SchedulerRegistry.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/PassManager.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetLibraryInfo.h"
@@ -36,6 +45,10 @@
 #include "llvm/Transforms/Instrumentation.h"
 #include "llvm/Transforms/ObjCARC.h"
 #include "llvm/Transforms/Scalar.h"
+#include <vector>
+#if defined(LLVM_ON_UNIX)
+#include <pthread.h>
+#endif
 using namespace clang;
 using namespace llvm;
 
@@ -48,6 +61,12 @@ class EmitAssemblyHelper {
   const LangOptions &LangOpts;
   Module *TheModule;
 
+  /// Serializes the diagnostics of the helpers for the partitions of a module,
+  /// which run concurrently; null if this helper is for a whole module.
+  /// Partitions leave LLVM's process-wide options, and the time-trace
+  /// profiler, to the main thread.
+  sys::Mutex *DiagsLock;
+
   Timer CodeGenerationTime;
 
   mutable PassManager *CodeGenPasses;
@@ -98,6 +117,13 @@ private:
   /// the requested target.
   TargetMachine *CreateTargetMachine(bool MustCreateTM);
 
+  /// SetGlobalOptions - Set the backend options that LLVM only offers as
+  /// process-wide state: the ones parsed from the command line, and a few
+  /// static TargetMachine settings.
+  void SetGlobalOptions();
+
+  bool isPartition() const { return DiagsLock != 0; }
+
   /// AddEmitPasses - Add passes necessary to emit assembly or LLVM IR.
   ///
   /// \return True on success.
@@ -109,9 +135,10 @@ public:
                      const CodeGenOptions &CGOpts,
                      const clang::TargetOptions &TOpts,
                      const LangOptions &LOpts,
-                     Module *M)
+                     Module *M, sys::Mutex *DiagsLock = 0)
     : Diags(_Diags), CodeGenOpts(CGOpts), TargetOpts(TOpts), LangOpts(LOpts),
-      TheModule(M), CodeGenerationTime("Code Generation Time"),
+      TheModule(M), DiagsLock(DiagsLock),
+      CodeGenerationTime("Code Generation Time"),
       CodeGenPasses(0), PerModulePasses(0), PerFunctionPasses(0) {}
 
   ~EmitAssemblyHelper() {
@@ -120,9 +147,56 @@ public:
     delete PerFunctionPasses;
   }
 
+  /// PrepareBackend - Set LLVM's process-wide options for the backend, and
+  /// check that Action can be carried out for the target of the module,
+  /// without generating any code. This readies the helpers of the module's
+  /// partitions to run concurrently.
+  ///
+  /// \return True on success.
+  bool PrepareBackend(BackendAction Action);
+
   void EmitAssembly(BackendAction Action, raw_ostream *OS);
 };
 
+/// Holds a lock, if there is one, for the lifetime of the object.
+class OptionalLockGuard {
+  sys::Mutex *Lock;
+
+  OptionalLockGuard(const OptionalLockGuard &) LLVM_DELETED_FUNCTION;
+  void operator=(const OptionalLockGuard &) LLVM_DELETED_FUNCTION;
+
+public:
+  explicit OptionalLockGuard(sys::Mutex *Lock) : Lock(Lock) {
+    if (Lock)
+      Lock->acquire();
+  }
+  ~OptionalLockGuard() {
+    if (Lock)
+      Lock->release();
+  }
+};
+
+/// A TimeTraceScope that records nothing for a partition: the profiler keeps
+/// a single stack of events, which belongs to the main thread.
+class BackendTimeTraceScope {
+  bool Active;
+
+  BackendTimeTraceScope(const BackendTimeTraceScope &) LLVM_DELETED_FUNCTION;
+  void operator=(const BackendTimeTraceScope &) LLVM_DELETED_FUNCTION;
+
+public:
+  BackendTimeTraceScope(bool IsPartition, StringRef Name,
+                        StringRef Detail = StringRef())
+    : Active(!IsPartition && isTimeTraceProfilerEnabled()) {
+    if (Active)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+  ~BackendTimeTraceScope() {
+    if (Active)
+      timeTraceProfilerEnd();
+  }
+};
+
 // We need this wrapper to access LangOpts and CGOpts from extension functions
 // that we add to the PassManagerBuilder.
 class PassManagerBuilderWrapper : public PassManagerBuilder {
@@ -328,19 +402,15 @@ TargetMachine *EmitAssemblyHelper::CreateTargetMachine(bool MustCreateTM) {
   std::string Triple = TheModule->getTargetTriple();
   const llvm::Target *TheTarget = TargetRegistry::lookupTarget(Triple, Error);
   if (!TheTarget) {
-    if (MustCreateTM)
+    if (MustCreateTM) {
+      OptionalLockGuard Guard(DiagsLock);
       Diags.Report(diag::err_fe_unable_to_create_target) << Error;
+    }
     return 0;
   }
 
-  // FIXME: Expose these capabilities via actual APIs!!!! Aside from just
-  // being gross, this is also totally broken if we ever care about
-  // concurrency.
-
-  TargetMachine::setAsmVerbosityDefault(CodeGenOpts.AsmVerbose);
-
-  TargetMachine::setFunctionSections(CodeGenOpts.FunctionSections);
-  TargetMachine::setDataSections    (CodeGenOpts.DataSections);
+  if (!isPartition())
+    SetGlobalOptions();
 
   // FIXME: Parse this earlier.
   llvm::CodeModel::Model CM;
@@ -357,26 +427,6 @@ TargetMachine *EmitAssemblyHelper::CreateTargetMachine(bool MustCreateTM) {
     CM = llvm::CodeModel::Default;
   }
 
-  SmallVector<const char *, 16> BackendArgs;
-  BackendArgs.push_back("clang"); // Fake program name.
-  if (!CodeGenOpts.DebugPass.empty()) {
-    BackendArgs.push_back("-debug-pass");
-    BackendArgs.push_back(CodeGenOpts.DebugPass.c_str());
-  }
-  if (!CodeGenOpts.LimitFloatPrecision.empty()) {
-    BackendArgs.push_back("-limit-float-precision");
-    BackendArgs.push_back(CodeGenOpts.LimitFloatPrecision.c_str());
-  }
-  if (llvm::TimePassesIsEnabled)
-    BackendArgs.push_back("-time-passes");
-  for (unsigned i = 0, e = CodeGenOpts.BackendOptions.size(); i != e; ++i)
-    BackendArgs.push_back(CodeGenOpts.BackendOptions[i].c_str());
-  if (CodeGenOpts.NoGlobalMerge)
-    BackendArgs.push_back("-global-merge=false");
-  BackendArgs.push_back(0);
-  llvm::cl::ParseCommandLineOptions(BackendArgs.size() - 1,
-                                    BackendArgs.data());
-
   std::string FeaturesStr;
   if (TargetOpts.Features.size()) {
     SubtargetFeatures Features;
@@ -477,6 +527,37 @@ TargetMachine *EmitAssemblyHelper::CreateTargetMachine(bool MustCreateTM) {
   return TM;
 }
 
+void EmitAssemblyHelper::SetGlobalOptions() {
+  // FIXME: Expose these capabilities via actual APIs!!!! Aside from just
+  // being gross, this is also totally broken if we ever care about
+  // concurrency. Partitions rely on it being done once, before they start.
+
+  TargetMachine::setAsmVerbosityDefault(CodeGenOpts.AsmVerbose);
+
+  TargetMachine::setFunctionSections(CodeGenOpts.FunctionSections);
+  TargetMachine::setDataSections    (CodeGenOpts.DataSections);
+
+  SmallVector<const char *, 16> BackendArgs;
+  BackendArgs.push_back("clang"); // Fake program name.
+  if (!CodeGenOpts.DebugPass.empty()) {
+    BackendArgs.push_back("-debug-pass");
+    BackendArgs.push_back(CodeGenOpts.DebugPass.c_str());
+  }
+  if (!CodeGenOpts.LimitFloatPrecision.empty()) {
+    BackendArgs.push_back("-limit-float-precision");
+    BackendArgs.push_back(CodeGenOpts.LimitFloatPrecision.c_str());
+  }
+  if (llvm::TimePassesIsEnabled)
+    BackendArgs.push_back("-time-passes");
+  for (unsigned i = 0, e = CodeGenOpts.BackendOptions.size(); i != e; ++i)
+    BackendArgs.push_back(CodeGenOpts.BackendOptions[i].c_str());
+  if (CodeGenOpts.NoGlobalMerge)
+    BackendArgs.push_back("-global-merge=false");
+  BackendArgs.push_back(0);
+  llvm::cl::ParseCommandLineOptions(BackendArgs.size() - 1,
+                                    BackendArgs.data());
+}
+
 bool EmitAssemblyHelper::AddEmitPasses(BackendAction Action,
                                        formatted_raw_ostream &OS,
                                        TargetMachine *TM) {
@@ -513,6 +594,7 @@ bool EmitAssemblyHelper::AddEmitPasses(BackendAction Action,
 
   if (TM->addPassesToEmitFile(*PM, OS, CGFT,
                               /*DisableVerify=*/!CodeGenOpts.VerifyModule)) {
+    OptionalLockGuard Guard(DiagsLock);
     Diags.Report(diag::err_fe_unable_to_interface_with_target);
     return false;
   }
@@ -520,6 +602,22 @@ bool EmitAssemblyHelper::AddEmitPasses(BackendAction Action,
   return true;
 }
 
+bool EmitAssemblyHelper::PrepareBackend(BackendAction Action) {
+  TargetMachine *TM = CreateTargetMachine(/*MustCreateTM=*/true);
+  if (!TM)
+    return false;
+
+  raw_null_ostream Null;
+  formatted_raw_ostream FormattedOS(Null);
+  bool Prepared = AddEmitPasses(Action, FormattedOS, TM);
+
+  // The code generator passes refer to the target machine.
+  delete CodeGenPasses;
+  CodeGenPasses = 0;
+  delete TM;
+  return Prepared;
+}
+
 void EmitAssemblyHelper::EmitAssembly(BackendAction Action, raw_ostream *OS) {
   TimeRegion Region(llvm::TimePassesIsEnabled ? &CodeGenerationTime : 0);
   llvm::formatted_raw_ostream FormattedOS;
@@ -551,29 +649,36 @@ void EmitAssemblyHelper::EmitAssembly(BackendAction Action, raw_ostream *OS) {
   }
 
   // Before executing passes, print the final values of the LLVM options.
-  cl::PrintOptionValues();
+  if (!isPartition())
+    cl::PrintOptionValues();
 
   // Run passes. For now we do all passes at once, but eventually we
   // would like to have the option of streaming code generation.
 
   if (PerFunctionPasses) {
     PrettyStackTraceString CrashInfo("Per-function optimization");
+    BackendTimeTraceScope TimeScope(isPartition(), "PerFunctionPasses");
 
     PerFunctionPasses->doInitialization();
     for (Module::iterator I = TheModule->begin(),
            E = TheModule->end(); I != E; ++I)
-      if (!I->isDeclaration())
+      if (!I->isDeclaration()) {
+        BackendTimeTraceScope FunctionScope(isPartition(), "OptFunction",
+                                            I->getName());
         PerFunctionPasses->run(*I);
+      }
     PerFunctionPasses->doFinalization();
   }
 
   if (PerModulePasses) {
     PrettyStackTraceString CrashInfo("Per-module optimization passes");
+    BackendTimeTraceScope TimeScope(isPartition(), "PerModulePasses");
     PerModulePasses->run(*TheModule);
   }
 
   if (CodeGenPasses) {
     PrettyStackTraceString CrashInfo("Code generation");
+    BackendTimeTraceScope TimeScope(isPartition(), "CodeGenPasses");
     CodeGenPasses->run(*TheModule);
   }
 }
@@ -588,3 +693,174 @@ void clang::EmitBackendOutput(DiagnosticsEngine &Diags,
 
   AsmHelper.EmitAssembly(Action, OS);
 }
+
+namespace {
+/// The work of compiling one partition of a module.
+struct PartitionJob {
+  DiagnosticsEngine *Diags;
+  const CodeGenOptions *CGOpts;
+  const clang::TargetOptions *TOpts;
+  const LangOptions *LOpts;
+  BackendAction Action;
+  sys::Mutex *DiagsLock;
+  raw_ostream *OS;
+
+  /// The partitioning of the module, or null if the module couldn't be split.
+  const CodeGen::ModulePartitioning *Partitioning;
+  unsigned Partition;
+
+  /// The module to compile in place, for the first partition. The other
+  /// partitions read the module from Bitcode into a context of their own, or
+  /// compile an empty module if it couldn't be split.
+  Module *TheModule;
+  StringRef Bitcode;
+  StringRef ModuleIdentifier, TargetTriple, DataLayoutString;
+};
+}
+
+static void RunPartitionJob(void *Data) {
+  PartitionJob &Job = *static_cast<PartitionJob *>(Data);
+  PrettyStackTraceString CrashInfo("Module partition code generation");
+
+  // The module must go before its context.
+  OwningPtr<LLVMContext> Context;
+  OwningPtr<Module> Partition;
+  Module *M = Job.TheModule;
+  if (!M) {
+    Context.reset(new LLVMContext());
+    if (Job.Partitioning) {
+      OwningPtr<MemoryBuffer> Buffer(
+        MemoryBuffer::getMemBuffer(Job.Bitcode, Job.ModuleIdentifier,
+                                   /*RequiresNullTerminator=*/false));
+      std::string Error;
+      Partition.reset(ParseBitcodeFile(Buffer.get(), *Context, &Error));
+      if (!Partition)
+        report_fatal_error("cannot read back module partition: " + Error);
+    } else {
+      Partition.reset(new Module(Job.ModuleIdentifier, *Context));
+      Partition->setTargetTriple(Job.TargetTriple);
+      Partition->setDataLayout(Job.DataLayoutString);
+    }
+    M = Partition.get();
+  }
+
+  if (Job.Partitioning)
+    Job.Partitioning->extractPartition(*M, Job.Partition);
+
+  EmitAssemblyHelper AsmHelper(*Job.Diags, *Job.CGOpts, *Job.TOpts,
+                               *Job.LOpts, M, Job.DiagsLock);
+  AsmHelper.EmitAssembly(Job.Action, Job.OS);
+}
+
+#if defined(LLVM_ON_UNIX)
+namespace {
+struct ThreadStart {
+  void (*Fn)(void *);
+  void *Data;
+};
+}
+
+static void *RunThreadStart(void *Start) {
+  ThreadStart *TS = static_cast<ThreadStart *>(Start);
+  TS->Fn(TS->Data);
+  return 0;
+}
+#endif
+
+/// Run Fn on each element of Data, the first on the calling thread and each
+/// of the others on a new thread, and wait for all of them to finish.
+///
+/// llvm_execute_on_thread() would do, except that it waits for the thread it
+/// starts before returning, so it can only run one thing at a time. Where
+/// threads can't be started, or LLVM was built without them, everything runs
+/// on the calling thread, one after the other.
+static void RunConcurrently(void (*Fn)(void *), ArrayRef<void *> Data) {
+  unsigned NumStarted = 1;
+#if defined(LLVM_ON_UNIX)
+  std::vector<ThreadStart> Starts(Data.size());
+  std::vector<pthread_t> Threads(Data.size());
+  // LLVM only guards its shared state once it is in multithreaded mode.
+  if (llvm_is_multithreaded() || llvm_start_multithreaded()) {
+    pthread_attr_t Attr;
+    pthread_attr_init(&Attr);
+    // Ask for the same 8MB of stack as the other threads clang starts.
+    pthread_attr_setstacksize(&Attr, 8 << 20);
+    for (; NumStarted != Data.size(); ++NumStarted) {
+      Starts[NumStarted].Fn = Fn;
+      Starts[NumStarted].Data = Data[NumStarted];
+      if (pthread_create(&Threads[NumStarted], &Attr, RunThreadStart,
+                         &Starts[NumStarted]))
+        break;
+    }
+    pthread_attr_destroy(&Attr);
+  }
+#endif
+
+  Fn(Data[0]);
+  for (unsigned I = NumStarted; I < Data.size(); ++I)
+    Fn(Data[I]);
+
+#if defined(LLVM_ON_UNIX)
+  for (unsigned I = 1; I < NumStarted; ++I)
+    pthread_join(Threads[I], 0);
+#endif
+}
+
+void clang::EmitPartitionedBackendOutput(DiagnosticsEngine &Diags,
+                                         const CodeGenOptions &CGOpts,
+                                         const clang::TargetOptions &TOpts,
+                                         const LangOptions &LOpts,
+                                         Module *M, BackendAction Action,
+                                         ArrayRef<raw_ostream *> OS) {
+  assert((Action == Backend_EmitAssembly || Action == Backend_EmitObj) &&
+         "Only native code can be partitioned");
+  assert(!OS.empty() && "No output for the first partition");
+  TimeTraceScope TimeScope("CodeGenPartitions");
+
+  // Settle LLVM's process-wide options, and any error in setting up the
+  // target, here; the partitions then only read them.
+  {
+    EmitAssemblyHelper Setup(Diags, CGOpts, TOpts, LOpts, M);
+    if (!Setup.PrepareBackend(Action))
+      return;
+  }
+
+  // gcov names its data files after the module, so partitions of a module
+  // would overwrite each other's.
+  CodeGen::ModulePartitioning Partitioning;
+  bool Split = !CGOpts.EmitGcovArcs && !CGOpts.EmitGcovNotes &&
+               OS.size() > 1 && Partitioning.partition(*M, OS.size());
+
+  // Write the module out before the first partition is cut from it in place.
+  std::string Bitcode;
+  if (Split) {
+    raw_string_ostream BitcodeOS(Bitcode);
+    WriteBitcodeToFile(M, BitcodeOS);
+  }
+  std::string ModuleIdentifier = M->getModuleIdentifier();
+  std::string TargetTriple = M->getTargetTriple();
+  std::string DataLayoutString = M->getDataLayout();
+
+  sys::Mutex DiagsLock;
+  std::vector<PartitionJob> Jobs(OS.size());
+  std::vector<void *> JobData;
+  for (unsigned I = 0, E = OS.size(); I != E; ++I) {
+    PartitionJob &Job = Jobs[I];
+    Job.Diags = &Diags;
+    Job.CGOpts = &CGOpts;
+    Job.TOpts = &TOpts;
+    Job.LOpts = &LOpts;
+    Job.Action = Action;
+    Job.DiagsLock = &DiagsLock;
+    Job.OS = OS[I];
+    Job.Partitioning = Split ? &Partitioning : 0;
+    Job.Partition = I;
+    Job.TheModule = I == 0 ? M : 0;
+    Job.Bitcode = Bitcode;
+    Job.ModuleIdentifier = ModuleIdentifier;
+    Job.TargetTriple = TargetTriple;
+    Job.DataLayoutString = DataLayoutString;
+    JobData.push_back(&Job);
+  }
+  RunConcurrently(RunPartitionJob, JobData);
+}
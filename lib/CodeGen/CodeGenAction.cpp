@@ -20,6 +20,7 @@
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -27,6 +28,7 @@
 #include "llvm/Linker.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/Timer.h"
 using namespace clang;
@@ -43,6 +45,10 @@ namespace clang {
     raw_ostream *AsmOutStream;
     ASTContext *Context;
 
+    /// \brief The outputs of the module partitions after the first, with
+    /// -codegen-partitions.
+    SmallVector<raw_ostream *, 4> PartitionOutStreams;
+
     Timer LLVMIRGeneration;
 
     OwningPtr<CodeGenerator> Gen;
@@ -73,6 +79,10 @@ namespace clang {
       llvm::TimePassesIsEnabled = TimePasses;
     }
 
+    void addPartitionOutStream(raw_ostream *OS) {
+      PartitionOutStreams.push_back(OS);
+    }
+
     llvm::Module *takeModule() { return TheModule.take(); }
     llvm::Module *takeLinkModule() { return LinkModule.take(); }
 
@@ -158,8 +168,17 @@ namespace clang {
       void *OldContext = Ctx.getInlineAsmDiagnosticContext();
       Ctx.setInlineAsmDiagnosticHandler(InlineAsmDiagHandler, this);
 
-      EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
-                        TheModule.get(), Action, AsmOutStream);
+      if (PartitionOutStreams.empty()) {
+        EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
+                          TheModule.get(), Action, AsmOutStream);
+      } else {
+        SmallVector<raw_ostream *, 4> OutStreams;
+        OutStreams.push_back(AsmOutStream);
+        OutStreams.append(PartitionOutStreams.begin(),
+                          PartitionOutStreams.end());
+        EmitPartitionedBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
+                                     TheModule.get(), Action, OutStreams);
+      }
       
       Ctx.setInlineAsmDiagnosticHandler(OldHandler, OldContext);
     }
@@ -175,6 +194,10 @@ namespace clang {
       Gen->CompleteTentativeDefinition(D);
     }
 
+    virtual void PrintStats() {
+      Gen->PrintStats();
+    }
+
     virtual void HandleVTable(CXXRecordDecl *RD, bool DefinitionRequired) {
       Gen->HandleVTable(RD, DefinitionRequired);
     }
@@ -322,12 +345,56 @@ static raw_ostream *GetOutputStream(CompilerInstance &CI,
   llvm_unreachable("Invalid action!");
 }
 
+/// \brief With -codegen-partitions, create the outputs of the module
+/// partitions after the first, whose output goes to the usual file: the
+/// second partition of foo.o goes to foo.part1.o.
+///
+/// \returns false if an output file couldn't be created.
+static bool GetPartitionOutputStreams(CompilerInstance &CI, StringRef InFile,
+                                      BackendAction Action,
+                                      SmallVectorImpl<raw_ostream *> &OS) {
+  unsigned NumPartitions = CI.getCodeGenOpts().CodeGenPartitions;
+  if (NumPartitions <= 1 ||
+      (Action != Backend_EmitAssembly && Action != Backend_EmitObj))
+    return true;
+
+  const std::string &OutputFile = CI.getFrontendOpts().OutputFile;
+  if (OutputFile == "-" || (OutputFile.empty() && InFile == "-")) {
+    CI.getDiagnostics().Report(diag::warn_fe_codegen_partitions_stdout);
+    return true;
+  }
+
+  bool Binary = Action == Backend_EmitObj;
+  for (unsigned I = 1; I != NumPartitions; ++I) {
+    std::string Extension = "part" + llvm::utostr(I) + (Binary ? ".o" : ".s");
+    raw_ostream *PartitionOS;
+    if (OutputFile.empty()) {
+      PartitionOS = CI.createOutputFile("", Binary,
+                                        /*RemoveFileOnSignal=*/true, InFile,
+                                        Extension, /*UseTemporary=*/true);
+    } else {
+      SmallString<128> Path(OutputFile);
+      llvm::sys::path::replace_extension(Path, Extension);
+      PartitionOS = CI.createOutputFile(Path, Binary,
+                                        /*RemoveFileOnSignal=*/true, "", "",
+                                        /*UseTemporary=*/true);
+    }
+    if (!PartitionOS)
+      return false;
+    OS.push_back(PartitionOS);
+  }
+  return true;
+}
+
 ASTConsumer *CodeGenAction::CreateASTConsumer(CompilerInstance &CI,
                                               StringRef InFile) {
   BackendAction BA = static_cast<BackendAction>(Act);
   OwningPtr<raw_ostream> OS(GetOutputStream(CI, InFile, BA));
   if (BA != Backend_EmitNothing && !OS)
     return 0;
+  SmallVector<raw_ostream *, 4> PartitionOS;
+  if (!GetPartitionOutputStreams(CI, InFile, BA, PartitionOS))
+    return 0;
 
   llvm::Module *LinkModuleToUse = LinkModule;
 
@@ -359,6 +426,8 @@ ASTConsumer *CodeGenAction::CreateASTConsumer(CompilerInstance &CI,
                           CI.getLangOpts(),
                           CI.getFrontendOpts().ShowTimers, InFile,
                           LinkModuleToUse, OS.take(), *VMContext);
+  for (unsigned I = 0, E = PartitionOS.size(); I != E; ++I)
+    BEConsumer->addPartitionOutStream(PartitionOS[I]);
   return BEConsumer;
 }
 
@@ -370,6 +439,9 @@ void CodeGenAction::ExecuteAction() {
     raw_ostream *OS = GetOutputStream(CI, getCurrentFile(), BA);
     if (BA != Backend_EmitNothing && !OS)
       return;
+    SmallVector<raw_ostream *, 4> PartitionOS;
+    if (!GetPartitionOutputStreams(CI, getCurrentFile(), BA, PartitionOS))
+      return;
 
     bool Invalid;
     SourceManager &SM = CI.getSourceManager();
@@ -412,10 +484,18 @@ void CodeGenAction::ExecuteAction() {
       return;
     }
 
-    EmitBackendOutput(CI.getDiagnostics(), CI.getCodeGenOpts(),
-                      CI.getTargetOpts(), CI.getLangOpts(),
-                      TheModule.get(),
-                      BA, OS);
+    if (PartitionOS.empty()) {
+      EmitBackendOutput(CI.getDiagnostics(), CI.getCodeGenOpts(),
+                        CI.getTargetOpts(), CI.getLangOpts(),
+                        TheModule.get(),
+                        BA, OS);
+      return;
+    }
+
+    PartitionOS.insert(PartitionOS.begin(), OS);
+    EmitPartitionedBackendOutput(CI.getDiagnostics(), CI.getCodeGenOpts(),
+                                 CI.getTargetOpts(), CI.getLangOpts(),
+                                 TheModule.get(), BA, PartitionOS);
     return;
   }
 
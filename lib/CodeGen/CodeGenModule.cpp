@@ -35,7 +35,9 @@
 #include "clang/Basic/Module.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/TargetInfo.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Frontend/CodeGenOptions.h"
+#include "clang/Frontend/FrontendDiagnostic.h"
 #include "llvm/ADT/APSInt.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/IR/CallingConv.h"
@@ -46,7 +48,11 @@
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/ConvertUTF.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
 #include "llvm/Target/Mangler.h"
+#include <algorithm>
 
 using namespace clang;
 using namespace CodeGen;
@@ -77,7 +83,9 @@ CodeGenModule::CodeGenModule(ASTContext &C, const CodeGenOptions &CGO,
     TheTargetCodeGenInfo(0), Types(*this), VTables(*this),
     ObjCRuntime(0), OpenCLRuntime(0), CUDARuntime(0),
     DebugInfo(0), ARCData(0), NoObjCARCExceptionsMetadata(0),
-    RRData(0), CFConstantStringClassRef(0),
+    RRData(0), NumSharedLinkonceEmitted(0),
+    NumSharedLinkonceInstructions(0), NumSharedLinkonceUnavailable(0),
+    CFConstantStringClassRef(0),
     ConstantStringClassRef(0), NSConstantStringType(0),
     NSConcreteGlobalBlock(0), NSConcreteStackBlock(0),
     BlockObjectAssign(0), BlockObjectDispose(0),
@@ -131,6 +139,11 @@ CodeGenModule::CodeGenModule(ASTContext &C, const CodeGenOptions &CGO,
   if (C.getLangOpts().ObjCAutoRefCount)
     ARCData = new ARCEntrypoints();
   RRData = new RREntrypoints();
+
+  // The manifest is needed while parsing, to pick the inline methods to hand
+  // to CodeGen.
+  if (!CodeGenOpts.SharedLinkonceEmitFile.empty())
+    LoadSharedLinkonceManifest();
 }
 
 CodeGenModule::~CodeGenModule() {
@@ -173,7 +186,10 @@ void CodeGenModule::createCUDARuntime() {
 }
 
 void CodeGenModule::Release() {
+  if (!CodeGenOpts.SharedLinkonceEmitFile.empty())
+    EmitSharedLinkonceFunctions();
   EmitDeferred();
+  FinishSharedLinkonceFunctions();
   EmitCXXGlobalInitFunc();
   EmitCXXGlobalDtorFunc();
   EmitCXXThreadLocalInitFunc();
@@ -909,11 +925,259 @@ void CodeGenModule::EmitDeferred() {
     if (isa<llvm::GlobalAlias>(CGRef))
       continue;
 
+    // With -fshared-linkonce-record, leave the definition to the translation
+    // unit that emits the shared ones, and just note that it is needed.
+    if (!CodeGenOpts.SharedLinkonceRecordFile.empty() &&
+        isSharedLinkonceFunction(D)) {
+      SharedLinkonceFunctions.insert(Name);
+      continue;
+    }
+
     // Otherwise, emit the definition and move on to the next one.
     EmitGlobalDefinition(D);
   }
 }
 
+/// \brief Whether \p D is declared in the main source file, which the
+/// translation unit that emits the shared linkonce functions doesn't see.
+static bool isDeclaredInMainFile(const Decl *D, const SourceManager &SM) {
+  return SM.isFromMainFile(SM.getExpansionLoc(D->getLocation()));
+}
+
+static bool refersToMainFileDecl(const TemplateArgumentList &Args,
+                                 const SourceManager &SM);
+
+/// \brief Whether the canonical type \p T names a type declared in the main
+/// source file.
+static bool refersToMainFileDecl(QualType T, const SourceManager &SM) {
+  const Type *Ty = T.getTypePtr();
+  if (const ArrayType *AT = dyn_cast<ArrayType>(Ty))
+    return refersToMainFileDecl(AT->getElementType(), SM);
+  if (const MemberPointerType *MPT = dyn_cast<MemberPointerType>(Ty))
+    return refersToMainFileDecl(QualType(MPT->getClass(), 0), SM) ||
+           refersToMainFileDecl(MPT->getPointeeType(), SM);
+  if (!Ty->getPointeeType().isNull())
+    return refersToMainFileDecl(Ty->getPointeeType(), SM);
+
+  if (const FunctionType *FT = dyn_cast<FunctionType>(Ty)) {
+    if (refersToMainFileDecl(FT->getResultType(), SM))
+      return true;
+    if (const FunctionProtoType *FPT = dyn_cast<FunctionProtoType>(FT))
+      for (FunctionProtoType::arg_type_iterator A = FPT->arg_type_begin(),
+                                                AEnd = FPT->arg_type_end();
+           A != AEnd; ++A)
+        if (refersToMainFileDecl(*A, SM))
+          return true;
+    return false;
+  }
+
+  if (const TagType *TT = dyn_cast<TagType>(Ty)) {
+    const TagDecl *TD = TT->getDecl();
+    if (isDeclaredInMainFile(TD, SM))
+      return true;
+    if (const ClassTemplateSpecializationDecl *Spec
+          = dyn_cast<ClassTemplateSpecializationDecl>(TD))
+      return refersToMainFileDecl(Spec->getTemplateArgs(), SM);
+  }
+  return false;
+}
+
+static bool refersToMainFileDecl(const TemplateArgument &Arg,
+                                 const SourceManager &SM) {
+  switch (Arg.getKind()) {
+  case TemplateArgument::Type:
+    return refersToMainFileDecl(Arg.getAsType().getCanonicalType(), SM);
+  case TemplateArgument::Declaration:
+    return isDeclaredInMainFile(Arg.getAsDecl(), SM);
+  case TemplateArgument::Template:
+  case TemplateArgument::TemplateExpansion:
+    if (TemplateDecl *TD
+          = Arg.getAsTemplateOrTemplatePattern().getAsTemplateDecl())
+      return isDeclaredInMainFile(TD, SM);
+    return false;
+  case TemplateArgument::Pack:
+    for (TemplateArgument::pack_iterator P = Arg.pack_begin(),
+                                         PEnd = Arg.pack_end();
+         P != PEnd; ++P)
+      if (refersToMainFileDecl(*P, SM))
+        return true;
+    return false;
+  default:
+    return false;
+  }
+}
+
+/// \brief Whether any of the template arguments \p Args names a type or
+/// declaration declared in the main source file.
+static bool refersToMainFileDecl(const TemplateArgumentList &Args,
+                                 const SourceManager &SM) {
+  for (unsigned I = 0, N = Args.size(); I != N; ++I)
+    if (refersToMainFileDecl(Args[I], SM))
+      return true;
+  return false;
+}
+
+/// \brief Whether the translation unit that emits the shared linkonce
+/// functions, which only sees the headers, can define \p FD: neither its
+/// definition nor any template argument it was instantiated with may come
+/// from the main source file.
+static bool isDefinableFromHeaders(const FunctionDecl *FD,
+                                   const SourceManager &SM) {
+  const FunctionDecl *Pattern = FD->getTemplateInstantiationPattern();
+  const FunctionDecl *Definition = 0;
+  if (!(Pattern ? Pattern : FD)->hasBody(Definition) ||
+      isDeclaredInMainFile(Definition, SM))
+    return false;
+
+  if (const TemplateArgumentList *Args = FD->getTemplateSpecializationArgs())
+    if (refersToMainFileDecl(*Args, SM))
+      return false;
+  for (const DeclContext *DC = FD->getDeclContext(); !DC->isFileContext();
+       DC = DC->getParent())
+    if (const ClassTemplateSpecializationDecl *Spec
+          = dyn_cast<ClassTemplateSpecializationDecl>(DC))
+      if (refersToMainFileDecl(Spec->getTemplateArgs(), SM))
+        return false;
+  return true;
+}
+
+bool CodeGenModule::isSharedLinkonceFunction(GlobalDecl GD) {
+  const FunctionDecl *FD = dyn_cast<FunctionDecl>(GD.getDecl());
+  if (!FD || getFunctionLinkage(FD) != llvm::Function::LinkOnceODRLinkage)
+    return false;
+
+  // The inliner needs the body of an always_inline function, even at -O0.
+  if (FD->hasAttr<AlwaysInlineAttr>())
+    return false;
+
+  if (const CXXMethodDecl *MD = dyn_cast<CXXMethodDecl>(FD)) {
+    // Lambdas in some contexts are numbered per translation unit, so their
+    // mangled names can't be matched up across translation units.
+    if (MD->getParent()->isLambda())
+      return false;
+
+    // Thunks for variadic virtual methods are made by cloning the body.
+    if (MD->isVirtual() && MD->isVariadic())
+      return false;
+  }
+
+  // Inline functions of the main file, and instantiations for its types,
+  // can only be defined here.
+  return isDefinableFromHeaders(FD, Context.getSourceManager());
+}
+
+void CodeGenModule::LoadSharedLinkonceManifest() {
+  const std::string &File = CodeGenOpts.SharedLinkonceEmitFile;
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  if (llvm::error_code EC = llvm::MemoryBuffer::getFile(File, Buffer)) {
+    getDiags().Report(diag::err_fe_error_opening) << File << EC.message();
+    return;
+  }
+
+  // The manifest is the concatenation of the -fshared-linkonce-record
+  // manifests of the translation units, one mangled name per line.
+  SmallVector<StringRef, 64> Names;
+  Buffer->getBuffer().split(Names, "\n", -1, /*KeepEmpty=*/false);
+  for (unsigned I = 0, N = Names.size(); I != N; ++I) {
+    StringRef Name = Names[I].trim();
+    if (!Name.empty() && SharedLinkonceFunctions.insert(Name))
+      SharedLinkonceManifest.push_back(
+                                SharedLinkonceFunctions.find(Name)->getKey());
+  }
+}
+
+bool CodeGenModule::isSharedLinkonceRequested(const CXXMethodDecl *MD) {
+  if (SharedLinkonceFunctions.empty())
+    return false;
+
+  if (const CXXConstructorDecl *CD = dyn_cast<CXXConstructorDecl>(MD))
+    return SharedLinkonceFunctions.count(
+               getMangledName(GlobalDecl(CD, Ctor_Complete))) ||
+           SharedLinkonceFunctions.count(
+               getMangledName(GlobalDecl(CD, Ctor_Base)));
+  if (const CXXDestructorDecl *DD = dyn_cast<CXXDestructorDecl>(MD))
+    return SharedLinkonceFunctions.count(
+               getMangledName(GlobalDecl(DD, Dtor_Complete))) ||
+           SharedLinkonceFunctions.count(
+               getMangledName(GlobalDecl(DD, Dtor_Base)));
+  return SharedLinkonceFunctions.count(getMangledName(MD));
+}
+
+void CodeGenModule::EmitSharedLinkonceFunctions() {
+  for (unsigned I = 0, N = SharedLinkonceManifest.size(); I != N; ++I) {
+    // Referencing a deferred decl queues it for emission. Anything else is
+    // either defined already or not defined in this translation unit.
+    llvm::StringMap<GlobalDecl>::iterator DDI
+      = DeferredDecls.find(SharedLinkonceManifest[I]);
+    if (DDI != DeferredDecls.end() && isa<FunctionDecl>(DDI->second.getDecl()))
+      GetAddrOfGlobal(DDI->second);
+  }
+}
+
+void CodeGenModule::FinishSharedLinkonceFunctions() {
+  if (!CodeGenOpts.SharedLinkonceEmitFile.empty()) {
+    for (unsigned I = 0, N = SharedLinkonceManifest.size(); I != N; ++I) {
+      llvm::GlobalValue *GV = GetGlobalValue(SharedLinkonceManifest[I]);
+      if (!GV || GV->isDeclaration()) {
+        // Unless another translation unit provides it, the build won't link.
+        getDiags().Report(diag::warn_fe_shared_linkonce_unavailable)
+          << SharedLinkonceManifest[I]
+          << CodeGenOpts.SharedLinkonceEmitFile;
+        ++NumSharedLinkonceUnavailable;
+        continue;
+      }
+
+      // The other translation units rely on this definition, so it must not
+      // be dropped even if nothing here uses it.
+      if (GV->getLinkage() == llvm::GlobalValue::LinkOnceODRLinkage)
+        GV->setLinkage(llvm::GlobalValue::WeakODRLinkage);
+
+      ++NumSharedLinkonceEmitted;
+      if (llvm::Function *F = dyn_cast<llvm::Function>(GV))
+        for (llvm::Function::iterator BB = F->begin(), BE = F->end();
+             BB != BE; ++BB)
+          NumSharedLinkonceInstructions += BB->size();
+    }
+    return;
+  }
+
+  const std::string &File = CodeGenOpts.SharedLinkonceRecordFile;
+  if (File.empty())
+    return;
+
+  std::string ErrorInfo;
+  llvm::raw_fd_ostream OS(File.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    getDiags().Report(diag::err_fe_unable_to_open_output) << File << ErrorInfo;
+    return;
+  }
+
+  // Sort the names so that the manifest doesn't depend on hash order.
+  std::vector<StringRef> Names;
+  for (llvm::StringSet<>::iterator I = SharedLinkonceFunctions.begin(),
+                                   E = SharedLinkonceFunctions.end();
+       I != E; ++I)
+    Names.push_back(I->getKey());
+  std::sort(Names.begin(), Names.end());
+  for (unsigned I = 0, N = Names.size(); I != N; ++I)
+    OS << Names[I] << '\n';
+}
+
+void CodeGenModule::PrintStats() {
+  if (!CodeGenOpts.SharedLinkonceRecordFile.empty()) {
+    llvm::errs() << "\n*** CodeGen Stats:\n";
+    llvm::errs() << "  " << SharedLinkonceFunctions.size()
+                 << " linkonce functions left to the shared definitions\n";
+  } else if (!CodeGenOpts.SharedLinkonceEmitFile.empty()) {
+    llvm::errs() << "\n*** CodeGen Stats:\n";
+    llvm::errs() << "  " << NumSharedLinkonceEmitted
+                 << " shared linkonce functions defined ("
+                 << NumSharedLinkonceInstructions << " instructions)\n";
+    llvm::errs() << "  " << NumSharedLinkonceUnavailable
+                 << " shared linkonce functions not available\n";
+  }
+}
+
 void CodeGenModule::EmitGlobalAnnotations() {
   if (Annotations.empty())
     return;
@@ -1223,6 +1487,13 @@ void CodeGenModule::EmitGlobalDefinition(GlobalDecl GD) {
   PrettyStackTraceDecl CrashInfo(const_cast<ValueDecl *>(D), D->getLocation(), 
                                  Context.getSourceManager(),
                                  "Generating code for declaration");
+
+  // Time the emission here rather than in EmitGlobal(), which defers most
+  // definitions.
+  std::string TraceDetail;
+  if (isTimeTraceProfilerEnabled())
+    TraceDetail = D->getQualifiedNameAsString();
+  TimeTraceScope TimeScope("EmitGlobal", TraceDetail);
   
   if (const FunctionDecl *Function = dyn_cast<FunctionDecl>(D)) {
     // At -O0, don't generate IR for functions with available_externally 
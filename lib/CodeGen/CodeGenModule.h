@@ -28,6 +28,7 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/IR/CallingConv.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/ValueHandle.h"
@@ -276,6 +277,22 @@ class CodeGenModule : public CodeGenTypeCache {
   /// is done.
   std::vector<GlobalDecl> DeferredDeclsToEmit;
 
+  /// SharedLinkonceFunctions - With -fshared-linkonce-record, the mangled
+  /// names of the linkonce_odr functions this translation unit needs but left
+  /// undefined; with -fshared-linkonce-emit, the ones it was asked to define.
+  llvm::StringSet<> SharedLinkonceFunctions;
+
+  /// SharedLinkonceManifest - With -fshared-linkonce-emit, the names in
+  /// SharedLinkonceFunctions in the order the manifest lists them.
+  std::vector<StringRef> SharedLinkonceManifest;
+
+  /// Statistics for -fshared-linkonce-emit: the number of functions defined
+  /// for the other translation units, the number of instructions in them, and
+  /// the number of functions that weren't available in this one.
+  unsigned NumSharedLinkonceEmitted;
+  unsigned NumSharedLinkonceInstructions;
+  unsigned NumSharedLinkonceUnavailable;
+
   /// DeferredVTables - A queue of (optional) vtables to consider emitting.
   std::vector<const CXXRecordDecl*> DeferredVTables;
 
@@ -423,6 +440,9 @@ public:
   /// Release - Finalize LLVM code generation.
   void Release();
 
+  /// PrintStats - Print statistics about code generation to llvm::errs().
+  void PrintStats();
+
   /// getObjCRuntime() - Return a reference to the configured
   /// Objective-C runtime.
   CGObjCRuntime &getObjCRuntime() {
@@ -756,6 +776,10 @@ public:
   /// EmitTopLevelDecl - Emit code for a single top level declaration.
   void EmitTopLevelDecl(Decl *D);
 
+  /// isSharedLinkonceRequested - Whether the -fshared-linkonce-emit manifest
+  /// asks for a definition of MD, in any of its variants.
+  bool isSharedLinkonceRequested(const CXXMethodDecl *MD);
+
   /// HandleCXXStaticMemberVarInstantiation - Tell the consumer that this
   // variable has been instantiated.
   void HandleCXXStaticMemberVarInstantiation(VarDecl *VD);
@@ -1070,6 +1094,23 @@ private:
   /// was deferred.
   void EmitDeferred();
 
+  /// isSharedLinkonceFunction - Whether -fshared-linkonce-record leaves the
+  /// definition of GD to the translation unit built with
+  /// -fshared-linkonce-emit.
+  bool isSharedLinkonceFunction(GlobalDecl GD);
+
+  /// LoadSharedLinkonceManifest - Read the -fshared-linkonce-emit manifest.
+  void LoadSharedLinkonceManifest();
+
+  /// EmitSharedLinkonceFunctions - Queue the functions listed in the
+  /// -fshared-linkonce-emit manifest for emission.
+  void EmitSharedLinkonceFunctions();
+
+  /// FinishSharedLinkonceFunctions - Give the functions defined for
+  /// -fshared-linkonce-emit weak_odr linkage, or write the manifest for
+  /// -fshared-linkonce-record.
+  void FinishSharedLinkonceFunctions();
+
   /// EmitDeferredVTables - Emit any vtables which we deferred and
   /// still have a use for.
   void EmitDeferredVTables();
@@ -79,15 +79,19 @@ namespace {
       Builder->UpdateCompletedType(D);
       
       // In C++, we may have member functions that need to be emitted at this 
-      // point.
+      // point. With -fshared-linkonce-emit, so are the inline ones the
+      // manifest lists, so that CodeGen can find them by their mangled name.
       if (Ctx->getLangOpts().CPlusPlus && !D->isDependentContext()) {
+        bool EmitInlineMethods = !CodeGenOpts.SharedLinkonceEmitFile.empty();
         for (DeclContext::decl_iterator M = D->decls_begin(), 
                                      MEnd = D->decls_end();
              M != MEnd; ++M)
           if (CXXMethodDecl *Method = dyn_cast<CXXMethodDecl>(*M))
             if (Method->doesThisDeclarationHaveABody() &&
                 (Method->hasAttr<UsedAttr>() || 
-                 Method->hasAttr<ConstructorAttr>()))
+                 Method->hasAttr<ConstructorAttr>() ||
+                 (EmitInlineMethods &&
+                  Builder->isSharedLinkonceRequested(Method))))
               Builder->EmitTopLevelDecl(Method);
       }
     }
@@ -102,6 +106,11 @@ namespace {
         Builder->Release();
     }
 
+    virtual void PrintStats() {
+      if (Builder)
+        Builder->PrintStats();
+    }
+
     virtual void CompleteTentativeDefinition(VarDecl *D) {
       if (Diags.hasErrorOccurred())
         return;
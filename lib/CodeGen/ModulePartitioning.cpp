@@ -0,0 +1,422 @@
+//===--- ModulePartitioning.cpp - Split a module for parallel codegen -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This splits an LLVM module into partitions that are optimized and compiled
+// independently, on separate threads, into object files that link together.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ModulePartitioning.h"
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include <algorithm>
+#include <utility>
+
+using namespace clang;
+using namespace CodeGen;
+
+/// \brief The partition of a definition that hasn't been placed yet.
+static const unsigned NoPartition = ~0U;
+
+namespace {
+
+/// \brief How a global value is spread over the partitions.
+enum DefinitionKind {
+  DK_Declaration, ///< Defined in another module.
+  DK_Owned,       ///< Defined in exactly one partition.
+  DK_Copied,      ///< Defined in every partition that refers to it.
+  DK_Local,       ///< Defined in the first partition that refers to it.
+  DK_Appending    ///< An appending array, defined in the first partition.
+};
+
+/// \brief Numbers the global values of a module: the functions, then the
+/// global variables, then the aliases, each in module order. Writing the
+/// module to bitcode and reading it back keeps the numbering.
+class GlobalNumbering {
+  llvm::DenseMap<const llvm::GlobalValue *, unsigned> Numbers;
+  std::vector<llvm::GlobalValue *> Values;
+
+  void add(llvm::GlobalValue *GV) {
+    Numbers[GV] = Values.size();
+    Values.push_back(GV);
+  }
+
+public:
+  explicit GlobalNumbering(llvm::Module &M) {
+    for (llvm::Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+      add(&*I);
+    for (llvm::Module::global_iterator I = M.global_begin(),
+           E = M.global_end(); I != E; ++I)
+      add(&*I);
+    for (llvm::Module::alias_iterator I = M.alias_begin(),
+           E = M.alias_end(); I != E; ++I)
+      add(&*I);
+  }
+
+  unsigned size() const { return Values.size(); }
+  llvm::GlobalValue *operator[](unsigned N) const { return Values[N]; }
+
+  unsigned getNumber(const llvm::GlobalValue *GV) const {
+    llvm::DenseMap<const llvm::GlobalValue *, unsigned>::const_iterator I
+      = Numbers.find(GV);
+    assert(I != Numbers.end() && "Global value of another module");
+    return I->second;
+  }
+};
+
+/// \brief Orders functions, given as (instruction count, number) pairs, from
+/// the largest to the smallest.
+struct LargerFunction {
+  bool operator()(const std::pair<unsigned, unsigned> &LHS,
+                  const std::pair<unsigned, unsigned> &RHS) const {
+    return LHS.first > RHS.first;
+  }
+};
+
+/// \brief Follows the references from the definitions of each partition to
+/// find the copied and local definitions the partition needs.
+class ReferenceWalker {
+  const GlobalNumbering &Globals;
+  const std::vector<DefinitionKind> &Kinds;
+  std::vector<llvm::BitVector> &Defines;
+
+  /// \brief The partition of each local definition, or NoPartition.
+  std::vector<unsigned> LocalOwners;
+
+  /// \brief The global values referenced from the current partition, waiting
+  /// to be visited.
+  llvm::SmallVector<llvm::GlobalValue *, 32> Worklist;
+
+  /// \brief The constants already searched for references from the current
+  /// partition.
+  llvm::SmallPtrSet<const llvm::Constant *, 32> VisitedConstants;
+
+  void addReferences(llvm::Constant *C);
+  void addReferences(llvm::GlobalValue *GV);
+  void visit(llvm::GlobalValue *GV, unsigned Partition);
+
+public:
+  /// \brief The local definitions that a partition other than their own
+  /// refers to.
+  llvm::BitVector NeedExternalizing;
+
+  ReferenceWalker(const GlobalNumbering &Globals,
+                  const std::vector<DefinitionKind> &Kinds,
+                  std::vector<llvm::BitVector> &Defines)
+    : Globals(Globals), Kinds(Kinds), Defines(Defines),
+      LocalOwners(Globals.size(), NoPartition),
+      NeedExternalizing(Globals.size()) {}
+
+  /// \brief Find what \p Partition needs in order to hold the definitions
+  /// already marked in Defines[Partition].
+  void walkPartition(unsigned Partition);
+
+  /// \brief Put the local definitions that no partition refers to into
+  /// \p Partition, along with what they need.
+  void placeUnreferencedLocals(unsigned Partition);
+};
+
+} // end anonymous namespace
+
+static DefinitionKind classify(const llvm::GlobalValue *GV) {
+  // An alias is a definition even if the value it aliases isn't.
+  if (!isa<llvm::GlobalAlias>(GV) && GV->isDeclaration())
+    return DK_Declaration;
+  if (GV->hasAppendingLinkage())
+    return DK_Appending;
+  if (GV->hasLocalLinkage())
+    return DK_Local;
+  if (GV->hasLinkOnceLinkage() || GV->hasAvailableExternallyLinkage())
+    return DK_Copied;
+  return DK_Owned;
+}
+
+void ReferenceWalker::addReferences(llvm::Constant *C) {
+  if (llvm::GlobalValue *GV = dyn_cast<llvm::GlobalValue>(C)) {
+    Worklist.push_back(GV);
+    return;
+  }
+  if (!VisitedConstants.insert(C))
+    return;
+  for (llvm::User::op_iterator I = C->op_begin(), E = C->op_end(); I != E;
+       ++I)
+    if (llvm::Constant *Op = dyn_cast<llvm::Constant>(*I))
+      addReferences(Op);
+}
+
+void ReferenceWalker::addReferences(llvm::GlobalValue *GV) {
+  if (llvm::GlobalAlias *GA = dyn_cast<llvm::GlobalAlias>(GV)) {
+    if (llvm::Constant *Aliasee = GA->getAliasee())
+      addReferences(Aliasee);
+    return;
+  }
+
+  if (llvm::GlobalVariable *Var = dyn_cast<llvm::GlobalVariable>(GV)) {
+    if (Var->hasInitializer())
+      addReferences(Var->getInitializer());
+    return;
+  }
+
+  llvm::Function *F = cast<llvm::Function>(GV);
+  for (llvm::Function::iterator BB = F->begin(), BE = F->end(); BB != BE;
+       ++BB)
+    for (llvm::BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E;
+         ++I)
+      for (llvm::User::op_iterator Op = I->op_begin(), OE = I->op_end();
+           Op != OE; ++Op)
+        if (llvm::Constant *C = dyn_cast<llvm::Constant>(*Op))
+          addReferences(C);
+}
+
+void ReferenceWalker::visit(llvm::GlobalValue *GV, unsigned Partition) {
+  unsigned N = Globals.getNumber(GV);
+  switch (Kinds[N]) {
+  case DK_Declaration:
+  case DK_Owned:
+  case DK_Appending:
+    // Partitions that don't define these refer to a declaration.
+    return;
+
+  case DK_Copied:
+    if (Defines[Partition].test(N))
+      return;
+    Defines[Partition].set(N);
+    addReferences(GV);
+    return;
+
+  case DK_Local:
+    if (LocalOwners[N] == NoPartition) {
+      LocalOwners[N] = Partition;
+      Defines[Partition].set(N);
+      addReferences(GV);
+    } else if (LocalOwners[N] != Partition) {
+      NeedExternalizing.set(N);
+    }
+    return;
+  }
+}
+
+void ReferenceWalker::walkPartition(unsigned Partition) {
+  VisitedConstants.clear();
+  for (int N = Defines[Partition].find_first(); N != -1;
+       N = Defines[Partition].find_next(N))
+    addReferences(Globals[N]);
+
+  while (!Worklist.empty())
+    visit(Worklist.pop_back_val(), Partition);
+}
+
+void ReferenceWalker::placeUnreferencedLocals(unsigned Partition) {
+  VisitedConstants.clear();
+  for (unsigned N = 0, E = Globals.size(); N != E; ++N) {
+    if (Kinds[N] != DK_Local || LocalOwners[N] != NoPartition)
+      continue;
+    LocalOwners[N] = Partition;
+    Defines[Partition].set(N);
+    addReferences(Globals[N]);
+  }
+
+  while (!Worklist.empty())
+    visit(Worklist.pop_back_val(), Partition);
+}
+
+bool ModulePartitioning::partition(llvm::Module &M, unsigned NumPartitions) {
+  assert(NumPartitions > 1 && "Nothing to split");
+  Defines.clear();
+
+  if (!M.getModuleInlineAsm().empty())
+    return false;
+
+  GlobalNumbering Globals(M);
+  unsigned NumGlobals = Globals.size();
+  std::vector<DefinitionKind> Kinds(NumGlobals);
+  std::vector<std::pair<unsigned, unsigned> > OwnedFunctions;
+  for (unsigned N = 0; N != NumGlobals; ++N) {
+    Kinds[N] = classify(Globals[N]);
+    llvm::Function *F = dyn_cast<llvm::Function>(Globals[N]);
+    if (!F || Kinds[N] == DK_Declaration)
+      continue;
+
+    unsigned Size = 0;
+    for (llvm::Function::iterator BB = F->begin(), BE = F->end(); BB != BE;
+         ++BB) {
+      if (BB->hasAddressTaken())
+        return false;
+      for (llvm::BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E;
+           ++I) {
+        ++Size;
+        if (llvm::CallInst *Call = dyn_cast<llvm::CallInst>(I))
+          if (Call->isInlineAsm())
+            return false;
+      }
+    }
+    if (Kinds[N] == DK_Owned)
+      OwnedFunctions.push_back(std::make_pair(Size, N));
+  }
+
+  std::vector<llvm::BitVector> NewDefines(NumPartitions,
+                                          llvm::BitVector(NumGlobals));
+
+  // Hand out the owned functions from the largest down, each to the partition
+  // with the fewest instructions so far.
+  std::stable_sort(OwnedFunctions.begin(), OwnedFunctions.end(),
+                   LargerFunction());
+  std::vector<unsigned> Sizes(NumPartitions);
+  std::vector<unsigned> Owners(NumGlobals, NoPartition);
+  for (unsigned I = 0, E = OwnedFunctions.size(); I != E; ++I) {
+    unsigned Smallest = std::min_element(Sizes.begin(), Sizes.end())
+                          - Sizes.begin();
+    Owners[OwnedFunctions[I].second] = Smallest;
+    Sizes[Smallest] += OwnedFunctions[I].first;
+    NewDefines[Smallest].set(OwnedFunctions[I].second);
+  }
+
+  // The other owned definitions go to the first partition, except that an
+  // alias has to be in the same partition as the definition it aliases.
+  for (unsigned N = 0; N != NumGlobals; ++N) {
+    if ((Kinds[N] != DK_Owned && Kinds[N] != DK_Appending) ||
+        Owners[N] != NoPartition)
+      continue;
+    unsigned Partition = 0;
+    if (llvm::GlobalAlias *GA = dyn_cast<llvm::GlobalAlias>(Globals[N]))
+      if (const llvm::GlobalValue *Aliased = GA->resolveAliasedGlobal(false)) {
+        unsigned AliasedN = Globals.getNumber(Aliased);
+        if (Owners[AliasedN] != NoPartition)
+          Partition = Owners[AliasedN];
+      }
+    NewDefines[Partition].set(N);
+  }
+
+  ReferenceWalker Walker(Globals, Kinds, NewDefines);
+  for (unsigned Partition = 0; Partition != NumPartitions; ++Partition)
+    Walker.walkPartition(Partition);
+  Walker.placeUnreferencedLocals(0);
+
+  // An alias can only alias a definition.
+  for (unsigned N = 0; N != NumGlobals; ++N) {
+    llvm::GlobalAlias *GA = dyn_cast<llvm::GlobalAlias>(Globals[N]);
+    if (!GA)
+      continue;
+    const llvm::GlobalValue *Aliased = GA->getAliasedGlobal();
+    if (!Aliased)
+      return false;
+    unsigned AliasedN = Globals.getNumber(Aliased);
+    for (unsigned Partition = 0; Partition != NumPartitions; ++Partition)
+      if (NewDefines[Partition].test(N) &&
+          !NewDefines[Partition].test(AliasedN))
+        return false;
+  }
+
+  // Local symbols that other partitions refer to become external, under a
+  // name that depends on the module's own external symbols so that two
+  // modules linked together don't export the same one.
+  if (Walker.NeedExternalizing.any()) {
+    llvm::hash_code Hash = llvm::hash_value(M.getModuleIdentifier());
+    for (unsigned N = 0; N != NumGlobals; ++N)
+      if (Kinds[N] == DK_Owned)
+        Hash = llvm::hash_combine(Hash, Globals[N]->getName());
+    std::string Suffix = ".partition." + llvm::utohexstr(size_t(Hash));
+
+    for (int N = Walker.NeedExternalizing.find_first(); N != -1;
+         N = Walker.NeedExternalizing.find_next(N)) {
+      llvm::GlobalValue *GV = Globals[N];
+      GV->setName(llvm::Twine(GV->getName()) + Suffix);
+      GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      GV->setVisibility(llvm::GlobalValue::HiddenVisibility);
+    }
+  }
+
+  Defines.swap(NewDefines);
+  return true;
+}
+
+/// \brief Replace \p GA, an alias defined in another partition, with a
+/// declaration of the value it aliases.
+static void replaceWithDeclaration(llvm::Module &M, llvm::GlobalAlias *GA) {
+  llvm::Type *Ty = GA->getType()->getElementType();
+  llvm::GlobalValue *Decl;
+  if (llvm::FunctionType *FTy = dyn_cast<llvm::FunctionType>(Ty)) {
+    Decl = llvm::Function::Create(FTy, llvm::GlobalValue::ExternalLinkage, "",
+                                  &M);
+  } else {
+    llvm::GlobalVariable::ThreadLocalMode TLM
+      = llvm::GlobalVariable::NotThreadLocal;
+    if (const llvm::GlobalVariable *Aliased
+          = dyn_cast_or_null<llvm::GlobalVariable>(
+              GA->resolveAliasedGlobal(false)))
+      TLM = Aliased->getThreadLocalMode();
+    Decl = new llvm::GlobalVariable(M, Ty, /*isConstant=*/false,
+                                    llvm::GlobalValue::ExternalLinkage,
+                                    /*Initializer=*/0, "",
+                                    /*InsertBefore=*/0, TLM,
+                                    GA->getType()->getAddressSpace());
+  }
+  Decl->takeName(GA);
+  Decl->setVisibility(GA->getVisibility());
+  GA->replaceAllUsesWith(Decl);
+  GA->eraseFromParent();
+}
+
+void ModulePartitioning::extractPartition(llvm::Module &M,
+                                          unsigned Partition) const {
+  GlobalNumbering Globals(M);
+  const llvm::BitVector &Defined = Defines[Partition];
+  assert(Globals.size() == Defined.size() && "Not the partitioned module");
+
+  // Drop the definitions held elsewhere first, so that the local symbols only
+  // they referred to are left unused. Aliases come last in the numbering,
+  // after everything that might refer to them.
+  std::vector<llvm::GlobalValue *> Unused;
+  for (unsigned N = 0, E = Globals.size(); N != E; ++N) {
+    llvm::GlobalValue *GV = Globals[N];
+    if (Defined.test(N) || classify(GV) == DK_Declaration)
+      continue;
+
+    if (GV->hasLocalLinkage() || GV->hasAppendingLinkage()) {
+      GV->dropAllReferences();
+      Unused.push_back(GV);
+      continue;
+    }
+
+    GV->setUnnamedAddr(false);
+    if (llvm::Function *F = dyn_cast<llvm::Function>(GV)) {
+      F->deleteBody();
+    } else if (llvm::GlobalVariable *Var = dyn_cast<llvm::GlobalVariable>(GV)) {
+      Var->setInitializer(0);
+      Var->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    } else {
+      llvm::GlobalAlias *GA = cast<llvm::GlobalAlias>(GV);
+      GA->removeDeadConstantUsers();
+      if (GA->use_empty())
+        GA->eraseFromParent();
+      else
+        replaceWithDeclaration(M, GA);
+    }
+  }
+
+  // Nothing this partition defines refers to the local symbols it doesn't;
+  // those are externalized. Debug info may still name them, and loses track
+  // of them as they go.
+  for (unsigned I = 0, E = Unused.size(); I != E; ++I) {
+    Unused[I]->removeDeadConstantUsers();
+    assert(Unused[I]->use_empty() &&
+           "Local symbol used by another partition was not externalized");
+    Unused[I]->eraseFromParent();
+  }
+}
@@ -0,0 +1,72 @@
+//===--- ModulePartitioning.h - Split a module for codegen ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This splits an LLVM module into partitions that are optimized and compiled
+// independently, on separate threads, into object files that link together.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_CODEGEN_MODULEPARTITIONING_H
+#define CLANG_CODEGEN_MODULEPARTITIONING_H
+
+#include "llvm/ADT/BitVector.h"
+#include <vector>
+
+namespace llvm {
+  class Module;
+}
+
+namespace clang {
+namespace CodeGen {
+
+/// \brief Decides which partition of a module defines each of its global
+/// values.
+///
+/// Each external definition goes to exactly one partition. Functions are
+/// spread so that the partitions get about as many instructions each; global
+/// variables go to the first partition, along with llvm.global_ctors and the
+/// other appending arrays. Linkonce and available_externally definitions are
+/// copied into every partition that refers to them. A local symbol goes to
+/// the first partition that refers to it; if another partition refers to it
+/// too, it becomes a hidden external symbol, renamed so that it can't clash
+/// with a symbol of another module.
+///
+/// Partitions are described by the position of each global value in the
+/// module's lists, so they still apply to a copy of the module read back from
+/// bitcode into another LLVMContext.
+class ModulePartitioning {
+  /// \brief For each partition, the global values it defines: the functions,
+  /// then the global variables, then the aliases, each in module order.
+  std::vector<llvm::BitVector> Defines;
+
+public:
+  /// \brief The number of partitions, or zero before partition() succeeds.
+  unsigned getNumPartitions() const { return Defines.size(); }
+
+  /// \brief Split \p M into \p NumPartitions partitions, and externalize the
+  /// local symbols of \p M that more than one partition refers to.
+  ///
+  /// \returns false, leaving \p M untouched, if \p M can't be split: its
+  /// inline assembly may refer to local symbols by name, and the address of a
+  /// basic block can't be taken from another partition.
+  bool partition(llvm::Module &M, unsigned NumPartitions);
+
+  /// \brief Turn \p M, the module given to partition() or a copy of it, into
+  /// partition \p Partition, by deleting the definitions the partition doesn't
+  /// hold. Global values other partitions define become declarations.
+  ///
+  /// Partitions may be extracted concurrently, from copies of the module in
+  /// different LLVMContexts.
+  void extractPartition(llvm::Module &M, unsigned Partition) const;
+};
+
+}  // end namespace CodeGen
+}  // end namespace clang
+
+#endif
@@ -18,6 +18,7 @@
 #include "clang/AST/StmtVisitor.h"
 #include "clang/AST/TypeOrdering.h"
 #include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
 #include "clang/Basic/TargetInfo.h"
 #include "clang/Basic/TargetOptions.h"
 #include "clang/Frontend/CompilerInstance.h"
@@ -32,6 +33,7 @@
 #include "clang/Serialization/ASTReader.h"
 #include "clang/Serialization/ASTWriter.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/Atomic.h"
@@ -42,11 +44,15 @@
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/MutexGuard.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cstdio>
 #include <cstdlib>
 #include <sys/stat.h>
+#if defined(LLVM_ON_UNIX)
+#include <pthread.h>
+#endif
 using namespace clang;
 
 using llvm::TimeRecord;
@@ -79,10 +85,20 @@ namespace {
     }
   };
   
+  struct SharedPreamble;
+
   struct OnDiskData {
     /// \brief The file in which the precompiled preamble is stored.
     std::string PreambleFile;
 
+    /// \brief The shared preamble that \c PreambleFile belongs to, if any.
+    ///
+    /// Shared preambles are reference-counted; the file is only erased once
+    /// the last ASTUnit using it lets go.
+    SharedPreamble *SharedPCH;
+
+    OnDiskData() : SharedPCH(0) { }
+
     /// \brief Temporary files that should be removed when the ASTUnit is 
     /// destroyed.
     SmallVector<llvm::sys::Path, 4> TemporaryFiles;
@@ -163,6 +179,129 @@ static const std::string &getPreambleFile(const ASTUnit *AU) {
   return getOnDiskData(AU).PreambleFile;  
 }
 
+namespace {
+  /// \brief What precompiling a preamble produces besides the PCH file.
+  struct PrecompiledPreambleInfo {
+    /// \brief The hash of the top-level declarations and macros.
+    unsigned TopLevelHashValue;
+
+    /// \brief The IDs of the top-level declarations in the PCH file.
+    std::vector<serialization::DeclID> TopLevelDecls;
+
+    /// \brief The files the preamble depends on, with their size and
+    /// modification time.
+    llvm::StringMap<std::pair<off_t, time_t> > Files;
+
+    PrecompiledPreambleInfo() : TopLevelHashValue(0) { }
+  };
+
+  /// \brief A precompiled preamble that can be used by every ASTUnit in the
+  /// process whose main file starts with the same preamble text and is parsed
+  /// with an equivalent compiler invocation.
+  struct SharedPreamble {
+    /// \brief The key under which the preamble is registered.
+    std::string Key;
+
+    /// \brief The precompiled preamble file.
+    std::string PCHFile;
+
+    /// \brief The number of ASTUnits using this preamble. Guarded by the
+    /// on-disk mutex.
+    unsigned RefCount;
+
+    /// \brief The size reserved for the main file within the preamble.
+    unsigned ReservedSize;
+
+    /// \brief The number of warnings produced while parsing the preamble.
+    unsigned NumWarnings;
+
+    /// \brief The hash of the top-level declarations and macros of the
+    /// preamble.
+    unsigned TopLevelHashValue;
+
+    /// \brief The files the preamble depends on, with their size and
+    /// modification time.
+    llvm::StringMap<std::pair<off_t, time_t> > Files;
+
+    /// \brief The diagnostics produced while parsing the preamble.
+    SmallVector<StoredDiagnostic, 4> Diagnostics;
+
+    /// \brief The top-level declarations of the preamble.
+    std::vector<serialization::DeclID> TopLevelDecls;
+
+    SharedPreamble() : RefCount(0), ReservedSize(0), NumWarnings(0),
+                       TopLevelHashValue(0) { }
+  };
+}
+
+typedef llvm::StringMap<SharedPreamble *> SharedPreambleMap;
+
+/// \brief Replace the contents of \p To with those of \p From.
+///
+/// StringMap can only be assigned from an empty map.
+static void copyPreambleFiles(
+                    const llvm::StringMap<std::pair<off_t, time_t> > &From,
+                    llvm::StringMap<std::pair<off_t, time_t> > &To) {
+  To.clear();
+  for (llvm::StringMap<std::pair<off_t, time_t> >::const_iterator
+         F = From.begin(), FEnd = From.end();
+       F != FEnd; ++F)
+    To[F->first()] = F->second;
+}
+
+/// \brief The process-wide table of shared preambles, keyed by
+/// \c getSharedPreambleKey().
+///
+/// Entries are not owned by the table; they unregister themselves when their
+/// last user releases them. Guarded by the on-disk mutex.
+static SharedPreambleMap &getSharedPreambleMap() {
+  // Never destroyed, since ASTUnits can be cleaned up at exit.
+  static SharedPreambleMap *M = new SharedPreambleMap();
+  return *M;
+}
+
+/// \brief Find a shared preamble and retain it.
+static SharedPreamble *retainSharedPreamble(StringRef Key) {
+  llvm::MutexGuard Guard(getOnDiskMutex());
+  SharedPreambleMap &M = getSharedPreambleMap();
+  SharedPreambleMap::iterator I = M.find(Key);
+  if (I == M.end())
+    return 0;
+  ++I->second->RefCount;
+  return I->second;
+}
+
+/// \brief Register a freshly-built preamble so that other ASTUnits can use it.
+///
+/// \returns false if an equivalent preamble is already registered, in which
+/// case the caller keeps sole ownership of \p P.
+static bool registerSharedPreamble(SharedPreamble *P) {
+  llvm::MutexGuard Guard(getOnDiskMutex());
+  llvm::StringMapEntry<SharedPreamble *> &Entry
+    = getSharedPreambleMap().GetOrCreateValue(P->Key, 0);
+  if (Entry.getValue())
+    return false;
+  Entry.setValue(P);
+  P->RefCount = 1;
+  return true;
+}
+
+/// \brief Release a shared preamble, erasing it when it is no longer used.
+static void releaseSharedPreamble(SharedPreamble *P) {
+  llvm::MutexGuard Guard(getOnDiskMutex());
+  if (--P->RefCount)
+    return;
+  getSharedPreambleMap().erase(P->Key);
+  llvm::sys::Path(P->PCHFile).eraseFromDisk();
+  delete P;
+}
+
+static void setSharedPreamble(const ASTUnit *AU, SharedPreamble *P) {
+  OnDiskData &D = getOnDiskData(AU);
+  D.SharedPCH = P;
+  D.PreambleFile = P->PCHFile;
+}
+
 void OnDiskData::CleanTemporaryFiles() {
   for (unsigned I = 0, N = TemporaryFiles.size(); I != N; ++I)
     TemporaryFiles[I].eraseFromDisk();
@@ -170,7 +309,11 @@ void OnDiskData::CleanTemporaryFiles() {
 }
 
 void OnDiskData::CleanPreambleFile() {
-  if (!PreambleFile.empty()) {
+  if (SharedPCH) {
+    releaseSharedPreamble(SharedPCH);
+    SharedPCH = 0;
+    PreambleFile.clear();
+  } else if (!PreambleFile.empty()) {
     llvm::sys::Path(PreambleFile).eraseFromDisk();
     PreambleFile.clear();
   }
@@ -189,6 +332,68 @@ struct ASTUnit::ASTWriterData {
   ASTWriterData() : Stream(Buffer), Writer(Stream) { }
 };
 
+/// \brief A precompiled preamble being rebuilt on a worker thread, while the
+/// unit keeps parsing with its stale preamble, or without one.
+///
+/// Everything the worker reads is copied into the rebuild before it starts,
+/// and the results are only read once it has been joined.
+struct ASTUnit::PreambleRebuild {
+  /// \brief The invocation that precompiles the preamble into its output
+  /// file. Its remapped buffers belong to the rebuild.
+  IntrusiveRefCntPtr<CompilerInvocation> Invocation;
+
+  /// \brief The preamble text being precompiled.
+  std::string Text;
+
+  /// \brief Whether the preamble ends at the start of a new line.
+  bool EndsAtStartOfLine;
+
+  /// \brief The size reserved for the main file within the preamble.
+  unsigned ReservedSize;
+
+  /// \brief The key to share the preamble under, or empty.
+  std::string SharedKey;
+
+  /// \brief Whether the worker has not been joined yet.
+  bool Running;
+
+  /// \brief Guards \c Finished.
+  llvm::sys::Mutex Lock;
+
+  /// \brief Whether the worker is done.
+  bool Finished;
+
+  /// \brief Whether the preamble was precompiled.
+  bool Succeeded;
+
+  /// \brief The number of warnings produced while parsing the preamble.
+  unsigned NumWarnings;
+
+  PrecompiledPreambleInfo Info;
+
+  /// \brief The diagnostics produced while parsing the preamble.
+  SmallVector<StoredDiagnostic, 4> Diagnostics;
+
+#if defined(LLVM_ON_UNIX)
+  pthread_t Thread;
+#endif
+
+  PreambleRebuild()
+    : EndsAtStartOfLine(false), ReservedSize(0), Running(false),
+      Lock(/*recursive=*/false), Finished(false), Succeeded(false),
+      NumWarnings(0) { }
+
+  ~PreambleRebuild();
+
+  bool isFinished() {
+    llvm::MutexGuard Guard(Lock);
+    return Finished;
+  }
+
+  static void build(void *Rebuild);
+  static void *run(void *Rebuild);
+};
+
 void ASTUnit::clearFileLevelDecls() {
   for (FileDeclsTy::iterator
          I = FileDecls.begin(), E = FileDecls.end(); I != E; ++I)
@@ -224,7 +429,8 @@ ASTUnit::ASTUnit(bool _MainFileIsAST)
     PreambleRebuildCounter(0), SavedMainFileBuffer(0), PreambleBuffer(0),
     NumWarningsInPreamble(0),
     ShouldCacheCodeCompletionResults(false),
-    IncludeBriefCommentsInCodeCompletion(false), UserFilesAreVolatile(false),
+    IncludeBriefCommentsInCodeCompletion(false),
+    RebuildPreambleInBackground(false), UserFilesAreVolatile(false),
     CompletionCacheTopLevelHashValue(0),
     PreambleTopLevelHashValue(0),
     CurrentTopLevelHashValue(0),
@@ -236,6 +442,10 @@ ASTUnit::ASTUnit(bool _MainFileIsAST)
 }
 
 ASTUnit::~ASTUnit() {
+  // A preamble still being rebuilt is dropped, but its worker has to finish
+  // first.
+  waitForPreambleRebuild();
+
   clearFileLevelDecls();
 
   // Clean up the temporary files and the preamble file.
@@ -954,15 +1164,17 @@ public:
 };
 
 class PrecompilePreambleConsumer : public PCHGenerator {
-  ASTUnit &Unit;
+  DiagnosticsEngine &Diags;
   unsigned &Hash;                                   
   std::vector<Decl *> TopLevelDecls;
+  std::vector<serialization::DeclID> &TopLevelDeclIDs;
                                      
 public:
-  PrecompilePreambleConsumer(ASTUnit &Unit, const Preprocessor &PP, 
+  PrecompilePreambleConsumer(PrecompiledPreambleInfo &Info,
+                             const Preprocessor &PP, 
                              StringRef isysroot, raw_ostream *Out)
-    : PCHGenerator(PP, "", 0, isysroot, Out), Unit(Unit),
-      Hash(Unit.getCurrentTopLevelHashValue()) {
+    : PCHGenerator(PP, "", 0, isysroot, Out), Diags(PP.getDiagnostics()),
+      Hash(Info.TopLevelHashValue), TopLevelDeclIDs(Info.TopLevelDecls) {
     Hash = 0;
   }
 
@@ -983,23 +1195,23 @@ public:
 
   virtual void HandleTranslationUnit(ASTContext &Ctx) {
     PCHGenerator::HandleTranslationUnit(Ctx);
-    if (!Unit.getDiagnostics().hasErrorOccurred()) {
+    if (!Diags.hasErrorOccurred()) {
       // Translate the top-level declarations we captured during
       // parsing into declaration IDs in the precompiled
       // preamble. This will allow us to deserialize those top-level
       // declarations when requested.
       for (unsigned I = 0, N = TopLevelDecls.size(); I != N; ++I)
-        Unit.addTopLevelDeclFromPreamble(
-                                      getWriter().getDeclID(TopLevelDecls[I]));
+        TopLevelDeclIDs.push_back(getWriter().getDeclID(TopLevelDecls[I]));
     }
   }
 };
 
 class PrecompilePreambleAction : public ASTFrontendAction {
-  ASTUnit &Unit;
+  PrecompiledPreambleInfo &Info;
 
 public:
-  explicit PrecompilePreambleAction(ASTUnit &Unit) : Unit(Unit) {}
+  explicit PrecompilePreambleAction(PrecompiledPreambleInfo &Info)
+    : Info(Info) {}
 
   virtual ASTConsumer *CreateASTConsumer(CompilerInstance &CI,
                                          StringRef InFile) {
@@ -1015,8 +1227,8 @@ public:
       Sysroot.clear();
 
     CI.getPreprocessor().addPPCallbacks(
-     new MacroDefinitionTrackerPPCallbacks(Unit.getCurrentTopLevelHashValue()));
-    return new PrecompilePreambleConsumer(Unit, CI.getPreprocessor(), Sysroot, 
+                    new MacroDefinitionTrackerPPCallbacks(Info.TopLevelHashValue));
+    return new PrecompilePreambleConsumer(Info, CI.getPreprocessor(), Sysroot, 
                                           OS);
   }
 
@@ -1144,6 +1356,7 @@ bool ASTUnit::Parse(llvm::MemoryBuffer *OverrideMainBuffer) {
     PreprocessorOpts.PrecompiledPreambleBytes.second
                                                     = PreambleEndsAtStartOfLine;
     PreprocessorOpts.ImplicitPCHInclude = getPreambleFile(this);
+    PreprocessorOpts.PrecompiledPreambleMainFile = OriginalSourceFile;
     PreprocessorOpts.DisablePCHValidation = true;
     
     // The stored diagnostic has the old source manager in it; update
@@ -1325,6 +1538,580 @@ static llvm::MemoryBuffer *CreatePaddedMainFileBuffer(llvm::MemoryBuffer *Old,
   return Result;
 }
 
+/// \brief The size of the buffer to reserve for the main file within a
+/// precompiled preamble, given the size of the main file now.
+static unsigned getPreambleReservedSize(unsigned MainFileSize) {
+  // Leave room in case the file grows.
+  if (MainFileSize < 4096)
+    return 8191;
+  return MainFileSize * 2;
+}
+
+/// \brief Create the main file buffer to precompile a preamble from: the
+/// preamble text, padded to \p ReservedSize.
+static llvm::MemoryBuffer *CreatePaddedPreambleBuffer(StringRef Text,
+                                                      unsigned ReservedSize,
+                                                      StringRef Name) {
+  llvm::MemoryBuffer *Result
+    = llvm::MemoryBuffer::getNewUninitMemBuffer(ReservedSize, Name);
+  memcpy(const_cast<char*>(Result->getBufferStart()), Text.data(),
+         Text.size());
+  memset(const_cast<char*>(Result->getBufferStart()) + Text.size(),
+         ' ', ReservedSize - Text.size() - 1);
+  const_cast<char*>(Result->getBufferEnd())[-1] = '\n';
+  return Result;
+}
+
+/// \brief Create a main file buffer to parse with a stale preamble.
+///
+/// The buffer starts with the stale preamble text, padded with spaces and
+/// line breaks to the length and number of lines of the file's current
+/// preamble, so that everything after the preamble stays at the same offset,
+/// line and column as in the file.
+///
+/// \returns null if the stale preamble is longer than the current one, or
+/// has more lines.
+static llvm::MemoryBuffer *
+CreateStalePreambleMainFileBuffer(const ASTUnit::PreambleData &Stale,
+                                  llvm::MemoryBuffer *Main,
+                                  unsigned PreambleSize,
+                                  unsigned ReservedSize,
+                                  StringRef Name) {
+  StringRef StaleText(Stale.getBufferStart(), Stale.size());
+  StringRef NewText(Main->getBufferStart(), PreambleSize);
+
+  // Pad in front of the stale preamble's last line break, in its style.
+  StringRef Break = StaleText.endswith("\r\n") ? "\r\n" : "\n";
+  if (!StaleText.endswith(Break))
+    return 0;
+  size_t StaleLines = StaleText.count('\n');
+  size_t NewLines = NewText.count('\n');
+  if (StaleText.size() > NewText.size() || StaleLines > NewLines)
+    return 0;
+  size_t ExtraLines = NewLines - StaleLines;
+  if (NewText.size() - StaleText.size() < ExtraLines * Break.size())
+    return 0;
+  size_t Spaces = NewText.size() - StaleText.size() - ExtraLines*Break.size();
+
+  llvm::MemoryBuffer *Result
+    = llvm::MemoryBuffer::getNewUninitMemBuffer(ReservedSize, Name);
+  char *Out = const_cast<char*>(Result->getBufferStart());
+  StringRef Directives = StaleText.substr(0, StaleText.size()-Break.size());
+  memcpy(Out, Directives.data(), Directives.size());
+  Out += Directives.size();
+  memset(Out, ' ', Spaces);
+  Out += Spaces;
+  for (size_t I = 0; I <= ExtraLines; ++I) {
+    memcpy(Out, Break.data(), Break.size());
+    Out += Break.size();
+  }
+  memcpy(Out, Main->getBufferStart() + PreambleSize,
+         Main->getBufferSize() - PreambleSize);
+  Out += Main->getBufferSize() - PreambleSize;
+  memset(Out, ' ', Result->getBufferEnd() - Out - 1);
+  const_cast<char*>(Result->getBufferEnd())[-1] = '\n';
+  return Result;
+}
+
+/// \brief Determine whether any of the files a precompiled preamble depends
+/// on has changed since the preamble was built.
+static bool anyPreambleFileChanged(
+                    FileManager &FileMgr, PreprocessorOptions &PreprocessorOpts,
+                    const llvm::StringMap<std::pair<off_t, time_t> > &Files) {
+  // First, make a record of those files that have been overridden via
+  // remapping or unsaved_files.
+  llvm::StringMap<std::pair<off_t, time_t> > OverriddenFiles;
+  for (PreprocessorOptions::remapped_file_iterator
+            R = PreprocessorOpts.remapped_file_begin(),
+         REnd = PreprocessorOpts.remapped_file_end();
+       R != REnd;
+       ++R) {
+    struct stat StatBuf;
+    if (FileMgr.getNoncachedStatValue(R->second, StatBuf)) {
+      // If we can't stat the file we're remapping to, assume that something
+      // horrible happened.
+      return true;
+    }
+    
+    OverriddenFiles[R->first] = std::make_pair(StatBuf.st_size, 
+                                               StatBuf.st_mtime);
+  }
+  for (PreprocessorOptions::remapped_file_buffer_iterator
+            R = PreprocessorOpts.remapped_file_buffer_begin(),
+         REnd = PreprocessorOpts.remapped_file_buffer_end();
+       R != REnd;
+       ++R) {
+    // FIXME: Should we actually compare the contents of file->buffer
+    // remappings?
+    OverriddenFiles[R->first] = std::make_pair(R->second->getBufferSize(), 
+                                               0);
+  }
+   
+  // Check whether anything has changed.
+  for (llvm::StringMap<std::pair<off_t, time_t> >::const_iterator 
+         F = Files.begin(), FEnd = Files.end();
+       F != FEnd; 
+       ++F) {
+    llvm::StringMap<std::pair<off_t, time_t> >::iterator Overridden
+      = OverriddenFiles.find(F->first());
+    if (Overridden != OverriddenFiles.end()) {
+      // This file was remapped; check whether the newly-mapped file 
+      // matches up with the previous mapping.
+      if (Overridden->second != F->second)
+        return true;
+      continue;
+    }
+    
+    // The file was not remapped; check whether it has changed on disk.
+    struct stat StatBuf;
+    if (FileMgr.getNoncachedStatValue(F->first(), StatBuf)) {
+      // If we can't stat the file, assume that something horrible happened.
+      return true;
+    }
+    if (StatBuf.st_size != F->second.first || 
+        StatBuf.st_mtime != F->second.second)
+      return true;
+  }
+
+  return false;
+}
+
+/// \brief Whether precompiled preambles may be shared between ASTUnits.
+static bool canSharePreambles() {
+  // When the preamble file is forced for testing, every ASTUnit writes to the
+  // same file anyway.
+  return !::getenv("CINDEXTEST_PREAMBLE_FILE") &&
+         !::getenv("LIBCLANG_NO_SHARED_PREAMBLES");
+}
+
+/// \brief Compute the key under which a precompiled preamble with the given
+/// text and compiler invocation is shared.
+///
+/// The main file itself is not part of the key, so that every main file that
+/// starts with the same preamble text can use the same PCH. Its directory is,
+/// since quoted includes are looked up relative to it. Everything in the
+/// invocation that can change the contents of the precompiled preamble or the
+/// diagnostics it produces is hashed, including the contents of remapped
+/// buffers other than the main file, which the file-change check only
+/// compares by size.
+static std::string getSharedPreambleKey(CompilerInvocation &Invocation,
+                                        StringRef MainFilename,
+                                        StringRef PreambleText,
+                                        bool EndsAtStartOfLine,
+                                        bool CaptureDiagnostics) {
+  using llvm::hash_combine;
+
+  // The module hash covers the compiler version, language, target, macros
+  // and system include configuration.
+  llvm::hash_code Code = llvm::hash_value(Invocation.getModuleHash());
+
+  SmallString<128> MainFileDir(llvm::sys::path::parent_path(MainFilename));
+  llvm::sys::fs::make_absolute(MainFileDir);
+  Code = hash_combine(Code, MainFileDir.str(),
+                      Invocation.getFileSystemOpts().WorkingDir);
+
+  // The preamble is built with the frontend options of the main file, and
+  // the ones below change what ends up in the PCH.
+  const FrontendOptions &FEOpts = Invocation.getFrontendOpts();
+  const FrontendInputFile &Input = FEOpts.Inputs[0];
+  Code = hash_combine(Code, static_cast<unsigned>(Input.getKind()),
+                      Input.isSystem());
+  Code = hash_combine(Code, FEOpts.SkipFunctionBodies, FEOpts.RelocatablePCH,
+                      FEOpts.UseGlobalModuleIndex,
+                      FEOpts.OverrideRecordLayoutsFile);
+  for (unsigned I = 0, N = FEOpts.ASTMergeFiles.size(); I != N; ++I)
+    Code = hash_combine(Code, FEOpts.ASTMergeFiles[I]);
+
+  // Units that don't capture diagnostics have none to hand out.
+  Code = hash_combine(Code, CaptureDiagnostics);
+
+  const LangOptions &LangOpts = *Invocation.getLangOpts();
+#define LANGOPT(Name, Bits, Default, Description)
+#define BENIGN_LANGOPT(Name, Bits, Default, Description) \
+  Code = hash_combine(Code, LangOpts.Name);
+#define BENIGN_ENUM_LANGOPT(Name, Type, Bits, Default, Description) \
+  Code = hash_combine(Code, static_cast<unsigned>(LangOpts.get##Name()));
+#include "clang/Basic/LangOptions.def"
+
+  const HeaderSearchOptions &HSOpts = Invocation.getHeaderSearchOpts();
+  Code = hash_combine(Code, HSOpts.ResourceDir);
+  for (unsigned I = 0, N = HSOpts.UserEntries.size(); I != N; ++I) {
+    const HeaderSearchOptions::Entry &E = HSOpts.UserEntries[I];
+    Code = hash_combine(Code, E.Path, static_cast<unsigned>(E.Group),
+                        static_cast<unsigned>(E.IsFramework),
+                        static_cast<unsigned>(E.IgnoreSysRoot));
+  }
+
+  PreprocessorOptions &PPOpts = Invocation.getPreprocessorOpts();
+  for (unsigned I = 0, N = PPOpts.Includes.size(); I != N; ++I)
+    Code = hash_combine(Code, PPOpts.Includes[I]);
+  for (unsigned I = 0, N = PPOpts.MacroIncludes.size(); I != N; ++I)
+    Code = hash_combine(Code, PPOpts.MacroIncludes[I]);
+  Code = hash_combine(Code, PPOpts.ImplicitPCHInclude,
+                      PPOpts.ImplicitPTHInclude);
+  for (PreprocessorOptions::remapped_file_iterator
+            R = PPOpts.remapped_file_begin(),
+         REnd = PPOpts.remapped_file_end();
+       R != REnd; ++R)
+    Code = hash_combine(Code, R->first, R->second);
+  for (PreprocessorOptions::remapped_file_buffer_iterator
+            R = PPOpts.remapped_file_buffer_begin(),
+         REnd = PPOpts.remapped_file_buffer_end();
+       R != REnd; ++R) {
+    if (R->first == MainFilename)
+      continue;
+    Code = hash_combine(Code, R->first, R->second->getBuffer());
+  }
+
+  const DiagnosticOptions &DiagOpts = Invocation.getDiagnosticOpts();
+#define DIAGOPT(Name, Bits, Default) \
+  Code = hash_combine(Code, DiagOpts.Name);
+#define ENUM_DIAGOPT(Name, Type, Bits, Default) \
+  Code = hash_combine(Code, static_cast<unsigned>(DiagOpts.get##Name()));
+#include "clang/Basic/DiagnosticOptions.def"
+  for (unsigned I = 0, N = DiagOpts.Warnings.size(); I != N; ++I)
+    Code = hash_combine(Code, DiagOpts.Warnings[I]);
+
+  std::string Key = llvm::utostr(static_cast<size_t>(Code));
+  Key += EndsAtStartOfLine ? '1' : '0';
+  Key += PreambleText;
+  return Key;
+}
+
+/// \brief Precompile the preamble of the main file of \p PreambleInvocation,
+/// which must be remapped to the padded preamble text, into the invocation's
+/// output file.
+///
+/// \returns false if no precompiled preamble was written.
+static bool precompilePreamble(CompilerInvocation *PreambleInvocation,
+                               DiagnosticsEngine &Diags,
+                               PrecompiledPreambleInfo &Info) {
+  // Create the compiler instance to use for building the precompiled preamble.
+  OwningPtr<CompilerInstance> Clang(new CompilerInstance());
+
+  // Recover resources if we crash before exiting this method.
+  llvm::CrashRecoveryContextCleanupRegistrar<CompilerInstance>
+    CICleanup(Clang.get());
+
+  Clang->setInvocation(PreambleInvocation);
+  Clang->setDiagnostics(&Diags);
+
+  // Create the target instance.
+  Clang->setTarget(TargetInfo::CreateTargetInfo(Clang->getDiagnostics(),
+                                                &Clang->getTargetOpts()));
+  if (!Clang->hasTarget())
+    return false;
+
+  // Inform the target of the language options.
+  //
+  // FIXME: We shouldn't need to do this, the target should be immutable once
+  // created. This complexity should be lifted elsewhere.
+  Clang->getTarget().setForcedLangOptions(Clang->getLangOpts());
+
+  assert(Clang->getFrontendOpts().Inputs.size() == 1 &&
+         "Invocation must have exactly one source file!");
+  assert(Clang->getFrontendOpts().Inputs[0].getKind() != IK_AST &&
+         "FIXME: AST inputs not yet supported here!");
+  assert(Clang->getFrontendOpts().Inputs[0].getKind() != IK_LLVM_IR &&
+         "IR inputs not support here!");
+
+  // Create a file manager object to provide access to and cache the filesystem.
+  Clang->setFileManager(new FileManager(Clang->getFileSystemOpts()));
+
+  // Create the source manager.
+  Clang->setSourceManager(new SourceManager(Diags, Clang->getFileManager()));
+
+  OwningPtr<PrecompilePreambleAction> Act;
+  Act.reset(new PrecompilePreambleAction(Info));
+  if (!Act->BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0]))
+    return false;
+
+  Act->Execute();
+  Act->EndSourceFile();
+
+  // There were errors parsing the preamble, so no precompiled header was
+  // generated.
+  if (Diags.hasErrorOccurred())
+    return false;
+
+  // Keep track of all of the files that the source manager knows about,
+  // so we can verify whether they have changed or not.
+  SourceManager &SourceMgr = Clang->getSourceManager();
+  const llvm::MemoryBuffer *MainFileBuffer
+    = SourceMgr.getBuffer(SourceMgr.getMainFileID());
+  for (SourceManager::fileinfo_iterator F = SourceMgr.fileinfo_begin(),
+                                     FEnd = SourceMgr.fileinfo_end();
+       F != FEnd;
+       ++F) {
+    const FileEntry *File = F->second->OrigEntry;
+    if (!File || F->second->getRawBuffer() == MainFileBuffer)
+      continue;
+
+    Info.Files[File->getName()]
+      = std::make_pair(F->second->getSize(), File->getModificationTime());
+  }
+  return true;
+}
+
+ASTUnit::PreambleRebuild::~PreambleRebuild() {
+  assert(!Running && "Preamble rebuild dropped while its worker runs");
+  PreprocessorOptions &PPOpts = Invocation->getPreprocessorOpts();
+  for (PreprocessorOptions::remapped_file_buffer_iterator
+         R = PPOpts.remapped_file_buffer_begin(),
+         REnd = PPOpts.remapped_file_buffer_end();
+       R != REnd;
+       ++R)
+    delete R->second;
+
+  // The output file is cleared once a unit uses the preamble.
+  const std::string &PCHFile = Invocation->getFrontendOpts().OutputFile;
+  if (!PCHFile.empty())
+    llvm::sys::Path(PCHFile).eraseFromDisk();
+}
+
+void ASTUnit::PreambleRebuild::build(void *Data) {
+  PreambleRebuild &Rebuild = *static_cast<PreambleRebuild *>(Data);
+  CompilerInvocation &Invocation = *Rebuild.Invocation;
+
+  // The unit's diagnostics engine is in use by the thread parsing it.
+  StoredDiagnosticConsumer Client(Rebuild.Diagnostics);
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagIDs(new DiagnosticIDs());
+  IntrusiveRefCntPtr<DiagnosticsEngine>
+    Diags(new DiagnosticsEngine(DiagIDs, &Invocation.getDiagnosticOpts(),
+                                &Client, /*ShouldOwnClient=*/false));
+  ProcessWarningOptions(*Diags, Invocation.getDiagnosticOpts());
+
+  Rebuild.Succeeded = precompilePreamble(&Invocation, *Diags, Rebuild.Info);
+  Rebuild.NumWarnings = Diags->getNumWarnings();
+}
+
+void *ASTUnit::PreambleRebuild::run(void *Data) {
+  PreambleRebuild &Rebuild = *static_cast<PreambleRebuild *>(Data);
+  llvm::CrashRecoveryContext CRC;
+  if (!CRC.RunSafely(build, Data))
+    Rebuild.Succeeded = false;
+
+  llvm::MutexGuard Guard(Rebuild.Lock);
+  Rebuild.Finished = true;
+  return 0;
+}
+
+void ASTUnit::waitForPreambleRebuild() {
+  if (!PendingPreamble || !PendingPreamble->Running)
+    return;
+#if defined(LLVM_ON_UNIX)
+  pthread_join(PendingPreamble->Thread, 0);
+#endif
+  PendingPreamble->Running = false;
+}
+
+/// \brief Start precompiling the preamble \p NewPreamble on a worker thread.
+///
+/// \returns false if the preamble has to be precompiled on this thread.
+bool ASTUnit::startPreambleRebuild(CompilerInvocation &PreambleInvocation,
+        const std::pair<llvm::MemoryBuffer *,
+                        std::pair<unsigned, bool> > &NewPreamble) {
+#if defined(LLVM_ON_UNIX)
+  // Crash-recovery tests force every preamble into one file, which would be
+  // overwritten while the stale preamble in it is still in use.
+  if (::getenv("CINDEXTEST_PREAMBLE_FILE"))
+    return false;
+
+  // LLVM only guards its shared state once it is in multithreaded mode.
+  if (!llvm_is_multithreaded() && !llvm_start_multithreaded())
+    return false;
+
+  std::string PreamblePCHPath = GetPreamblePCHPath();
+  if (PreamblePCHPath.empty())
+    return false;
+
+  OwningPtr<PreambleRebuild> Rebuild(new PreambleRebuild());
+  Rebuild->Invocation = new CompilerInvocation(PreambleInvocation);
+  FrontendOptions &FrontendOpts = Rebuild->Invocation->getFrontendOpts();
+  PreprocessorOptions &PreprocessorOpts
+    = Rebuild->Invocation->getPreprocessorOpts();
+
+  // The unit deletes its unsaved files when it is reparsed, so the worker
+  // reads copies of them.
+  for (PreprocessorOptions::remapped_file_buffer_iterator
+         R = PreprocessorOpts.remapped_file_buffer_begin(),
+         REnd = PreprocessorOpts.remapped_file_buffer_end();
+       R != REnd;
+       ++R)
+    R->second = llvm::MemoryBuffer::getMemBufferCopy(R->second->getBuffer(),
+                                         R->second->getBufferIdentifier());
+  PreprocessorOpts.RetainRemappedFileBuffers = true;
+
+  StringRef MainFilename = FrontendOpts.Inputs[0].getFile();
+  Rebuild->Text.assign(NewPreamble.first->getBufferStart(),
+                       NewPreamble.second.first);
+  Rebuild->EndsAtStartOfLine = NewPreamble.second.second;
+  Rebuild->ReservedSize
+    = getPreambleReservedSize(NewPreamble.first->getBufferSize());
+  if (canSharePreambles())
+    Rebuild->SharedKey = getSharedPreambleKey(*Rebuild->Invocation,
+                                              MainFilename, Rebuild->Text,
+                                              Rebuild->EndsAtStartOfLine,
+                                              CaptureDiagnostics);
+
+  // Remap the main source file to the preamble buffer.
+  llvm::sys::PathWithStatus MainFilePath(MainFilename);
+  PreprocessorOpts.addRemappedFile(MainFilePath.str(),
+                                   CreatePaddedPreambleBuffer(Rebuild->Text,
+                                                         Rebuild->ReservedSize,
+                                                         MainFilename));
+
+  // Tell the compiler invocation to generate a temporary precompiled header.
+  FrontendOpts.ProgramAction = frontend::GeneratePCH;
+  FrontendOpts.OutputFile = PreamblePCHPath;
+  PreprocessorOpts.PrecompiledPreambleBytes.first = 0;
+  PreprocessorOpts.PrecompiledPreambleBytes.second = false;
+
+  pthread_attr_t Attr;
+  pthread_attr_init(&Attr);
+  // Ask for the same 8MB of stack as the other threads clang starts.
+  pthread_attr_setstacksize(&Attr, 8 << 20);
+  int Error = pthread_create(&Rebuild->Thread, &Attr, PreambleRebuild::run,
+                             Rebuild.get());
+  pthread_attr_destroy(&Attr);
+  if (Error)
+    return false;
+
+  Rebuild->Running = true;
+  PendingPreamble.reset(Rebuild.take());
+  return true;
+#else
+  return false;
+#endif
+}
+
+/// \brief Use the preamble precompiled in the background, if it is the
+/// preamble \p NewPreamble and none of the files it depends on has changed
+/// since. Otherwise the rebuild is dropped.
+///
+/// \returns the main file buffer to parse with the preamble, or null.
+llvm::MemoryBuffer *ASTUnit::getMainBufferWithRebuiltPreamble(
+        CompilerInvocation &PreambleInvocation,
+        const std::pair<llvm::MemoryBuffer *,
+                        std::pair<unsigned, bool> > &NewPreamble) {
+  waitForPreambleRebuild();
+  OwningPtr<PreambleRebuild> Rebuild(PendingPreamble.take());
+
+  if (!Rebuild->Succeeded) {
+    // Don't try again right away; the preamble likely has errors.
+    PreambleRebuildCounter = DefaultPreambleRebuildInterval;
+    return 0;
+  }
+
+  if (Rebuild->Text.size() != NewPreamble.second.first ||
+      Rebuild->EndsAtStartOfLine != NewPreamble.second.second ||
+      NewPreamble.first->getBufferSize() >= Rebuild->ReservedSize-2 ||
+      memcmp(Rebuild->Text.data(), NewPreamble.first->getBufferStart(),
+             NewPreamble.second.first) != 0 ||
+      anyPreambleFileChanged(*FileMgr, PreambleInvocation.getPreprocessorOpts(),
+                             Rebuild->Info.Files))
+    return 0;
+
+  SimpleTimer PreambleTimer(WantTiming);
+  PreambleTimer.setOutput("Using preamble precompiled in the background");
+
+  // The stale preamble is no longer needed.
+  erasePreambleFile(this);
+  delete PreambleBuffer;
+  PreambleBuffer = 0;
+
+  StringRef MainFilename = PreambleInvocation.getFrontendOpts().Inputs[0]
+                                                                .getFile();
+  Preamble.assign(FileMgr->getFile(MainFilename),
+                  NewPreamble.first->getBufferStart(),
+                  NewPreamble.first->getBufferStart()
+                                                  + NewPreamble.second.first);
+  PreambleEndsAtStartOfLine = NewPreamble.second.second;
+  PreambleReservedSize = Rebuild->ReservedSize;
+  OriginalSourceFile = MainFilename;
+
+  // The unit owns the precompiled preamble from now on.
+  std::string PCHFile;
+  PCHFile.swap(Rebuild->Invocation->getFrontendOpts().OutputFile);
+  setPreambleFile(this, PCHFile);
+
+  // Mimic the state we would be in after precompiling the preamble ourselves.
+  getDiagnostics().Reset();
+  ProcessWarningOptions(getDiagnostics(),
+                        PreambleInvocation.getDiagnosticOpts());
+  checkAndRemoveNonDriverDiags(StoredDiagnostics);
+  getDiagnostics().setNumWarnings(Rebuild->NumWarnings);
+  NumWarningsInPreamble = Rebuild->NumWarnings;
+  PreambleDiagnostics.swap(Rebuild->Diagnostics);
+  TopLevelDecls.clear();
+  TopLevelDeclsInPreamble.swap(Rebuild->Info.TopLevelDecls);
+  copyPreambleFiles(Rebuild->Info.Files, FilesInPreamble);
+  PreambleRebuildCounter = 1;
+
+  CurrentTopLevelHashValue = Rebuild->Info.TopLevelHashValue;
+  if (CurrentTopLevelHashValue != PreambleTopLevelHashValue) {
+    CompletionCacheTopLevelHashValue = 0;
+    PreambleTopLevelHashValue = CurrentTopLevelHashValue;
+  }
+
+  if (!Rebuild->SharedKey.empty())
+    sharePrecompiledPreamble(Rebuild->SharedKey);
+
+  return CreatePaddedMainFileBuffer(NewPreamble.first, PreambleReservedSize,
+                                    MainFilename);
+}
+
+/// \brief Keep using the stale preamble while a new one is precompiled in
+/// the background, as long as only the main file's preamble text changed.
+///
+/// \returns the main file buffer to parse with the stale preamble, or null if
+/// the main file has to be parsed without a preamble.
+llvm::MemoryBuffer *ASTUnit::getMainBufferWithStalePreamble(
+        CompilerInvocation &PreambleInvocation,
+        const std::pair<llvm::MemoryBuffer *,
+                        std::pair<unsigned, bool> > &NewPreamble) {
+  // A preamble whose headers changed would read the new headers at the old
+  // offsets.
+  if (!PreambleEndsAtStartOfLine || !NewPreamble.second.second ||
+      NewPreamble.first->getBufferSize() >= PreambleReservedSize-2 ||
+      anyPreambleFileChanged(*FileMgr, PreambleInvocation.getPreprocessorOpts(),
+                             FilesInPreamble))
+    return 0;
+
+  llvm::MemoryBuffer *Result
+    = CreateStalePreambleMainFileBuffer(Preamble, NewPreamble.first,
+                                        NewPreamble.second.first,
+                                        PreambleReservedSize,
+                         PreambleInvocation.getFrontendOpts().Inputs[0]
+                                                                .getFile());
+  if (!Result)
+    return 0;
+
+  getDiagnostics().Reset();
+  ProcessWarningOptions(getDiagnostics(),
+                        PreambleInvocation.getDiagnosticOpts());
+  getDiagnostics().setNumWarnings(NumWarningsInPreamble);
+  return Result;
+}
+
+/// \brief Offer the unit's precompiled preamble to other ASTUnits parsing a
+/// main file with the same preamble.
+void ASTUnit::sharePrecompiledPreamble(const std::string &Key) {
+  SharedPreamble *Shared = new SharedPreamble();
+  Shared->Key = Key;
+  Shared->PCHFile = getPreambleFile(this);
+  Shared->ReservedSize = PreambleReservedSize;
+  Shared->NumWarnings = NumWarningsInPreamble;
+  Shared->TopLevelHashValue = CurrentTopLevelHashValue;
+  copyPreambleFiles(FilesInPreamble, Shared->Files);
+  Shared->Diagnostics = PreambleDiagnostics;
+  Shared->TopLevelDecls = TopLevelDeclsInPreamble;
+  if (registerSharedPreamble(Shared))
+    setSharedPreamble(this, Shared);
+  else
+    delete Shared;
+}
+
 /// \brief Attempt to build or re-use a precompiled preamble when (re-)parsing
 /// the source file.
 ///
@@ -1335,6 +2122,11 @@ static llvm::MemoryBuffer *CreatePaddedMainFileBuffer(llvm::MemoryBuffer *Old,
 /// this routine will determine if it is still valid and, if so, avoid 
 /// rebuilding the precompiled preamble.
 ///
+/// When the unit rebuilds its preamble in the background, an out-of-date
+/// preamble is precompiled again on a worker thread. Until the new preamble
+/// is ready, the stale one is used if only the main file's preamble text
+/// changed, and otherwise the main file is parsed without a preamble.
+///
 /// \param AllowRebuild When true (the default), this routine is
 /// allowed to rebuild the precompiled preamble if it is found to be
 /// out-of-date.
@@ -1364,7 +2156,7 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
   OwningPtr<llvm::MemoryBuffer> OwnedPreambleBuffer;
   if (CreatedPreambleBuffer)
     OwnedPreambleBuffer.reset(NewPreamble.first);
-
+  
   if (!NewPreamble.second.first) {
     // We couldn't find a preamble in the main source. Clear out the current
     // preamble, if we have one. It's obviously no good any more.
@@ -1375,7 +2167,15 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
     PreambleRebuildCounter = 1;
     return 0;
   }
-  
+
+  // Switch to a preamble precompiled in the background since the last parse.
+  if (AllowRebuild && PendingPreamble && PendingPreamble->isFinished()) {
+    if (llvm::MemoryBuffer *Buffer
+          = getMainBufferWithRebuiltPreamble(*PreambleInvocation,
+                                             NewPreamble))
+      return Buffer;
+  }
+
   if (!Preamble.empty()) {
     // We've previously computed a preamble. Check whether we have the same
     // preamble now that we did before, and that there's enough space in
@@ -1390,62 +2190,8 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
       // preamble.
 
       // Check that none of the files used by the preamble have changed.
-      bool AnyFileChanged = false;
-          
-      // First, make a record of those files that have been overridden via
-      // remapping or unsaved_files.
-      llvm::StringMap<std::pair<off_t, time_t> > OverriddenFiles;
-      for (PreprocessorOptions::remapped_file_iterator
-                R = PreprocessorOpts.remapped_file_begin(),
-             REnd = PreprocessorOpts.remapped_file_end();
-           !AnyFileChanged && R != REnd;
-           ++R) {
-        struct stat StatBuf;
-        if (FileMgr->getNoncachedStatValue(R->second, StatBuf)) {
-          // If we can't stat the file we're remapping to, assume that something
-          // horrible happened.
-          AnyFileChanged = true;
-          break;
-        }
-        
-        OverriddenFiles[R->first] = std::make_pair(StatBuf.st_size, 
-                                                   StatBuf.st_mtime);
-      }
-      for (PreprocessorOptions::remapped_file_buffer_iterator
-                R = PreprocessorOpts.remapped_file_buffer_begin(),
-             REnd = PreprocessorOpts.remapped_file_buffer_end();
-           !AnyFileChanged && R != REnd;
-           ++R) {
-        // FIXME: Should we actually compare the contents of file->buffer
-        // remappings?
-        OverriddenFiles[R->first] = std::make_pair(R->second->getBufferSize(), 
-                                                   0);
-      }
-       
-      // Check whether anything has changed.
-      for (llvm::StringMap<std::pair<off_t, time_t> >::iterator 
-             F = FilesInPreamble.begin(), FEnd = FilesInPreamble.end();
-           !AnyFileChanged && F != FEnd; 
-           ++F) {
-        llvm::StringMap<std::pair<off_t, time_t> >::iterator Overridden
-          = OverriddenFiles.find(F->first());
-        if (Overridden != OverriddenFiles.end()) {
-          // This file was remapped; check whether the newly-mapped file 
-          // matches up with the previous mapping.
-          if (Overridden->second != F->second)
-            AnyFileChanged = true;
-          continue;
-        }
-        
-        // The file was not remapped; check whether it has changed on disk.
-        struct stat StatBuf;
-        if (FileMgr->getNoncachedStatValue(F->first(), StatBuf)) {
-          // If we can't stat the file, assume that something horrible happened.
-          AnyFileChanged = true;
-        } else if (StatBuf.st_size != F->second.first || 
-                   StatBuf.st_mtime != F->second.second)
-          AnyFileChanged = true;
-      }
+      bool AnyFileChanged = anyPreambleFileChanged(*FileMgr, PreprocessorOpts,
+                                                   FilesInPreamble);
           
       if (!AnyFileChanged) {
         // Okay! We can re-use the precompiled preamble.
@@ -1470,6 +2216,22 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
     if (!AllowRebuild)
       return 0;
 
+    // Rebuild the preamble in the background, unless a rebuild is already
+    // under way or the last one failed recently, and don't wait for it.
+    if (RebuildPreambleInBackground) {
+      bool InBackground = true;
+      if (!PendingPreamble) {
+        if (PreambleRebuildCounter > 1)
+          --PreambleRebuildCounter;
+        else
+          InBackground = startPreambleRebuild(*PreambleInvocation,
+                                              NewPreamble);
+      }
+      if (InBackground)
+        return getMainBufferWithStalePreamble(*PreambleInvocation,
+                                              NewPreamble);
+    }
+
     // We can't reuse the previously-computed preamble. Build a new one.
     Preamble.clear();
     PreambleDiagnostics.clear();
@@ -1489,6 +2251,63 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
     return 0;
   }
 
+  StringRef MainFilename = FrontendOpts.Inputs[0].getFile();
+
+  // Another ASTUnit may already have precompiled this exact preamble.
+  std::string SharedKey;
+  if (canSharePreambles()) {
+    StringRef PreambleText(NewPreamble.first->getBufferStart(),
+                           NewPreamble.second.first);
+    SharedKey = getSharedPreambleKey(*PreambleInvocation, MainFilename,
+                                     PreambleText, NewPreamble.second.second,
+                                     CaptureDiagnostics);
+    if (SharedPreamble *Shared = retainSharedPreamble(SharedKey)) {
+      if (NewPreamble.first->getBufferSize() < Shared->ReservedSize-2 &&
+          !anyPreambleFileChanged(*FileMgr, PreprocessorOpts, Shared->Files)) {
+        SimpleTimer PreambleTimer(WantTiming);
+        PreambleTimer.setOutput("Reusing shared preamble");
+
+        Preamble.assign(FileMgr->getFile(MainFilename),
+                        NewPreamble.first->getBufferStart(), 
+                        NewPreamble.first->getBufferStart() 
+                                                    + NewPreamble.second.first);
+        PreambleEndsAtStartOfLine = NewPreamble.second.second;
+        PreambleReservedSize = Shared->ReservedSize;
+        OriginalSourceFile = MainFilename;
+        setSharedPreamble(this, Shared);
+
+        // Mimic the state we would be in after precompiling the preamble
+        // ourselves.
+        getDiagnostics().Reset();
+        ProcessWarningOptions(getDiagnostics(),
+                              PreambleInvocation->getDiagnosticOpts());
+        checkAndRemoveNonDriverDiags(StoredDiagnostics);
+        getDiagnostics().setNumWarnings(Shared->NumWarnings);
+        NumWarningsInPreamble = Shared->NumWarnings;
+        PreambleDiagnostics = Shared->Diagnostics;
+        TopLevelDecls.clear();
+        TopLevelDeclsInPreamble = Shared->TopLevelDecls;
+        copyPreambleFiles(Shared->Files, FilesInPreamble);
+        PreambleRebuildCounter = 1;
+
+        CurrentTopLevelHashValue = Shared->TopLevelHashValue;
+        if (CurrentTopLevelHashValue != PreambleTopLevelHashValue) {
+          CompletionCacheTopLevelHashValue = 0;
+          PreambleTopLevelHashValue = CurrentTopLevelHashValue;
+        }
+
+        return CreatePaddedMainFileBuffer(NewPreamble.first,
+                                          PreambleReservedSize,
+                                          FrontendOpts.Inputs[0].getFile());
+      }
+
+      // The shared preamble is stale; it will go away once its other users
+      // rebuild. Build our own.
+      releaseSharedPreamble(Shared);
+      SharedKey.clear();
+    }
+  }
+
   // Create a temporary file for the precompiled preamble. In rare 
   // circumstances, this can fail.
   std::string PreamblePCHPath = GetPreamblePCHPath();
@@ -1506,15 +2325,11 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
   // extra space for the original contents of the file (which will be present
   // when we actually parse the file) along with more room in case the file
   // grows.  
-  PreambleReservedSize = NewPreamble.first->getBufferSize();
-  if (PreambleReservedSize < 4096)
-    PreambleReservedSize = 8191;
-  else
-    PreambleReservedSize *= 2;
+  PreambleReservedSize
+    = getPreambleReservedSize(NewPreamble.first->getBufferSize());
 
   // Save the preamble text for later; we'll need to compare against it for
   // subsequent reparses.
-  StringRef MainFilename = PreambleInvocation->getFrontendOpts().Inputs[0].getFile();
   Preamble.assign(FileMgr->getFile(MainFilename),
                   NewPreamble.first->getBufferStart(), 
                   NewPreamble.first->getBufferStart() 
@@ -1523,13 +2338,9 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
 
   delete PreambleBuffer;
   PreambleBuffer
-    = llvm::MemoryBuffer::getNewUninitMemBuffer(PreambleReservedSize,
-                                                FrontendOpts.Inputs[0].getFile());
-  memcpy(const_cast<char*>(PreambleBuffer->getBufferStart()), 
-         NewPreamble.first->getBufferStart(), Preamble.size());
-  memset(const_cast<char*>(PreambleBuffer->getBufferStart()) + Preamble.size(), 
-         ' ', PreambleReservedSize - Preamble.size() - 1);
-  const_cast<char*>(PreambleBuffer->getBufferEnd())[-1] = '\n';  
+    = CreatePaddedPreambleBuffer(StringRef(Preamble.getBufferStart(),
+                                           Preamble.size()),
+                                 PreambleReservedSize, MainFilename);
   
   // Remap the main source file to the preamble buffer.
   llvm::sys::PathWithStatus MainFilePath(FrontendOpts.Inputs[0].getFile());
@@ -1542,82 +2353,29 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
   PreprocessorOpts.PrecompiledPreambleBytes.first = 0;
   PreprocessorOpts.PrecompiledPreambleBytes.second = false;
   
-  // Create the compiler instance to use for building the precompiled preamble.
-  OwningPtr<CompilerInstance> Clang(new CompilerInstance());
+  OriginalSourceFile = MainFilename;
 
-  // Recover resources if we crash before exiting this method.
-  llvm::CrashRecoveryContextCleanupRegistrar<CompilerInstance>
-    CICleanup(Clang.get());
-
-  Clang->setInvocation(&*PreambleInvocation);
-  OriginalSourceFile = Clang->getFrontendOpts().Inputs[0].getFile();
-  
-  // Set up diagnostics, capturing all of the diagnostics produced.
-  Clang->setDiagnostics(&getDiagnostics());
-  
-  // Create the target instance.
-  Clang->setTarget(TargetInfo::CreateTargetInfo(Clang->getDiagnostics(),
-                                                &Clang->getTargetOpts()));
-  if (!Clang->hasTarget()) {
-    llvm::sys::Path(FrontendOpts.OutputFile).eraseFromDisk();
-    Preamble.clear();
-    PreambleRebuildCounter = DefaultPreambleRebuildInterval;
-    PreprocessorOpts.eraseRemappedFile(
-                               PreprocessorOpts.remapped_file_buffer_end() - 1);
-    return 0;
-  }
-  
-  // Inform the target of the language options.
-  //
-  // FIXME: We shouldn't need to do this, the target should be immutable once
-  // created. This complexity should be lifted elsewhere.
-  Clang->getTarget().setForcedLangOptions(Clang->getLangOpts());
-  
-  assert(Clang->getFrontendOpts().Inputs.size() == 1 &&
-         "Invocation must have exactly one source file!");
-  assert(Clang->getFrontendOpts().Inputs[0].getKind() != IK_AST &&
-         "FIXME: AST inputs not yet supported here!");
-  assert(Clang->getFrontendOpts().Inputs[0].getKind() != IK_LLVM_IR &&
-         "IR inputs not support here!");
-  
   // Clear out old caches and data.
   getDiagnostics().Reset();
-  ProcessWarningOptions(getDiagnostics(), Clang->getDiagnosticOpts());
+  ProcessWarningOptions(getDiagnostics(),
+                        PreambleInvocation->getDiagnosticOpts());
   checkAndRemoveNonDriverDiags(StoredDiagnostics);
   TopLevelDecls.clear();
   TopLevelDeclsInPreamble.clear();
-  
-  // Create a file manager object to provide access to and cache the filesystem.
-  Clang->setFileManager(new FileManager(Clang->getFileSystemOpts()));
-  
-  // Create the source manager.
-  Clang->setSourceManager(new SourceManager(getDiagnostics(),
-                                            Clang->getFileManager()));
-  
-  OwningPtr<PrecompilePreambleAction> Act;
-  Act.reset(new PrecompilePreambleAction(*this));
-  if (!Act->BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0])) {
-    llvm::sys::Path(FrontendOpts.OutputFile).eraseFromDisk();
-    Preamble.clear();
-    PreambleRebuildCounter = DefaultPreambleRebuildInterval;
-    PreprocessorOpts.eraseRemappedFile(
+
+  PrecompiledPreambleInfo Info;
+  bool Precompiled = precompilePreamble(&*PreambleInvocation,
+                                        getDiagnostics(), Info);
+  CurrentTopLevelHashValue = Info.TopLevelHashValue;
+  PreprocessorOpts.eraseRemappedFile(
                                PreprocessorOpts.remapped_file_buffer_end() - 1);
-    return 0;
-  }
-  
-  Act->Execute();
-  Act->EndSourceFile();
 
-  if (Diagnostics->hasErrorOccurred()) {
-    // There were errors parsing the preamble, so no precompiled header was
-    // generated. Forget that we even tried.
+  if (!Precompiled) {
+    // Forget that we even tried.
     // FIXME: Should we leave a note for ourselves to try again?
     llvm::sys::Path(FrontendOpts.OutputFile).eraseFromDisk();
     Preamble.clear();
-    TopLevelDeclsInPreamble.clear();
     PreambleRebuildCounter = DefaultPreambleRebuildInterval;
-    PreprocessorOpts.eraseRemappedFile(
-                               PreprocessorOpts.remapped_file_buffer_end() - 1);
     return 0;
   }
   
@@ -1631,28 +2389,9 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
   // Keep track of the preamble we precompiled.
   setPreambleFile(this, FrontendOpts.OutputFile);
   NumWarningsInPreamble = getDiagnostics().getNumWarnings();
-  
-  // Keep track of all of the files that the source manager knows about,
-  // so we can verify whether they have changed or not.
-  FilesInPreamble.clear();
-  SourceManager &SourceMgr = Clang->getSourceManager();
-  const llvm::MemoryBuffer *MainFileBuffer
-    = SourceMgr.getBuffer(SourceMgr.getMainFileID());
-  for (SourceManager::fileinfo_iterator F = SourceMgr.fileinfo_begin(),
-                                     FEnd = SourceMgr.fileinfo_end();
-       F != FEnd;
-       ++F) {
-    const FileEntry *File = F->second->OrigEntry;
-    if (!File || F->second->getRawBuffer() == MainFileBuffer)
-      continue;
-    
-    FilesInPreamble[File->getName()]
-      = std::make_pair(F->second->getSize(), File->getModificationTime());
-  }
-  
+  TopLevelDeclsInPreamble.swap(Info.TopLevelDecls);
+  copyPreambleFiles(Info.Files, FilesInPreamble);
   PreambleRebuildCounter = 1;
-  PreprocessorOpts.eraseRemappedFile(
-                               PreprocessorOpts.remapped_file_buffer_end() - 1);
   
   // If the hash of top-level entities differs from the hash of the top-level
   // entities the last time we rebuilt the preamble, clear out the completion
@@ -1661,6 +2400,10 @@ llvm::MemoryBuffer *ASTUnit::getMainBufferWithPrecompiledPreamble(
     CompletionCacheTopLevelHashValue = 0;
     PreambleTopLevelHashValue = CurrentTopLevelHashValue;
   }
+
+  // Offer the preamble to other ASTUnits parsing the same file.
+  if (!SharedKey.empty())
+    sharePrecompiledPreamble(SharedKey);
   
   return CreatePaddedMainFileBuffer(NewPreamble.first, 
                                     PreambleReservedSize,
@@ -2470,6 +3213,7 @@ void ASTUnit::CodeComplete(StringRef File, unsigned Line, unsigned Column,
     PreprocessorOpts.PrecompiledPreambleBytes.second
                                                     = PreambleEndsAtStartOfLine;
     PreprocessorOpts.ImplicitPCHInclude = getPreambleFile(this);
+    PreprocessorOpts.PrecompiledPreambleMainFile = OriginalSourceFile;
     PreprocessorOpts.DisablePCHValidation = true;
     
     OwnedBuffers.push_back(OverrideMainBuffer);
@@ -2880,6 +3624,10 @@ const FileEntry *ASTUnit::getPCHFile() {
   return 0;
 }
 
+StringRef ASTUnit::getPrecompiledPreambleFile() const {
+  return getPreambleFile(this);
+}
+
 bool ASTUnit::isModuleFile() {
   return isMainFileAST() && !ASTFileLangOpts.CurrentModule.empty();
 }
@@ -330,6 +330,12 @@ static bool ParseCodeGenArgs(CodeGenOptions &Opts, ArgList &Args, InputKind IK,
 
   Opts.DisableLLVMOpts = Args.hasArg(OPT_disable_llvm_optzns);
   Opts.DisableRedZone = Args.hasArg(OPT_disable_red_zone);
+  Opts.SharedLinkonceRecordFile =
+    Args.getLastArgValue(OPT_fshared_linkonce_record_EQ);
+  Opts.SharedLinkonceEmitFile = Args.getLastArgValue(OPT_fshared_linkonce_emit_EQ);
+  int CodeGenPartitions =
+    Args.getLastArgIntValue(OPT_codegen_partitions, 1, Diags);
+  Opts.CodeGenPartitions = CodeGenPartitions > 1 ? CodeGenPartitions : 1;
   Opts.ForbidGuardVariables = Args.hasArg(OPT_fforbid_guard_variables);
   Opts.UseRegisterSizedBitfieldAccess = Args.hasArg(
     OPT_fuse_register_sized_bitfield_access);
@@ -718,6 +724,8 @@ static InputKind ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
   Opts.ShowHelp = Args.hasArg(OPT_help);
   Opts.ShowStats = Args.hasArg(OPT_print_stats);
   Opts.ShowTimers = Args.hasArg(OPT_ftime_report);
+  Opts.TimeTrace = Args.hasArg(OPT_ftime_trace);
+  Opts.TemplateStats = Args.hasArg(OPT_ftemplate_stats);
   Opts.ShowVersion = Args.hasArg(OPT_version);
   Opts.ASTMergeFiles = Args.getAllArgValues(OPT_ast_merge);
   Opts.LLVMArgs = Args.getAllArgValues(OPT_mllvm);
@@ -134,6 +134,10 @@ private:
   /// \brief End a DIAG block.
   void ExitDiagBlock();
 
+  /// \brief Write what has been serialized so far to the output stream, if
+  /// enough of it has accumulated. No block may be open.
+  void FlushBatch();
+
   /// \brief Emit a DIAG record.
   void EmitDiagnosticMessage(SourceLocation Loc,
                              PresumedLoc PLoc,
@@ -531,6 +535,7 @@ void SDiagsWriter::HandleDiagnostic(DiagnosticsEngine::Level DiagLevel,
     if (State->EmittedAnyDiagBlocks)
       ExitDiagBlock();
 
+    FlushBatch();
     EnterDiagBlock();
     State->EmittedAnyDiagBlocks = true;
   }
@@ -620,6 +625,22 @@ void SDiagsWriter::ExitDiagBlock() {
   State->Stream.ExitBlock();
 }
 
+/// \brief The amount of serialized diagnostics to accumulate before writing
+/// them out, so that a build with very many diagnostics doesn't keep them
+/// all in memory and readers of the file see them as they come.
+static const unsigned DiagnosticBatchSize = 16 * 1024;
+
+void SDiagsWriter::FlushBatch() {
+  // Between blocks, the bitstream writer doesn't need to backpatch anything
+  // it has written, so it can all go out.
+  if (State->Buffer.size() < DiagnosticBatchSize || !State->OS)
+    return;
+
+  State->OS->write(State->Buffer.data(), State->Buffer.size());
+  State->OS->flush();
+  State->Buffer.clear();
+}
+
 void SDiagsRenderer::beginDiagnostic(DiagOrStoredDiag D,
                                      DiagnosticsEngine::Level Level) {
   if (Level == DiagnosticsEngine::Note)
@@ -688,8 +709,8 @@ void SDiagsWriter::finish() {
   if (State->EmittedAnyDiagBlocks)
     ExitDiagBlock();
 
-  // Write the generated bitstream to "Out".
-  State->OS->write((char *)&State->Buffer.front(), State->Buffer.size());
+  // Write the rest of the generated bitstream to "Out".
+  State->OS->write(State->Buffer.data(), State->Buffer.size());
   State->OS->flush();
 
   State->OS.reset(0);
@@ -668,7 +668,7 @@ static bool printWordWrapped(raw_ostream &OS, StringRef Str,
 TextDiagnostic::TextDiagnostic(raw_ostream &OS,
                                const LangOptions &LangOpts,
                                DiagnosticOptions *DiagOpts)
-  : DiagnosticRenderer(LangOpts, DiagOpts), OS(OS) {}
+  : DiagnosticRenderer(LangOpts, DiagOpts), OS(OS), SnippetLinesSM(0) {}
 
 TextDiagnostic::~TextDiagnostic() {}
 
@@ -1091,26 +1091,49 @@ void TextDiagnostic::emitSnippetAndCaret(
   if (Invalid)
     return;
 
-  unsigned LineNo = SM.getLineNumber(FID, FileOffset);
-  unsigned ColNo = SM.getColumnNumber(FID, FileOffset);
-  
+  if (&SM != SnippetLinesSM) {
+    SnippetLines.clear();
+    SnippetLinesSM = &SM;
+  }
+
   // Arbitrarily stop showing snippets when the line is too long.
   static const ptrdiff_t MaxLineLengthToPrint = 4096;
-  if (ColNo > MaxLineLengthToPrint)
-    return;
 
-  // Rewind from the current position to the start of the line.
-  const char *TokPtr = BufStart+FileOffset;
-  const char *LineStart = TokPtr-ColNo+1; // Column # is 1-based.
+  unsigned LineNo, ColNo;
+  const char *LineStart, *LineEnd;
+  llvm::DenseMap<FileID, SnippetLine>::iterator Cached = SnippetLines.find(FID);
+  if (Cached != SnippetLines.end() && FileOffset >= Cached->second.Start &&
+      FileOffset <= Cached->second.End) {
+    // Same line as the last snippet from this file.
+    LineNo = Cached->second.LineNo;
+    ColNo = FileOffset - Cached->second.Start + 1;
+    LineStart = BufStart + Cached->second.Start;
+    LineEnd = BufStart + Cached->second.End;
+  } else {
+    LineNo = SM.getLineNumber(FID, FileOffset);
+    ColNo = SM.getColumnNumber(FID, FileOffset);
+    if (ColNo > MaxLineLengthToPrint)
+      return;
+
+    // Rewind from the current position to the start of the line.
+    const char *TokPtr = BufStart+FileOffset;
+    LineStart = TokPtr-ColNo+1; // Column # is 1-based.
 
-  // Compute the line end.  Scan forward from the error position to the end of
-  // the line.
-  const char *LineEnd = TokPtr;
-  while (*LineEnd != '\n' && *LineEnd != '\r' && *LineEnd != '\0')
-    ++LineEnd;
+    // Compute the line end.  Scan forward from the error position to the end
+    // of the line.
+    LineEnd = TokPtr;
+    while (*LineEnd != '\n' && *LineEnd != '\r' && *LineEnd != '\0')
+      ++LineEnd;
+
+    SnippetLine &Line = SnippetLines[FID];
+    Line.LineNo = LineNo;
+    Line.Start = LineStart - BufStart;
+    Line.End = LineEnd - BufStart;
+  }
 
   // Arbitrarily stop showing snippets when the line is too long.
-  if (LineEnd - LineStart > MaxLineLengthToPrint)
+  if (ColNo > MaxLineLengthToPrint ||
+      LineEnd - LineStart > MaxLineLengthToPrint)
     return;
 
   // Copy the line of code into an std::string for ease of manipulation.
@@ -15,6 +15,7 @@
 #include "clang/Lex/LexDiagnostic.h"
 #include "clang/Lex/MacroInfo.h"
 #include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/SaveAndRestore.h"
 #include <algorithm>
@@ -142,6 +143,38 @@ bool MacroArgs::ArgNeedsPreexpansion(const Token *ArgTok,
   return false;
 }
 
+/// appendToKey - Append the raw bytes of \p Value to the cache key \p Key.
+template <typename T>
+static void appendToKey(SmallVectorImpl<char> &Key, T Value) {
+  const char *Bytes = reinterpret_cast<const char *>(&Value);
+  Key.append(Bytes, Bytes + sizeof(T));
+}
+
+/// getPreExpansionKey - Compute the key under which the pre-expanded form of
+/// the specified argument is remembered, or return false if it must not be
+/// remembered.
+static bool getPreExpansionKey(const Token *ArgToks, Preprocessor &PP,
+                               SmallVectorImpl<char> &Key) {
+  // Which macros are expanded in the argument depends on which are disabled.
+  SmallVector<const MacroInfo *, 8> Disabled;
+  PP.getDisabledMacros(Disabled);
+  appendToKey(Key, Disabled.size());
+  for (unsigned i = 0, e = Disabled.size(); i != e; ++i)
+    appendToKey(Key, Disabled[i]);
+
+  SourceManager &SM = PP.getSourceManager();
+  for (; ArgToks->isNot(tok::eof); ++ArgToks) {
+    const Token &Tok = *ArgToks;
+    if (Tok.is(tok::code_completion) || Tok.isAnnotation())
+      return false;
+    appendToKey(Key, SM.getSpellingLoc(Tok.getLocation()).getRawEncoding());
+    appendToKey(Key, Tok.getLength());
+    appendToKey(Key, static_cast<unsigned short>(Tok.getKind()));
+    appendToKey(Key, static_cast<unsigned char>(Tok.getFlags()));
+  }
+  return true;
+}
+
 /// getPreExpArgument - Return the pre-expanded form of the specified
 /// argument.
 const std::vector<Token> &
@@ -161,6 +194,44 @@ MacroArgs::getPreExpArgument(unsigned Arg, const MacroInfo *MI,
   const Token *AT = getUnexpArgument(Arg);
   unsigned NumToks = getArgLength(AT)+1;  // Include the EOF.
 
+  // X-macros and preprocessor metaprogramming libraries expand the same
+  // argument tokens over and over.  If these were pre-expanded before, in the
+  // same state, reuse that expansion, with the locations of tokens that came
+  // from the argument mapped to this argument.  A token that was expanded from
+  // a macro invocation in the argument gets a location as if that invocation
+  // expanded to it directly; the macros expanded in between don't show up in
+  // its expansion history.  Since no macro is expanded, no PPCallbacks would
+  // be called; when there are any, always expand.
+  SmallString<128> Key;
+  bool Remember = !PP.getPPCallbacks() && getPreExpansionKey(AT, PP, Key);
+  if (Remember) {
+    llvm::StringMap<std::vector<Preprocessor::PreExpandedToken> >::iterator
+      Known = PP.PreExpArgCache.find(Key);
+    if (Known != PP.PreExpArgCache.end()) {
+      SourceManager &SM = PP.getSourceManager();
+      const std::vector<Preprocessor::PreExpandedToken> &Toks =
+        Known->getValue();
+      Result.reserve(Toks.size());
+      for (unsigned i = 0, e = Toks.size(); i != e; ++i) {
+        Result.push_back(Toks[i].Tok);
+        Token &Tok = Result.back();
+        if (Toks[i].Last == ~0U)
+          Tok.setLocation(AT[Toks[i].First].getLocation());
+        else
+          Tok.setLocation(SM.createExpansionLoc(Tok.getLocation(),
+                                          AT[Toks[i].First].getLocation(),
+                                          AT[Toks[i].Last].getLocation(),
+                                          Tok.getLength()));
+      }
+      ++PP.NumPreExpArgHits;
+      return Result;
+    }
+    ++PP.NumPreExpArgMisses;
+  }
+  unsigned StartOffset = PP.getSourceManager().getNextLocalOffset();
+  unsigned NumDiagnostics = PP.NumDiagnostics;
+  unsigned NumBuiltinMacroExpanded = PP.NumBuiltinMacroExpanded;
+
   // Otherwise, we have to pre-expand this argument, populating Result.  To do
   // this, we set up a fake TokenLexer to lex from the unexpanded argument
   // list.  With this installed, we lex expanded tokens until we hit the EOF
@@ -183,9 +254,89 @@ MacroArgs::getPreExpArgument(unsigned Arg, const MacroInfo *MI,
   if (PP.InCachingLexMode())
     PP.ExitCachingLexMode();
   PP.RemoveTopOfLexerStack();
+
+  // Builtin macros like __LINE__ and __COUNTER__ expand differently each
+  // time, and diagnostics have to be issued again.
+  if (Remember && PP.NumDiagnostics == NumDiagnostics &&
+      PP.NumBuiltinMacroExpanded == NumBuiltinMacroExpanded)
+    rememberPreExpansion(AT, NumToks, Result, StartOffset, Key, PP);
   return Result;
 }
 
+/// rememberPreExpansion - Remember the pre-expanded form \p Expanded of the
+/// argument \p ArgToks under \p Key, with where its tokens came from in terms
+/// of the indices of the argument tokens.  Tokens expanded from a macro
+/// invocation in the argument are remembered with their spelling location.
+/// Nothing is remembered if a token can't be traced back to the argument.
+void MacroArgs::rememberPreExpansion(const Token *ArgToks, unsigned NumToks,
+                                     const std::vector<Token> &Expanded,
+                                     unsigned StartOffset, StringRef Key,
+                                     Preprocessor &PP) {
+  llvm::DenseMap<unsigned, unsigned> ArgIndex;
+  for (unsigned i = 0; i != NumToks; ++i)
+    if (!ArgIndex.insert(std::make_pair(ArgToks[i].getLocation()
+                                          .getRawEncoding(), i)).second)
+      return;
+
+  SourceManager &SM = PP.getSourceManager();
+  std::vector<Preprocessor::PreExpandedToken> Toks(Expanded.size());
+  for (unsigned i = 0, e = Expanded.size(); i != e; ++i) {
+    Preprocessor::PreExpandedToken &Tok = Toks[i];
+    Tok.Tok = Expanded[i];
+    SourceLocation Loc = Tok.Tok.getLocation();
+    llvm::DenseMap<unsigned, unsigned>::iterator Known =
+      ArgIndex.find(Loc.getRawEncoding());
+    if (Known != ArgIndex.end()) {
+      Tok.First = Known->second;
+      Tok.Last = ~0U;
+      continue;
+    }
+
+    // Walk up the expansions this token went through, which were all made
+    // while pre-expanding, until one was invoked by argument tokens.
+    for (;;) {
+      if (!Loc.isMacroID() || SM.isBeforeInSLocAddrSpace(Loc, StartOffset))
+        return;
+      std::pair<SourceLocation, SourceLocation> Range =
+        SM.getImmediateExpansionRange(Loc);
+      Known = ArgIndex.find(Range.first.getRawEncoding());
+      if (Known != ArgIndex.end()) {
+        llvm::DenseMap<unsigned, unsigned>::iterator End =
+          ArgIndex.find(Range.second.getRawEncoding());
+        if (End == ArgIndex.end())
+          return;
+        Tok.First = Known->second;
+        Tok.Last = End->second;
+        break;
+      }
+      Loc = Range.first;
+    }
+    Tok.Tok.setLocation(SM.getSpellingLoc(Tok.Tok.getLocation()));
+  }
+  PP.PreExpArgCache[Key].swap(Toks);
+}
+
+
+/// getStringifyKey - Compute the key under which the stringified form of the
+/// specified argument is remembered, or return false if it must not be
+/// remembered.
+static bool getStringifyKey(const Token *ArgToks, Preprocessor &PP,
+                            SmallVectorImpl<char> &Key) {
+  SourceManager &SM = PP.getSourceManager();
+  for (bool isFirst = true; ArgToks->isNot(tok::eof); ++ArgToks) {
+    const Token &Tok = *ArgToks;
+    // Stringifying a code completion token has to notify the code completer.
+    if (Tok.is(tok::code_completion))
+      return false;
+    appendToKey(Key, SM.getSpellingLoc(Tok.getLocation()).getRawEncoding());
+    appendToKey(Key, Tok.getLength());
+    appendToKey(Key, static_cast<unsigned short>(Tok.getKind()));
+    appendToKey(Key, !isFirst && (Tok.hasLeadingSpace() ||
+                                  Tok.isAtStartOfLine()));
+    isFirst = false;
+  }
+  return true;
+}
 
 /// StringifyArgument - Implement C99 6.10.3.2p2, converting a sequence of
 /// tokens into the literal string token that should be produced by the C #
@@ -200,6 +351,30 @@ Token MacroArgs::StringifyArgument(const Token *ArgToks,
   Tok.startToken();
   Tok.setKind(Charify ? tok::char_constant : tok::string_literal);
 
+  // If these tokens have been stringified before, reuse that spelling.
+  // Charified arguments are rare and may need diagnosing, so aren't
+  // remembered.
+  SmallString<64> Key;
+  bool Remember = !Charify && getStringifyKey(ArgToks, PP, Key);
+  if (Remember) {
+    llvm::StringMap<Preprocessor::StringifiedArgument>::iterator Known =
+      PP.StringifyCache.find(Key);
+    if (Known != PP.StringifyCache.end()) {
+      const Preprocessor::StringifiedArgument &Arg = Known->getValue();
+      SourceLocation Loc = Arg.Loc;
+      if (ExpansionLocStart.isValid())
+        Loc = PP.getSourceManager().createExpansionLoc(Loc, ExpansionLocStart,
+                                                       ExpansionLocEnd,
+                                                       Arg.Length);
+      Tok.setLocation(Loc);
+      Tok.setLength(Arg.Length);
+      Tok.setLiteralData(Arg.Data);
+      ++PP.NumStringifiedArgHits;
+      return Tok;
+    }
+    ++PP.NumStringifiedArgMisses;
+  }
+
   const Token *ArgTokStart = ArgToks;
 
   // Stringify all the tokens.
@@ -263,6 +438,8 @@ Token MacroArgs::StringifyArgument(const Token *ArgToks,
       // Diagnose errors for things like: #define F(X) #X   /   F(\)
       PP.Diag(ArgToks[-1], diag::pp_invalid_string_literal);
       Result.pop_back();  // remove one of the \'s.
+      // Diagnose this again if the argument is stringified again.
+      Remember = false;
     }
   }
   Result += '"';
@@ -289,6 +466,13 @@ Token MacroArgs::StringifyArgument(const Token *ArgToks,
 
   PP.CreateString(Result, Tok,
                   ExpansionLocStart, ExpansionLocEnd);
+
+  if (Remember) {
+    Preprocessor::StringifiedArgument &Arg = PP.StringifyCache[Key];
+    Arg.Loc = PP.getSourceManager().getSpellingLoc(Tok.getLocation());
+    Arg.Data = Tok.getLiteralData();
+    Arg.Length = Tok.getLength();
+  }
   return Tok;
 }
 
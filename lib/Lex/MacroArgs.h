@@ -56,6 +56,13 @@ class MacroArgs {
   MacroArgs(unsigned NumToks, bool varargsElided)
     : NumUnexpArgTokens(NumToks), VarargsElided(varargsElided), ArgCache(0) {}
   ~MacroArgs() {}
+
+  /// rememberPreExpansion - Add a pre-expanded argument to the preprocessor's
+  /// cache of them; see getPreExpArgument().
+  static void rememberPreExpansion(const Token *ArgToks, unsigned NumToks,
+                                   const std::vector<Token> &Expanded,
+                                   unsigned StartOffset, StringRef Key,
+                                   Preprocessor &PP);
 public:
   /// MacroArgs ctor function - Create a new MacroArgs object with the specified
   /// macro and argument info.
@@ -15,6 +15,7 @@
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/SourceManager.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Lex/HeaderSearch.h"
 #include "clang/Lex/LexDiagnostic.h"
 #include "clang/Lex/MacroInfo.h"
@@ -76,6 +77,11 @@ void Preprocessor::EnterSourceFile(FileID FID, const DirectoryLookup *CurDir,
   if (MaxIncludeStackDepth < IncludeMacroStack.size())
     MaxIncludeStackDepth = IncludeMacroStack.size();
 
+  // Time the file until HandleEndOfFile() leaves it.
+  if (isTimeTraceProfilerEnabled())
+    timeTraceProfilerBegin("Source", SourceMgr.getBufferName(
+                                       SourceMgr.getLocForStartOfFile(FID)));
+
   if (PTH) {
     if (PTHLexer *PL = PTH->CreateLexer(FID)) {
       EnterSourceFileWithPTH(PL, CurDir);
@@ -91,6 +97,8 @@ void Preprocessor::EnterSourceFile(FileID FID, const DirectoryLookup *CurDir,
     SourceLocation FileStart = SourceMgr.getLocForStartOfFile(FID);
     Diag(Loc, diag::err_pp_error_opening_file)
       << std::string(SourceMgr.getBufferName(FileStart)) << "";
+    if (isTimeTraceProfilerEnabled())
+      timeTraceProfilerEnd();
     return;
   }
 
@@ -238,6 +246,12 @@ bool Preprocessor::HandleEndOfFile(Token &Result, bool isEndOfMacro) {
   assert(!CurTokenLexer &&
          "Ending a file when currently in a macro!");
 
+  // Close the time-trace event opened when EnterSourceFile() entered this
+  // file; _Pragma lexers don't get one.
+  if (isTimeTraceProfilerEnabled() && !isEndOfMacro && CurPPLexer &&
+      !(CurLexer && CurLexer->Is_PragmaLexer))
+    timeTraceProfilerEnd();
+
   // See if this file had a controlling macro.
   if (CurPPLexer) {  // Not ending a macro, ignore it.
     if (const IdentifierInfo *ControllingMacro =
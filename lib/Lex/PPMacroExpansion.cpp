@@ -53,6 +53,22 @@ void Preprocessor::appendMacroDirective(IdentifierInfo *II, MacroDirective *MD){
                          cast<DefMacroDirective>(MD)->isImported();
   if (II->isFromAST() && !isImportedMacro)
     II->setChangedSinceDeserialization();
+
+  // Pre-expanded macro arguments may depend on the old definition.
+  if (!PreExpArgCache.empty())
+    PreExpArgCache.clear();
+}
+
+void Preprocessor::getDisabledMacros(
+                               SmallVectorImpl<const MacroInfo *> &MIs) const {
+  if (CurTokenLexer && CurTokenLexer->Macro &&
+      !CurTokenLexer->Macro->isEnabled())
+    MIs.push_back(CurTokenLexer->Macro);
+  for (unsigned i = IncludeMacroStack.size(); i != 0; --i) {
+    const TokenLexer *TL = IncludeMacroStack[i-1].TheTokenLexer;
+    if (TL && TL->Macro && !TL->Macro->isEnabled())
+      MIs.push_back(TL->Macro);
+  }
 }
 
 void Preprocessor::setLoadedMacroDirective(IdentifierInfo *II,
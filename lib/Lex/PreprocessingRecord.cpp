@@ -63,13 +63,9 @@ PreprocessingRecord::getPreprocessedEntitiesInRange(SourceRange Range) {
   return std::make_pair(iterator(this, Res.first), iterator(this, Res.second));
 }
 
-static bool isPreprocessedEntityIfInFileID(PreprocessedEntity *PPE, FileID FID,
-                                           SourceManager &SM) {
+static bool isEntityLocInFileID(SourceLocation Loc, FileID FID,
+                                SourceManager &SM) {
   assert(!FID.isInvalid());
-  if (!PPE)
-    return false;
-
-  SourceLocation Loc = PPE->getSourceRange().getBegin();
   if (Loc.isInvalid())
     return false;
   
@@ -99,7 +95,8 @@ bool PreprocessingRecord::isEntityInFileID(iterator PPEI, FileID FID) {
     assert(ExternalSource && "No external source to load from");
     unsigned LoadedIndex = LoadedPreprocessedEntities.size()+Pos;
     if (PreprocessedEntity *PPE = LoadedPreprocessedEntities[LoadedIndex])
-      return isPreprocessedEntityIfInFileID(PPE, FID, SourceMgr);
+      return isEntityLocInFileID(PPE->getSourceRange().getBegin(), FID,
+                                 SourceMgr);
 
     // See if the external source can see if the entity is in the file without
     // deserializing it.
@@ -110,17 +107,16 @@ bool PreprocessingRecord::isEntityInFileID(iterator PPEI, FileID FID) {
 
     // The external source did not provide a definite answer, go and deserialize
     // the entity to check it.
-    return isPreprocessedEntityIfInFileID(
-                                       getLoadedPreprocessedEntity(LoadedIndex),
-                                          FID, SourceMgr);
+    PreprocessedEntity *PPE = getLoadedPreprocessedEntity(LoadedIndex);
+    return isEntityLocInFileID(PPE->getSourceRange().getBegin(), FID,
+                               SourceMgr);
   }
 
-  if (unsigned(Pos) >= PreprocessedEntities.size()) {
+  if (unsigned(Pos) >= LocalEntities.size()) {
     assert(0 && "Out-of bounds local preprocessed entity");
     return false;
   }
-  return isPreprocessedEntityIfInFileID(PreprocessedEntities[Pos],
-                                        FID, SourceMgr);
+  return isEntityLocInFileID(LocalEntityBegins[Pos], FID, SourceMgr);
 }
 
 /// \brief Returns a pair of [Begin, End) iterators of preprocessed entities
@@ -169,32 +165,14 @@ PreprocessingRecord::findLocalPreprocessedEntitiesInRange(
 
 namespace {
 
-template <SourceLocation (SourceRange::*getRangeLoc)() const>
-struct PPEntityComp {
+struct PPEntityLocComp {
   const SourceManager &SM;
 
-  explicit PPEntityComp(const SourceManager &SM) : SM(SM) { }
-
-  bool operator()(PreprocessedEntity *L, PreprocessedEntity *R) const {
-    SourceLocation LHS = getLoc(L);
-    SourceLocation RHS = getLoc(R);
-    return SM.isBeforeInTranslationUnit(LHS, RHS);
-  }
-
-  bool operator()(PreprocessedEntity *L, SourceLocation RHS) const {
-    SourceLocation LHS = getLoc(L);
-    return SM.isBeforeInTranslationUnit(LHS, RHS);
-  }
+  explicit PPEntityLocComp(const SourceManager &SM) : SM(SM) { }
 
-  bool operator()(SourceLocation LHS, PreprocessedEntity *R) const {
-    SourceLocation RHS = getLoc(R);
+  bool operator()(SourceLocation LHS, SourceLocation RHS) const {
     return SM.isBeforeInTranslationUnit(LHS, RHS);
   }
-
-  SourceLocation getLoc(PreprocessedEntity *PPE) const {
-    SourceRange Range = PPE->getSourceRange();
-    return (Range.*getRangeLoc)();
-  }
 };
 
 }
@@ -204,11 +182,9 @@ unsigned PreprocessingRecord::findBeginLocalPreprocessedEntity(
   if (SourceMgr.isLoadedSourceLocation(Loc))
     return 0;
 
-  size_t Count = PreprocessedEntities.size();
-  size_t Half;
-  std::vector<PreprocessedEntity *>::const_iterator
-    First = PreprocessedEntities.begin();
-  std::vector<PreprocessedEntity *>::const_iterator I;
+  unsigned Count = LocalEntities.size();
+  unsigned First = 0;
+  unsigned Half;
 
   // Do a binary search manually instead of using std::lower_bound because
   // The end locations of entities may be unordered (when a macro expansion
@@ -216,18 +192,16 @@ unsigned PreprocessingRecord::findBeginLocalPreprocessedEntity(
   // whether we get the first macro expansion or its containing macro.
   while (Count > 0) {
     Half = Count/2;
-    I = First;
-    std::advance(I, Half);
-    if (SourceMgr.isBeforeInTranslationUnit((*I)->getSourceRange().getEnd(),
+    unsigned I = First + Half;
+    if (SourceMgr.isBeforeInTranslationUnit(getLocalEntityRange(I).getEnd(),
                                             Loc)){
-      First = I;
-      ++First;
+      First = I + 1;
       Count = Count - Half - 1;
     } else
       Count = Half;
   }
 
-  return First - PreprocessedEntities.begin();
+  return First;
 }
 
 unsigned PreprocessingRecord::findEndLocalPreprocessedEntity(
@@ -235,36 +209,43 @@ unsigned PreprocessingRecord::findEndLocalPreprocessedEntity(
   if (SourceMgr.isLoadedSourceLocation(Loc))
     return 0;
 
-  std::vector<PreprocessedEntity *>::const_iterator
-  I = std::upper_bound(PreprocessedEntities.begin(),
-                       PreprocessedEntities.end(),
+  std::vector<SourceLocation>::const_iterator
+  I = std::upper_bound(LocalEntityBegins.begin(),
+                       LocalEntityBegins.end(),
                        Loc,
-                       PPEntityComp<&SourceRange::getBegin>(SourceMgr));
-  return I - PreprocessedEntities.begin();
+                       PPEntityLocComp(SourceMgr));
+  return I - LocalEntityBegins.begin();
 }
 
 PreprocessingRecord::PPEntityID
 PreprocessingRecord::addPreprocessedEntity(PreprocessedEntity *Entity) {
   assert(Entity);
-  SourceLocation BeginLoc = Entity->getSourceRange().getBegin();
-
-  if (isa<MacroDefinition>(Entity)) {
-    assert((PreprocessedEntities.empty() ||
-            !SourceMgr.isBeforeInTranslationUnit(BeginLoc,
-                   PreprocessedEntities.back()->getSourceRange().getBegin())) &&
-           "a macro definition was encountered out-of-order");
-    PreprocessedEntities.push_back(Entity);
-    return getPPEntityID(PreprocessedEntities.size()-1, /*isLoaded=*/false);
-  }
+  return addLocalEntity(Entity->getSourceRange(),
+                        LocalEntityRef(Entity, LEK_Entity));
+}
+
+PreprocessingRecord::PPEntityID
+PreprocessingRecord::addLocalEntity(SourceRange Range, LocalEntityRef Ref) {
+  SourceLocation BeginLoc = Range.getBegin();
+  unsigned EndOffset = Range.getEnd().getRawEncoding() -
+                       BeginLoc.getRawEncoding();
 
   // Check normal case, this entity begin location is after the previous one.
-  if (PreprocessedEntities.empty() ||
+  // Macro definitions are always in order.
+  if (LocalEntities.empty() ||
       !SourceMgr.isBeforeInTranslationUnit(BeginLoc,
-                   PreprocessedEntities.back()->getSourceRange().getBegin())) {
-    PreprocessedEntities.push_back(Entity);
-    return getPPEntityID(PreprocessedEntities.size()-1, /*isLoaded=*/false);
+                                           LocalEntityBegins.back())) {
+    LocalEntityBegins.push_back(BeginLoc);
+    LocalEntityEndOffsets.push_back(EndOffset);
+    LocalEntities.push_back(Ref);
+    return getPPEntityID(LocalEntities.size()-1, /*isLoaded=*/false);
   }
 
+  assert((Ref.getInt() != LEK_Entity ||
+          !isa<MacroDefinition>(static_cast<PreprocessedEntity *>(
+                                                      Ref.getPointer()))) &&
+         "a macro definition was encountered out-of-order");
+
   // The entity's location is not after the previous one; this can happen with
   // include directives that form the filename using macros, e.g:
   // "#include MACRO(STUFF)"
@@ -277,32 +258,29 @@ PreprocessingRecord::addPreprocessedEntity(PreprocessedEntity *Entity) {
   //  FM(M1, M2)
   // \endcode
 
-  typedef std::vector<PreprocessedEntity *>::iterator pp_iter;
-
   // Usually there are few macro expansions when defining the filename, do a
   // linear search for a few entities.
+  unsigned Insert = LocalEntities.size();
   unsigned count = 0;
-  for (pp_iter RI    = PreprocessedEntities.end(),
-               Begin = PreprocessedEntities.begin();
-       RI != Begin && count < 4; --RI, ++count) {
-    pp_iter I = RI;
-    --I;
+  for (; Insert != 0 && count < 4; --Insert, ++count) {
     if (!SourceMgr.isBeforeInTranslationUnit(BeginLoc,
-                                           (*I)->getSourceRange().getBegin())) {
-      pp_iter insertI = PreprocessedEntities.insert(RI, Entity);
-      return getPPEntityID(insertI - PreprocessedEntities.begin(),
-                           /*isLoaded=*/false);
-    }
+                                             LocalEntityBegins[Insert-1]))
+      break;
   }
 
   // Linear search unsuccessful. Do a binary search.
-  pp_iter I = std::upper_bound(PreprocessedEntities.begin(),
-                               PreprocessedEntities.end(),
-                               BeginLoc,
-                               PPEntityComp<&SourceRange::getBegin>(SourceMgr));
-  pp_iter insertI = PreprocessedEntities.insert(I, Entity);
-  return getPPEntityID(insertI - PreprocessedEntities.begin(),
-                       /*isLoaded=*/false);
+  if (Insert != 0 && count == 4)
+    Insert = std::upper_bound(LocalEntityBegins.begin(),
+                              LocalEntityBegins.end(),
+                              BeginLoc,
+                              PPEntityLocComp(SourceMgr))
+             - LocalEntityBegins.begin();
+
+  LocalEntityBegins.insert(LocalEntityBegins.begin() + Insert, BeginLoc);
+  LocalEntityEndOffsets.insert(LocalEntityEndOffsets.begin() + Insert,
+                               EndOffset);
+  LocalEntities.insert(LocalEntities.begin() + Insert, Ref);
+  return getPPEntityID(Insert, /*isLoaded=*/false);
 }
 
 void PreprocessingRecord::SetExternalSource(
@@ -335,10 +313,61 @@ PreprocessedEntity *PreprocessingRecord::getPreprocessedEntity(PPEntityID PPID){
 
   if (PPID.ID == 0)
     return 0;
-  unsigned Index = PPID.ID - 1;
-  assert(Index < PreprocessedEntities.size() &&
+  return getLocalPreprocessedEntity(PPID.ID - 1);
+}
+
+/// \brief Retrieve the local preprocessed entity at the given index.
+PreprocessedEntity *
+PreprocessingRecord::getLocalPreprocessedEntity(unsigned Index) {
+  assert(Index < LocalEntities.size() &&
+         "Out-of bounds local preprocessed entity");
+  LocalEntityRef &Ref = LocalEntities[Index];
+  PreprocessedEntity *Entity = 0;
+  switch (Ref.getInt()) {
+  case LEK_Entity:
+    return static_cast<PreprocessedEntity *>(Ref.getPointer());
+  case LEK_MacroExpansion:
+    Entity = new (*this) MacroExpansion(
+                          static_cast<MacroDefinition *>(Ref.getPointer()),
+                          getLocalEntityRange(Index));
+    break;
+  case LEK_BuiltinMacroExpansion:
+    Entity = new (*this) MacroExpansion(
+                          static_cast<IdentifierInfo *>(Ref.getPointer()),
+                          getLocalEntityRange(Index));
+    break;
+  }
+  Ref = LocalEntityRef(Entity, LEK_Entity);
+  return Entity;
+}
+
+bool PreprocessingRecord::getLocalMacroExpansion(unsigned Index,
+                                       MacroDefinition *&Def,
+                                       const IdentifierInfo *&BuiltinName) const {
+  assert(Index < LocalEntities.size() &&
          "Out-of bounds local preprocessed entity");
-  return PreprocessedEntities[Index];
+  LocalEntityRef Ref = LocalEntities[Index];
+  Def = 0;
+  BuiltinName = 0;
+  switch (Ref.getInt()) {
+  case LEK_Entity:
+    if (MacroExpansion *ME = dyn_cast<MacroExpansion>(
+                        static_cast<PreprocessedEntity *>(Ref.getPointer()))) {
+      if (ME->isBuiltinMacro())
+        BuiltinName = ME->getName();
+      else
+        Def = ME->getDefinition();
+      return true;
+    }
+    return false;
+  case LEK_MacroExpansion:
+    Def = static_cast<MacroDefinition *>(Ref.getPointer());
+    return true;
+  case LEK_BuiltinMacroExpansion:
+    BuiltinName = static_cast<IdentifierInfo *>(Ref.getPointer());
+    return true;
+  }
+  llvm_unreachable("Invalid LocalEntityKind!");
 }
 
 /// \brief Retrieve the loaded preprocessed entity at the given index.
@@ -373,12 +402,12 @@ void PreprocessingRecord::addMacroExpansion(const Token &Id,
   if (Id.getLocation().isMacroID())
     return;
 
+  // Expansions are only allocated when a client asks for them.
   if (MI->isBuiltinMacro())
-    addPreprocessedEntity(
-                      new (*this) MacroExpansion(Id.getIdentifierInfo(),Range));
+    addLocalEntity(Range, LocalEntityRef(Id.getIdentifierInfo(),
+                                         LEK_BuiltinMacroExpansion));
   else if (MacroDefinition *Def = findMacroDefinition(MI))
-    addPreprocessedEntity(
-                       new (*this) MacroExpansion(Def, Range));
+    addLocalEntity(Range, LocalEntityRef(Def, LEK_MacroExpansion));
 }
 
 void PreprocessingRecord::Ifdef(SourceLocation Loc, const Token &MacroNameTok,
@@ -479,6 +508,8 @@ void PreprocessingRecord::InclusionDirective(
 size_t PreprocessingRecord::getTotalMemory() const {
   return BumpAlloc.getTotalMemory()
     + llvm::capacity_in_bytes(MacroDefinitions)
-    + llvm::capacity_in_bytes(PreprocessedEntities)
+    + llvm::capacity_in_bytes(LocalEntityBegins)
+    + llvm::capacity_in_bytes(LocalEntityEndOffsets)
+    + llvm::capacity_in_bytes(LocalEntities)
     + llvm::capacity_in_bytes(LoadedPreprocessedEntities);
 }
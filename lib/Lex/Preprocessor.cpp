@@ -81,6 +81,9 @@ Preprocessor::Preprocessor(IntrusiveRefCntPtr<PreprocessorOptions> PPOpts,
   NumFastMacroExpanded = NumTokenPaste = NumFastTokenPaste = 0;
   MaxIncludeStackDepth = 0;
   NumSkipped = 0;
+  NumStringifiedArgHits = NumStringifiedArgMisses = 0;
+  NumPreExpArgHits = NumPreExpArgMisses = 0;
+  NumDiagnostics = 0;
   
   // Default to discarding comments.
   KeepComments = false;
@@ -242,6 +245,12 @@ void Preprocessor::PrintStats() {
   llvm::errs() << (NumFastTokenPaste+NumTokenPaste)
              << " token paste (##) operations performed, "
              << NumFastTokenPaste << " on the fast path.\n";
+  llvm::errs() << (NumStringifiedArgHits+NumStringifiedArgMisses)
+             << " macro arguments stringified, " << NumStringifiedArgHits
+             << " reusing an earlier spelling.\n";
+  llvm::errs() << (NumPreExpArgHits+NumPreExpArgMisses)
+             << " macro arguments pre-expanded, " << NumPreExpArgHits
+             << " reusing an earlier expansion.\n";
 
   llvm::errs() << "\nPreprocessor Memory: " << getTotalMemory() << "B total";
 
@@ -114,6 +114,41 @@ void RewriteBuffer::ReplaceText(unsigned OrigOffset, unsigned OrigLength,
     AddReplaceDelta(OrigOffset, NewStr.size() - OrigLength);
 }
 
+void RewriteBuffer::ReplaceTexts(ArrayRef<Edit> Edits) {
+  if (Edits.empty())
+    return;
+
+  // Map every edit into the current buffer before adding any delta, so that
+  // each one lands where ReplaceText would have put it on its own.
+  std::string Result;
+  Result.reserve(size());
+  iterator Pos = begin();
+  unsigned PosOffset = 0;
+  for (unsigned i = 0, e = Edits.size(); i != e; ++i) {
+    const Edit &E = Edits[i];
+    assert((i == 0 ||
+            E.OrigOffset >= Edits[i-1].OrigOffset + Edits[i-1].OrigLength) &&
+           "Edits are not sorted, or overlap");
+    unsigned RealOffset = getMappedOffset(E.OrigOffset, true);
+    assert(RealOffset >= PosOffset && RealOffset + E.OrigLength <= size() &&
+           "Invalid location");
+    for (; PosOffset != RealOffset; ++PosOffset, ++Pos)
+      Result += *Pos;
+    Result.append(E.NewStr.begin(), E.NewStr.end());
+    for (unsigned n = E.OrigLength; n != 0; --n)
+      ++Pos;
+    PosOffset += E.OrigLength;
+  }
+  Result.append(Pos, end());
+
+  Buffer.assign(Result.data(), Result.data() + Result.size());
+  for (unsigned i = 0, e = Edits.size(); i != e; ++i) {
+    const Edit &E = Edits[i];
+    if (E.OrigLength != E.NewStr.size())
+      AddReplaceDelta(E.OrigOffset, E.NewStr.size() - E.OrigLength);
+  }
+}
+
 
 //===----------------------------------------------------------------------===//
 // Rewriter class
@@ -33,6 +33,7 @@
 #include "clang/Analysis/CFGStmtMap.h"
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/SourceManager.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Lex/Lexer.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Sema/ScopeInfo.h"
@@ -1425,6 +1426,7 @@ clang::sema::AnalysisBasedWarnings::Policy::Policy() {
 
 clang::sema::AnalysisBasedWarnings::AnalysisBasedWarnings(Sema &s)
   : S(s),
+    ThreadSafetyCache(0),
     NumFunctionsAnalyzed(0),
     NumFunctionsWithBadCFGs(0),
     NumCFGBlocks(0),
@@ -1444,6 +1446,10 @@ clang::sema::AnalysisBasedWarnings::AnalysisBasedWarnings(Sema &s)
 
 }
 
+clang::sema::AnalysisBasedWarnings::~AnalysisBasedWarnings() {
+  thread_safety::threadSafetyCleanup(ThreadSafetyCache);
+}
+
 static void flushDiagnostics(Sema &S, sema::FunctionScopeInfo *fscope) {
   for (SmallVectorImpl<sema::PossiblyUnreachableDiag>::iterator
        i = fscope->PossiblyUnreachableDiags.begin(),
@@ -1482,7 +1488,9 @@ AnalysisBasedWarnings::IssueWarnings(sema::AnalysisBasedWarnings::Policy P,
     flushDiagnostics(S, fscope);
     return;
   }
-  
+
+  TimeTraceScope TimeScope("AnalysisBasedWarnings");
+
   const Stmt *Body = D->getBody();
   assert(Body);
 
@@ -1602,7 +1610,7 @@ AnalysisBasedWarnings::IssueWarnings(sema::AnalysisBasedWarnings::Policy P,
         != DiagnosticsEngine::Ignored)
       Reporter.setIssueBetaWarnings(true);
 
-    thread_safety::runThreadSafetyAnalysis(AC, Reporter);
+    thread_safety::runThreadSafetyAnalysis(AC, Reporter, &ThreadSafetyCache);
     Reporter.emitDiagnostics();
   }
 
@@ -36,6 +36,7 @@
 #include "clang/Sema/Scope.h"
 #include "clang/Sema/ScopeInfo.h"
 #include "clang/Sema/SemaConsumer.h"
+#include "clang/Sema/Template.h"
 #include "clang/Sema/TemplateDeduction.h"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/DenseMap.h"
@@ -86,7 +87,8 @@ Sema::Sema(Preprocessor &pp, ASTContext &ctxt, ASTConsumer &consumer,
     NSDictionaryDecl(0), DictionaryWithObjectsMethod(0),
     GlobalNewDeleteDeclared(false),
     TUKind(TUKind),
-    NumSFINAEErrors(0), InFunctionDeclarator(0),
+    NumSFINAEErrors(0), NumConversionSequenceLookups(0),
+    NumConversionSequenceHits(0), InFunctionDeclarator(0),
     AccessCheckingSFINAE(false), InNonInstantiationSFINAEContext(false),
     NonInstantiationEntries(0), ArgumentPackSubstitutionIndex(-1),
     CurrentInstantiationScope(0), TyposCorrected(0),
@@ -251,6 +253,12 @@ void Sema::addExternalSource(ExternalSemaSource *E) {
 void Sema::PrintStats() const {
   llvm::errs() << "\n*** Semantic Analysis Stats:\n";
   llvm::errs() << NumSFINAEErrors << " SFINAE diagnostics trapped.\n";
+  llvm::errs() << NumConversionSequenceHits << "/"
+               << NumConversionSequenceLookups
+               << " overload candidate conversion sequences reused.\n";
+  if (SubstTypes)
+    llvm::errs() << SubstTypes->NumHits << "/" << SubstTypes->NumLookups
+                 << " type substitutions reused from the cache.\n";
 
   BumpAlloc.PrintStats();
   AnalysisWarnings.PrintStats();
@@ -789,6 +789,7 @@ void OverloadCandidateSet::clear() {
   NumInlineSequences = 0;
   Candidates.clear();
   Functions.clear();
+  Conversions.clear();
 }
 
 namespace {
@@ -4663,6 +4664,36 @@ TryCopyInitialization(Sema &S, Expr *From, QualType ToType,
                                AllowObjCWritebackConversion);
 }
 
+/// \brief Try to copy-initialize a parameter of type \p ToType of an overload
+/// candidate from the argument \p From, reusing the conversion sequence
+/// computed for an earlier candidate in \p CandidateSet with the same
+/// parameter type.
+static ImplicitConversionSequence
+TryCopyInitialization(Sema &S, OverloadCandidateSet &CandidateSet,
+                      Expr *From, QualType ToType,
+                      bool SuppressUserConversions,
+                      bool InOverloadResolution,
+                      bool AllowObjCWritebackConversion,
+                      bool AllowExplicit = false) {
+  OverloadCandidateSet::ConversionKey Key(
+      std::make_pair(From, ToType.getAsOpaquePtr()),
+      SuppressUserConversions | InOverloadResolution << 1 |
+        AllowObjCWritebackConversion << 2 | AllowExplicit << 3);
+  ++S.NumConversionSequenceLookups;
+  if (const ImplicitConversionSequence *Known
+        = CandidateSet.getCachedConversion(Key)) {
+    ++S.NumConversionSequenceHits;
+    return *Known;
+  }
+
+  ImplicitConversionSequence ICS
+    = TryCopyInitialization(S, From, ToType, SuppressUserConversions,
+                            InOverloadResolution, AllowObjCWritebackConversion,
+                            AllowExplicit);
+  CandidateSet.setCachedConversion(Key, ICS);
+  return ICS;
+}
+
 static bool TryCopyInitialization(const CanQualType FromQTy,
                                   const CanQualType ToQTy,
                                   Sema &S,
@@ -5414,7 +5445,7 @@ Sema::AddOverloadCandidate(FunctionDecl *Function,
       // parameter of F.
       QualType ParamType = Proto->getArgType(ArgIdx);
       Candidate.Conversions[ArgIdx]
-        = TryCopyInitialization(*this, Args[ArgIdx], ParamType,
+        = TryCopyInitialization(*this, CandidateSet, Args[ArgIdx], ParamType,
                                 SuppressUserConversions,
                                 /*InOverloadResolution=*/true,
                                 /*AllowObjCWritebackConversion=*/
@@ -5587,7 +5618,7 @@ Sema::AddMethodCandidate(CXXMethodDecl *Method, DeclAccessPair FoundDecl,
       // parameter of F.
       QualType ParamType = Proto->getArgType(ArgIdx);
       Candidate.Conversions[ArgIdx + 1]
-        = TryCopyInitialization(*this, Args[ArgIdx], ParamType,
+        = TryCopyInitialization(*this, CandidateSet, Args[ArgIdx], ParamType,
                                 SuppressUserConversions,
                                 /*InOverloadResolution=*/true,
                                 /*AllowObjCWritebackConversion=*/
@@ -6094,7 +6125,8 @@ void Sema::AddBuiltinCandidate(QualType ResultTy, QualType *ParamTys,
         = TryContextuallyConvertToBool(*this, Args[ArgIdx]);
     } else {
       Candidate.Conversions[ArgIdx]
-        = TryCopyInitialization(*this, Args[ArgIdx], ParamTys[ArgIdx],
+        = TryCopyInitialization(*this, CandidateSet, Args[ArgIdx],
+                                ParamTys[ArgIdx],
                                 ArgIdx == 0 && IsAssignmentOperator,
                                 /*InOverloadResolution=*/false,
                                 /*AllowObjCWritebackConversion=*/
@@ -17,11 +17,16 @@
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/Expr.h"
 #include "clang/Basic/LangOptions.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Sema/DeclSpec.h"
 #include "clang/Sema/Initialization.h"
 #include "clang/Sema/Lookup.h"
 #include "clang/Sema/Template.h"
 #include "clang/Sema/TemplateDeduction.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 
 using namespace clang;
 using namespace sema;
@@ -168,6 +173,182 @@ bool Sema::ActiveTemplateInstantiation::isInstantiationRecord() const {
   llvm_unreachable("Invalid InstantiationKind!");
 }
 
+/// \brief Retrieve the template, member template or member of a class
+/// template from which \p D was instantiated.
+static const Decl *getInstantiatedFromTemplate(const Decl *D) {
+  if (const ClassTemplateSpecializationDecl *Spec
+        = dyn_cast<ClassTemplateSpecializationDecl>(D))
+    return Spec->getSpecializedTemplate();
+  if (const CXXRecordDecl *Record = dyn_cast<CXXRecordDecl>(D)) {
+    if (const CXXRecordDecl *Member = Record->getInstantiatedFromMemberClass())
+      return Member;
+    return D;
+  }
+  if (const FunctionDecl *Function = dyn_cast<FunctionDecl>(D)) {
+    if (const FunctionTemplateDecl *Template = Function->getPrimaryTemplate())
+      return Template;
+    if (const FunctionDecl *Member
+          = Function->getInstantiatedFromMemberFunction())
+      return Member;
+  }
+  return D;
+}
+
+static double getCurrentWallTime() {
+  return llvm::TimeRecord::getCurrentTime(true).getWallTime();
+}
+
+void
+TemplateInstantiationStats::begin(const Sema::ActiveTemplateInstantiation &Inst,
+                                  unsigned Depth) {
+  // Only count actual instantiations, not substitutions and checks.
+  if (Inst.Kind != Sema::ActiveTemplateInstantiation::TemplateInstantiation ||
+      !Inst.Entity) {
+    Stack.push_back(std::make_pair((const Decl *)0, 0.0));
+    return;
+  }
+
+  const Decl *Template = getInstantiatedFromTemplate(Inst.Entity);
+  TemplateInfo &Info = Templates[Template];
+  ++Info.Count;
+  ++Info.Active;
+  Info.MaxDepth = std::max(Info.MaxDepth, Depth);
+  ++NumInstantiations;
+  MaxDepth = std::max(MaxDepth, Depth);
+  Stack.push_back(std::make_pair(Template, getCurrentWallTime()));
+}
+
+void TemplateInstantiationStats::end() {
+  assert(!Stack.empty() && "Unbalanced template instantiation stats");
+  std::pair<const Decl *, double> Top = Stack.pop_back_val();
+  if (!Top.first)
+    return;
+
+  // Recursive instantiations of a template are only timed once.
+  TemplateInfo &Info = Templates[Top.first];
+  if (--Info.Active == 0)
+    Info.Time += getCurrentWallTime() - Top.second;
+}
+
+namespace {
+typedef std::pair<const Decl *, TemplateInstantiationStats::TemplateInfo>
+  TemplateStatsEntry;
+
+struct OrderByInstantiationTime {
+  bool operator()(const TemplateStatsEntry &X,
+                  const TemplateStatsEntry &Y) const {
+    return X.second.Time > Y.second.Time;
+  }
+};
+
+struct OrderByInstantiationCount {
+  bool operator()(const TemplateStatsEntry &X,
+                  const TemplateStatsEntry &Y) const {
+    return X.second.Count > Y.second.Count;
+  }
+};
+} // end anonymous namespace
+
+/// \brief The number of templates listed in each table of the
+/// -ftemplate-stats report.
+static const unsigned NumTemplateStatsListed = 20;
+
+static void printTemplateStatsTable(raw_ostream &OS, StringRef Title,
+                                    ArrayRef<TemplateStatsEntry> Entries) {
+  OS << "\n" << Title << ":\n";
+  OS << "   Time (ms)     Count  Depth  Template\n";
+  for (unsigned I = 0,
+                N = std::min<size_t>(Entries.size(), NumTemplateStatsListed);
+       I != N; ++I) {
+    const TemplateInstantiationStats::TemplateInfo &Info = Entries[I].second;
+    OS << llvm::format("%12.3f  %8u  %5u  ", Info.Time * 1000, Info.Count,
+                       Info.MaxDepth);
+    if (const NamedDecl *ND = dyn_cast<NamedDecl>(Entries[I].first))
+      OS << ND->getQualifiedNameAsString();
+    else
+      OS << "<unnamed " << Entries[I].first->getDeclKindName() << ">";
+    OS << "\n";
+  }
+}
+
+void Sema::enableTemplateStats() {
+  if (!TemplateStats)
+    TemplateStats.reset(new TemplateInstantiationStats());
+}
+
+void Sema::PrintTemplateStats() const {
+  if (!TemplateStats)
+    return;
+
+  raw_ostream &OS = llvm::errs();
+  OS << "\n*** Template Instantiation Stats:\n";
+  OS << TemplateStats->NumInstantiations << " instantiations of "
+     << TemplateStats->Templates.size() << " templates, maximum depth "
+     << TemplateStats->MaxDepth << ".\n";
+  if (SubstTypes)
+    OS << SubstTypes->NumHits << "/" << SubstTypes->NumLookups
+       << " type substitutions reused (" << SubstTypes->size()
+       << " memoized).\n";
+
+  SmallVector<TemplateStatsEntry, 64> Entries(TemplateStats->Templates.begin(),
+                                              TemplateStats->Templates.end());
+  std::stable_sort(Entries.begin(), Entries.end(), OrderByInstantiationTime());
+  printTemplateStatsTable(OS, "Templates by instantiation time", Entries);
+  std::stable_sort(Entries.begin(), Entries.end(),
+                   OrderByInstantiationCount());
+  printTemplateStatsTable(OS, "Templates by instantiation count", Entries);
+}
+
+/// \brief Open a time-trace event for an instantiation that was just pushed
+/// onto the stack of active instantiations; \c Clear() closes it.
+static void
+beginInstantiationTrace(const Sema::ActiveTemplateInstantiation &Inst) {
+  if (!isTimeTraceProfilerEnabled())
+    return;
+
+  const char *Name = "InstantiateTemplate";
+  switch (Inst.Kind) {
+  case Sema::ActiveTemplateInstantiation::TemplateInstantiation:
+    if (isa<CXXRecordDecl>(Inst.Entity))
+      Name = "InstantiateClass";
+    else if (isa<FunctionDecl>(Inst.Entity))
+      Name = "InstantiateFunction";
+    break;
+  case Sema::ActiveTemplateInstantiation::DefaultTemplateArgumentInstantiation:
+  case Sema::ActiveTemplateInstantiation::DefaultFunctionArgumentInstantiation:
+    Name = "InstantiateDefaultArgument";
+    break;
+  case Sema::ActiveTemplateInstantiation::ExplicitTemplateArgumentSubstitution:
+  case Sema::ActiveTemplateInstantiation::DeducedTemplateArgumentSubstitution:
+  case Sema::ActiveTemplateInstantiation::PriorTemplateArgumentSubstitution:
+    Name = "SubstituteTemplateArguments";
+    break;
+  case Sema::ActiveTemplateInstantiation::DefaultTemplateArgumentChecking:
+    Name = "CheckDefaultTemplateArgument";
+    break;
+  case Sema::ActiveTemplateInstantiation::ExceptionSpecInstantiation:
+    Name = "InstantiateExceptionSpec";
+    break;
+  }
+
+  std::string Detail;
+  if (const NamedDecl *ND = dyn_cast_or_null<NamedDecl>(Inst.Entity))
+    Detail = ND->getQualifiedNameAsString();
+  timeTraceProfilerBegin(Name, Detail);
+}
+
+/// \brief Record the start of an instantiation that was just pushed onto the
+/// stack of active instantiations; \c Clear() records its end.
+static void
+noteInstantiationBegin(Sema &SemaRef,
+                       const Sema::ActiveTemplateInstantiation &Inst) {
+  if (SemaRef.TemplateStats)
+    SemaRef.TemplateStats->begin(Inst,
+                                 SemaRef.ActiveTemplateInstantiations.size() -
+                                   SemaRef.NonInstantiationEntries);
+  beginInstantiationTrace(Inst);
+}
+
 Sema::InstantiatingTemplate::
 InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
                       Decl *Entity,
@@ -188,6 +369,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    noteInstantiationBegin(SemaRef, Inst);
   }
 }
 
@@ -211,6 +393,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    noteInstantiationBegin(SemaRef, Inst);
   }
 }
 
@@ -236,6 +419,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    noteInstantiationBegin(SemaRef, Inst);
   }
 }
 
@@ -262,6 +446,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    noteInstantiationBegin(SemaRef, Inst);
     
     if (!Inst.isInstantiationRecord())
       ++SemaRef.NonInstantiationEntries;
@@ -290,6 +475,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    noteInstantiationBegin(SemaRef, Inst);
   }
 }
 
@@ -314,6 +500,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    noteInstantiationBegin(SemaRef, Inst);
   }
 }
 
@@ -338,6 +525,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    noteInstantiationBegin(SemaRef, Inst);
   }
 }
 
@@ -362,6 +550,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
     Inst.InstantiationRange = InstantiationRange;
     SemaRef.InNonInstantiationSFINAEContext = false;
     SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+    noteInstantiationBegin(SemaRef, Inst);
   }
 }
 
@@ -386,6 +575,7 @@ InstantiatingTemplate(Sema &SemaRef, SourceLocation PointOfInstantiation,
   Inst.InstantiationRange = InstantiationRange;
   SemaRef.InNonInstantiationSFINAEContext = false;
   SemaRef.ActiveTemplateInstantiations.push_back(Inst);
+  noteInstantiationBegin(SemaRef, Inst);
   
   assert(!Inst.isInstantiationRecord());
   ++SemaRef.NonInstantiationEntries;
@@ -400,6 +590,10 @@ void Sema::InstantiatingTemplate::Clear() {
     SemaRef.InNonInstantiationSFINAEContext
       = SavedInNonInstantiationSFINAEContext;
     SemaRef.ActiveTemplateInstantiations.pop_back();
+    if (SemaRef.TemplateStats)
+      SemaRef.TemplateStats->end();
+    if (isTimeTraceProfilerEnabled())
+      timeTraceProfilerEnd();
     Invalid = true;
   }
 }
@@ -1547,6 +1741,195 @@ TypeSourceInfo *Sema::SubstType(TypeLoc TL,
   return TLB.getTypeSourceInfo(Context, Result);
 }
 
+SubstTypeCache::~SubstTypeCache() {
+  llvm::SmallVector<Entry *, 16> ToDelete;
+  for (llvm::FoldingSet<Entry>::iterator I = Entries.begin(),
+                                         E = Entries.end(); I != E; ++I)
+    ToDelete.push_back(&*I);
+  Entries.clear();
+  for (unsigned I = 0, N = ToDelete.size(); I != N; ++I)
+    delete ToDelete[I];
+}
+
+void SubstTypeCache::Profile(llvm::FoldingSetNodeID &ID, ASTContext &Context,
+                             QualType T,
+                         const MultiLevelTemplateArgumentList &TemplateArgs) {
+  ID.AddPointer(T.getAsOpaquePtr());
+  ID.AddInteger(TemplateArgs.getNumLevels());
+  for (unsigned Depth = 0, N = TemplateArgs.getNumLevels(); Depth != N;
+       ++Depth) {
+    const MultiLevelTemplateArgumentList::ArgList &Level
+      = TemplateArgs.getLevel(Depth);
+    ID.AddInteger(Level.second);
+    for (unsigned I = 0; I != Level.second; ++I)
+      Level.first[I].Profile(ID, Context);
+  }
+}
+
+QualType SubstTypeCache::lookup(const llvm::FoldingSetNodeID &ID) {
+  ++NumLookups;
+  void *InsertPos = 0;
+  Entry *E = Entries.FindNodeOrInsertPos(ID, InsertPos);
+  if (!E)
+    return QualType();
+  ++NumHits;
+  return E->Result;
+}
+
+void SubstTypeCache::insert(const llvm::FoldingSetNodeID &ID,
+                            QualType Result) {
+  void *InsertPos = 0;
+  if (Entries.FindNodeOrInsertPos(ID, InsertPos))
+    return;
+  Entry *E = new Entry(ID);
+  E->Result = Result;
+  Entries.InsertNode(E, InsertPos);
+}
+
+/// \brief Determine whether a declaration named by a type can be referenced
+/// directly from the result of a substitution, rather than being looked up
+/// in the current instantiation.
+static bool isContextIndependentDecl(const Decl *D) {
+  return !D->getDeclContext()->isDependentContext() &&
+         !D->getDeclContext()->isFunctionOrMethod();
+}
+
+/// \brief Determine whether substituting template arguments into \p T
+/// depends only on the template arguments, so that the result can be
+/// memoized.
+///
+/// This rules out anything that involves expressions, name lookup or
+/// declarations local to the template being instantiated, all of which
+/// depend on the current instantiation scope or the access context.
+static bool isSubstitutionMemoizable(QualType T) {
+  switch (T->getTypeClass()) {
+  case Type::Builtin:
+  case Type::TemplateTypeParm:
+    return true;
+
+  case Type::SubstTemplateTypeParm:
+    return isSubstitutionMemoizable(
+             cast<SubstTemplateTypeParmType>(T)->getReplacementType());
+
+  case Type::Pointer:
+    return isSubstitutionMemoizable(T->getPointeeType());
+  case Type::BlockPointer:
+    return isSubstitutionMemoizable(T->getPointeeType());
+  case Type::LValueReference:
+  case Type::RValueReference:
+    return isSubstitutionMemoizable(
+             cast<ReferenceType>(T)->getPointeeTypeAsWritten());
+  case Type::MemberPointer: {
+    const MemberPointerType *MPT = cast<MemberPointerType>(T);
+    return isSubstitutionMemoizable(QualType(MPT->getClass(), 0)) &&
+           isSubstitutionMemoizable(MPT->getPointeeType());
+  }
+
+  case Type::ConstantArray:
+  case Type::IncompleteArray:
+    return isSubstitutionMemoizable(
+             cast<ArrayType>(T)->getElementType());
+
+  case Type::Paren:
+    return isSubstitutionMemoizable(cast<ParenType>(T)->getInnerType());
+
+  case Type::FunctionNoProto:
+    return isSubstitutionMemoizable(
+             cast<FunctionType>(T)->getResultType());
+
+  case Type::FunctionProto: {
+    const FunctionProtoType *Proto = cast<FunctionProtoType>(T);
+    switch (Proto->getExceptionSpecType()) {
+    case EST_None:
+    case EST_DynamicNone:
+    case EST_MSAny:
+    case EST_BasicNoexcept:
+      break;
+    case EST_Dynamic:
+      for (unsigned I = 0, N = Proto->getNumExceptions(); I != N; ++I)
+        if (!isSubstitutionMemoizable(Proto->getExceptionType(I)))
+          return false;
+      break;
+    case EST_ComputedNoexcept:
+    case EST_Unevaluated:
+    case EST_Uninstantiated:
+      return false;
+    }
+    for (unsigned I = 0, N = Proto->getNumArgs(); I != N; ++I)
+      if (!isSubstitutionMemoizable(Proto->getArgType(I)))
+        return false;
+    return isSubstitutionMemoizable(Proto->getResultType());
+  }
+
+  case Type::Record:
+  case Type::Enum:
+    return isContextIndependentDecl(cast<TagType>(T)->getDecl());
+
+  case Type::Typedef:
+    return isContextIndependentDecl(cast<TypedefType>(T)->getDecl());
+
+  case Type::Elaborated: {
+    const ElaboratedType *ET = cast<ElaboratedType>(T);
+    for (NestedNameSpecifier *NNS = ET->getQualifier(); NNS;
+         NNS = NNS->getPrefix()) {
+      switch (NNS->getKind()) {
+      case NestedNameSpecifier::Global:
+        break;
+      case NestedNameSpecifier::Namespace:
+        if (!isContextIndependentDecl(NNS->getAsNamespace()))
+          return false;
+        break;
+      default:
+        return false;
+      }
+    }
+    return isSubstitutionMemoizable(ET->getNamedType());
+  }
+
+  case Type::TemplateSpecialization: {
+    const TemplateSpecializationType *TST
+      = cast<TemplateSpecializationType>(T);
+    if (TST->isTypeAlias())
+      return false;
+    TemplateName Name = TST->getTemplateName();
+    if (Name.getKind() != TemplateName::Template ||
+        !isa<ClassTemplateDecl>(Name.getAsTemplateDecl()) ||
+        !isContextIndependentDecl(Name.getAsTemplateDecl()))
+      return false;
+    for (unsigned I = 0, N = TST->getNumArgs(); I != N; ++I) {
+      const TemplateArgument &Arg = TST->getArg(I);
+      switch (Arg.getKind()) {
+      case TemplateArgument::Null:
+      case TemplateArgument::Declaration:
+      case TemplateArgument::NullPtr:
+      case TemplateArgument::Integral:
+        break;
+      case TemplateArgument::Type:
+        if (!isSubstitutionMemoizable(Arg.getAsType()))
+          return false;
+        break;
+      case TemplateArgument::Template: {
+        TemplateName ArgName = Arg.getAsTemplate();
+        if (ArgName.getKind() != TemplateName::Template ||
+            !isa<ClassTemplateDecl>(ArgName.getAsTemplateDecl()) ||
+            !isContextIndependentDecl(ArgName.getAsTemplateDecl()))
+          return false;
+        break;
+      }
+      case TemplateArgument::TemplateExpansion:
+      case TemplateArgument::Expression:
+      case TemplateArgument::Pack:
+        return false;
+      }
+    }
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
 /// Deprecated form of the above.
 QualType Sema::SubstType(QualType T,
                          const MultiLevelTemplateArgumentList &TemplateArgs,
@@ -1560,8 +1943,31 @@ QualType Sema::SubstType(QualType T,
   if (!T->isInstantiationDependentType() && !T->isVariablyModifiedType())
     return T;
 
+  // The same type is often substituted with the same arguments along
+  // different paths. Reuse the earlier result when it cannot depend on
+  // anything else. Results are only remembered if the substitution produced
+  // no errors, trapped or otherwise, so that later substitutions still
+  // diagnose them.
+  llvm::FoldingSetNodeID ID;
+  bool Memoize = ArgumentPackSubstitutionIndex == -1 &&
+                 !getDiagnostics().hasErrorOccurred() &&
+                 isSubstitutionMemoizable(T);
+  if (Memoize) {
+    if (!SubstTypes)
+      SubstTypes.reset(new SubstTypeCache());
+    SubstTypeCache::Profile(ID, Context, T, TemplateArgs);
+    QualType Result = SubstTypes->lookup(ID);
+    if (!Result.isNull())
+      return Result;
+  }
+
+  unsigned SavedSFINAEErrors = NumSFINAEErrors;
   TemplateInstantiator Instantiator(*this, TemplateArgs, Loc, Entity);
-  return Instantiator.TransformType(T);
+  QualType Result = Instantiator.TransformType(T);
+  if (Memoize && !Result.isNull() && NumSFINAEErrors == SavedSFINAEErrors &&
+      !getDiagnostics().hasErrorOccurred())
+    SubstTypes->insert(ID, Result);
+  return Result;
 }
 
 static bool NeedsInstantiationAsFunctionType(TypeSourceInfo *T) {
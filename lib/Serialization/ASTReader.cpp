@@ -1641,6 +1641,15 @@ InputFile ASTReader::getInputFile(ModuleFile &F, unsigned ID, bool Complain) {
     StringRef OrigFilename = Blob;
     std::string Filename = OrigFilename;
     MaybeAddSystemRootToFilename(F, Filename);
+
+    // A precompiled preamble may have been built from another main file that
+    // starts with the same text; its contents are always overridden by the
+    // main file being parsed, so read it as that file.
+    const PreprocessorOptions &PPOpts = PP.getPreprocessorOpts();
+    if (F.Kind == MK_Preamble && Overridden &&
+        !PPOpts.PrecompiledPreambleMainFile.empty() &&
+        Filename == F.OriginalSourceFileName)
+      Filename = PPOpts.PrecompiledPreambleMainFile;
     const FileEntry *File 
       = Overridden? FileMgr.getVirtualFile(Filename, StoredSize, StoredTime)
                   : FileMgr.getFile(Filename, /*OpenFile=*/false);
@@ -4375,6 +4384,7 @@ void ASTReader::ReadPragmaDiagnosticMappings(DiagnosticsEngine &Diag) {
         diag::Mapping Map = (diag::Mapping)F.PragmaDiagMappings[Idx++];
         DiagnosticMappingInfo MappingInfo = Diag.makeMappingInfo(Map, Loc);
         Diag.GetCurDiagState()->setMappingInfo(DiagID, MappingInfo);
+        Diag.updateIgnoredEverywhere(DiagID, MappingInfo);
       }
     }
   }
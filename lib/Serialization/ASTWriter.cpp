@@ -2098,16 +2098,28 @@ void ASTWriter::WritePreprocessorDetail(PreprocessingRecord &PPRec) {
     + NUM_PREDEF_PP_ENTITY_IDS;
   unsigned NextPreprocessorEntityID = FirstPreprocessorEntityID;
   RecordData Record;
-  for (PreprocessingRecord::iterator E = PPRec.local_begin(),
-                                  EEnd = PPRec.local_end();
-       E != EEnd; 
-       (void)++E, ++NumPreprocessingRecords, ++NextPreprocessorEntityID) {
+  for (unsigned I = 0, N = PPRec.LocalEntities.size(); I != N;
+       ++I, ++NumPreprocessingRecords, ++NextPreprocessorEntityID) {
     Record.clear();
 
-    PreprocessedEntityOffsets.push_back(PPEntityOffset((*E)->getSourceRange(),
-                                                     Stream.GetCurrentBitNo()));
+    PreprocessedEntityOffsets.push_back(
+        PPEntityOffset(PPRec.getLocalEntityRange(I), Stream.GetCurrentBitNo()));
 
-    if (MacroDefinition *MD = dyn_cast<MacroDefinition>(*E)) {
+    // Write macro expansions without having the record allocate them.
+    MacroDefinition *ExpandedDef;
+    const IdentifierInfo *BuiltinName;
+    if (PPRec.getLocalMacroExpansion(I, ExpandedDef, BuiltinName)) {
+      Record.push_back(BuiltinName != 0);
+      if (BuiltinName)
+        AddIdentifierRef(BuiltinName, Record);
+      else
+        Record.push_back(MacroDefinitions[ExpandedDef]);
+      Stream.EmitRecord(PPD_MACRO_EXPANSION, Record);
+      continue;
+    }
+
+    PreprocessedEntity *E = PPRec.getLocalPreprocessedEntity(I);
+    if (MacroDefinition *MD = dyn_cast<MacroDefinition>(E)) {
       // Record this macro definition's ID.
       MacroDefinitions[MD] = NextPreprocessorEntityID;
       
@@ -2116,17 +2128,7 @@ void ASTWriter::WritePreprocessorDetail(PreprocessingRecord &PPRec) {
       continue;
     }
 
-    if (MacroExpansion *ME = dyn_cast<MacroExpansion>(*E)) {
-      Record.push_back(ME->isBuiltinMacro());
-      if (ME->isBuiltinMacro())
-        AddIdentifierRef(ME->getName(), Record);
-      else
-        Record.push_back(MacroDefinitions[ME->getDefinition()]);
-      Stream.EmitRecord(PPD_MACRO_EXPANSION, Record);
-      continue;
-    }
-
-    if (InclusionDirective *ID = dyn_cast<InclusionDirective>(*E)) {
+    if (InclusionDirective *ID = dyn_cast<InclusionDirective>(E)) {
       Record.push_back(PPD_INCLUSION_DIRECTIVE);
       Record.push_back(ID->getFileName().size());
       Record.push_back(ID->wasInQuotes());
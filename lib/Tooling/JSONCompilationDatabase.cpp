@@ -12,12 +12,20 @@
 //===----------------------------------------------------------------------===//
 
 #include "clang/Tooling/JSONCompilationDatabase.h"
+#include "clang/Basic/CharInfo.h"
+#include "clang/Basic/OnDiskHashTable.h"
 #include "clang/Tooling/CompilationDatabase.h"
 #include "clang/Tooling/CompilationDatabasePluginRegistry.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLParser.h"
 #include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <sys/stat.h>
 
 namespace clang {
 namespace tooling {
@@ -117,6 +125,127 @@ std::vector<std::string> unescapeCommandLine(
   return parser.parse();
 }
 
+/// \brief A scanner for the subset of JSON that compilation databases are
+/// written in.
+///
+/// Strings are returned as their raw contents, leaving unescaping to the
+/// caller; the scanner only checks that the escapes are ones that
+/// \c unescapeJSONString() understands.
+class JSONDatabaseScanner {
+public:
+  JSONDatabaseScanner(StringRef Input)
+    : Position(Input.begin()), End(Input.end()) {}
+
+  /// \brief Consumes \p C, after any whitespace, if it is next.
+  bool consume(char C) {
+    skipWhitespace();
+    if (Position == End || *Position != C)
+      return false;
+    ++Position;
+    return true;
+  }
+
+  /// \brief Whether only whitespace is left.
+  bool atEnd() {
+    skipWhitespace();
+    return Position == End;
+  }
+
+  /// \brief Scans a string, setting \p Raw to what is between its quotes and
+  /// \p HasEscapes to whether that contains escapes.
+  bool scanString(StringRef &Raw, bool &HasEscapes) {
+    if (!consume('"'))
+      return false;
+    const char *Start = Position;
+    HasEscapes = false;
+    for (; Position != End && *Position != '"'; ++Position) {
+      if (static_cast<unsigned char>(*Position) < 0x20)
+        return false;
+      if (*Position != '\\')
+        continue;
+      HasEscapes = true;
+      if (++Position == End)
+        return false;
+      switch (*Position) {
+      case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r':
+      case 't':
+        break;
+      case 'u': {
+        // Surrogate pairs are left to the YAML parser.
+        if (End - Position < 5)
+          return false;
+        unsigned CodePoint = 0;
+        for (unsigned I = 1; I != 5; ++I) {
+          if (!isHexDigit(Position[I]))
+            return false;
+          CodePoint = CodePoint * 16 + llvm::hexDigitValue(Position[I]);
+        }
+        if (CodePoint >= 0xD800 && CodePoint <= 0xDFFF)
+          return false;
+        Position += 4;
+        break;
+      }
+      default:
+        return false;
+      }
+    }
+    if (Position == End)
+      return false;
+    Raw = StringRef(Start, Position - Start);
+    ++Position;
+    return true;
+  }
+
+private:
+  void skipWhitespace() {
+    while (Position != End && (*Position == ' ' || *Position == '\t' ||
+                               *Position == '\n' || *Position == '\r'))
+      ++Position;
+  }
+
+  const char *Position;
+  const char *End;
+};
+
+/// \brief Appends the value of a JSON string, given the raw contents that
+/// \c JSONDatabaseScanner accepted, to \p Value.
+void unescapeJSONString(StringRef Raw, std::string &Value) {
+  for (StringRef::iterator I = Raw.begin(), E = Raw.end(); I != E; ++I) {
+    if (*I != '\\') {
+      Value.push_back(*I);
+      continue;
+    }
+    switch (*++I) {
+    case 'b': Value.push_back('\b'); break;
+    case 'f': Value.push_back('\f'); break;
+    case 'n': Value.push_back('\n'); break;
+    case 'r': Value.push_back('\r'); break;
+    case 't': Value.push_back('\t'); break;
+    case 'u': {
+      unsigned CodePoint = 0;
+      for (unsigned J = 0; J != 4; ++J)
+        CodePoint = CodePoint * 16 + llvm::hexDigitValue(*++I);
+      // Encode as UTF-8; surrogates never get here.
+      if (CodePoint < 0x80) {
+        Value.push_back(CodePoint);
+      } else if (CodePoint < 0x800) {
+        Value.push_back(0xC0 | (CodePoint >> 6));
+        Value.push_back(0x80 | (CodePoint & 0x3F));
+      } else {
+        Value.push_back(0xE0 | (CodePoint >> 12));
+        Value.push_back(0x80 | ((CodePoint >> 6) & 0x3F));
+        Value.push_back(0x80 | (CodePoint & 0x3F));
+      }
+      break;
+    }
+    default:
+      // '"', '\\' and '/' stand for themselves.
+      Value.push_back(*I);
+      break;
+    }
+  }
+}
+
 } // end namespace
 
 class JSONCompilationDatabasePlugin : public CompilationDatabasePlugin {
@@ -158,6 +287,40 @@ JSONCompilationDatabase::loadFromFile(StringRef FilePath,
   return Database.take();
 }
 
+JSONCompilationDatabase *
+JSONCompilationDatabase::loadFromFile(StringRef FilePath, StringRef IndexPath,
+                                      std::string &ErrorMessage) {
+  struct stat StatBuf;
+  if (::stat(FilePath.str().c_str(), &StatBuf))
+    return loadFromFile(FilePath, ErrorMessage);
+  uint64_t ModTime = StatBuf.st_mtime;
+  uint64_t Size = StatBuf.st_size;
+
+  OwningPtr<llvm::MemoryBuffer> DatabaseBuffer;
+  llvm::error_code Result =
+    llvm::MemoryBuffer::getFile(FilePath, DatabaseBuffer);
+  if (Result != 0) {
+    ErrorMessage = "Error while opening JSON database: " + Result.message();
+    return NULL;
+  }
+  OwningPtr<JSONCompilationDatabase> Database(
+    new JSONCompilationDatabase(DatabaseBuffer.take()));
+  // If the database changed since it was stat'ed, neither the index nor the
+  // key to write it under can be trusted.
+  bool Unchanged = Database->Database->getBufferSize() == Size;
+
+  OwningPtr<llvm::MemoryBuffer> IndexBuffer;
+  if (Unchanged && !llvm::MemoryBuffer::getFile(IndexPath, IndexBuffer) &&
+      Database->readIndex(IndexBuffer->getBuffer(), ModTime, Size))
+    return Database.take();
+
+  if (!Database->parse(ErrorMessage))
+    return NULL;
+  if (Unchanged)
+    Database->writeIndex(IndexPath, ModTime, Size);
+  return Database.take();
+}
+
 JSONCompilationDatabase *
 JSONCompilationDatabase::loadFromBuffer(StringRef DatabaseString,
                                         std::string &ErrorMessage) {
@@ -219,16 +382,111 @@ void JSONCompilationDatabase::getCommands(
                                   ArrayRef<CompileCommandRef> CommandsRef,
                                   std::vector<CompileCommand> &Commands) const {
   for (int I = 0, E = CommandsRef.size(); I != E; ++I) {
-    SmallString<8> DirectoryStorage;
-    SmallString<1024> CommandStorage;
+    const CompileCommandRef &Ref = CommandsRef[I];
+    StringRef Directory = Ref.Directory;
+    StringRef CommandLine = Ref.CommandLine;
+    std::string DirectoryStorage;
+    std::string CommandLineStorage;
+    if (Ref.Escaped) {
+      unescapeJSONString(Ref.Directory, DirectoryStorage);
+      unescapeJSONString(Ref.CommandLine, CommandLineStorage);
+      Directory = DirectoryStorage;
+      CommandLine = CommandLineStorage;
+    }
     Commands.push_back(CompileCommand(
       // FIXME: Escape correctly:
-      CommandsRef[I].first->getValue(DirectoryStorage),
-      unescapeCommandLine(CommandsRef[I].second->getValue(CommandStorage))));
+      Directory, unescapeCommandLine(CommandLine)));
   }
 }
 
 bool JSONCompilationDatabase::parse(std::string &ErrorMessage) {
+  // Databases written by build tools are plain JSON; only fall back to the
+  // YAML parser, which builds a node for everything and gives proper error
+  // messages, for anything else.
+  if (parseFast())
+    return true;
+  return parseYAML(ErrorMessage);
+}
+
+namespace {
+struct ScannedEntry {
+  StringRef Directory;
+  StringRef Command;
+  StringRef File;
+  bool DirectoryEscaped;
+  bool CommandEscaped;
+  bool FileEscaped;
+};
+} // end anonymous namespace
+
+bool JSONCompilationDatabase::parseFast() {
+  JSONDatabaseScanner Scanner(Database->getBuffer());
+  if (!Scanner.consume('['))
+    return false;
+
+  // Nothing is indexed until the whole buffer has been scanned, so that a
+  // failure leaves a clean slate for the YAML parser.
+  std::vector<ScannedEntry> Entries;
+  if (!Scanner.consume(']')) {
+    do {
+      if (!Scanner.consume('{'))
+        return false;
+      ScannedEntry Entry;
+      bool HasDirectory = false, HasCommand = false, HasFile = false;
+      do {
+        StringRef Key, Value;
+        bool KeyEscaped, ValueEscaped;
+        if (!Scanner.scanString(Key, KeyEscaped) || KeyEscaped ||
+            !Scanner.consume(':') || !Scanner.scanString(Value, ValueEscaped))
+          return false;
+        if (Key == "directory") {
+          Entry.Directory = Value;
+          Entry.DirectoryEscaped = ValueEscaped;
+          HasDirectory = true;
+        } else if (Key == "command") {
+          Entry.Command = Value;
+          Entry.CommandEscaped = ValueEscaped;
+          HasCommand = true;
+        } else if (Key == "file") {
+          Entry.File = Value;
+          Entry.FileEscaped = ValueEscaped;
+          HasFile = true;
+        } else {
+          return false;
+        }
+      } while (Scanner.consume(','));
+      if (!Scanner.consume('}') || !HasDirectory || !HasCommand || !HasFile)
+        return false;
+      Entries.push_back(Entry);
+    } while (Scanner.consume(','));
+    if (!Scanner.consume(']'))
+      return false;
+  }
+  if (!Scanner.atEnd())
+    return false;
+
+  for (unsigned I = 0, E = Entries.size(); I != E; ++I) {
+    const ScannedEntry &Entry = Entries[I];
+    // Both strings of a command are unescaped together when it is looked up.
+    CompileCommandRef Ref;
+    Ref.Directory = Entry.Directory;
+    Ref.CommandLine = Entry.Command;
+    Ref.Escaped = Entry.DirectoryEscaped || Entry.CommandEscaped;
+    if (!Entry.FileEscaped && !Entry.DirectoryEscaped) {
+      addCommand(Entry.File, Entry.Directory, Ref);
+      continue;
+    }
+    std::string FileName, Directory;
+    unescapeJSONString(Entry.File, FileName);
+    unescapeJSONString(Entry.Directory, Directory);
+    addCommand(FileName, Directory, Ref);
+  }
+  return true;
+}
+
+bool JSONCompilationDatabase::parseYAML(std::string &ErrorMessage) {
+  llvm::SourceMgr SM;
+  llvm::yaml::Stream YAMLStream(Database->getBuffer(), SM);
   llvm::yaml::document_iterator I = YAMLStream.begin();
   if (I == YAMLStream.end()) {
     ErrorMessage = "Error while parsing YAML.";
@@ -300,24 +558,174 @@ bool JSONCompilationDatabase::parse(std::string &ErrorMessage) {
       ErrorMessage = "Missing key: \"directory\".";
       return false;
     }
+    // The nodes go away with the stream, so keep copies of their values.
     SmallString<8> FileStorage;
-    StringRef FileName = File->getValue(FileStorage);
-    SmallString<128> NativeFilePath;
-    if (llvm::sys::path::is_relative(FileName)) {
-      SmallString<8> DirectoryStorage;
-      SmallString<128> AbsolutePath(
-          Directory->getValue(DirectoryStorage));
-      llvm::sys::path::append(AbsolutePath, FileName);
-      llvm::sys::path::native(AbsolutePath.str(), NativeFilePath);
-    } else {
-      llvm::sys::path::native(FileName, NativeFilePath);
+    SmallString<8> DirectoryStorage;
+    SmallString<1024> CommandStorage;
+    CompileCommandRef Ref;
+    Ref.Directory = copyString(Directory->getValue(DirectoryStorage));
+    Ref.CommandLine = copyString(Command->getValue(CommandStorage));
+    Ref.Escaped = false;
+    addCommand(File->getValue(FileStorage), Ref.Directory, Ref);
+  }
+  return true;
+}
+
+/// The index starts with the signature "CDBI" and a version number, followed
+/// by the size and modification time of the database it was written for, and
+/// the number of commands. For each command, it then holds the length of its
+/// file's absolute native path, the offset and length of its directory and
+/// of its command line in the database, and whether those are escaped. The
+/// paths follow, in the same order. All numbers are little-endian, 32 bits
+/// wide except for the size and the modification time.
+static const char IndexSignature[] = { 'C', 'D', 'B', 'I' };
+static const uint32_t IndexVersion = 1;
+static const unsigned IndexHeaderSize = 4 + 4 + 8 + 8 + 4;
+static const unsigned IndexEntrySize = 6 * 4;
+
+bool JSONCompilationDatabase::readIndex(StringRef Index, uint64_t ModTime,
+                                        uint64_t Size) {
+  using namespace clang::io;
+
+  if (Index.size() < IndexHeaderSize ||
+      !Index.startswith(StringRef(IndexSignature, sizeof(IndexSignature))))
+    return false;
+  const unsigned char *Data =
+    reinterpret_cast<const unsigned char *>(Index.data()) +
+    sizeof(IndexSignature);
+  if (ReadUnalignedLE32(Data) != IndexVersion ||
+      ReadUnalignedLE64(Data) != Size || ReadUnalignedLE64(Data) != ModTime)
+    return false;
+  uint64_t NumCommands = ReadUnalignedLE32(Data);
+  if (NumCommands * IndexEntrySize > Index.size() - IndexHeaderSize)
+    return false;
+
+  // Check the whole index before indexing anything, so that a damaged one
+  // leaves a clean slate for parse().
+  StringRef Buffer = Database->getBuffer();
+  const unsigned char *Entry = Data;
+  uint64_t PathsSize = 0;
+  for (uint64_t I = 0; I != NumCommands; ++I) {
+    PathsSize += ReadUnalignedLE32(Entry);
+    for (unsigned J = 0; J != 2; ++J) {
+      uint64_t Offset = ReadUnalignedLE32(Entry);
+      uint64_t Length = ReadUnalignedLE32(Entry);
+      if (Offset + Length > Buffer.size())
+        return false;
     }
-    IndexByFile[NativeFilePath].push_back(
-        CompileCommandRef(Directory, Command));
-    MatchTrie.insert(NativeFilePath.str());
+    if (ReadUnalignedLE32(Entry) > 1)
+      return false;
+  }
+  const char *Paths = reinterpret_cast<const char *>(Entry);
+  if (PathsSize != uint64_t(Index.end() - Paths))
+    return false;
+
+  for (uint64_t I = 0; I != NumCommands; ++I) {
+    uint32_t PathLength = ReadUnalignedLE32(Data);
+    CompileCommandRef Ref;
+    uint32_t Offset = ReadUnalignedLE32(Data);
+    Ref.Directory = Buffer.substr(Offset, ReadUnalignedLE32(Data));
+    Offset = ReadUnalignedLE32(Data);
+    Ref.CommandLine = Buffer.substr(Offset, ReadUnalignedLE32(Data));
+    Ref.Escaped = ReadUnalignedLE32(Data) != 0;
+    addNativeCommand(StringRef(Paths, PathLength), Ref);
+    Paths += PathLength;
   }
   return true;
 }
 
+void JSONCompilationDatabase::writeIndex(StringRef IndexPath, uint64_t ModTime,
+                                         uint64_t Size) const {
+  using namespace clang::io;
+
+  // Offsets are 32 bits wide.
+  StringRef Buffer = Database->getBuffer();
+  if (Buffer.size() > UINT32_MAX)
+    return;
+
+  SmallString<1024> Index;
+  llvm::raw_svector_ostream OS(Index);
+  OS.write(IndexSignature, sizeof(IndexSignature));
+  Emit32(OS, IndexVersion);
+  Emit64(OS, Size);
+  Emit64(OS, ModTime);
+  unsigned NumCommands = 0;
+  for (llvm::StringMap< std::vector<CompileCommandRef> >::const_iterator
+         I = IndexByFile.begin(), E = IndexByFile.end(); I != E; ++I)
+    NumCommands += I->getValue().size();
+  Emit32(OS, NumCommands);
+
+  for (llvm::StringMap< std::vector<CompileCommandRef> >::const_iterator
+         I = IndexByFile.begin(), E = IndexByFile.end(); I != E; ++I) {
+    const std::vector<CompileCommandRef> &Refs = I->getValue();
+    for (unsigned J = 0, JE = Refs.size(); J != JE; ++J) {
+      // Commands read by parseYAML() are copies, not in the database.
+      const CompileCommandRef &Ref = Refs[J];
+      if (Ref.Directory.begin() < Buffer.begin() ||
+          Ref.Directory.end() > Buffer.end() ||
+          Ref.CommandLine.begin() < Buffer.begin() ||
+          Ref.CommandLine.end() > Buffer.end())
+        return;
+      Emit32(OS, I->getKey().size());
+      Emit32(OS, Ref.Directory.begin() - Buffer.begin());
+      Emit32(OS, Ref.Directory.size());
+      Emit32(OS, Ref.CommandLine.begin() - Buffer.begin());
+      Emit32(OS, Ref.CommandLine.size());
+      Emit32(OS, Ref.Escaped);
+    }
+  }
+  for (llvm::StringMap< std::vector<CompileCommandRef> >::const_iterator
+         I = IndexByFile.begin(), E = IndexByFile.end(); I != E; ++I)
+    for (unsigned J = 0, JE = I->getValue().size(); J != JE; ++J)
+      OS << I->getKey();
+  OS.flush();
+
+  // Write to a temporary file and rename it over the index, so that tools
+  // loading the database concurrently never see a partial index.
+  SmallString<128> TempPath;
+  int FD;
+  if (llvm::sys::fs::unique_file(IndexPath + "-%%%%%%%%", FD, TempPath,
+                                 /*makeAbsolute=*/false))
+    return;
+  llvm::raw_fd_ostream Out(FD, /*shouldClose=*/true);
+  Out << Index.str();
+  Out.close();
+
+  bool Existed;
+  if (Out.has_error()) {
+    Out.clear_error();
+    llvm::sys::fs::remove(TempPath.str(), Existed);
+    return;
+  }
+  if (llvm::sys::fs::rename(TempPath.str(), IndexPath))
+    llvm::sys::fs::remove(TempPath.str(), Existed);
+}
+
+StringRef JSONCompilationDatabase::copyString(StringRef Str) {
+  char *Data = Strings.Allocate<char>(Str.size());
+  std::copy(Str.begin(), Str.end(), Data);
+  return StringRef(Data, Str.size());
+}
+
+void JSONCompilationDatabase::addCommand(StringRef FileName,
+                                         StringRef Directory,
+                                         const CompileCommandRef &Command) {
+  SmallString<128> NativeFilePath;
+  if (llvm::sys::path::is_relative(FileName)) {
+    SmallString<128> AbsolutePath(Directory);
+    llvm::sys::path::append(AbsolutePath, FileName);
+    llvm::sys::path::native(AbsolutePath.str(), NativeFilePath);
+  } else {
+    llvm::sys::path::native(FileName, NativeFilePath);
+  }
+  addNativeCommand(NativeFilePath, Command);
+}
+
+void JSONCompilationDatabase::addNativeCommand(
+    StringRef NativeFilePath, const CompileCommandRef &Command) {
+  IndexByFile[NativeFilePath].push_back(Command);
+  MatchTrie.insert(NativeFilePath);
+}
+
 } // end namespace tooling
 } // end namespace clang
@@ -18,6 +18,7 @@
 #include "clang/Lex/Lexer.h"
 #include "clang/Rewrite/Core/Rewriter.h"
 #include "clang/Tooling/Refactoring.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/raw_os_ostream.h"
 
 namespace clang {
@@ -47,17 +48,24 @@ bool Replacement::isApplicable() const {
   return FilePath != InvalidLocation;
 }
 
-bool Replacement::apply(Rewriter &Rewrite) const {
-  SourceManager &SM = Rewrite.getSourceMgr();
+/// \brief Return the FileID of \p FilePath, creating one if the file has not
+/// been loaded yet, or an invalid FileID if there is no such file.
+static FileID getFileIDForPath(SourceManager &SM, StringRef FilePath) {
   const FileEntry *Entry = SM.getFileManager().getFile(FilePath);
   if (Entry == NULL)
-    return false;
-  FileID ID;
+    return FileID();
   // FIXME: Use SM.translateFile directly.
   SourceLocation Location = SM.translateFileLineCol(Entry, 1, 1);
-  ID = Location.isValid() ?
+  return Location.isValid() ?
     SM.getFileID(Location) :
     SM.createFileID(Entry, SourceLocation(), SrcMgr::C_User);
+}
+
+bool Replacement::apply(Rewriter &Rewrite) const {
+  SourceManager &SM = Rewrite.getSourceMgr();
+  FileID ID = getFileIDForPath(SM, FilePath);
+  if (ID.isInvalid())
+    return false;
   // FIXME: We cannot check whether Offset + Length is in the file, as
   // the remapping API is not public in the RewriteBuffer.
   const SourceLocation Start =
@@ -122,15 +130,47 @@ void Replacement::setFromSourceRange(SourceManager &Sources,
 }
 
 bool applyAllReplacements(Replacements &Replaces, Rewriter &Rewrite) {
+  SourceManager &SM = Rewrite.getSourceMgr();
   bool Result = true;
-  for (Replacements::const_iterator I = Replaces.begin(),
-                                    E = Replaces.end();
-       I != E; ++I) {
-    if (I->isApplicable()) {
-      Result = I->apply(Rewrite) && Result;
-    } else {
+  SmallVector<RewriteBuffer::Edit, 16> Edits;
+
+  // The replacements are sorted by file and offset, so each file's are
+  // validated and applied together, looking the file up only once.
+  Replacements::const_iterator I = Replaces.begin(), E = Replaces.end();
+  while (I != E) {
+    StringRef FilePath = I->getFilePath();
+    Replacements::const_iterator FileEnd = I;
+    while (FileEnd != E && FileEnd->getFilePath() == FilePath)
+      ++FileEnd;
+
+    FileID ID;
+    if (I->isApplicable())
+      ID = getFileIDForPath(SM, FilePath);
+    if (ID.isInvalid()) {
       Result = false;
+      I = FileEnd;
+      continue;
+    }
+
+    unsigned FileSize = SM.getBuffer(ID)->getBufferSize();
+    unsigned PrevEnd = 0;
+    Edits.clear();
+    for (; I != FileEnd; ++I) {
+      // Skip replacements past the end of the file, and replacements that
+      // overlap the previous one, since the result would depend on the order
+      // in which they were applied.
+      if (I->getOffset() > FileSize ||
+          I->getLength() > FileSize - I->getOffset() ||
+          I->getOffset() < PrevEnd) {
+        Result = false;
+        continue;
+      }
+      Edits.push_back(RewriteBuffer::Edit(I->getOffset(), I->getLength(),
+                                          I->getReplacementText()));
+      PrevEnd = I->getOffset() + I->getLength();
     }
+    if (!Edits.empty())
+      Rewrite.getEditBuffer(ID).ReplaceTexts(Edits);
   }
   return Result;
 }
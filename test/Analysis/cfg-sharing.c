@@ -0,0 +1,32 @@
+// REQUIRES: asserts
+// RUN: %clang_cc1 -analyze -analyzer-checker=core -analyzer-stats -w %s 2>&1 | FileCheck %s
+
+// The CFG of a function is shared by the contexts that ask for it between
+// two clears of the analysis contexts, and by those of the next round, and
+// is freed after that. (-w keeps Sema's warnings from building CFGs of their
+// own.)
+//
+// The syntax pass builds the CFGs of callee, caller1 and caller2 in turn,
+// each freed two rounds later; only caller2's is left for the path pass.
+// The path pass then analyzes:
+// - caller2, reusing its CFG for its statistics and its analysis, and
+//   building callee's to inline it;
+// - caller1, building its CFG anew and reusing it for its analysis, and
+//   reusing callee's to inline it.
+// callee is not analyzed on its own, as it was inlined.
+
+static int callee(int x) {
+  return x + 1;
+}
+
+int caller1(int x) {
+  return callee(x);
+}
+
+int caller2(int x) {
+  return callee(x) * 2;
+}
+
+// CHECK: ... Statistics Collected ...
+// CHECK: {{^ *}}4 AnalysisDeclContext - The # of times a CFG built for another context was reused
+// CHECK: {{^ *}}5 CFG - The # of CFGs built
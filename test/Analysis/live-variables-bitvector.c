@@ -0,0 +1,144 @@
+// RUN: %clang_cc1 -analyze -analyzer-checker=deadcode.DeadStores -verify %s
+
+// LiveVariables numbers statements and variables as it finds them live,
+// walking backwards from the exit, so 'x' below gets a bit past the first
+// 64-bit word of the live sets.
+
+int produce(void);
+void consume(int);
+
+void live_across_back_edge(int n) {
+  int v0 = produce(), v1 = produce(), v2 = produce(), v3 = produce(),
+      v4 = produce(), v5 = produce(), v6 = produce(), v7 = produce(),
+      v8 = produce(), v9 = produce(), v10 = produce(), v11 = produce(),
+      v12 = produce(), v13 = produce(), v14 = produce(), v15 = produce(),
+      v16 = produce(), v17 = produce(), v18 = produce(), v19 = produce(),
+      v20 = produce(), v21 = produce(), v22 = produce(), v23 = produce(),
+      v24 = produce(), v25 = produce(), v26 = produce(), v27 = produce(),
+      v28 = produce(), v29 = produce(), v30 = produce(), v31 = produce(),
+      v32 = produce(), v33 = produce(), v34 = produce(), v35 = produce(),
+      v36 = produce(), v37 = produce(), v38 = produce(), v39 = produce(),
+      v40 = produce(), v41 = produce(), v42 = produce(), v43 = produce(),
+      v44 = produce(), v45 = produce(), v46 = produce(), v47 = produce(),
+      v48 = produce(), v49 = produce(), v50 = produce(), v51 = produce(),
+      v52 = produce(), v53 = produce(), v54 = produce(), v55 = produce(),
+      v56 = produce(), v57 = produce(), v58 = produce(), v59 = produce(),
+      v60 = produce(), v61 = produce(), v62 = produce(), v63 = produce(),
+      v64 = produce(), v65 = produce(), v66 = produce(), v67 = produce(),
+      v68 = produce(), v69 = produce();
+  int x = 0;
+  for (int i = 0; i < n; ++i) {
+    consume(x);
+    x = produce(); // no-warning
+  }
+  consume(v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 + v12 +
+          v13 + v14 + v15 + v16 + v17 + v18 + v19 + v20 + v21 + v22 + v23 +
+          v24 + v25 + v26 + v27 + v28 + v29 + v30 + v31 + v32 + v33 + v34 +
+          v35 + v36 + v37 + v38 + v39 + v40 + v41 + v42 + v43 + v44 + v45 +
+          v46 + v47 + v48 + v49 + v50 + v51 + v52 + v53 + v54 + v55 + v56 +
+          v57 + v58 + v59 + v60 + v61 + v62 + v63 + v64 + v65 + v66 + v67 +
+          v68 + v69);
+}
+
+void dead_after_loop(int n) {
+  int v0 = produce(), v1 = produce(), v2 = produce(), v3 = produce(),
+      v4 = produce(), v5 = produce(), v6 = produce(), v7 = produce(),
+      v8 = produce(), v9 = produce(), v10 = produce(), v11 = produce(),
+      v12 = produce(), v13 = produce(), v14 = produce(), v15 = produce(),
+      v16 = produce(), v17 = produce(), v18 = produce(), v19 = produce(),
+      v20 = produce(), v21 = produce(), v22 = produce(), v23 = produce(),
+      v24 = produce(), v25 = produce(), v26 = produce(), v27 = produce(),
+      v28 = produce(), v29 = produce(), v30 = produce(), v31 = produce(),
+      v32 = produce(), v33 = produce(), v34 = produce(), v35 = produce(),
+      v36 = produce(), v37 = produce(), v38 = produce(), v39 = produce(),
+      v40 = produce(), v41 = produce(), v42 = produce(), v43 = produce(),
+      v44 = produce(), v45 = produce(), v46 = produce(), v47 = produce(),
+      v48 = produce(), v49 = produce(), v50 = produce(), v51 = produce(),
+      v52 = produce(), v53 = produce(), v54 = produce(), v55 = produce(),
+      v56 = produce(), v57 = produce(), v58 = produce(), v59 = produce(),
+      v60 = produce(), v61 = produce(), v62 = produce(), v63 = produce(),
+      v64 = produce(), v65 = produce(), v66 = produce(), v67 = produce(),
+      v68 = produce(), v69 = produce();
+  int x;
+  for (int i = 0; i < n; ++i)
+    x = produce(); // no-warning
+  consume(x);
+  x = produce(); // expected-warning{{Value stored to 'x' is never read}}
+  consume(v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 + v12 +
+          v13 + v14 + v15 + v16 + v17 + v18 + v19 + v20 + v21 + v22 + v23 +
+          v24 + v25 + v26 + v27 + v28 + v29 + v30 + v31 + v32 + v33 + v34 +
+          v35 + v36 + v37 + v38 + v39 + v40 + v41 + v42 + v43 + v44 + v45 +
+          v46 + v47 + v48 + v49 + v50 + v51 + v52 + v53 + v54 + v55 + v56 +
+          v57 + v58 + v59 + v60 + v61 + v62 + v63 + v64 + v65 + v66 + v67 +
+          v68 + v69);
+}
+
+void live_through_nested_loops(int n) {
+  int v0 = produce(), v1 = produce(), v2 = produce(), v3 = produce(),
+      v4 = produce(), v5 = produce(), v6 = produce(), v7 = produce(),
+      v8 = produce(), v9 = produce(), v10 = produce(), v11 = produce(),
+      v12 = produce(), v13 = produce(), v14 = produce(), v15 = produce(),
+      v16 = produce(), v17 = produce(), v18 = produce(), v19 = produce(),
+      v20 = produce(), v21 = produce(), v22 = produce(), v23 = produce(),
+      v24 = produce(), v25 = produce(), v26 = produce(), v27 = produce(),
+      v28 = produce(), v29 = produce(), v30 = produce(), v31 = produce(),
+      v32 = produce(), v33 = produce(), v34 = produce(), v35 = produce(),
+      v36 = produce(), v37 = produce(), v38 = produce(), v39 = produce(),
+      v40 = produce(), v41 = produce(), v42 = produce(), v43 = produce(),
+      v44 = produce(), v45 = produce(), v46 = produce(), v47 = produce(),
+      v48 = produce(), v49 = produce(), v50 = produce(), v51 = produce(),
+      v52 = produce(), v53 = produce(), v54 = produce(), v55 = produce(),
+      v56 = produce(), v57 = produce(), v58 = produce(), v59 = produce(),
+      v60 = produce(), v61 = produce(), v62 = produce(), v63 = produce(),
+      v64 = produce(), v65 = produce(), v66 = produce(), v67 = produce(),
+      v68 = produce(), v69 = produce();
+  int x = 0, y = 0;
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      consume(y);
+      y = x; // no-warning
+    }
+    x = produce(); // no-warning
+  }
+  consume(v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 + v12 +
+          v13 + v14 + v15 + v16 + v17 + v18 + v19 + v20 + v21 + v22 + v23 +
+          v24 + v25 + v26 + v27 + v28 + v29 + v30 + v31 + v32 + v33 + v34 +
+          v35 + v36 + v37 + v38 + v39 + v40 + v41 + v42 + v43 + v44 + v45 +
+          v46 + v47 + v48 + v49 + v50 + v51 + v52 + v53 + v54 + v55 + v56 +
+          v57 + v58 + v59 + v60 + v61 + v62 + v63 + v64 + v65 + v66 + v67 +
+          v68 + v69);
+}
+
+void dead_in_loop(int n) {
+  int v0 = produce(), v1 = produce(), v2 = produce(), v3 = produce(),
+      v4 = produce(), v5 = produce(), v6 = produce(), v7 = produce(),
+      v8 = produce(), v9 = produce(), v10 = produce(), v11 = produce(),
+      v12 = produce(), v13 = produce(), v14 = produce(), v15 = produce(),
+      v16 = produce(), v17 = produce(), v18 = produce(), v19 = produce(),
+      v20 = produce(), v21 = produce(), v22 = produce(), v23 = produce(),
+      v24 = produce(), v25 = produce(), v26 = produce(), v27 = produce(),
+      v28 = produce(), v29 = produce(), v30 = produce(), v31 = produce(),
+      v32 = produce(), v33 = produce(), v34 = produce(), v35 = produce(),
+      v36 = produce(), v37 = produce(), v38 = produce(), v39 = produce(),
+      v40 = produce(), v41 = produce(), v42 = produce(), v43 = produce(),
+      v44 = produce(), v45 = produce(), v46 = produce(), v47 = produce(),
+      v48 = produce(), v49 = produce(), v50 = produce(), v51 = produce(),
+      v52 = produce(), v53 = produce(), v54 = produce(), v55 = produce(),
+      v56 = produce(), v57 = produce(), v58 = produce(), v59 = produce(),
+      v60 = produce(), v61 = produce(), v62 = produce(), v63 = produce(),
+      v64 = produce(), v65 = produce(), v66 = produce(), v67 = produce(),
+      v68 = produce(), v69 = produce();
+  int x;
+  for (int i = 0; i < n; ++i) {
+    x = produce(); // expected-warning{{Value stored to 'x' is never read}}
+    x = i;
+    consume(x);
+  }
+  consume(v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 + v12 +
+          v13 + v14 + v15 + v16 + v17 + v18 + v19 + v20 + v21 + v22 + v23 +
+          v24 + v25 + v26 + v27 + v28 + v29 + v30 + v31 + v32 + v33 + v34 +
+          v35 + v36 + v37 + v38 + v39 + v40 + v41 + v42 + v43 + v44 + v45 +
+          v46 + v47 + v48 + v49 + v50 + v51 + v52 + v53 + v54 + v55 + v56 +
+          v57 + v58 + v59 + v60 + v61 + v62 + v63 + v64 + v65 + v66 + v67 +
+          v68 + v69);
+}
@@ -0,0 +1,70 @@
+// REQUIRES: x86-registered-target
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -S -codegen-partitions 2 %s -o %t.s
+// RUN: FileCheck -check-prefix=PART0 %s < %t.s
+// RUN: FileCheck -check-prefix=NOT0 %s < %t.s
+// RUN: FileCheck -check-prefix=PART1 %s < %t.part1.s
+// RUN: FileCheck -check-prefix=NOT1 %s < %t.part1.s
+
+// A module that can't be split goes whole to the first output.
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -S -codegen-partitions 2 -DMODULE_ASM %s -o %t-asm.s
+// RUN: FileCheck -check-prefix=WHOLE %s < %t-asm.s
+// RUN: FileCheck -check-prefix=EMPTY %s < %t-asm.part1.s
+
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -S -codegen-partitions 2 %s -o - 2>&1 | FileCheck -check-prefix=STDOUT %s
+
+#ifdef MODULE_ASM
+__asm__(".globl from_asm\nfrom_asm:\n");
+#endif
+
+int counter = 1;
+
+// big and small, in different partitions, both call helper, so it becomes a
+// hidden external symbol. Only medium calls only_medium, which stays local.
+static int helper(int x) { return x + counter; }
+static int only_medium(int x) { return x * 3; }
+
+// big has the most instructions, so it gets a partition to itself.
+int big(int a, int b) {
+  int x = a * b;
+  x += a / (b | 1);
+  x ^= a << 3;
+  x -= b >> 2;
+  return helper(x);
+}
+
+int medium(int a) { return only_medium(a) + 1; }
+
+int small(int a) { return helper(a); }
+
+// Referenced from llvm.global_ctors, which stays in the first partition.
+__attribute__((constructor)) static void init(void) { counter = 2; }
+
+// PART0: {{^}}big:
+// PART0: .hidden helper.partition.{{[0-9A-F]+}}
+// PART0: {{^}}helper.partition.{{[0-9A-F]+}}:
+// PART0: {{^}}init:
+// PART0: {{^}}counter:
+// PART0: .quad init
+
+// NOT0-NOT: {{^(medium|only_medium|small)}}:
+
+// PART1: {{^}}medium:
+// PART1: {{^}}only_medium:
+// PART1: {{^}}small:
+// PART1: call{{q?}} helper.partition.{{[0-9A-F]+}}
+
+// NOT1-NOT: .globl only_medium
+// NOT1-NOT: {{^(big|helper[.a-zA-Z0-9]*|init|counter)}}:
+// NOT1-NOT: .quad init
+
+// WHOLE: from_asm:
+// WHOLE: {{^}}big:
+// WHOLE: {{^}}helper:
+// WHOLE: {{^}}medium:
+// WHOLE: {{^}}small:
+
+// EMPTY-NOT: {{^[a-z_.]+}}:
+
+// STDOUT: warning: -codegen-partitions ignored when writing to standard output
+// STDOUT: {{^}}big:
+// STDOUT: {{^}}small:
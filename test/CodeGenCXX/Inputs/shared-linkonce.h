@@ -0,0 +1,12 @@
+inline int square(int x) { return x * x; }
+
+template <typename T> T twice(T x) { return x + x; }
+
+template <typename T> T identity(T x) { return x; }
+
+inline __attribute__((always_inline)) int forced(int x) { return x - 1; }
+
+struct S {
+  int get() { return 1; }
+  int unlisted() { return 2; }
+};
@@ -0,0 +1,49 @@
+// RUN: %clang_cc1 -triple x86_64-unknown-unknown -emit-llvm -fshared-linkonce-record=%t.manifest -print-stats -o - %s 2> %t.record-stats | FileCheck -check-prefix=RECORD %s
+// RUN: FileCheck -check-prefix=MANIFEST %s < %t.manifest
+// RUN: FileCheck -check-prefix=RECORD-STATS %s < %t.record-stats
+// RUN: %clang_cc1 -triple x86_64-unknown-unknown -emit-llvm -fshared-linkonce-emit=%t.manifest -print-stats -x c++ -o - %S/Inputs/shared-linkonce.h 2> %t.emit-stats | FileCheck -check-prefix=EMIT %s
+// RUN: FileCheck -check-prefix=EMIT-STATS %s < %t.emit-stats
+
+#include "Inputs/shared-linkonce.h"
+
+// Only this translation unit can define its own inline functions, and
+// instantiations for its own types.
+inline int local(int x) { return x; }
+
+struct Local { int value; };
+
+// RECORD: define i32 @_Z3usei
+// RECORD: declare i32 @_Z5squarei
+// RECORD: declare i32 @_Z5twiceIiET_S0_
+// RECORD: define linkonce_odr i32 @_Z6forcedi
+// RECORD: declare i32 @_ZN1S3getEv
+// RECORD: define linkonce_odr i32 @_Z5locali
+// RECORD: define linkonce_odr i32 @_Z8identityI5LocalE
+int use(int x) {
+  S s;
+  Local l = { x };
+  return square(x) + twice(x) + forced(x) + s.get() + local(x) +
+         identity(l).value;
+}
+
+// MANIFEST: _Z5squarei
+// MANIFEST-NEXT: _Z5twiceIiET_S0_
+// MANIFEST-NEXT: _ZN1S3getEv
+// MANIFEST-NOT: forced
+// MANIFEST-NOT: local
+// MANIFEST-NOT: identity
+
+// RECORD-STATS: *** CodeGen Stats:
+// RECORD-STATS: 3 linkonce functions left to the shared definitions
+
+// The provider defines what the manifest lists, even though nothing in it
+// is used. It never instantiated twice<int>, so it can't define that.
+// EMIT: define weak_odr i32 @_Z5squarei
+// EMIT-NOT: @_Z5twiceIiET_S0_
+// EMIT: define weak_odr i32 @_ZN1S3getEv
+// EMIT-NOT: @_ZN1S8unlistedEv
+
+// EMIT-STATS: warning: cannot define shared linkonce function '_Z5twiceIiET_S0_' listed in '{{.*}}.manifest'
+// EMIT-STATS: *** CodeGen Stats:
+// EMIT-STATS: 2 shared linkonce functions defined
+// EMIT-STATS: 1 shared linkonce functions not available
@@ -0,0 +1,21 @@
+// RUN: %clang_cc1 -ftime-trace -emit-llvm -o %t.ll %s
+// RUN: FileCheck %s < %t.json
+
+// CHECK: "traceEvents":
+// CHECK-DAG: "name":"Total ExecuteCompiler"
+// CHECK-DAG: "name":"Total Source"
+// CHECK-DAG: "name":"Total InstantiateClass"
+// CHECK-DAG: "name":"Total InstantiateFunction"
+// CHECK-DAG: "name":"Total PerformPendingInstantiations"
+// CHECK-DAG: "name":"Total EmitGlobal"
+// CHECK-DAG: "name":"Total AnalysisBasedWarnings"
+// CHECK: "name":"process_name"
+
+template <typename T> struct S {
+  T get() { return T(); }
+};
+
+int f() {
+  S<int> s;
+  return s.get();
+}
@@ -0,0 +1,24 @@
+// Note: the run lines follow their respective tests, since line/column
+// matter in this test.
+
+int getBarCount(int);
+int getBaz(int);
+int GBC;
+int globalBuffer;
+int fooBarCount;
+
+void f() {
+  GBC = 0;
+}
+
+// RUN: env CINDEXTEST_COMPLETION_FILTER=gbc c-index-test -code-completion-at=%s:11:3 %s | FileCheck -check-prefix=CHECK-CC1 %s
+// CHECK-CC1: VarDecl:{ResultType int}{TypedText GBC} (50)
+// CHECK-CC1-NEXT: FunctionDecl:{ResultType int}{TypedText getBarCount}{LeftParen (}{Placeholder int}{RightParen )} (50)
+// CHECK-CC1-NOT: getBaz
+// CHECK-CC1-NOT: globalBuffer
+// CHECK-CC1-NOT: fooBarCount
+// CHECK-CC1: Completion contexts:
+
+// RUN: env CINDEXTEST_COMPLETION_FILTER=getba CINDEXTEST_COMPLETION_MAX_RESULTS=1 c-index-test -code-completion-at=%s:11:3 %s | FileCheck -check-prefix=CHECK-CC2 %s
+// CHECK-CC2: FunctionDecl:{ResultType int}{TypedText getBarCount}{LeftParen (}{Placeholder int}{RightParen )} (50)
+// CHECK-CC2-NEXT: Completion contexts:
@@ -0,0 +1,27 @@
+// RUN: c-index-test -write-index-db %t.db %s
+// RUN: c-index-test -query-index-db %t.db usr c:@F@foo | FileCheck -check-prefix=USR %s
+// RUN: c-index-test -query-index-db %t.db file %s | FileCheck -check-prefix=FILE %s
+
+int foo(int x);
+
+int foo(int x) {
+  return x;
+}
+
+void bar(void) {
+  foo(1);
+  foo(2);
+}
+
+// USR:      foo | c:@F@foo | function
+// USR-NEXT:   {{.*}}index-db.c:5:5 | foo | roles: decl{{$}}
+// USR-NEXT:   {{.*}}index-db.c:7:5 | foo | roles: decl def{{$}}
+// USR-NEXT:   {{.*}}index-db.c:12:3 | foo | roles: ref | container: c:@F@bar
+// USR-NEXT:   {{.*}}index-db.c:13:3 | foo | roles: ref | container: c:@F@bar
+
+// FILE:      index-db.c
+// FILE-NEXT:   {{.*}}index-db.c:5:5 | foo | roles: decl{{$}}
+// FILE-NEXT:   {{.*}}index-db.c:7:5 | foo | roles: decl def{{$}}
+// FILE-NEXT:   {{.*}}index-db.c:11:6 | bar | roles: decl def{{$}}
+// FILE-NEXT:   {{.*}}index-db.c:12:3 | foo | roles: ref | container: c:@F@bar
+// FILE-NEXT:   {{.*}}index-db.c:13:3 | foo | roles: ref | container: c:@F@bar
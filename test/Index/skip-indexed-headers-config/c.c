@@ -0,0 +1,3 @@
+#include "shared.h"
+
+int c_val;
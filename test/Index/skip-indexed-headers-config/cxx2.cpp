@@ -0,0 +1,3 @@
+#include "shared.h"
+
+int cxx_val2;
@@ -0,0 +1,6 @@
+#ifndef SHARED_H
+#define SHARED_H
+
+void shared_fn(int);
+
+#endif
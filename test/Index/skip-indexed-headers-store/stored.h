@@ -0,0 +1,6 @@
+#ifndef STORED_H
+#define STORED_H
+
+extern int stored_val;
+
+#endif
@@ -0,0 +1,3 @@
+#include "stored.h"
+
+int main_val1;
@@ -0,0 +1,10 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+extern int config_val;
+
+#ifdef USE_EXTRA
+extern int extra_val;
+#endif
+
+#endif
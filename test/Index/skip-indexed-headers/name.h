@@ -0,0 +1,6 @@
+#ifndef NAME_H
+#define NAME_H
+
+extern int NAME;
+
+#endif
@@ -0,0 +1,5 @@
+#include "config.h"
+#include "plain.h"
+#include "name.h"
+
+int main_val1;
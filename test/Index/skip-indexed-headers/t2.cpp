@@ -0,0 +1,4 @@
+#include "config.h"
+#include "plain.h"
+
+int main_val2;
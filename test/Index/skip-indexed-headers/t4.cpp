@@ -0,0 +1,3 @@
+#include "name.h"
+
+int main_val4;
@@ -0,0 +1,66 @@
+namespace outer {
+  namespace inner {
+    void f(int);
+    void f(int x);
+    static int g(int a, int b);
+    static int g(int a, int b) { return a + b; }
+
+    class Cls;
+    class Cls {
+    public:
+      int get() const;
+      template <typename T> T cast() const;
+    };
+
+    template <typename T> struct Box;
+    template <typename T> struct Box {
+      T value;
+      void set(T v);
+    };
+    template <> struct Box<int> {
+      int value;
+    };
+  }
+}
+
+int outer::inner::Cls::get() const {
+  extern int counter;
+  return counter;
+}
+
+void outer::inner::f(int x) {
+  struct Local { int y; };
+  Local l;
+  l.y = x;
+}
+
+namespace {
+  struct Anon { void h(); };
+  void Anon::h() { }
+}
+
+int counter;
+
+// The cached USRs must be exactly the ones generated from scratch, both when
+// visiting cursors and when indexing.
+// RUN: c-index-test -test-load-source-usrs all %s > %t.cached
+// RUN: env LIBCLANG_DISABLE_USR_CACHE=1 c-index-test -test-load-source-usrs all %s > %t.uncached
+// RUN: diff %t.cached %t.uncached
+// RUN: FileCheck %s < %t.cached
+// RUN: c-index-test -index-file %s > %t.index.cached
+// RUN: env LIBCLANG_DISABLE_USR_CACHE=1 c-index-test -index-file %s > %t.index.uncached
+// RUN: diff %t.index.cached %t.index.uncached
+
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@F@f#I# Extent=[3:5 - 3:16]
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@F@f#I# Extent=[4:5 - 4:18]
+// CHECK: usrs-cache.cpp c:usrs-cache.cpp@{{[0-9]+}}@N@outer@N@inner@F@g#I#I# Extent=[5:5 - 5:31]
+// CHECK: usrs-cache.cpp c:usrs-cache.cpp@{{[0-9]+}}@N@outer@N@inner@F@g#I#I# Extent=[6:5 - 6:49]
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@C@Cls Extent=[8:5 - 8:14]
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@C@Cls Extent=[9:5 - 13:6]
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@C@Cls@F@get#1 Extent=[11:7 - 11:22]
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@ST>1#T@Box Extent=[15:5 - 15:37]
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@ST>1#T@Box Extent=[16:5 - 19:6]
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@C@Cls@F@get#1 Extent=[26:1 - 29:2]
+// CHECK: usrs-cache.cpp c:@counter Extent=[27:3 - 27:21]
+// CHECK: usrs-cache.cpp c:@N@outer@N@inner@F@f#I# Extent=[31:1 - 35:2]
+// CHECK: usrs-cache.cpp c:@counter Extent=[42:1 - 42:12]
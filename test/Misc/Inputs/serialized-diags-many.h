@@ -0,0 +1,50 @@
+#warning warning 0
+#warning warning 1
+#warning warning 2
+#warning warning 3
+#warning warning 4
+#warning warning 5
+#warning warning 6
+#warning warning 7
+#warning warning 8
+#warning warning 9
+#warning warning 10
+#warning warning 11
+#warning warning 12
+#warning warning 13
+#warning warning 14
+#warning warning 15
+#warning warning 16
+#warning warning 17
+#warning warning 18
+#warning warning 19
+#warning warning 20
+#warning warning 21
+#warning warning 22
+#warning warning 23
+#warning warning 24
+#warning warning 25
+#warning warning 26
+#warning warning 27
+#warning warning 28
+#warning warning 29
+#warning warning 30
+#warning warning 31
+#warning warning 32
+#warning warning 33
+#warning warning 34
+#warning warning 35
+#warning warning 36
+#warning warning 37
+#warning warning 38
+#warning warning 39
+#warning warning 40
+#warning warning 41
+#warning warning 42
+#warning warning 43
+#warning warning 44
+#warning warning 45
+#warning warning 46
+#warning warning 47
+#warning warning 48
+#warning warning 49
@@ -0,0 +1,39 @@
+// RUN: %clang_cc1 -fsyntax-only -verify %s
+// RUN: %clang_cc1 -fsyntax-only -Wno-shadow -print-stats %s 2>&1 | FileCheck %s
+
+// -Wshadow is off until the pragma; the answer cached for the first function
+// must not hide the warning in the second.
+int x; // expected-note {{previous declaration is here}}
+void f(void) {
+  int x = 0;
+  (void)x;
+}
+
+#pragma clang diagnostic warning "-Wshadow"
+
+void g(void) {
+  int x = 0; // expected-warning {{declaration shadows a variable in the global scope}}
+  (void)x;
+}
+
+// Mapping only -Wshadow updates only its cached answer.
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wshadow"
+#pragma clang diagnostic ignored "-Wunused-variable"
+
+void h(void) {
+  int x = 0;
+  int unused = 0;
+}
+
+#pragma clang diagnostic pop
+
+void i(void) {
+  int x = 0; // expected-warning {{declaration shadows a variable in the global scope}}
+  (void)x;
+}
+
+// CHECK: *** Diagnostic Stats:
+// CHECK: 3 diagnostic states, 4 state changes.
+// CHECK: {{[0-9]+}}/{{[0-9]+}} level queries for diagnostics ignored everywhere.
+// CHECK: {{[0-9]+}} level queries looked up the state of their location.
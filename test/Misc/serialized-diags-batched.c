@@ -0,0 +1,31 @@
+// RUN: rm -f %t
+// RUN: %clang -fsyntax-only %s --serialize-diagnostics %t > /dev/null 2>&1
+// RUN: c-index-test -read-diagnostics %t 2>&1 | FileCheck %s
+
+// The diagnostics are written out in several batches; make sure the file
+// still reads back as a whole.
+
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+#include "Inputs/serialized-diags-many.h"
+
+// CHECK: serialized-diags-many.h:1:2: warning: warning 0 [-W#warnings]
+// CHECK: serialized-diags-many.h:50:2: warning: warning 49 [-W#warnings]
+// CHECK: Number of diagnostics: 1000
@@ -0,0 +1,42 @@
+// RUN: %clang_cc1 -dump-tokens -print-stats %s 2>&1 | FileCheck %s
+
+// Expanding the list again reuses the pre-expanded arguments of ID, with
+// locations in the new expansion.
+#define RED 1
+#define GREEN 2
+#define ID(x) x
+#define LIST ID(RED) ID(GREEN)
+
+LIST
+LIST
+// CHECK: numeric_constant '1'{{.*}}Loc=<{{.*}}:10:1 <Spelling={{.*}}:5:13>>
+// CHECK-NEXT: numeric_constant '2'{{.*}}Loc=<{{.*}}:10:1 <Spelling={{.*}}:6:15>>
+// CHECK-NEXT: numeric_constant '1'{{.*}}Loc=<{{.*}}:11:1 <Spelling={{.*}}:5:13>>
+// CHECK-NEXT: numeric_constant '2'{{.*}}Loc=<{{.*}}:11:1 <Spelling={{.*}}:6:15>>
+
+// Redefining a macro invalidates what was pre-expanded.
+#undef RED
+#define RED 3
+LIST
+// CHECK-NEXT: numeric_constant '3'{{.*}}Loc=<{{.*}}:20:1 <Spelling={{.*}}:19:13>>
+// CHECK-NEXT: numeric_constant '2'{{.*}}Loc=<{{.*}}:20:1 <Spelling={{.*}}:6:15>>
+
+// Within F, the F that G in the argument of ID expands to can't be expanded
+// again.  Outside of F it can, so what was pre-expanded within F must not be
+// reused there.
+#define F() M () done
+#define M ID(G)
+#define G F
+F()
+// CHECK-NEXT: identifier 'F'{{.*}}[ExpandDisabled]
+// CHECK-NEXT: l_paren '('
+// CHECK-NEXT: r_paren ')'
+// CHECK-NEXT: identifier 'done'
+M()
+// CHECK-NEXT: identifier 'F'{{.*}}[ExpandDisabled]
+// CHECK-NEXT: l_paren '('
+// CHECK-NEXT: r_paren ')'
+// CHECK-NEXT: identifier 'done'
+// CHECK-NEXT: eof ''
+
+// CHECK: 9 macro arguments pre-expanded, 3 reusing an earlier expansion.
@@ -0,0 +1,16 @@
+// RUN: %clang_cc1 -E -print-stats %s -o - 2> %t.stats | FileCheck %s
+// RUN: FileCheck -check-prefix=STATS %s < %t.stats
+
+// Each expansion of the list stringifies the same argument tokens; the
+// second reuses the spellings made by the first.
+
+#define STR(x) #x
+#define X(c) STR(c),
+#define LIST X(red) X(green) X(blue)
+
+const char *names[] = { LIST };
+// CHECK: names[] = { "red",{{ *}}"green",{{ *}}"blue",
+const char *again[] = { LIST };
+// CHECK: again[] = { "red",{{ *}}"green",{{ *}}"blue",
+
+// STATS: 6 macro arguments stringified, 3 reusing an earlier spelling.
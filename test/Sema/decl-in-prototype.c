@@ -1,4 +1,8 @@
 // RUN: %clang_cc1_only -verify %s
+// RUN: %clang_cc1_only -print-stats %s 2>&1 | FileCheck %s
+
+// Declarations in prototype scope are kept in an ASTContext side table.
+// CHECK: {{[1-9][0-9]*}} bytes allocated for AST nodes, {{[1-9][0-9]*}} bytes for side tables
 
 const int AA = 5;
 
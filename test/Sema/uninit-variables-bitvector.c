@@ -0,0 +1,80 @@
+// RUN: %clang_cc1 -fsyntax-only -Wuninitialized -Wconditional-uninitialized %s -verify
+
+// Each variable takes two bits of the analysis' bit vectors, so the variables
+// checked here, which come after 36 others, live past the first 64-bit word.
+
+void consume(int);
+int produce(void);
+
+int sometimes_past_first_word(int y) {
+  int v0 = 0, v1 = 1, v2 = 2, v3 = 3, v4 = 4, v5 = 5, v6 = 6, v7 = 7, v8 = 8,
+      v9 = 9, v10 = 10, v11 = 11, v12 = 12, v13 = 13, v14 = 14, v15 = 15,
+      v16 = 16, v17 = 17, v18 = 18, v19 = 19, v20 = 20, v21 = 21, v22 = 22,
+      v23 = 23, v24 = 24, v25 = 25, v26 = 26, v27 = 27, v28 = 28, v29 = 29,
+      v30 = 30, v31 = 31, v32 = 32, v33 = 33, v34 = 34, v35 = 35;
+  int x; // expected-note{{initialize the variable 'x' to silence this warning}}
+  if (y) // expected-warning{{variable 'x' is used uninitialized whenever 'if' condition is false}} \
+         // expected-note{{remove the 'if' if its condition is always true}}
+    x = 1;
+  return x + v0 + v35; // expected-note{{uninitialized use occurs here}}
+}
+
+int loop_exit_past_first_word(int n) {
+  int v0 = 0, v1 = 1, v2 = 2, v3 = 3, v4 = 4, v5 = 5, v6 = 6, v7 = 7, v8 = 8,
+      v9 = 9, v10 = 10, v11 = 11, v12 = 12, v13 = 13, v14 = 14, v15 = 15,
+      v16 = 16, v17 = 17, v18 = 18, v19 = 19, v20 = 20, v21 = 21, v22 = 22,
+      v23 = 23, v24 = 24, v25 = 25, v26 = 26, v27 = 27, v28 = 28, v29 = 29,
+      v30 = 30, v31 = 31, v32 = 32, v33 = 33, v34 = 34, v35 = 35;
+  int x; // expected-note{{initialize the variable 'x' to silence this warning}}
+  for (unsigned i = 0 ; i < n; ++i) {
+    if (i == n - 1)
+      break;
+    x = 1;
+  }
+  return x + v0 + v35; // expected-warning{{variable 'x' may be uninitialized when used here}}
+}
+
+int loop_body_past_first_word(unsigned n) {
+  int v0 = 0, v1 = 1, v2 = 2, v3 = 3, v4 = 4, v5 = 5, v6 = 6, v7 = 7, v8 = 8,
+      v9 = 9, v10 = 10, v11 = 11, v12 = 12, v13 = 13, v14 = 14, v15 = 15,
+      v16 = 16, v17 = 17, v18 = 18, v19 = 19, v20 = 20, v21 = 21, v22 = 22,
+      v23 = 23, v24 = 24, v25 = 25, v26 = 26, v27 = 27, v28 = 28, v29 = 29,
+      v30 = 30, v31 = 31, v32 = 32, v33 = 33, v34 = 34, v35 = 35;
+  int x; // expected-note{{initialize the variable 'x' to silence this warning}}
+  for (unsigned i = 0 ; i < n; ++i) {
+    x = 1;
+  }
+  return x + v0 + v35; // expected-warning{{variable 'x' may be uninitialized when used here}}
+}
+
+void loop_carried_past_first_word(void) {
+  int v0 = 0, v1 = 1, v2 = 2, v3 = 3, v4 = 4, v5 = 5, v6 = 6, v7 = 7, v8 = 8,
+      v9 = 9, v10 = 10, v11 = 11, v12 = 12, v13 = 13, v14 = 14, v15 = 15,
+      v16 = 16, v17 = 17, v18 = 18, v19 = 19, v20 = 20, v21 = 21, v22 = 22,
+      v23 = 23, v24 = 24, v25 = 25, v26 = 26, v27 = 27, v28 = 28, v29 = 29,
+      v30 = 30, v31 = 31, v32 = 32, v33 = 33, v34 = 34, v35 = 35;
+  for (int n = 0; n < 100; ++n) {
+    int k; // expected-note {{initialize}}
+    consume(k + v0 + v35); // expected-warning {{variable 'k' is uninitialized}}
+    k = produce();
+  }
+}
+
+// Every variable is initialized on every path into the loop, and the values
+// converge after the back edge is visited again.
+int converges_past_first_word(int n) {
+  int v0 = 0, v1 = 1, v2 = 2, v3 = 3, v4 = 4, v5 = 5, v6 = 6, v7 = 7, v8 = 8,
+      v9 = 9, v10 = 10, v11 = 11, v12 = 12, v13 = 13, v14 = 14, v15 = 15,
+      v16 = 16, v17 = 17, v18 = 18, v19 = 19, v20 = 20, v21 = 21, v22 = 22,
+      v23 = 23, v24 = 24, v25 = 25, v26 = 26, v27 = 27, v28 = 28, v29 = 29,
+      v30 = 30, v31 = 31, v32 = 32, v33 = 33, v34 = 34, v35 = 35;
+  int x, y;
+  x = produce();
+  y = produce();
+  while (n--) {
+    consume(x + y + v0 + v35); // no-warning
+    x = y;
+    y = produce();
+  }
+  return x; // no-warning
+}
@@ -0,0 +1,42 @@
+// RUN: %clang_cc1 -fsyntax-only -verify %s
+// RUN: %clang_cc1 -fsyntax-only -print-stats %s 2>&1 | FileCheck %s
+
+// Conversion sequences computed for one overload candidate are reused for
+// other candidates of the same call with the same parameter type.
+
+// CHECK: {{[1-9][0-9]*}}/{{[0-9]+}} overload candidate conversion sequences reused.
+
+struct Stream {};
+struct Convertible { operator int() const; operator double() const; };
+
+struct T0 {};
+struct T1 {};
+struct T2 {};
+struct T3 {};
+struct T4 {};
+struct T5 {};
+struct T6 {};
+struct T7 {};
+struct T8 {};
+struct T9 {};
+struct T10 {};
+struct T11 {};
+Stream &operator<<(Stream &, T0);
+Stream &operator<<(Stream &, T1);
+Stream &operator<<(Stream &, T2);
+Stream &operator<<(Stream &, T3);
+Stream &operator<<(Stream &, T4);
+Stream &operator<<(Stream &, T5);
+Stream &operator<<(Stream &, T6);
+Stream &operator<<(Stream &, T7);
+Stream &operator<<(Stream &, T8);
+Stream &operator<<(Stream &, T9);
+Stream &operator<<(Stream &, T10);
+Stream &operator<<(Stream &, T11);
+Stream &operator<<(Stream &, int); // expected-note {{candidate function}}
+Stream &operator<<(Stream &, double); // expected-note {{candidate function}}
+
+void f(Stream &S, Convertible C) {
+  S << T0() << T11() << 1 << 2.0;
+  S << C; // expected-error {{use of overloaded operator '<<' is ambiguous}}
+}
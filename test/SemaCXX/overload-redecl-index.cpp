@@ -0,0 +1,154 @@
+// RUN: %clang_cc1 -fsyntax-only -verify %s
+// RUN: %clang_cc1 -fsyntax-only -print-stats %s 2>&1 | FileCheck %s
+// expected-no-diagnostics
+
+// Redeclarations of heavily overloaded functions are found through an index
+// of the lookup list rather than by checking every overload.
+
+// CHECK: {{[1-9][0-9]*}} lookup lists indexed by function, {{[1-9][0-9]*}} redeclarations found through the index.
+
+namespace N {
+  struct S0 {};
+  struct S1 {};
+  struct S2 {};
+  struct S3 {};
+  struct S4 {};
+  struct S5 {};
+  struct S6 {};
+  struct S7 {};
+  struct S8 {};
+  struct S9 {};
+  struct S10 {};
+  struct S11 {};
+  struct S12 {};
+  struct S13 {};
+  struct S14 {};
+  struct S15 {};
+  struct S16 {};
+  struct S17 {};
+  struct S18 {};
+  struct S19 {};
+  int f(S0);
+  int f(S1);
+  int f(S2);
+  int f(S3);
+  int f(S4);
+  int f(S5);
+  int f(S6);
+  int f(S7);
+  int f(S8);
+  int f(S9);
+  int f(S10);
+  int f(S11);
+  int f(S12);
+  int f(S13);
+  int f(S14);
+  int f(S15);
+  int f(S16);
+  int f(S17);
+  int f(S18);
+  int f(S19);
+  template <typename T> T f(T, int);
+  template <typename T> T f(T, long);
+}
+
+namespace N {
+  int f(S0);
+  int f(S1);
+  int f(S2);
+  int f(S3);
+  int f(S4);
+  int f(S5);
+  int f(S6);
+  int f(S7);
+  int f(S8);
+  int f(S9);
+  int f(S10);
+  int f(S11);
+  int f(S12);
+  int f(S13);
+  int f(S14);
+  int f(S15);
+  int f(S16);
+  int f(S17);
+  int f(S18);
+  int f(S19);
+  template <typename T> T f(T, int);
+}
+
+int N::f(S0) { return 0; }
+int N::f(S1) { return 1; }
+int N::f(S2) { return 2; }
+int N::f(S3) { return 3; }
+int N::f(S4) { return 4; }
+int N::f(S5) { return 5; }
+int N::f(S6) { return 6; }
+int N::f(S7) { return 7; }
+int N::f(S8) { return 8; }
+int N::f(S9) { return 9; }
+int N::f(S10) { return 10; }
+int N::f(S11) { return 11; }
+int N::f(S12) { return 12; }
+int N::f(S13) { return 13; }
+int N::f(S14) { return 14; }
+int N::f(S15) { return 15; }
+int N::f(S16) { return 16; }
+int N::f(S17) { return 17; }
+int N::f(S18) { return 18; }
+int N::f(S19) { return 19; }
+template <typename T> T N::f(T t, int) { return t; }
+
+int (*p0)(N::S0) = &N::f;
+int (*p19)(N::S19) = &N::f;
+double (*pt)(double, int) = &N::f;
+
+int g() {
+  return N::f(N::S3()) + N::f(N::S17()) + N::f(1, 2);
+}
+
+// Using declarations are inserted at the front of the lookup list, and tags
+// stay at its end, which moves indexed entries around.
+namespace Other {
+  int h(char);
+}
+
+namespace M {
+  int h(N::S0);
+  int h(N::S1);
+  int h(N::S2);
+  int h(N::S3);
+  int h(N::S4);
+  int h(N::S5);
+  int h(N::S6);
+  int h(N::S7);
+  int h(N::S8);
+  int h(N::S9);
+  int h(N::S10);
+  int h(N::S11);
+  int h(N::S12);
+  int h(N::S13);
+  int h(N::S14);
+  int h(N::S15);
+  int h(N::S16);
+  struct h {};
+}
+
+namespace M {
+  int h(N::S0);
+  using Other::h;
+  int h(N::S16);
+  int h(N::S17);
+  int h(N::S8);
+  int h(N::S17);
+}
+
+int M::h(N::S8) { return 8; }
+int M::h(N::S16) { return 16; }
+int M::h(N::S17) { return 17; }
+
+int k() {
+  struct M::h tag;
+  (void)tag;
+  return M::h(N::S0()) + M::h(N::S8()) + M::h(N::S16()) + M::h(N::S17()) +
+         M::h('c');
+}
@@ -3985,3 +3985,66 @@ private:
 
 }  // end namespace LockUnlockFunctionTest
 
+
+
+namespace LockExprCacheTest {
+
+// Attribute arguments are parsed once and reused where nothing needs to be
+// substituted into them; check that the ones that do are still substituted.
+
+Mutex globalMu;
+int globalData GUARDED_BY(globalMu);
+
+void lockRequired(Mutex *m) EXCLUSIVE_LOCKS_REQUIRED(m);
+
+class Account {
+public:
+  void deposit() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void transfer(Account &other);
+  void transferUnlocked(Account &other);
+
+  Mutex mu_;
+  int balance_ GUARDED_BY(mu_);
+};
+
+void Account::transfer(Account &other) {
+  mu_.Lock();
+  other.mu_.Lock();
+  balance_ = 0;
+  other.balance_ = 1;
+  deposit();
+  other.deposit();
+  other.mu_.Unlock();
+  mu_.Unlock();
+}
+
+void Account::transferUnlocked(Account &other) {
+  mu_.Lock();
+  balance_ = 0;
+  other.balance_ = 1; // \
+    // expected-warning {{writing variable 'balance_' requires locking 'other.mu_' exclusively}} \
+    // expected-note {{found near match 'mu_'}}
+  deposit();
+  other.deposit(); // \
+    // expected-warning {{calling function 'deposit' requires exclusive lock on 'other.mu_'}} \
+    // expected-note {{found near match 'mu_'}}
+  mu_.Unlock();
+}
+
+void test1() {
+  globalMu.Lock();
+  globalData = 1;
+  globalMu.Unlock();
+}
+
+void test2(Mutex *a, Mutex *b) {
+  globalData = 2; // \
+    // expected-warning {{writing variable 'globalData' requires locking 'globalMu' exclusively}}
+  a->Lock();
+  lockRequired(a);
+  lockRequired(b); // \
+    // expected-warning {{calling function 'lockRequired' requires exclusive lock on 'b'}}
+  a->Unlock();
+}
+
+}  // end namespace LockExprCacheTest
@@ -0,0 +1,43 @@
+// RUN: %clang_cc1 -fsyntax-only -verify -std=c++11 -ftemplate-stats %s 2>&1 | FileCheck %s
+
+// Substituting into the type of a non-type template parameter, and into an
+// explicitly-specified result type, reuses earlier results with the same
+// template arguments. The reused types must be the ones a fresh substitution
+// would produce.
+
+// CHECK: {{^[1-9][0-9]*}}/{{[0-9]+}} type substitutions reused
+
+template <typename T, typename U> struct is_same {
+  static const bool value = false;
+};
+template <typename T> struct is_same<T, T> {
+  static const bool value = true;
+};
+
+int i1, i2;
+long l1, l2;
+
+template <typename T, T *P> struct Ptr {
+  typedef T *type;
+};
+
+// 'T *' with T = int, then with T = long, then both again from the cache.
+typedef Ptr<int, &i1> PI1;
+typedef Ptr<long, &l1> PL1;
+typedef Ptr<int, &i2> PI2;
+typedef Ptr<long, &l2> PL2;
+
+static_assert(is_same<PI2::type, int *>::value, "");
+static_assert(is_same<PL2::type, long *>::value, "");
+static_assert(!is_same<PI1, PI2>::value, "");
+static_assert(!is_same<PI2, PL2>::value, "");
+
+template <typename T, typename U> T *convert(U *);
+
+static_assert(is_same<decltype(convert<int>(&l1)), int *>::value, "");
+static_assert(is_same<decltype(convert<long>(&i1)), long *>::value, "");
+static_assert(is_same<decltype(convert<int>(&i1)), int *>::value, "");
+static_assert(is_same<decltype(convert<long>(&l1)), long *>::value, "");
+
+// A cached 'int *' must not be used for T = long.
+typedef Ptr<long, &i1> Bad; // expected-error{{non-type template argument of type 'int *' cannot be converted to a value of type 'long *'}}
@@ -0,0 +1,31 @@
+// RUN: %clang_cc1 -fsyntax-only -ftemplate-stats %s 2>&1 | FileCheck %s
+
+// CHECK: *** Template Instantiation Stats:
+// CHECK-NEXT: {{[0-9]+}} instantiations of {{[0-9]+}} templates, maximum depth {{[0-9]+}}.
+// CHECK-NEXT: {{^[1-9][0-9]*}}/{{[0-9]+}} type substitutions reused ({{[0-9]+}} memoized).
+// CHECK: Templates by instantiation time:
+// CHECK: {{^ +[0-9.]+ +4 +[0-9]+  Fib$}}
+// CHECK: Templates by instantiation count:
+// CHECK-NEXT: Time (ms)     Count  Depth  Template
+// CHECK-NEXT: {{^ +[0-9.]+ +4 +[0-9]+  Fib$}}
+// CHECK-NEXT: {{^ +[0-9.]+ +2 +[0-9]+  (Constant|get)$}}
+// CHECK-NEXT: {{^ +[0-9.]+ +2 +[0-9]+  (Constant|get)$}}
+
+template <int N> struct Fib {
+  static const int value = Fib<N - 1>::value + Fib<N - 2>::value;
+};
+template <> struct Fib<1> { static const int value = 1; };
+template <> struct Fib<0> { static const int value = 0; };
+
+int fib5[Fib<5>::value];
+
+template <typename T, T V> struct Constant { static const T value = V; };
+template <typename T> T get() { return Constant<T, 0>::value; }
+
+int i = get<int>();
+long l = get<long>();
+
+// Naming a specialization checks its arguments without instantiating it;
+// the type of V is substituted with the same arguments both times.
+typedef Constant<int, 1> One;
+typedef Constant<int, 2> Two;
@@ -1927,9 +1927,24 @@ int perform_code_completion(int argc, const char **argv, int timing_only) {
     enum CXCursorKind containerKind;
     CXString objCSelector;
     const char *selectorString;
+    const char *filter = getenv("CINDEXTEST_COMPLETION_FILTER");
     if (!timing_only) {      
-      /* Sort the code-completion results based on the typed text. */
-      clang_sortCodeCompletionResults(results->Results, results->NumResults);
+      if (filter) {
+        /* Filter as if the prefix was typed one character at a time. */
+        const char *max_results = getenv("CINDEXTEST_COMPLETION_MAX_RESULTS");
+        unsigned max = max_results ? (unsigned)atoi(max_results) : 0;
+        size_t len, filter_len = strlen(filter);
+        char *prefix = (char *)malloc(filter_len + 1);
+        for (len = 0; len <= filter_len; ++len) {
+          memcpy(prefix, filter, len);
+          prefix[len] = '\0';
+          n = clang_codeCompleteFilterResults(results, prefix, max);
+        }
+        free(prefix);
+      } else {
+        /* Sort the code-completion results based on the typed text. */
+        clang_sortCodeCompletionResults(results->Results, results->NumResults);
+      }
 
       for (i = 0; i != n; ++i)
         print_completion_result(results->Results + i, stdout);
@@ -2825,6 +2840,8 @@ static unsigned getIndexOptions(void) {
     index_opts |= CXIndexOpt_IndexFunctionLocalSymbols;
   if (!getenv("CINDEXTEST_DISABLE_SKIPPARSEDBODIES"))
     index_opts |= CXIndexOpt_SkipParsedBodiesInSession;
+  if (getenv("CINDEXTEST_SKIPINDEXEDHEADERS"))
+    index_opts |= CXIndexOpt_SkipIndexedHeadersInSession;
 
   return index_opts;
 }
@@ -2966,6 +2983,107 @@ static int index_tu(int argc, const char **argv) {
   return result;
 }
 
+static int write_index_db(int argc, const char **argv) {
+  const char *db_file;
+  CXIndex Idx;
+  CXIndexAction idxAction;
+  CXIndexDBWriter writer;
+  int result;
+
+  if (argc < 2) {
+    fprintf(stderr, "no compiler arguments\n");
+    return -1;
+  }
+  db_file = argv[0];
+
+  if (!(Idx = clang_createIndex(/* excludeDeclsFromPCH */ 1,
+                                /* displayDiagnostics=*/1))) {
+    fprintf(stderr, "Could not create Index\n");
+    return 1;
+  }
+  idxAction = clang_IndexAction_create(Idx);
+  writer = clang_IndexDBWriter_create();
+
+  result = clang_IndexDBWriter_indexSourceFile(writer, idxAction,
+                                               getIndexOptions(), 0,
+                                               argv + 1, argc - 1, 0, 0);
+  if (!result && clang_IndexDBWriter_write(writer, db_file)) {
+    fprintf(stderr, "unable to write index database '%s'\n", db_file);
+    result = 1;
+  }
+
+  clang_IndexDBWriter_dispose(writer);
+  clang_IndexAction_dispose(idxAction);
+  clang_disposeIndex(Idx);
+  return result;
+}
+
+static void print_index_db_occurrence(CXIndexDB db, CXIndexDBOccurrence occur) {
+  printf("  %s:%u:%u | %s | roles:", occur.file, occur.line, occur.column,
+         clang_IndexDB_getSymbolName(db, occur.symbol));
+  if (occur.roles & CXIndexDBRole_Declaration)
+    printf(" decl");
+  if (occur.roles & CXIndexDBRole_Definition)
+    printf(" def");
+  if (occur.roles & CXIndexDBRole_Reference)
+    printf(" ref");
+  if (occur.roles & CXIndexDBRole_Implicit)
+    printf(" implicit");
+  if (occur.container >= 0)
+    printf(" | container: %s",
+           clang_IndexDB_getSymbolUSR(db, occur.container));
+  printf("\n");
+}
+
+static int query_index_db(int argc, const char **argv) {
+  CXIndexDB db;
+  unsigned i, n;
+  int result = 0;
+
+  if (argc < 3 || (strcmp(argv[1], "usr") && strcmp(argv[1], "file"))) {
+    fprintf(stderr, "usage: -query-index-db <db file> (usr|file) <name>\n");
+    return 1;
+  }
+
+  db = clang_IndexDB_open(argv[0]);
+  if (!db) {
+    fprintf(stderr, "unable to open index database '%s'\n", argv[0]);
+    return 1;
+  }
+
+  if (strcmp(argv[1], "usr") == 0) {
+    int symbol = clang_IndexDB_findSymbol(db, argv[2]);
+    if (symbol < 0) {
+      printf("no symbol '%s'\n", argv[2]);
+      result = 1;
+    } else {
+      printf("%s | %s | %s\n", clang_IndexDB_getSymbolName(db, symbol),
+             clang_IndexDB_getSymbolUSR(db, symbol),
+             getEntityKindString(clang_IndexDB_getSymbolKind(db, symbol)));
+      n = clang_IndexDB_getNumSymbolOccurrences(db, symbol);
+      for (i = 0; i != n; ++i)
+        print_index_db_occurrence(db,
+                                  clang_IndexDB_getSymbolOccurrence(db, symbol,
+                                                                    i));
+    }
+  } else {
+    int file = clang_IndexDB_findFile(db, argv[2]);
+    if (file < 0) {
+      printf("no file '%s'\n", argv[2]);
+      result = 1;
+    } else {
+      printf("%s\n", argv[2]);
+      n = clang_IndexDB_getNumFileOccurrences(db, file);
+      for (i = 0; i != n; ++i)
+        print_index_db_occurrence(db,
+                                  clang_IndexDB_getFileOccurrence(db, file, i));
+    }
+  }
+
+  clang_IndexDB_dispose(db);
+  return result;
+}
+
 static int index_compile_db(int argc, const char **argv) {
   const char *check_prefix;
   CXIndex Idx;
@@ -2992,6 +3110,14 @@ static int index_compile_db(int argc, const char **argv) {
     return 1;
   }
   idxAction = clang_IndexAction_create(Idx);
+  if (getenv("CINDEXTEST_INDEXED_HEADERS_FILE") &&
+      clang_IndexAction_setIndexedHeadersFile(idxAction,
+                                  getenv("CINDEXTEST_INDEXED_HEADERS_FILE"))) {
+    fprintf(stderr, "Could not read the indexed headers file\n");
+    clang_IndexAction_dispose(idxAction);
+    clang_disposeIndex(Idx);
+    return 1;
+  }
 
   {
     const char *database = argv[0];
@@ -3733,6 +3859,8 @@ static void print_usage(void) {
     "       c-index-test -index-file-full [-check-prefix=<FileCheck prefix>] <compiler arguments>\n"
     "       c-index-test -index-tu [-check-prefix=<FileCheck prefix>] <AST file>\n"
     "       c-index-test -index-compile-db [-check-prefix=<FileCheck prefix>] <compilation database>\n"
+    "       c-index-test -write-index-db <db file> <compiler arguments>\n"
+    "       c-index-test -query-index-db <db file> (usr|file) <name>\n"
     "       c-index-test -test-file-scan <AST file> <source file> "
           "[FileCheck prefix]\n");
   fprintf(stderr,
@@ -3800,6 +3928,10 @@ int cindextest_main(int argc, const char **argv) {
     return index_tu(argc - 2, argv + 2);
   if (argc > 2 && strcmp(argv[1], "-index-compile-db") == 0)
     return index_compile_db(argc - 2, argv + 2);
+  if (argc > 2 && strcmp(argv[1], "-write-index-db") == 0)
+    return write_index_db(argc - 2, argv + 2);
+  if (argc > 2 && strcmp(argv[1], "-query-index-db") == 0)
+    return query_index_db(argc - 2, argv + 2);
   else if (argc >= 4 && strncmp(argv[1], "-test-load-tu", 13) == 0) {
     CXCursorVisitor I = GetVisitor(argv[1] + 13);
     if (I)
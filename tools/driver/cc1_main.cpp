@@ -13,6 +13,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Driver/Arg.h"
 #include "clang/Driver/ArgList.h"
 #include "clang/Driver/DriverDiagnostic.h"
@@ -24,10 +25,12 @@
 #include "clang/Frontend/TextDiagnosticBuffer.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/FrontendTool/Utils.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/LinkAllPasses.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/Timer.h"
@@ -55,6 +58,20 @@ static void LLVMErrorHandler(void *UserData, const std::string &Message,
   exit(GenCrashDiag ? 70 : 1);
 }
 
+/// \brief Determine where -ftime-trace writes its profile: next to the output
+/// file, or in the current directory when the output goes to stdout.
+static std::string getTimeTracePath(const FrontendOptions &Opts) {
+  SmallString<128> Path;
+  if (!Opts.OutputFile.empty() && Opts.OutputFile != "-")
+    Path = Opts.OutputFile;
+  else if (!Opts.Inputs.empty() && Opts.Inputs[0].isFile())
+    Path = llvm::sys::path::filename(Opts.Inputs[0].getFile());
+  else
+    Path = "clang";
+  llvm::sys::path::replace_extension(Path, "json");
+  return Path.str();
+}
+
 int cc1_main(const char **ArgBegin, const char **ArgEnd,
              const char *Argv0, void *MainAddr) {
   OwningPtr<CompilerInstance> Clang(new CompilerInstance());
@@ -95,8 +112,26 @@ int cc1_main(const char **ArgBegin, const char **ArgEnd,
   if (!Success)
     return 1;
 
+  if (Clang->getFrontendOpts().TimeTrace)
+    initTimeTraceProfiler();
+
   // Execute the frontend actions.
-  Success = ExecuteCompilerInvocation(Clang.get());
+  {
+    TimeTraceScope Scope("ExecuteCompiler");
+    Success = ExecuteCompilerInvocation(Clang.get());
+  }
+
+  if (isTimeTraceProfilerEnabled()) {
+    std::string Path = getTimeTracePath(Clang->getFrontendOpts());
+    std::string Error;
+    llvm::raw_fd_ostream OS(Path.c_str(), Error);
+    if (Error.empty())
+      writeTimeTraceProfile(OS);
+    else
+      Clang->getDiagnostics().Report(diag::err_fe_unable_to_open_output)
+        << Path << Error;
+    cleanupTimeTraceProfiler();
+  }
 
   // If any timers were active but haven't been destroyed yet, print their
   // results now.  This happens in -disable-free mode.
@@ -68,6 +68,7 @@ CXTranslationUnit cxtu::MakeCXTranslationUnit(CIndexer *CIdx, ASTUnit *AU) {
   D->StringPool = new cxstring::CXStringPool();
   D->Diagnostics = 0;
   D->OverridenCursorsPool = createOverridenCXCursorsPool();
+  D->USRCache = createUSRCache();
   D->FormatContext = 0;
   D->FormatInMemoryUniqueId = 0;
   return D;
@@ -2709,6 +2710,9 @@ static void clang_parseTranslationUnit_Impl(void *UserData) {
       printDiagsToStderr(Unit ? Unit.get() : ErrUnit.get());
   }
 
+  if (Unit && (options & CXTranslationUnit_RebuildPreambleInBackground))
+    Unit->setRebuildPreambleInBackground(true);
+
   PTUI->result = MakeCXTranslationUnit(CXXIdx, Unit.take());
 }
 CXTranslationUnit clang_parseTranslationUnit(CXIndex CIdx,
@@ -2842,6 +2846,7 @@ void clang_disposeTranslationUnit(CXTranslationUnit CTUnit) {
     delete CTUnit->StringPool;
     delete static_cast<CXDiagnosticSetImpl *>(CTUnit->Diagnostics);
     disposeOverridenCXCursorsPool(CTUnit->OverridenCursorsPool);
+    disposeUSRCache(CTUnit->USRCache);
     delete CTUnit->FormatContext;
     delete CTUnit;
   }
@@ -2882,6 +2887,9 @@ static void clang_reparseTranslationUnit_Impl(void *UserData) {
 
   ASTUnit *CXXUnit = cxtu::getASTUnit(TU);
   ASTUnit::ConcurrencyCheck Check(*CXXUnit);
+
+  // The declarations the cached USRs are keyed on are about to go away.
+  resetUSRCache(TU->USRCache);
   
   OwningPtr<std::vector<ASTUnit::RemappedFile> >
     RemappedFiles(new std::vector<ASTUnit::RemappedFile>());
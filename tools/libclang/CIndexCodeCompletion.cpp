@@ -21,6 +21,7 @@
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclObjC.h"
 #include "clang/AST/Type.h"
+#include "clang/Basic/CharInfo.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Frontend/ASTUnit.h"
@@ -29,12 +30,14 @@
 #include "clang/Sema/CodeCompleteConsumer.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Atomic.h"
 #include "llvm/Support/CrashRecoveryContext.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
@@ -305,6 +308,28 @@ struct AllocatedCXCodeCompleteResults : public CXCodeCompleteResults {
   /// \brief A string containing the Objective-C selector entered thus far for a
   /// message send.
   std::string Selector;
+
+  /// \brief The complete set of results, once \c Results has been narrowed
+  /// down by \c clang_codeCompleteFilterResults().
+  CXCompletionResult *AllResults;
+  unsigned NumAllResults;
+
+  /// \brief The typed text of each of \c AllResults, computed on the first
+  /// filtering.
+  std::vector<StringRef> TypedNames;
+
+  /// \brief Storage for typed names made of several typed-text chunks.
+  llvm::BumpPtrAllocator TypedNameAllocator;
+
+  /// \brief The prefix used by the last filtering.
+  std::string FilterPrefix;
+
+  /// \brief The indices into \c AllResults of every result that matched
+  /// \c FilterPrefix, regardless of the result limit.
+  std::vector<unsigned> FilterMatches;
+
+  /// \brief The storage \c Results points into after filtering.
+  std::vector<CXCompletionResult> FilteredResults;
 };
 
 } // end anonymous namespace
@@ -328,7 +353,9 @@ AllocatedCXCodeCompleteResults::AllocatedCXCodeCompleteResults(
     CodeCompletionAllocator(new clang::GlobalCodeCompletionAllocator),
     Contexts(CXCompletionContext_Unknown),
     ContainerKind(CXCursor_InvalidCode),
-    ContainerIsIncomplete(1)
+    ContainerIsIncomplete(1),
+    AllResults(0),
+    NumAllResults(0)
 { 
   if (getenv("LIBCLANG_OBJTRACKING")) {
     llvm::sys::AtomicIncrement(&CodeCompletionResultObjects);
@@ -337,7 +364,7 @@ AllocatedCXCodeCompleteResults::AllocatedCXCodeCompleteResults(
 }
   
 AllocatedCXCodeCompleteResults::~AllocatedCXCodeCompleteResults() {
-  delete [] Results;
+  delete [] (AllResults ? AllResults : Results);
 
   for (unsigned I = 0, N = TemporaryFiles.size(); I != N; ++I)
     TemporaryFiles[I].eraseFromDisk();
@@ -1000,3 +1027,170 @@ extern "C" {
     std::stable_sort(Results, Results + NumResults, OrderCompletionResults());
   }
 }
+
+/// \brief Whether the character at \p I starts a word of \p Name, e.g. the
+/// 'B' and 'c' of "getBar_count".
+static bool isWordStart(StringRef Name, unsigned I) {
+  if (I == 0)
+    return true;
+  char Prev = Name[I-1], C = Name[I];
+  if (Prev == '_' || Prev == ':')
+    return C != '_';
+  return isUppercase(C) && !isUppercase(Prev);
+}
+
+/// \brief Match the typed text \p Name of a result against \p Prefix.
+///
+/// \returns the quality of the match, lower being better, or ~0U if the
+/// result does not match at all. Every match of a prefix also matches any
+/// prefix of it, which is what allows filtering to be incremental.
+static unsigned matchCompletion(StringRef Name, StringRef Prefix) {
+  if (Prefix.empty())
+    return 0;
+  if (Name.startswith(Prefix))
+    return 0;
+  if (Name.size() >= Prefix.size() &&
+      Name.substr(0, Prefix.size()).equals_lower(Prefix))
+    return 1;
+
+  // Abbreviations, e.g. "gbc" for "getBar_count": each character of the
+  // prefix starts a word of the name, or continues the previous match.
+  unsigned N = 0, P = 0;
+  bool Contiguous = false;
+  while (P != Prefix.size() && N != Name.size()) {
+    if (toLowercase(Name[N]) == toLowercase(Prefix[P]) &&
+        (Contiguous || isWordStart(Name, N))) {
+      ++P;
+      Contiguous = true;
+    } else {
+      Contiguous = false;
+    }
+    ++N;
+  }
+  if (P == Prefix.size())
+    return 2;
+
+  // Anything else that contains the characters of the prefix, in order.
+  N = 0;
+  P = 0;
+  while (P != Prefix.size() && N != Name.size()) {
+    if (toLowercase(Name[N]) == toLowercase(Prefix[P]))
+      ++P;
+    ++N;
+  }
+  if (P == Prefix.size())
+    return 3;
+
+  return ~0U;
+}
+
+namespace {
+  /// \brief A result that matched the filter prefix, along with the keys it
+  /// is ranked by.
+  struct RankedCompletion {
+    unsigned Quality;
+    unsigned Priority;
+    unsigned Index;
+    StringRef Name;
+  };
+
+  struct OrderRankedCompletions {
+    bool operator()(const RankedCompletion &X,
+                    const RankedCompletion &Y) const {
+      if (X.Quality != Y.Quality)
+        return X.Quality < Y.Quality;
+      if (X.Priority != Y.Priority)
+        return X.Priority < Y.Priority;
+      if (X.Name.empty() || Y.Name.empty())
+        return !X.Name.empty() && Y.Name.empty();
+      if (int Result = X.Name.compare_lower(Y.Name))
+        return Result < 0;
+      if (int Result = X.Name.compare(Y.Name))
+        return Result < 0;
+      return X.Index < Y.Index;
+    }
+  };
+}
+
+extern "C" {
+  unsigned clang_codeCompleteFilterResults(CXCodeCompleteResults *ResultsIn,
+                                           const char *Prefix,
+                                           unsigned MaxResults) {
+    AllocatedCXCodeCompleteResults *Results
+      = static_cast<AllocatedCXCodeCompleteResults *>(ResultsIn);
+    if (!Results)
+      return 0;
+    StringRef PrefixStr(Prefix ? Prefix : "");
+
+    // Take over the original result array the first time through.
+    bool Incremental = true;
+    if (!Results->AllResults) {
+      Results->AllResults = Results->Results;
+      Results->NumAllResults = Results->NumResults;
+      Results->TypedNames.reserve(Results->NumAllResults);
+      for (unsigned I = 0, N = Results->NumAllResults; I != N; ++I) {
+        SmallString<256> Buffer;
+        StringRef Name = GetTypedName(
+           (CodeCompletionString *)Results->AllResults[I].CompletionString,
+           Buffer);
+        // Names assembled from several chunks live in the local buffer.
+        if (Name.data() == Buffer.data()) {
+          char *Copy = Results->TypedNameAllocator.Allocate<char>(Name.size());
+          std::memcpy(Copy, Name.data(), Name.size());
+          Name = StringRef(Copy, Name.size());
+        }
+        Results->TypedNames.push_back(Name);
+      }
+      Incremental = false;
+    } else {
+      StringRef Previous = Results->FilterPrefix;
+      Incremental = PrefixStr.size() >= Previous.size() &&
+                    PrefixStr.substr(0, Previous.size()).equals_lower(Previous);
+    }
+
+    // When the user keeps typing the same token, only the results that
+    // matched last time can match now.
+    std::vector<RankedCompletion> Ranked;
+    unsigned NumCandidates = Incremental ? Results->FilterMatches.size()
+                                         : Results->NumAllResults;
+    Ranked.reserve(NumCandidates);
+    for (unsigned I = 0; I != NumCandidates; ++I) {
+      unsigned Index = Incremental ? Results->FilterMatches[I] : I;
+      StringRef Name = Results->TypedNames[Index];
+      unsigned Quality = matchCompletion(Name, PrefixStr);
+      if (Quality == ~0U)
+        continue;
+
+      RankedCompletion R;
+      R.Quality = Quality;
+      R.Priority = clang_getCompletionPriority(
+                               Results->AllResults[Index].CompletionString);
+      R.Index = Index;
+      R.Name = Name;
+      Ranked.push_back(R);
+    }
+
+    Results->FilterPrefix = PrefixStr;
+    Results->FilterMatches.clear();
+    Results->FilterMatches.reserve(Ranked.size());
+    for (unsigned I = 0, N = Ranked.size(); I != N; ++I)
+      Results->FilterMatches.push_back(Ranked[I].Index);
+
+    unsigned NumKept = Ranked.size();
+    if (MaxResults && MaxResults < NumKept) {
+      NumKept = MaxResults;
+      std::partial_sort(Ranked.begin(), Ranked.begin() + NumKept, Ranked.end(),
+                        OrderRankedCompletions());
+    } else {
+      std::sort(Ranked.begin(), Ranked.end(), OrderRankedCompletions());
+    }
+
+    Results->FilteredResults.clear();
+    Results->FilteredResults.reserve(NumKept);
+    for (unsigned I = 0; I != NumKept; ++I)
+      Results->FilteredResults.push_back(Results->AllResults[Ranked[I].Index]);
+    Results->Results = NumKept ? &Results->FilteredResults[0] : 0;
+    Results->NumResults = NumKept;
+    return NumKept;
+  }
+}
@@ -14,12 +14,16 @@
 #include "CIndexer.h"
 #include "CXCursor.h"
 #include "CXString.h"
+#include "CXTranslationUnit.h"
 #include "clang/AST/DeclTemplate.h"
 #include "clang/AST/DeclVisitor.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Lex/PreprocessingRecord.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cstdlib>
 
 using namespace clang;
 
@@ -28,6 +32,8 @@ using namespace clang;
 //===----------------------------------------------------------------------===//
 
 namespace {
+class USRCache;
+
 class USRGenerator : public ConstDeclVisitor<USRGenerator> {
   OwningPtr<SmallString<128> > OwnedBuf;
   SmallVectorImpl<char> &Buf;
@@ -35,17 +41,20 @@ class USRGenerator : public ConstDeclVisitor<USRGenerator> {
   bool IgnoreResults;
   ASTContext *Context;
   bool generatedLoc;
+  USRCache *Cache;
   
   llvm::DenseMap<const Type *, unsigned> TypeSubstitutions;
   
 public:
-  explicit USRGenerator(ASTContext *Ctx = 0, SmallVectorImpl<char> *extBuf = 0)
+  explicit USRGenerator(ASTContext *Ctx = 0, SmallVectorImpl<char> *extBuf = 0,
+                        USRCache *cache = 0)
   : OwnedBuf(extBuf ? 0 : new SmallString<128>()),
     Buf(extBuf ? *extBuf : *OwnedBuf.get()),
     Out(Buf),
     IgnoreResults(false),
     Context(Ctx),
-    generatedLoc(false)
+    generatedLoc(false),
+    Cache(cache)
   {
     // Add the USR space prefix.
     Out << "c:";
@@ -64,6 +73,8 @@ public:
   }
 
   bool ignoreResults() const { return IgnoreResults; }
+  bool hasGeneratedLoc() const { return generatedLoc; }
+  bool hasTypeSubstitutions() const { return !TypeSubstitutions.empty(); }
 
   // Visitation methods from generating USRs from AST elements.
   void VisitDeclContext(const DeclContext *D);
@@ -135,8 +146,72 @@ public:
   bool EmitDeclName(const NamedDecl *D);
 };
 
+/// \brief The USR generated for a declaration, along with the generator state
+/// that influences the USRs of declarations nested inside it.
+struct CachedUSR {
+  /// \brief The interned USR, or null if the result should be ignored.
+  const llvm::StringMapEntry<char> *USR;
+  /// \brief Whether a location component was emitted.
+  bool GeneratedLoc;
+  /// \brief Whether the USR recorded type substitutions, which nested
+  /// declarations could refer back to.
+  bool UsedTypeSubstitutions;
+};
+
+/// \brief Caches the USRs of the declarations of a translation unit.
+///
+/// Entries are keyed on the declaration itself rather than its canonical
+/// declaration: redeclarations do not always share a USR (e.g. a block-scope
+/// extern variable is mangled with its enclosing function).
+///
+/// Setting LIBCLANG_DISABLE_USR_CACHE generates every USR from scratch
+/// instead, which lets tests check that cached USRs match generated ones.
+class USRCache {
+  llvm::DenseMap<const Decl *, CachedUSR> Decls;
+  llvm::StringMap<char, llvm::BumpPtrAllocator> Strings;
+  bool Enabled;
+
+public:
+  USRCache() : Enabled(!::getenv("LIBCLANG_DISABLE_USR_CACHE")) { }
+
+  CachedUSR get(const Decl *D, ASTContext *Ctx);
+
+  void reset() { Decls.clear(); }
+};
+
 } // end anonymous namespace
 
+CachedUSR USRCache::get(const Decl *D, ASTContext *Ctx) {
+  if (!Enabled) {
+    SmallString<128> Buf;
+    USRGenerator UG(Ctx, &Buf);
+    UG->Visit(D);
+
+    CachedUSR Entry;
+    Entry.USR = UG->ignoreResults() ? 0 : &Strings.GetOrCreateValue(UG->str());
+    Entry.GeneratedLoc = UG->hasGeneratedLoc();
+    Entry.UsedTypeSubstitutions = UG->hasTypeSubstitutions();
+    return Entry;
+  }
+
+  llvm::DenseMap<const Decl *, CachedUSR>::iterator I = Decls.find(D);
+  if (I != Decls.end())
+    return I->second;
+
+  // Generating the USR may recursively populate the cache with the enclosing
+  // declaration contexts, so don't hold on to iterators across it.
+  SmallString<128> Buf;
+  USRGenerator UG(Ctx, &Buf, this);
+  UG->Visit(D);
+
+  CachedUSR Entry;
+  Entry.USR = UG->ignoreResults() ? 0 : &Strings.GetOrCreateValue(UG->str());
+  Entry.GeneratedLoc = UG->hasGeneratedLoc();
+  Entry.UsedTypeSubstitutions = UG->hasTypeSubstitutions();
+  Decls[D] = Entry;
+  return Entry;
+}
+
 //===----------------------------------------------------------------------===//
 // Generating USRs from ASTS.
 //===----------------------------------------------------------------------===//
@@ -155,8 +230,26 @@ static inline bool ShouldGenerateLocation(const NamedDecl *D) {
 }
 
 void USRGenerator::VisitDeclContext(const DeclContext *DC) {
-  if (const NamedDecl *D = dyn_cast<NamedDecl>(DC))
-    Visit(D);
+  const NamedDecl *D = dyn_cast<NamedDecl>(DC);
+  if (!D)
+    return;
+
+  // Splice in the cached USR of the context, unless generating it from scratch
+  // could differ because of state accumulated by this generator, or the
+  // nested declaration needs the type substitutions the context recorded.
+  if (Cache && !generatedLoc && TypeSubstitutions.empty()) {
+    CachedUSR Prefix = Cache->get(D, Context);
+    if (!Prefix.UsedTypeSubstitutions) {
+      if (Prefix.USR)
+        Out << Prefix.USR->getKey().substr(2);
+      else
+        IgnoreResults = true;
+      generatedLoc = Prefix.GeneratedLoc;
+      return;
+    }
+  }
+
+  Visit(D);
 }
 
 void USRGenerator::VisitFieldDecl(const FieldDecl *D) {
@@ -818,6 +911,33 @@ bool cxcursor::getDeclCursorUSR(const Decl *D, SmallVectorImpl<char> &Buf) {
   return false;
 }
 
+bool cxcursor::getDeclCursorUSR(const Decl *D, CXTranslationUnit TU,
+                                StringRef &USR) {
+  // Don't generate USRs for things with invalid locations.
+  if (!D || D->getLocStart().isInvalid())
+    return true;
+
+  USRCache *Cache = static_cast<USRCache *>(TU->USRCache);
+  CachedUSR Entry = Cache->get(D, &D->getASTContext());
+  if (!Entry.USR)
+    return true;
+
+  USR = Entry.USR->getKey();
+  return false;
+}
+
+void *cxcursor::createUSRCache() {
+  return new USRCache();
+}
+
+void cxcursor::resetUSRCache(void *cache) {
+  static_cast<USRCache *>(cache)->reset();
+}
+
+void cxcursor::disposeUSRCache(void *cache) {
+  delete static_cast<USRCache *>(cache);
+}
+
 extern "C" {
 
 CXString clang_getCursorUSR(CXCursor C) {
@@ -832,20 +952,13 @@ CXString clang_getCursorUSR(CXCursor C) {
     if (!TU)
       return cxstring::createEmpty();
 
-    cxstring::CXStringBuf *buf = cxstring::getCXStringBuf(TU);
-    if (!buf)
+    StringRef USR;
+    if (cxcursor::getDeclCursorUSR(D, TU, USR))
       return cxstring::createEmpty();
 
-    bool Ignore = cxcursor::getDeclCursorUSR(D, buf->Data);
-    if (Ignore) {
-      buf->dispose();
-      return cxstring::createEmpty();
-    }
-
-    // Return the C-string, but don't make a copy since it is already in
-    // the string buffer.
-    buf->Data.push_back('\0');
-    return createCXString(buf);
+    // Return the C-string, but don't make a copy since it is interned in the
+    // translation unit.
+    return cxstring::createRef(USR.data());
   }
 
   if (K == CXCursor_MacroDefinition) {
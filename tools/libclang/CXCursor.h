@@ -287,6 +287,26 @@ CXCursor getTypeRefCursor(CXCursor cursor);
 /// false otherwise.
 bool getDeclCursorUSR(const Decl *D, SmallVectorImpl<char> &Buf);
 
+/// \brief Retrieve the USR for \arg D from the USR cache of \arg TU,
+/// generating it on first use.
+///
+/// The string referenced by \arg USR is nul-terminated and owned by the
+/// translation unit; it remains valid until the translation unit is disposed.
+/// \returns true if no USR was computed or the result should be ignored,
+/// false otherwise.
+bool getDeclCursorUSR(const Decl *D, CXTranslationUnit TU, StringRef &USR);
+
+/// \brief Create an opaque cache of the USRs generated for the declarations
+/// of a translation unit.
+void *createUSRCache();
+
+/// \brief Forget the declarations recorded in the USR cache, e.g. because the
+/// translation unit was reparsed. Strings previously handed out stay valid.
+void resetUSRCache(void *cache);
+
+/// \brief Dispose of the USR cache.
+void disposeUSRCache(void *cache);
+
 bool operator==(CXCursor X, CXCursor Y);
   
 inline bool operator!=(CXCursor X, CXCursor Y) {
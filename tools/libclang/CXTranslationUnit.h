@@ -29,6 +29,7 @@ struct CXTranslationUnitImpl {
   clang::cxstring::CXStringPool *StringPool;
   void *Diagnostics;
   void *OverridenCursorsPool;
+  void *USRCache;
   clang::SimpleFormatContext *FormatContext;
   unsigned FormatInMemoryUniqueId;
 };
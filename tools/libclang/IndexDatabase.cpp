@@ -0,0 +1,705 @@
+//===- IndexDatabase.cpp - Memory-mappable database of index results ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the CXIndexDBWriter and CXIndexDB APIs: a built-in
+// indexer client that collects the entities and references reported while
+// indexing into a compact binary database, and a reader for such databases
+// that works directly on the memory-mapped file.
+//
+// The database is a sequence of little-endian 32-bit words:
+//
+//   Header:          Magic, Version, NumSymbols, NumFiles, NumOccurrences,
+//                    StringTableSize
+//   Symbols:         {USR, Name, Kind, FirstOccurrence, NumOccurrences}
+//                    sorted by USR
+//   Files:           {Path, FirstFileOccurrence, NumFileOccurrences}
+//                    sorted by path
+//   Occurrences:     {Symbol, Container, File, Line, Column, Roles}
+//                    sorted by symbol, then by file and position
+//   FileOccurrences: indices into Occurrences, sorted by file and position
+//   StringTable:     nul-terminated strings, referenced by byte offset
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang-c/Index.h"
+#include "CLog.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/OnDiskHashTable.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace clang;
+
+namespace {
+
+enum {
+  IndexDBMagic = 0x42444943, // 'CIDB'
+  IndexDBVersion = 1,
+
+  HeaderWords = 6,
+  SymbolWords = 5,
+  FileWords = 3,
+  OccurrenceWords = 6,
+
+  NoContainer = ~0U
+};
+
+//===----------------------------------------------------------------------===//
+// IndexDBWriter
+//===----------------------------------------------------------------------===//
+
+struct DBOccurrence {
+  unsigned Symbol;
+  unsigned Container;
+  unsigned File;
+  unsigned Line;
+  unsigned Column;
+  unsigned Roles;
+
+  friend bool operator<(const DBOccurrence &LHS, const DBOccurrence &RHS) {
+    if (LHS.Symbol != RHS.Symbol) return LHS.Symbol < RHS.Symbol;
+    if (LHS.File != RHS.File) return LHS.File < RHS.File;
+    if (LHS.Line != RHS.Line) return LHS.Line < RHS.Line;
+    if (LHS.Column != RHS.Column) return LHS.Column < RHS.Column;
+    if (LHS.Roles != RHS.Roles) return LHS.Roles < RHS.Roles;
+    return LHS.Container < RHS.Container;
+  }
+
+  friend bool operator==(const DBOccurrence &LHS, const DBOccurrence &RHS) {
+    return LHS.Symbol == RHS.Symbol && LHS.Container == RHS.Container &&
+        LHS.File == RHS.File && LHS.Line == RHS.Line &&
+        LHS.Column == RHS.Column && LHS.Roles == RHS.Roles;
+  }
+};
+
+/// \brief Orders occurrence indices by file and position in the file.
+class FileOccurrenceCompare {
+  const std::vector<DBOccurrence> &Occurrences;
+public:
+  explicit FileOccurrenceCompare(const std::vector<DBOccurrence> &Occurrences)
+    : Occurrences(Occurrences) { }
+
+  bool operator()(unsigned LHSIdx, unsigned RHSIdx) const {
+    const DBOccurrence &LHS = Occurrences[LHSIdx];
+    const DBOccurrence &RHS = Occurrences[RHSIdx];
+    if (LHS.File != RHS.File) return LHS.File < RHS.File;
+    if (LHS.Line != RHS.Line) return LHS.Line < RHS.Line;
+    if (LHS.Column != RHS.Column) return LHS.Column < RHS.Column;
+    return LHSIdx < RHSIdx;
+  }
+};
+
+/// \brief Orders indices of entries of a StringMap by their key.
+template <typename MapEntryTy>
+class KeyCompare {
+  const std::vector<MapEntryTy *> &Entries;
+public:
+  explicit KeyCompare(const std::vector<MapEntryTy *> &Entries)
+    : Entries(Entries) { }
+
+  bool operator()(unsigned LHS, unsigned RHS) const {
+    return Entries[LHS]->getKey() < Entries[RHS]->getKey();
+  }
+};
+
+class IndexDBWriter {
+  struct SymbolInfo {
+    std::string Name;
+    CXIdxEntityKind Kind;
+  };
+
+  typedef llvm::StringMapEntry<unsigned> EntryTy;
+
+  /// \brief Interned USRs and file paths, mapped to the order they were first
+  /// seen in; they get sorted when the database is written.
+  llvm::StringMap<unsigned> USRs;
+  std::vector<EntryTy *> SymbolEntries;
+  std::vector<SymbolInfo> Symbols;
+  llvm::StringMap<unsigned> Paths;
+  std::vector<EntryTy *> FileEntries;
+
+  std::vector<DBOccurrence> Occurrences;
+
+  /// \brief The files of the translation unit currently being indexed.
+  llvm::DenseMap<CXFile, unsigned> TUFiles;
+
+public:
+  /// \brief Prepare for receiving the results of a new translation unit.
+  void startTranslationUnit() { TUFiles.clear(); }
+
+  unsigned getSymbol(const CXIdxEntityInfo *Info) {
+    EntryTy &Entry = USRs.GetOrCreateValue(Info->USR, ~0U);
+    if (Entry.getValue() == ~0U) {
+      Entry.setValue(SymbolEntries.size());
+      SymbolEntries.push_back(&Entry);
+      SymbolInfo Sym;
+      Sym.Name = Info->name ? Info->name : "";
+      Sym.Kind = Info->kind;
+      Symbols.push_back(Sym);
+    }
+    return Entry.getValue();
+  }
+
+  void addOccurrence(unsigned Symbol, unsigned Container, CXIdxLoc Loc,
+                     unsigned Roles) {
+    CXFile File;
+    unsigned Line, Column;
+    clang_indexLoc_getFileLocation(Loc, 0, &File, &Line, &Column, 0);
+    if (!File)
+      return;
+
+    DBOccurrence Occur = { Symbol, Container, getFile(File), Line, Column,
+                           Roles };
+    Occurrences.push_back(Occur);
+  }
+
+  bool write(raw_ostream &OS);
+
+private:
+  unsigned getFile(CXFile File) {
+    unsigned &TUFile = TUFiles[File];
+    if (TUFile)
+      return TUFile - 1;
+
+    StringRef Path = static_cast<FileEntry *>(File)->getName();
+    EntryTy &Entry = Paths.GetOrCreateValue(Path, ~0U);
+    if (Entry.getValue() == ~0U) {
+      Entry.setValue(FileEntries.size());
+      FileEntries.push_back(&Entry);
+    }
+    TUFile = Entry.getValue() + 1;
+    return Entry.getValue();
+  }
+};
+
+/// \brief Collects the strings of the database, each of them once.
+class StringTableBuilder {
+  llvm::StringMap<unsigned> Offsets;
+  std::string Data;
+
+public:
+  unsigned add(StringRef Str) {
+    llvm::StringMapEntry<unsigned> &Entry =
+      Offsets.GetOrCreateValue(Str, ~0U);
+    if (Entry.getValue() == ~0U) {
+      Entry.setValue(Data.size());
+      Data += Str;
+      Data += '\0';
+    }
+    return Entry.getValue();
+  }
+
+  StringRef getData() const { return Data; }
+};
+
+/// \brief Computes the permutation that sorts the given entries by key, and
+/// its inverse.
+static void sortEntries(const std::vector<llvm::StringMapEntry<unsigned> *>
+                          &Entries,
+                        std::vector<unsigned> &Order,
+                        std::vector<unsigned> &NewIndex) {
+  Order.resize(Entries.size());
+  for (unsigned I = 0, E = Order.size(); I != E; ++I)
+    Order[I] = I;
+  std::sort(Order.begin(), Order.end(),
+            KeyCompare<llvm::StringMapEntry<unsigned> >(Entries));
+  NewIndex.resize(Order.size());
+  for (unsigned I = 0, E = Order.size(); I != E; ++I)
+    NewIndex[Order[I]] = I;
+}
+
+bool IndexDBWriter::write(raw_ostream &OS) {
+  using namespace clang::io;
+
+  std::vector<unsigned> SymbolOrder, NewSymbol, FileOrder, NewFile;
+  sortEntries(SymbolEntries, SymbolOrder, NewSymbol);
+  sortEntries(FileEntries, FileOrder, NewFile);
+
+  // Renumber the occurrences and drop the duplicates that come from headers
+  // indexed as part of several translation units.
+  std::vector<DBOccurrence> Occurs(Occurrences);
+  for (unsigned I = 0, E = Occurs.size(); I != E; ++I) {
+    DBOccurrence &Occur = Occurs[I];
+    Occur.Symbol = NewSymbol[Occur.Symbol];
+    if (Occur.Container != NoContainer)
+      Occur.Container = NewSymbol[Occur.Container];
+    Occur.File = NewFile[Occur.File];
+  }
+  std::sort(Occurs.begin(), Occurs.end());
+  Occurs.erase(std::unique(Occurs.begin(), Occurs.end()), Occurs.end());
+
+  std::vector<unsigned> FileOccurs(Occurs.size());
+  for (unsigned I = 0, E = FileOccurs.size(); I != E; ++I)
+    FileOccurs[I] = I;
+  std::sort(FileOccurs.begin(), FileOccurs.end(),
+            FileOccurrenceCompare(Occurs));
+
+  StringTableBuilder Strings;
+
+  Emit32(OS, IndexDBMagic);
+  Emit32(OS, IndexDBVersion);
+  Emit32(OS, SymbolOrder.size());
+  Emit32(OS, FileOrder.size());
+  Emit32(OS, Occurs.size());
+
+  // The string table comes last, but its size is part of the header; intern
+  // all the strings upfront.
+  std::vector<unsigned> SymbolStrings;
+  SymbolStrings.reserve(SymbolOrder.size() * 2);
+  for (unsigned I = 0, E = SymbolOrder.size(); I != E; ++I) {
+    SymbolStrings.push_back(Strings.add(SymbolEntries[SymbolOrder[I]]->getKey()));
+    SymbolStrings.push_back(Strings.add(Symbols[SymbolOrder[I]].Name));
+  }
+  std::vector<unsigned> FileStrings;
+  FileStrings.reserve(FileOrder.size());
+  for (unsigned I = 0, E = FileOrder.size(); I != E; ++I)
+    FileStrings.push_back(Strings.add(FileEntries[FileOrder[I]]->getKey()));
+  Emit32(OS, Strings.getData().size());
+
+  unsigned OccurIdx = 0;
+  for (unsigned I = 0, E = SymbolOrder.size(); I != E; ++I) {
+    unsigned First = OccurIdx;
+    while (OccurIdx != Occurs.size() && Occurs[OccurIdx].Symbol == I)
+      ++OccurIdx;
+    Emit32(OS, SymbolStrings[2*I]);
+    Emit32(OS, SymbolStrings[2*I + 1]);
+    Emit32(OS, Symbols[SymbolOrder[I]].Kind);
+    Emit32(OS, First);
+    Emit32(OS, OccurIdx - First);
+  }
+
+  OccurIdx = 0;
+  for (unsigned I = 0, E = FileOrder.size(); I != E; ++I) {
+    unsigned First = OccurIdx;
+    while (OccurIdx != FileOccurs.size() &&
+           Occurs[FileOccurs[OccurIdx]].File == I)
+      ++OccurIdx;
+    Emit32(OS, FileStrings[I]);
+    Emit32(OS, First);
+    Emit32(OS, OccurIdx - First);
+  }
+
+  for (unsigned I = 0, E = Occurs.size(); I != E; ++I) {
+    const DBOccurrence &Occur = Occurs[I];
+    Emit32(OS, Occur.Symbol);
+    Emit32(OS, Occur.Container);
+    Emit32(OS, Occur.File);
+    Emit32(OS, Occur.Line);
+    Emit32(OS, Occur.Column);
+    Emit32(OS, Occur.Roles);
+  }
+
+  for (unsigned I = 0, E = FileOccurs.size(); I != E; ++I)
+    Emit32(OS, FileOccurs[I]);
+
+  OS << Strings.getData();
+  OS.flush();
+  return !OS.has_error();
+}
+
+//===----------------------------------------------------------------------===//
+// IndexerCallbacks feeding an IndexDBWriter
+//===----------------------------------------------------------------------===//
+
+static void *containerToClient(unsigned Symbol) {
+  return reinterpret_cast<void *>(static_cast<uintptr_t>(Symbol) + 1);
+}
+
+static unsigned clientToContainer(void *Client) {
+  if (!Client)
+    return NoContainer;
+  return static_cast<unsigned>(reinterpret_cast<uintptr_t>(Client) - 1);
+}
+
+static void indexDBDeclaration(CXClientData client_data,
+                               const CXIdxDeclInfo *info) {
+  IndexDBWriter &Writer = *static_cast<IndexDBWriter *>(client_data);
+  if (!info->entityInfo || !info->entityInfo->USR ||
+      !info->entityInfo->USR[0])
+    return;
+
+  unsigned Symbol = Writer.getSymbol(info->entityInfo);
+  if (info->declAsContainer)
+    clang_index_setClientContainer(info->declAsContainer,
+                                   containerToClient(Symbol));
+
+  unsigned Container = NoContainer;
+  if (info->semanticContainer)
+    Container =
+      clientToContainer(clang_index_getClientContainer(info->semanticContainer));
+
+  unsigned Roles = CXIndexDBRole_Declaration;
+  if (info->isDefinition)
+    Roles |= CXIndexDBRole_Definition;
+  if (info->isImplicit)
+    Roles |= CXIndexDBRole_Implicit;
+  Writer.addOccurrence(Symbol, Container, info->loc, Roles);
+}
+
+static void indexDBEntityReference(CXClientData client_data,
+                                   const CXIdxEntityRefInfo *info) {
+  IndexDBWriter &Writer = *static_cast<IndexDBWriter *>(client_data);
+  if (!info->referencedEntity || !info->referencedEntity->USR ||
+      !info->referencedEntity->USR[0])
+    return;
+
+  unsigned Symbol = Writer.getSymbol(info->referencedEntity);
+  unsigned Container = NoContainer;
+  if (info->container)
+    Container = clientToContainer(clang_index_getClientContainer(info->container));
+
+  unsigned Roles = CXIndexDBRole_Reference;
+  if (info->kind == CXIdxEntityRef_Implicit)
+    Roles |= CXIndexDBRole_Implicit;
+  Writer.addOccurrence(Symbol, Container, info->loc, Roles);
+}
+
+static IndexerCallbacks getIndexDBCallbacks() {
+  IndexerCallbacks CB;
+  memset(&CB, 0, sizeof(CB));
+  CB.indexDeclaration = indexDBDeclaration;
+  CB.indexEntityReference = indexDBEntityReference;
+  return CB;
+}
+
+//===----------------------------------------------------------------------===//
+// IndexDB
+//===----------------------------------------------------------------------===//
+
+class IndexDB {
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  const unsigned char *Symbols;
+  const unsigned char *Files;
+  const unsigned char *Occurrences;
+  const unsigned char *FileOccurrences;
+  const char *StringTable;
+  unsigned NumSymbols, NumFiles, NumOccurrences, StringTableSize;
+
+  static unsigned readWord(const unsigned char *Base, unsigned Idx) {
+    const unsigned char *Data = Base + 4 * Idx;
+    return clang::io::ReadUnalignedLE32(Data);
+  }
+
+  const char *getString(unsigned Offset) const {
+    if (Offset >= StringTableSize)
+      return "";
+    return StringTable + Offset;
+  }
+
+  int compareSymbolUSR(unsigned Symbol, const char *USR) const {
+    return strcmp(getString(readWord(Symbols, Symbol * SymbolWords)), USR);
+  }
+
+  int compareFilePath(unsigned File, const char *Path) const {
+    return strcmp(getString(readWord(Files, File * FileWords)), Path);
+  }
+
+public:
+  explicit IndexDB(llvm::MemoryBuffer *Buf)
+    : Buffer(Buf), Symbols(0), Files(0), Occurrences(0), FileOccurrences(0),
+      StringTable(0), NumSymbols(0), NumFiles(0), NumOccurrences(0),
+      StringTableSize(0) { }
+
+  /// \brief Check the header and the layout of the database.
+  bool init();
+
+  unsigned getNumSymbols() const { return NumSymbols; }
+  unsigned getNumFiles() const { return NumFiles; }
+
+  int findSymbol(const char *USR) const {
+    unsigned Lo = 0, Hi = NumSymbols;
+    while (Lo < Hi) {
+      unsigned Mid = Lo + (Hi - Lo) / 2;
+      int Cmp = compareSymbolUSR(Mid, USR);
+      if (Cmp == 0)
+        return Mid;
+      if (Cmp < 0)
+        Lo = Mid + 1;
+      else
+        Hi = Mid;
+    }
+    return -1;
+  }
+
+  const char *getSymbolUSR(unsigned Symbol) const {
+    return getString(readWord(Symbols, Symbol * SymbolWords));
+  }
+  const char *getSymbolName(unsigned Symbol) const {
+    return getString(readWord(Symbols, Symbol * SymbolWords + 1));
+  }
+  CXIdxEntityKind getSymbolKind(unsigned Symbol) const {
+    return (CXIdxEntityKind)readWord(Symbols, Symbol * SymbolWords + 2);
+  }
+  unsigned getNumSymbolOccurrences(unsigned Symbol) const {
+    return readWord(Symbols, Symbol * SymbolWords + 4);
+  }
+  CXIndexDBOccurrence getSymbolOccurrence(unsigned Symbol,
+                                          unsigned Index) const {
+    return getOccurrence(readWord(Symbols, Symbol * SymbolWords + 3) + Index);
+  }
+
+  int findFile(const char *Path) const {
+    unsigned Lo = 0, Hi = NumFiles;
+    while (Lo < Hi) {
+      unsigned Mid = Lo + (Hi - Lo) / 2;
+      int Cmp = compareFilePath(Mid, Path);
+      if (Cmp == 0)
+        return Mid;
+      if (Cmp < 0)
+        Lo = Mid + 1;
+      else
+        Hi = Mid;
+    }
+    return -1;
+  }
+
+  unsigned getNumFileOccurrences(unsigned File) const {
+    return readWord(Files, File * FileWords + 2);
+  }
+  CXIndexDBOccurrence getFileOccurrence(unsigned File, unsigned Index) const {
+    unsigned First = readWord(Files, File * FileWords + 1);
+    return getOccurrence(readWord(FileOccurrences, First + Index));
+  }
+
+private:
+  CXIndexDBOccurrence getOccurrence(unsigned Idx) const {
+    CXIndexDBOccurrence Occur = { -1, -1, "", 0, 0, 0 };
+    if (Idx >= NumOccurrences)
+      return Occur;
+
+    unsigned Base = Idx * OccurrenceWords;
+    Occur.symbol = readWord(Occurrences, Base);
+    unsigned Container = readWord(Occurrences, Base + 1);
+    Occur.container = Container == NoContainer ? -1 : (int)Container;
+    unsigned File = readWord(Occurrences, Base + 2);
+    if (File < NumFiles)
+      Occur.file = getString(readWord(Files, File * FileWords));
+    Occur.line = readWord(Occurrences, Base + 3);
+    Occur.column = readWord(Occurrences, Base + 4);
+    Occur.roles = readWord(Occurrences, Base + 5);
+    return Occur;
+  }
+};
+
+bool IndexDB::init() {
+  const unsigned char *Start =
+    reinterpret_cast<const unsigned char *>(Buffer->getBufferStart());
+  uint64_t Size = Buffer->getBufferSize();
+  if (Size < HeaderWords * 4)
+    return false;
+  if (readWord(Start, 0) != IndexDBMagic ||
+      readWord(Start, 1) != IndexDBVersion)
+    return false;
+
+  NumSymbols = readWord(Start, 2);
+  NumFiles = readWord(Start, 3);
+  NumOccurrences = readWord(Start, 4);
+  StringTableSize = readWord(Start, 5);
+
+  uint64_t Words = HeaderWords;
+  Symbols = Start + 4 * Words;
+  Words += (uint64_t)NumSymbols * SymbolWords;
+  Files = Start + 4 * Words;
+  Words += (uint64_t)NumFiles * FileWords;
+  Occurrences = Start + 4 * Words;
+  Words += (uint64_t)NumOccurrences * OccurrenceWords;
+  FileOccurrences = Start + 4 * Words;
+  Words += NumOccurrences;
+  if (4 * Words + StringTableSize != Size)
+    return false;
+  StringTable = reinterpret_cast<const char *>(Start + 4 * Words);
+  if (StringTableSize && StringTable[StringTableSize - 1] != '\0')
+    return false;
+
+  // Make sure the occurrence ranges stay inside the occurrence tables.
+  for (unsigned I = 0; I != NumSymbols; ++I) {
+    uint64_t First = readWord(Symbols, I * SymbolWords + 3);
+    if (First + readWord(Symbols, I * SymbolWords + 4) > NumOccurrences)
+      return false;
+  }
+  for (unsigned I = 0; I != NumFiles; ++I) {
+    uint64_t First = readWord(Files, I * FileWords + 1);
+    if (First + readWord(Files, I * FileWords + 2) > NumOccurrences)
+      return false;
+  }
+  return true;
+}
+
+} // anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// libclang public APIs.
+//===----------------------------------------------------------------------===//
+
+extern "C" {
+
+CXIndexDBWriter clang_IndexDBWriter_create(void) {
+  return new IndexDBWriter();
+}
+
+void clang_IndexDBWriter_dispose(CXIndexDBWriter writer) {
+  delete static_cast<IndexDBWriter *>(writer);
+}
+
+int clang_IndexDBWriter_indexSourceFile(CXIndexDBWriter writer,
+                                        CXIndexAction idxAction,
+                                        unsigned index_options,
+                                        const char *source_filename,
+                                        const char * const *command_line_args,
+                                        int num_command_line_args,
+                                        struct CXUnsavedFile *unsaved_files,
+                                        unsigned num_unsaved_files) {
+  if (!writer)
+    return 1;
+
+  IndexDBWriter *Writer = static_cast<IndexDBWriter *>(writer);
+  Writer->startTranslationUnit();
+  IndexerCallbacks CB = getIndexDBCallbacks();
+  return clang_indexSourceFile(idxAction, Writer, &CB, sizeof(CB),
+                               index_options, source_filename,
+                               command_line_args, num_command_line_args,
+                               unsaved_files, num_unsaved_files,
+                               /*out_TU=*/0, CXTranslationUnit_None);
+}
+
+int clang_IndexDBWriter_indexTranslationUnit(CXIndexDBWriter writer,
+                                             CXIndexAction idxAction,
+                                             unsigned index_options,
+                                             CXTranslationUnit TU) {
+  if (!writer)
+    return 1;
+
+  IndexDBWriter *Writer = static_cast<IndexDBWriter *>(writer);
+  Writer->startTranslationUnit();
+  IndexerCallbacks CB = getIndexDBCallbacks();
+  return clang_indexTranslationUnit(idxAction, Writer, &CB, sizeof(CB),
+                                    index_options, TU);
+}
+
+int clang_IndexDBWriter_write(CXIndexDBWriter writer, const char *path) {
+  if (!writer || !path)
+    return 1;
+
+  std::string ErrorInfo;
+  llvm::raw_fd_ostream OS(path, ErrorInfo, llvm::raw_fd_ostream::F_Binary);
+  if (!ErrorInfo.empty()) {
+    LOG_FUNC_SECTION {
+      *Log << "unable to open '" << path << "': " << ErrorInfo;
+    }
+    return 1;
+  }
+
+  if (!static_cast<IndexDBWriter *>(writer)->write(OS)) {
+    OS.clear_error();
+    return 1;
+  }
+  return 0;
+}
+
+CXIndexDB clang_IndexDB_open(const char *path) {
+  if (!path)
+    return 0;
+
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  if (llvm::MemoryBuffer::getFile(path, Buffer))
+    return 0;
+
+  OwningPtr<IndexDB> DB(new IndexDB(Buffer.take()));
+  if (!DB->init())
+    return 0;
+  return DB.take();
+}
+
+void clang_IndexDB_dispose(CXIndexDB db) {
+  delete static_cast<IndexDB *>(db);
+}
+
+unsigned clang_IndexDB_getNumSymbols(CXIndexDB db) {
+  if (!db)
+    return 0;
+  return static_cast<IndexDB *>(db)->getNumSymbols();
+}
+
+int clang_IndexDB_findSymbol(CXIndexDB db, const char *USR) {
+  if (!db || !USR)
+    return -1;
+  return static_cast<IndexDB *>(db)->findSymbol(USR);
+}
+
+const char *clang_IndexDB_getSymbolUSR(CXIndexDB db, unsigned symbol) {
+  IndexDB *DB = static_cast<IndexDB *>(db);
+  if (!DB || symbol >= DB->getNumSymbols())
+    return 0;
+  return DB->getSymbolUSR(symbol);
+}
+
+const char *clang_IndexDB_getSymbolName(CXIndexDB db, unsigned symbol) {
+  IndexDB *DB = static_cast<IndexDB *>(db);
+  if (!DB || symbol >= DB->getNumSymbols())
+    return 0;
+  return DB->getSymbolName(symbol);
+}
+
+CXIdxEntityKind clang_IndexDB_getSymbolKind(CXIndexDB db, unsigned symbol) {
+  IndexDB *DB = static_cast<IndexDB *>(db);
+  if (!DB || symbol >= DB->getNumSymbols())
+    return CXIdxEntity_Unexposed;
+  return DB->getSymbolKind(symbol);
+}
+
+unsigned clang_IndexDB_getNumSymbolOccurrences(CXIndexDB db, unsigned symbol) {
+  IndexDB *DB = static_cast<IndexDB *>(db);
+  if (!DB || symbol >= DB->getNumSymbols())
+    return 0;
+  return DB->getNumSymbolOccurrences(symbol);
+}
+
+CXIndexDBOccurrence clang_IndexDB_getSymbolOccurrence(CXIndexDB db,
+                                                      unsigned symbol,
+                                                      unsigned index) {
+  IndexDB *DB = static_cast<IndexDB *>(db);
+  if (!DB || symbol >= DB->getNumSymbols() ||
+      index >= DB->getNumSymbolOccurrences(symbol)) {
+    CXIndexDBOccurrence Null = { -1, -1, "", 0, 0, 0 };
+    return Null;
+  }
+  return DB->getSymbolOccurrence(symbol, index);
+}
+
+int clang_IndexDB_findFile(CXIndexDB db, const char *filename) {
+  if (!db || !filename)
+    return -1;
+  return static_cast<IndexDB *>(db)->findFile(filename);
+}
+
+unsigned clang_IndexDB_getNumFileOccurrences(CXIndexDB db, unsigned file) {
+  IndexDB *DB = static_cast<IndexDB *>(db);
+  if (!DB || file >= DB->getNumFiles())
+    return 0;
+  return DB->getNumFileOccurrences(file);
+}
+
+CXIndexDBOccurrence clang_IndexDB_getFileOccurrence(CXIndexDB db,
+                                                    unsigned file,
+                                                    unsigned index) {
+  IndexDB *DB = static_cast<IndexDB *>(db);
+  if (!DB || file >= DB->getNumFiles() ||
+      index >= DB->getNumFileOccurrences(file)) {
+    CXIndexDBOccurrence Null = { -1, -1, "", 0, 0, 0 };
+    return Null;
+  }
+  return DB->getFileOccurrence(file, index);
+}
+
+} // end: extern "C"
@@ -17,20 +17,31 @@
 #include "CXTranslationUnit.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/DeclVisitor.h"
+#include "clang/Basic/TargetInfo.h"
+#include "clang/Basic/TargetOptions.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/CompilerInvocation.h"
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/Frontend/Utils.h"
 #include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/Lexer.h"
 #include "clang/Lex/PPCallbacks.h"
 #include "clang/Lex/PPConditionalDirectiveRecord.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Sema/SemaConsumer.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/CrashRecoveryContext.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <sys/stat.h>
 
 using namespace clang;
 using namespace cxtu;
@@ -238,6 +249,639 @@ private:
 
 #endif
 
+//===----------------------------------------------------------------------===//
+// Skip Indexed Headers
+//===----------------------------------------------------------------------===//
+
+#ifdef LLVM_ON_WIN32
+
+// FIXME: On windows it is disabled since current implementation depends on
+// file inodes.
+
+class SessionSkipHeaderData {
+public:
+  bool setStoreFile(StringRef Path) { return false; }
+};
+
+class TUSkipHeaderControl {
+public:
+  TUSkipHeaderControl(SessionSkipHeaderData &sessionData,
+                      IndexingContext &indexCtx,
+                      Preprocessor &pp) { }
+  void enteredFile(SourceLocation Loc) { }
+  void exitedFile() { }
+  void macroReferenced(IdentifierInfo *II) { }
+  void conditionEvaluated(SourceRange ConditionRange) { }
+  void finished() { }
+};
+
+#else
+
+/// \brief Identifies the contents of a header file on disk, by inode and
+/// modification time like PPRegion does, plus the file size.
+class HeaderFileKey {
+  ino_t ino;
+  dev_t dev;
+  time_t ModTime;
+  off_t Size;
+public:
+  HeaderFileKey() : ino(), dev(), ModTime(), Size() {}
+  HeaderFileKey(dev_t dev, ino_t ino, time_t modTime, off_t size)
+    : ino(ino), dev(dev), ModTime(modTime), Size(size) {}
+  explicit HeaderFileKey(const FileEntry *FE)
+    : ino(FE->getInode()), dev(FE->getDevice()),
+      ModTime(FE->getModificationTime()), Size(FE->getSize()) {}
+
+  ino_t getIno() const { return ino; }
+  dev_t getDev() const { return dev; }
+  time_t getModTime() const { return ModTime; }
+  off_t getSize() const { return Size; }
+
+  friend bool operator==(const HeaderFileKey &lhs, const HeaderFileKey &rhs) {
+    return lhs.dev == rhs.dev && lhs.ino == rhs.ino &&
+        lhs.ModTime == rhs.ModTime && lhs.Size == rhs.Size;
+  }
+  friend bool operator!=(const HeaderFileKey &lhs, const HeaderFileKey &rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+/// \brief The macro context that a header was indexed in.
+///
+/// A header expands to the same declarations as long as the identifiers it
+/// refers to before defining them itself still have the same macro
+/// definitions (or still have none), and the files it includes did not change
+/// on disk.
+struct HeaderContext {
+  /// \brief A hash of the language options and target of the translation
+  /// unit; a header may declare different entities, with different USRs, in
+  /// C and in C++, or for another target.
+  unsigned Configuration;
+
+  /// \brief Identifiers not defined by the header and referenced in it, along
+  /// with a fingerprint of their macro definition (0 if they were not macros).
+  std::vector<std::pair<std::string, unsigned> > Macros;
+
+  /// \brief Files (transitively) included by the header.
+  std::vector<std::pair<std::string, HeaderFileKey> > Includes;
+
+  HeaderContext() : Configuration(0) {}
+
+  friend bool operator==(const HeaderContext &lhs, const HeaderContext &rhs) {
+    return lhs.Configuration == rhs.Configuration &&
+        lhs.Macros == rhs.Macros && lhs.Includes == rhs.Includes;
+  }
+};
+
+} // end anonymous namespace
+
+namespace llvm {
+  template <> struct isPodLike<HeaderFileKey> {
+    static const bool value = true;
+  };
+
+  template <>
+  struct DenseMapInfo<HeaderFileKey> {
+    static inline HeaderFileKey getEmptyKey() {
+      return HeaderFileKey(0, 0, 0, off_t(-1));
+    }
+    static inline HeaderFileKey getTombstoneKey() {
+      return HeaderFileKey(0, 0, 0, off_t(-2));
+    }
+
+    static unsigned getHashValue(const HeaderFileKey &S) {
+      llvm::FoldingSetNodeID ID;
+      ID.AddInteger(S.getIno());
+      ID.AddInteger(S.getDev());
+      ID.AddInteger(S.getModTime());
+      ID.AddInteger(S.getSize());
+      return ID.ComputeHash();
+    }
+
+    static bool isEqual(const HeaderFileKey &LHS, const HeaderFileKey &RHS) {
+      return LHS == RHS;
+    }
+  };
+}
+
+namespace {
+
+class TUSkipHeaderControl;
+
+/// \brief The headers indexed so far by a CXIndexAction, along with the
+/// contexts they were indexed in.
+///
+/// If a store file is set, the headers indexed by earlier sessions are read
+/// from it, and the set is written back to it when the session ends, so that
+/// headers unchanged since the last run are skipped too.
+class SessionSkipHeaderData {
+  llvm::sys::Mutex Mux;
+
+  struct IndexedHeader {
+    std::string Name;
+    std::vector<HeaderContext> Contexts;
+  };
+  typedef llvm::DenseMap<HeaderFileKey, IndexedHeader> HeaderMapTy;
+  HeaderMapTy IndexedHeaders;
+
+  /// \brief The file the set is read from and written back to, if any.
+  std::string StoreFile;
+
+  /// \brief Headers like X-macro tables are included in many different macro
+  /// contexts; don't keep track of more than a few of them.
+  enum { MaxContextsPerHeader = 8 };
+
+public:
+  /// \brief A header indexed by a translation unit.
+  struct NewHeader {
+    HeaderFileKey Key;
+    std::string Name;
+    HeaderContext Context;
+  };
+
+  SessionSkipHeaderData() : Mux(/*recursive=*/false) {}
+
+  ~SessionSkipHeaderData() {
+    save();
+  }
+
+  /// \brief Whether the header identified by \p Key was already indexed in a
+  /// context that still holds in the translation unit of \p TU.
+  ///
+  /// The contexts are compared in place, under the lock.
+  bool isIndexed(const HeaderFileKey &Key, TUSkipHeaderControl &TU);
+
+  void update(ArrayRef<NewHeader> Headers) {
+    llvm::MutexGuard MG(Mux);
+    for (unsigned i = 0, e = Headers.size(); i != e; ++i) {
+      IndexedHeader &Header = IndexedHeaders[Headers[i].Key];
+      Header.Name = Headers[i].Name;
+      std::vector<HeaderContext> &Contexts = Header.Contexts;
+      if (Contexts.size() >= MaxContextsPerHeader)
+        continue;
+      if (std::find(Contexts.begin(), Contexts.end(), Headers[i].Context) ==
+            Contexts.end())
+        Contexts.push_back(Headers[i].Context);
+    }
+  }
+
+  /// \brief Read the headers indexed by earlier sessions from \p Path, and
+  /// write the set back there when the session ends.
+  ///
+  /// \returns true if \p Path exists but could not be read.
+  bool setStoreFile(StringRef Path);
+
+private:
+  bool load(StringRef Buffer);
+  void save();
+};
+
+/// \brief Whether the file \p Name on disk is still the one \p Key identifies.
+static bool isUnchangedOnDisk(const std::string &Name,
+                              const HeaderFileKey &Key) {
+  struct stat StatBuf;
+  if (::stat(Name.c_str(), &StatBuf))
+    return false;
+  return HeaderFileKey(StatBuf.st_dev, StatBuf.st_ino, StatBuf.st_mtime,
+                       StatBuf.st_size) == Key;
+}
+
+/// \brief Parse the four fields of a HeaderFileKey off the front of \p Line.
+static bool parseHeaderFileKey(StringRef &Line, HeaderFileKey &Key) {
+  unsigned long long Fields[4];
+  for (unsigned I = 0; I != 4; ++I) {
+    std::pair<StringRef, StringRef> Split = Line.split(' ');
+    if (Split.first.getAsInteger(10, Fields[I]))
+      return false;
+    Line = Split.second;
+  }
+  Key = HeaderFileKey(dev_t(Fields[0]), ino_t(Fields[1]), time_t(Fields[2]),
+                      off_t(Fields[3]));
+  return true;
+}
+
+static void writeHeaderFileKey(raw_ostream &OS, const HeaderFileKey &Key) {
+  OS << static_cast<unsigned long long>(Key.getDev()) << ' '
+     << static_cast<unsigned long long>(Key.getIno()) << ' '
+     << static_cast<unsigned long long>(Key.getModTime()) << ' '
+     << static_cast<unsigned long long>(Key.getSize()) << ' ';
+}
+
+/// \brief The first line of a store file; bump the version whenever the
+/// format or the way fingerprints are computed changes.
+static const char StoreSignature[] = "clang-indexed-headers 1";
+
+bool SessionSkipHeaderData::setStoreFile(StringRef Path) {
+  llvm::MutexGuard MG(Mux);
+  StoreFile = Path;
+
+  OwningPtr<llvm::MemoryBuffer> Buffer;
+  if (llvm::error_code EC = llvm::MemoryBuffer::getFile(Path, Buffer)) {
+    if (EC == llvm::errc::no_such_file_or_directory)
+      return false;
+    return true;
+  }
+  // A store from another version of libclang, or a damaged one, is simply
+  // replaced; a context that was only partly read must not be used.
+  if (!load(Buffer->getBuffer()))
+    IndexedHeaders.clear();
+  return false;
+}
+
+/// The store is a text file. After the signature, each context a header was
+/// indexed in starts with a line
+///   H <dev> <inode> <mtime> <size> <configuration> <name>
+/// followed by one line for each identifier it refers to,
+///   M <fingerprint> <identifier>
+/// and one line for each file it includes,
+///   I <dev> <inode> <mtime> <size> <name>
+/// The last line is "E".
+bool SessionSkipHeaderData::load(StringRef Buffer) {
+  std::pair<StringRef, StringRef> Line = Buffer.split('\n');
+  if (Line.first != StoreSignature)
+    return false;
+
+  HeaderContext *Context = 0;
+  for (Line = Line.second.split('\n'); !Line.first.empty();
+       Line = Line.second.split('\n')) {
+    StringRef Rest = Line.first.substr(std::min<size_t>(2, Line.first.size()));
+    HeaderFileKey Key;
+    switch (Line.first[0]) {
+    case 'E':
+      return true;
+    case 'H': {
+      Context = 0;
+      std::pair<StringRef, StringRef> Config;
+      unsigned Configuration;
+      if (!parseHeaderFileKey(Rest, Key))
+        return false;
+      Config = Rest.split(' ');
+      if (Config.first.getAsInteger(10, Configuration))
+        return false;
+      // Headers that changed since they were indexed would never match again.
+      std::string Name = Config.second;
+      if (!isUnchangedOnDisk(Name, Key))
+        continue;
+      IndexedHeader &Header = IndexedHeaders[Key];
+      Header.Name = Name;
+      if (Header.Contexts.size() >= MaxContextsPerHeader)
+        continue;
+      Header.Contexts.push_back(HeaderContext());
+      Context = &Header.Contexts.back();
+      Context->Configuration = Configuration;
+      break;
+    }
+    case 'M': {
+      std::pair<StringRef, StringRef> Macro = Rest.split(' ');
+      unsigned Fingerprint;
+      if (Macro.first.getAsInteger(10, Fingerprint))
+        return false;
+      if (Context)
+        Context->Macros.push_back(std::make_pair(Macro.second.str(),
+                                                 Fingerprint));
+      break;
+    }
+    case 'I':
+      if (!parseHeaderFileKey(Rest, Key))
+        return false;
+      if (Context)
+        Context->Includes.push_back(std::make_pair(Rest.str(), Key));
+      break;
+    default:
+      return false;
+    }
+  }
+  return false;
+}
+
+/// \brief Names with newlines can't be written to the store.
+static bool hasNewlineInInclude(const HeaderContext &Context) {
+  for (unsigned I = 0, E = Context.Includes.size(); I != E; ++I)
+    if (Context.Includes[I].first.find('\n') != std::string::npos)
+      return true;
+  return false;
+}
+
+void SessionSkipHeaderData::save() {
+  if (StoreFile.empty())
+    return;
+
+  // Write to a temporary file and rename it over the store, so that a
+  // session that ends concurrently never leaves a truncated store behind.
+  SmallString<128> TempPath;
+  TempPath = StoreFile;
+  TempPath += "-%%%%%%%%";
+  int FD;
+  if (llvm::sys::fs::unique_file(TempPath.str(), FD, TempPath,
+                                 /*makeAbsolute=*/false))
+    return;
+
+  llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  OS << StoreSignature << '\n';
+  for (HeaderMapTy::iterator
+         I = IndexedHeaders.begin(), E = IndexedHeaders.end(); I != E; ++I) {
+    const IndexedHeader &Header = I->second;
+    if (Header.Name.find('\n') != std::string::npos)
+      continue;
+    for (unsigned C = 0, CE = Header.Contexts.size(); C != CE; ++C) {
+      const HeaderContext &Context = Header.Contexts[C];
+      if (hasNewlineInInclude(Context))
+        continue;
+      OS << "H ";
+      writeHeaderFileKey(OS, I->first);
+      OS << Context.Configuration << ' ' << Header.Name << '\n';
+      for (unsigned M = 0, ME = Context.Macros.size(); M != ME; ++M)
+        OS << "M " << Context.Macros[M].second << ' '
+           << Context.Macros[M].first << '\n';
+      for (unsigned F = 0, FE = Context.Includes.size(); F != FE; ++F) {
+        OS << "I ";
+        writeHeaderFileKey(OS, Context.Includes[F].second);
+        OS << Context.Includes[F].first << '\n';
+      }
+    }
+  }
+  OS << "E\n";
+  OS.close();
+
+  bool Exists;
+  if (OS.has_error()) {
+    OS.clear_error();
+    llvm::sys::fs::remove(TempPath.str(), Exists);
+    return;
+  }
+  if (llvm::sys::fs::rename(TempPath.str(), StoreFile))
+    llvm::sys::fs::remove(TempPath.str(), Exists);
+}
+
+/// \brief Hash everything in the translation unit, besides macros, that can
+/// change the entities a header declares or their USRs.
+static unsigned getConfigurationHash(const Preprocessor &PP) {
+  const LangOptions &LangOpts = PP.getLangOpts();
+  llvm::hash_code Code = llvm::hash_value(0);
+#define LANGOPT(Name, Bits, Default, Description) \
+  Code = llvm::hash_combine(Code, LangOpts.Name);
+#define ENUM_LANGOPT(Name, Type, Bits, Default, Description) \
+  Code = llvm::hash_combine(Code, static_cast<unsigned>(LangOpts.get##Name()));
+#include "clang/Basic/LangOptions.def"
+  Code = llvm::hash_combine(Code, LangOpts.ObjCRuntime.getAsString(),
+                            LangOpts.CurrentModule);
+
+  const TargetOptions &TargetOpts = PP.getTargetInfo().getTargetOpts();
+  Code = llvm::hash_combine(Code, TargetOpts.Triple, TargetOpts.CPU,
+                            TargetOpts.ABI, TargetOpts.CXXABI);
+  for (unsigned I = 0, N = TargetOpts.Features.size(); I != N; ++I)
+    Code = llvm::hash_combine(Code, TargetOpts.Features[I]);
+  return static_cast<unsigned>(static_cast<size_t>(Code));
+}
+
+class TUSkipHeaderControl {
+  friend class SessionSkipHeaderData;
+
+  SessionSkipHeaderData &SessionData;
+  IndexingContext &IndexCtx;
+  Preprocessor &PP;
+
+  /// \brief A file on the include stack.
+  struct ActiveFile {
+    const FileEntry *FE;
+    SourceLocation StartLoc;
+    /// \brief Whether the macro context of the file is being recorded; false
+    /// for the main file, for buffers and for skipped headers.
+    bool IsRecording;
+    llvm::SmallPtrSet<const IdentifierInfo *, 32> SeenMacros;
+    HeaderContext Context;
+
+    ActiveFile(const FileEntry *FE, SourceLocation StartLoc, bool IsRecording)
+      : FE(FE), StartLoc(StartLoc), IsRecording(IsRecording) { }
+  };
+
+  SmallVector<ActiveFile *, 16> FileStack;
+  std::vector<SessionSkipHeaderData::NewHeader> NewIndexedHeaders;
+  llvm::DenseMap<const MacroInfo *, unsigned> Fingerprints;
+
+  /// \brief The hash of the language options and target of this translation
+  /// unit.
+  unsigned Configuration;
+
+public:
+  TUSkipHeaderControl(SessionSkipHeaderData &sessionData,
+                      IndexingContext &indexCtx,
+                      Preprocessor &pp)
+    : SessionData(sessionData), IndexCtx(indexCtx), PP(pp),
+      Configuration(getConfigurationHash(pp)) { }
+
+  ~TUSkipHeaderControl() {
+    llvm::DeleteContainerPointers(FileStack);
+  }
+
+  void enteredFile(SourceLocation Loc) {
+    SourceManager &SM = PP.getSourceManager();
+    FileID FID = SM.getFileID(Loc);
+    const FileEntry *FE = SM.getFileEntryForID(FID);
+    if (!FE || FID == SM.getMainFileID()) {
+      FileStack.push_back(new ActiveFile(FE, Loc, /*IsRecording=*/false));
+      return;
+    }
+
+    // The contents of the including headers depend on this one.
+    HeaderFileKey Key(FE);
+    std::pair<std::string, HeaderFileKey> Include(FE->getName(), Key);
+    for (unsigned I = 0, E = FileStack.size(); I != E; ++I) {
+      ActiveFile &File = *FileStack[I];
+      if (File.IsRecording &&
+          std::find(File.Context.Includes.begin(), File.Context.Includes.end(),
+                    Include) == File.Context.Includes.end())
+        File.Context.Includes.push_back(Include);
+    }
+
+    bool IsIndexed = SessionData.isIndexed(Key, *this);
+    if (IsIndexed)
+      IndexCtx.skipFile(FID);
+    FileStack.push_back(new ActiveFile(FE, Loc, /*IsRecording=*/!IsIndexed));
+    FileStack.back()->Context.Configuration = Configuration;
+  }
+
+  void exitedFile() {
+    if (FileStack.empty())
+      return;
+
+    recordIdentifiers(*FileStack.back());
+    OwningPtr<ActiveFile> File(FileStack.pop_back_val());
+    if (File->IsRecording) {
+      SessionSkipHeaderData::NewHeader Header;
+      Header.Key = HeaderFileKey(File->FE);
+      Header.Name = File->FE->getName();
+      Header.Context = File->Context;
+      NewIndexedHeaders.push_back(Header);
+    }
+  }
+
+  void macroReferenced(IdentifierInfo *II) {
+    if (!II)
+      return;
+
+    // Record the reference in the innermost files that the macro is external
+    // to. If the macro was defined or undefined after a file was entered, it
+    // is internal to that file and to every file that includes it.
+    for (unsigned I = FileStack.size(); I != 0; --I) {
+      ActiveFile &File = *FileStack[I-1];
+      if (!File.IsRecording)
+        continue;
+      if (!File.SeenMacros.insert(II))
+        break;
+      if (isChangedWithin(II, File))
+        break;
+      File.Context.Macros.push_back(std::make_pair(II->getName().str(),
+                                                   getFingerprint(II)));
+    }
+  }
+
+  /// \brief Identifiers in an \#if or \#elif condition are references too,
+  /// even if they are not defined as macros.
+  void conditionEvaluated(SourceRange ConditionRange) {
+    if (ConditionRange.isInvalid() || ConditionRange.getBegin().isMacroID() ||
+        ConditionRange.getEnd().isMacroID())
+      return;
+
+    SourceManager &SM = PP.getSourceManager();
+    FileID FID;
+    unsigned BeginOffset;
+    llvm::tie(FID, BeginOffset) = SM.getDecomposedLoc(ConditionRange.getBegin());
+    if (SM.getFileID(ConditionRange.getEnd()) != FID)
+      return;
+    unsigned EndOffset = SM.getFileOffset(ConditionRange.getEnd());
+
+    bool Invalid = false;
+    StringRef Buffer = SM.getBufferData(FID, &Invalid);
+    if (Invalid)
+      return;
+
+    Lexer RawLex(SM.getLocForStartOfFile(FID), PP.getLangOpts(),
+                 Buffer.begin(), Buffer.begin() + BeginOffset, Buffer.end());
+    Token Tok;
+    while (true) {
+      RawLex.LexFromRawLexer(Tok);
+      if (Tok.is(tok::eof) || SM.getFileOffset(Tok.getLocation()) > EndOffset)
+        break;
+      if (Tok.is(tok::raw_identifier))
+        macroReferenced(PP.getIdentifierInfo(
+                  StringRef(Tok.getRawIdentifierData(), Tok.getLength())));
+    }
+  }
+
+  void finished() {
+    SessionData.update(NewIndexedHeaders);
+  }
+
+private:
+  /// \brief Record every identifier in \p File as a reference, not only the
+  /// ones that are macros in this translation unit: 'FOO' in "extern int FOO;"
+  /// is a plain name here, but may be a macro in the next one (-DFOO=...).
+  void recordIdentifiers(const ActiveFile &File) {
+    if (!File.FE || !File.StartLoc.isFileID())
+      return;
+    bool IsRecorded = false;
+    for (unsigned I = 0, E = FileStack.size(); I != E && !IsRecorded; ++I)
+      IsRecorded = FileStack[I]->IsRecording;
+    if (!IsRecorded)
+      return;
+
+    SourceManager &SM = PP.getSourceManager();
+    FileID FID = SM.getFileID(File.StartLoc);
+    if (FID == SM.getMainFileID())
+      return;
+    bool Invalid = false;
+    StringRef Buffer = SM.getBufferData(FID, &Invalid);
+    if (Invalid)
+      return;
+
+    Lexer RawLex(SM.getLocForStartOfFile(FID), PP.getLangOpts(),
+                 Buffer.begin(), Buffer.begin(), Buffer.end());
+    Token Tok;
+    do {
+      RawLex.LexFromRawLexer(Tok);
+      if (Tok.is(tok::raw_identifier))
+        macroReferenced(PP.getIdentifierInfo(
+                  StringRef(Tok.getRawIdentifierData(), Tok.getLength())));
+    } while (Tok.isNot(tok::eof));
+  }
+
+  /// \brief Whether \p Context, the context a header was indexed in,
+  /// still holds in this translation unit.
+  bool matchesCurrentContext(const HeaderContext &Context) {
+    if (Context.Configuration != Configuration)
+      return false;
+
+    for (unsigned I = 0, E = Context.Macros.size(); I != E; ++I) {
+      IdentifierInfo *II = PP.getIdentifierInfo(Context.Macros[I].first);
+      if (getFingerprint(II) != Context.Macros[I].second)
+        return false;
+    }
+
+    FileManager &FileMgr = PP.getFileManager();
+    for (unsigned I = 0, E = Context.Includes.size(); I != E; ++I) {
+      const FileEntry *FE = FileMgr.getFile(Context.Includes[I].first);
+      if (!FE || HeaderFileKey(FE) != Context.Includes[I].second)
+        return false;
+    }
+    return true;
+  }
+
+  bool isChangedWithin(const IdentifierInfo *II, const ActiveFile &File) {
+    if (!II->hadMacroDefinition())
+      return false;
+    const MacroDirective *MD = PP.getMacroDirectiveHistory(II);
+    return MD->getLocation().isValid() &&
+        PP.getSourceManager().isBeforeInTranslationUnit(File.StartLoc,
+                                                        MD->getLocation());
+  }
+
+  /// \brief Hash the current definition of the macro, or 0 if the macro is
+  /// not defined.
+  unsigned getFingerprint(IdentifierInfo *II) {
+    const MacroInfo *MI = PP.getMacroInfo(II);
+    if (!MI)
+      return 0;
+
+    unsigned &Fingerprint = Fingerprints[MI];
+    if (Fingerprint)
+      return Fingerprint;
+
+    llvm::FoldingSetNodeID ID;
+    ID.AddBoolean(MI->isFunctionLike());
+    ID.AddBoolean(MI->isVariadic());
+    for (MacroInfo::arg_iterator
+           I = MI->arg_begin(), E = MI->arg_end(); I != E; ++I)
+      ID.AddString((*I)->getName());
+    SmallString<64> Buffer;
+    for (MacroInfo::tokens_iterator
+           I = MI->tokens_begin(), E = MI->tokens_end(); I != E; ++I) {
+      ID.AddInteger(I->getKind());
+      ID.AddBoolean(I->hasLeadingSpace());
+      ID.AddString(PP.getSpelling(*I, Buffer));
+    }
+    Fingerprint = ID.ComputeHash();
+    if (!Fingerprint)
+      Fingerprint = 1; // 0 stands for "not defined".
+    return Fingerprint;
+  }
+};
+
+bool SessionSkipHeaderData::isIndexed(const HeaderFileKey &Key,
+                                      TUSkipHeaderControl &TU) {
+  llvm::MutexGuard MG(Mux);
+  HeaderMapTy::const_iterator I = IndexedHeaders.find(Key);
+  if (I == IndexedHeaders.end())
+    return false;
+  const std::vector<HeaderContext> &Contexts = I->second.Contexts;
+  for (unsigned C = 0, CE = Contexts.size(); C != CE; ++C)
+    if (TU.matchesCurrentContext(Contexts[C]))
+      return true;
+  return false;
+}
+
+#endif
+
 //===----------------------------------------------------------------------===//
 // IndexPPCallbacks
 //===----------------------------------------------------------------------===//
@@ -245,14 +889,23 @@ private:
 class IndexPPCallbacks : public PPCallbacks {
   Preprocessor &PP;
   IndexingContext &IndexCtx;
+  TUSkipHeaderControl *SHCtrl;
   bool IsMainFileEntered;
 
 public:
-  IndexPPCallbacks(Preprocessor &PP, IndexingContext &indexCtx)
-    : PP(PP), IndexCtx(indexCtx), IsMainFileEntered(false) { }
+  IndexPPCallbacks(Preprocessor &PP, IndexingContext &indexCtx,
+                   TUSkipHeaderControl *shCtrl)
+    : PP(PP), IndexCtx(indexCtx), SHCtrl(shCtrl), IsMainFileEntered(false) { }
 
   virtual void FileChanged(SourceLocation Loc, FileChangeReason Reason,
                           SrcMgr::CharacteristicKind FileType, FileID PrevFID) {
+    if (SHCtrl) {
+      if (Reason == PPCallbacks::EnterFile)
+        SHCtrl->enteredFile(Loc);
+      else if (Reason == PPCallbacks::ExitFile)
+        SHCtrl->exitedFile();
+    }
+
     if (IsMainFileEntered)
       return;
 
@@ -293,6 +946,36 @@ public:
   /// MacroExpands - This is called by when a macro invocation is found.
   virtual void MacroExpands(const Token &MacroNameTok, const MacroDirective *MD,
                             SourceRange Range) {
+    if (SHCtrl)
+      SHCtrl->macroReferenced(MacroNameTok.getIdentifierInfo());
+  }
+
+  virtual void Defined(const Token &MacroNameTok, const MacroDirective *MD) {
+    if (SHCtrl)
+      SHCtrl->macroReferenced(MacroNameTok.getIdentifierInfo());
+  }
+
+  virtual void If(SourceLocation Loc, SourceRange ConditionRange) {
+    if (SHCtrl)
+      SHCtrl->conditionEvaluated(ConditionRange);
+  }
+
+  virtual void Elif(SourceLocation Loc, SourceRange ConditionRange,
+                    SourceLocation IfLoc) {
+    if (SHCtrl)
+      SHCtrl->conditionEvaluated(ConditionRange);
+  }
+
+  virtual void Ifdef(SourceLocation Loc, const Token &MacroNameTok,
+                     const MacroDirective *MD) {
+    if (SHCtrl)
+      SHCtrl->macroReferenced(MacroNameTok.getIdentifierInfo());
+  }
+
+  virtual void Ifndef(SourceLocation Loc, const Token &MacroNameTok,
+                      const MacroDirective *MD) {
+    if (SHCtrl)
+      SHCtrl->macroReferenced(MacroNameTok.getIdentifierInfo());
   }
 
   /// SourceRangeSkipped - This hook is called when a source range is skipped.
@@ -309,10 +992,12 @@ public:
 class IndexingConsumer : public ASTConsumer {
   IndexingContext &IndexCtx;
   TUSkipBodyControl *SKCtrl;
+  TUSkipHeaderControl *SHCtrl;
 
 public:
-  IndexingConsumer(IndexingContext &indexCtx, TUSkipBodyControl *skCtrl)
-    : IndexCtx(indexCtx), SKCtrl(skCtrl) { }
+  IndexingConsumer(IndexingContext &indexCtx, TUSkipBodyControl *skCtrl,
+                   TUSkipHeaderControl *shCtrl)
+    : IndexCtx(indexCtx), SKCtrl(skCtrl), SHCtrl(shCtrl) { }
 
   // ASTConsumer Implementation
 
@@ -324,6 +1009,8 @@ public:
   virtual void HandleTranslationUnit(ASTContext &Ctx) {
     if (SKCtrl)
       SKCtrl->finished();
+    if (SHCtrl)
+      SHCtrl->finished();
   }
 
   virtual bool HandleTopLevelDecl(DeclGroupRef DG) {
@@ -415,14 +1102,18 @@ class IndexingFrontendAction : public ASTFrontendAction {
   SessionSkipBodyData *SKData;
   OwningPtr<TUSkipBodyControl> SKCtrl;
 
+  SessionSkipHeaderData *SHData;
+  OwningPtr<TUSkipHeaderControl> SHCtrl;
+
 public:
   IndexingFrontendAction(CXClientData clientData,
                          IndexerCallbacks &indexCallbacks,
                          unsigned indexOptions,
                          CXTranslationUnit cxTU,
-                         SessionSkipBodyData *skData)
+                         SessionSkipBodyData *skData,
+                         SessionSkipHeaderData *shData)
     : IndexCtx(clientData, indexCallbacks, indexOptions, cxTU),
-      CXTU(cxTU), SKData(skData) { }
+      CXTU(cxTU), SKData(skData), SHData(shData) { }
 
   virtual ASTConsumer *CreateASTConsumer(CompilerInstance &CI,
                                          StringRef InFile) {
@@ -435,7 +1126,9 @@ public:
 
     IndexCtx.setASTContext(CI.getASTContext());
     Preprocessor &PP = CI.getPreprocessor();
-    PP.addPPCallbacks(new IndexPPCallbacks(PP, IndexCtx));
+    if (SHData)
+      SHCtrl.reset(new TUSkipHeaderControl(*SHData, IndexCtx, PP));
+    PP.addPPCallbacks(new IndexPPCallbacks(PP, IndexCtx, SHCtrl.get()));
     IndexCtx.setPreprocessor(PP);
 
     if (SKData) {
@@ -445,7 +1138,7 @@ public:
       SKCtrl.reset(new TUSkipBodyControl(*SKData, *PPRec, PP));
     }
 
-    return new IndexingConsumer(IndexCtx, SKCtrl.get());
+    return new IndexingConsumer(IndexCtx, SKCtrl.get(), SHCtrl.get());
   }
 
   virtual void EndSourceFileAction() {
@@ -468,9 +1161,11 @@ public:
 struct IndexSessionData {
   CXIndex CIdx;
   OwningPtr<SessionSkipBodyData> SkipBodyData;
+  OwningPtr<SessionSkipHeaderData> SkipHeaderData;
 
   explicit IndexSessionData(CXIndex cIdx)
-    : CIdx(cIdx), SkipBodyData(new SessionSkipBodyData) {}
+    : CIdx(cIdx), SkipBodyData(new SessionSkipBodyData),
+      SkipHeaderData(new SessionSkipHeaderData) {}
 };
 
 struct IndexSourceFileInfo {
@@ -628,10 +1323,13 @@ static void clang_indexSourceFile_Impl(void *UserData) {
   if (SkipBodies)
     CInvok->getFrontendOpts().SkipFunctionBodies = true;
 
+  bool SkipHeaders = index_options & CXIndexOpt_SkipIndexedHeadersInSession;
+
   OwningPtr<IndexingFrontendAction> IndexAction;
   IndexAction.reset(new IndexingFrontendAction(client_data, CB,
                                                index_options, CXTU->getTU(),
-                              SkipBodies ? IdxSession->SkipBodyData.get() : 0));
+                              SkipBodies ? IdxSession->SkipBodyData.get() : 0,
+                          SkipHeaders ? IdxSession->SkipHeaderData.get() : 0));
 
   // Recover resources if we crash before exiting this method.
   llvm::CrashRecoveryContextCleanupRegistrar<IndexingFrontendAction>
@@ -782,7 +1480,7 @@ static void clang_indexTranslationUnit_Impl(void *UserData) {
     IndexCtxCleanup(IndexCtx.get());
 
   OwningPtr<IndexingConsumer> IndexConsumer;
-  IndexConsumer.reset(new IndexingConsumer(*IndexCtx, 0));
+  IndexConsumer.reset(new IndexingConsumer(*IndexCtx, 0, 0));
 
   // Recover resources if we crash before exiting this method.
   llvm::CrashRecoveryContextCleanupRegistrar<IndexingConsumer>
@@ -960,6 +1658,14 @@ void clang_IndexAction_dispose(CXIndexAction idxAction) {
     delete static_cast<IndexSessionData *>(idxAction);
 }
 
+int clang_IndexAction_setIndexedHeadersFile(CXIndexAction idxAction,
+                                            const char *path) {
+  if (!idxAction || !path)
+    return 1;
+  IndexSessionData *IdxSession = static_cast<IndexSessionData *>(idxAction);
+  return IdxSession->SkipHeaderData->setStoreFile(path);
+}
+
 int clang_indexSourceFile(CXIndexAction idxAction,
                           CXClientData client_data,
                           IndexerCallbacks *index_callbacks,
@@ -715,6 +715,13 @@ bool IndexingContext::isNotFromSourceFile(SourceLocation Loc) const {
   return SM.getFileEntryForID(FID) == 0;
 }
 
+bool IndexingContext::isInSkippedFile(SourceLocation Loc) const {
+  if (SkippedFiles.empty() || Loc.isInvalid())
+    return false;
+  SourceManager &SM = Ctx->getSourceManager();
+  return SkippedFiles.count(SM.getFileID(SM.getFileLoc(Loc)));
+}
+
 void IndexingContext::addContainerInMap(const DeclContext *DC,
                                         CXIdxClientContainer container) {
   if (!DC)
@@ -1104,15 +1111,12 @@ void IndexingContext::getEntityInfo(const NamedDecl *D,
     EntityInfo.name = SA.copyCStr(StrBuf.str());
   }
 
-  {
-    SmallString<512> StrBuf;
-    bool Ignore = getDeclCursorUSR(D, StrBuf);
-    if (Ignore) {
-      EntityInfo.USR = 0;
-    } else {
-      EntityInfo.USR = SA.copyCStr(StrBuf.str());
-    }
-  }
+  // The USR is interned in the translation unit, no need to copy it.
+  StringRef USR;
+  if (getDeclCursorUSR(D, CXTU, USR))
+    EntityInfo.USR = 0;
+  else
+    EntityInfo.USR = USR.data();
 }
 
 void IndexingContext::getContainerInfo(const DeclContext *DC,
@@ -297,6 +297,10 @@ class IndexingContext {
   llvm::DenseSet<RefFileOccurence> RefFileOccurences;
 
   std::deque<DeclGroupRef> TUDeclsInObjCContainer;
+
+  /// \brief Files whose top-level declarations were already indexed in the
+  /// same macro context earlier in the indexing session.
+  llvm::DenseSet<FileID> SkippedFiles;
   
   llvm::BumpPtrAllocator StrScratch;
   unsigned StrAdapterCount;
@@ -449,6 +453,9 @@ public:
 
   bool isNotFromSourceFile(SourceLocation Loc) const;
 
+  void skipFile(FileID FID) { SkippedFiles.insert(FID); }
+  bool isInSkippedFile(SourceLocation Loc) const;
+
   void indexTopLevelDecl(const Decl *D);
   void indexTUDeclsInObjCContainer();
   void indexDeclGroupRef(DeclGroupRef DG);
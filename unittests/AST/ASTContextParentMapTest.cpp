@@ -67,5 +67,32 @@ TEST(GetParents, ReturnsMultipleParentsInTemplateInstantiations) {
                 hasAncestor(recordDecl(unless(isTemplateInstantiation())))))));
 }
 
+class CheckParentsAreDistinct : public MatchFinder::MatchCallback {
+public:
+  CheckParentsAreDistinct() : NumChecked(0) {}
+  virtual void run(const MatchFinder::MatchResult &Result) {
+    const Stmt *S = Result.Nodes.getNodeAs<Stmt>("s");
+    ASTContext::ParentVector Parents = Result.Context->getParents(*S);
+    EXPECT_FALSE(Parents.empty());
+    for (unsigned I = 0, N = Parents.size(); I != N; ++I)
+      for (unsigned J = I + 1; J != N; ++J)
+        EXPECT_NE(Parents[I].getMemoizationData(),
+                  Parents[J].getMemoizationData());
+    ++NumChecked;
+  }
+  unsigned NumChecked;
+};
+
+TEST(GetParents, ReturnsEachParentOnce) {
+  CheckParentsAreDistinct Callback;
+  MatchFinder Finder;
+  Finder.addMatcher(stmt().bind("s"), &Callback);
+  OwningPtr<FrontendActionFactory> Factory(newFrontendActionFactory(&Finder));
+  ASSERT_TRUE(tooling::runToolOnCode(Factory->create(),
+      "template<typename T> struct C { void f() { T t; t = 1; } };"
+      "void g() { C<int> c; c.f(); }"));
+  EXPECT_LT(0u, Callback.NumChecked);
+}
+
 } // end namespace ast_matchers
 } // end namespace clang
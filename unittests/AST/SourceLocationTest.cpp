@@ -155,5 +155,39 @@ TEST(InitListExpr, VectorLiteralInitListParens) {
                   "constant int2 i2 = (int2)(1, 2);", initListExpr(), Lang_OpenCL));
 }
 
+TEST(DeclRefExpr, Location) {
+  LocationVerifier<DeclRefExpr> Verifier;
+  Verifier.expectLocation(1, 25);
+  EXPECT_TRUE(Verifier.match("int x; int f() { return x; }", declRefExpr()));
+}
+
+TEST(ArraySubscriptExpr, Range) {
+  RangeVerifier<ArraySubscriptExpr> Verifier;
+  Verifier.expectRange(1, 28, 1, 33);
+  EXPECT_TRUE(Verifier.match("int a[2]; int f() { return a[ 1 ]; }",
+                             arraySubscriptExpr()));
+}
+
+class BinaryOperatorLocationVerifier : public LocationVerifier<BinaryOperator> {
+protected:
+  virtual SourceLocation getLocation(const BinaryOperator &Node) {
+    return Node.getOperatorLoc();
+  }
+};
+
+TEST(BinaryOperator, OperatorLocation) {
+  BinaryOperatorLocationVerifier Verifier;
+  Verifier.expectLocation(1, 26);
+  EXPECT_TRUE(Verifier.match("int f(int a) { return a  -  1; }",
+                             binaryOperator(hasOperatorName("-"))));
+}
+
+TEST(CompoundAssignOperator, OperatorLocation) {
+  BinaryOperatorLocationVerifier Verifier;
+  Verifier.expectLocation(1, 20);
+  EXPECT_TRUE(Verifier.match("void f(int a) { a  <<=  1; }",
+                             binaryOperator(hasOperatorName("<<="))));
+}
+
 } // end namespace ast_matchers
 } // end namespace clang
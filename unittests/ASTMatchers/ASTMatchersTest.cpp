@@ -12,7 +12,9 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/Support/Timer.h"
 #include "gtest/gtest.h"
+#include <algorithm>
 
 namespace clang {
 namespace ast_matchers {
@@ -3900,5 +3902,178 @@ TEST(MatchFinder, InterceptsStartOfTranslationUnit) {
   EXPECT_TRUE(VerifyCallback.Called);
 }
 
+class RecordMatchOrder : public MatchFinder::MatchCallback {
+public:
+  RecordMatchOrder(std::string Name, std::vector<std::string> *Order)
+    : Name(Name), Order(Order) {}
+  virtual void run(const MatchFinder::MatchResult &Result) {
+    Order->push_back(Name);
+  }
+  std::string Name;
+  std::vector<std::string> *Order;
+};
+
+TEST(MatchFinder, RunsMatchersOfEachKindInOrderAdded) {
+  std::vector<std::string> Order;
+  RecordMatchOrder First("first", &Order), Second("second", &Order),
+                   Third("third", &Order);
+  MatchFinder Finder;
+  Finder.addMatcher(varDecl(hasName("x")), &First);
+  Finder.addMatcher(integerLiteral(equals(1)), &Second);
+  Finder.addMatcher(decl(hasName("x")), &Third);
+  OwningPtr<FrontendActionFactory> Factory(newFrontendActionFactory(&Finder));
+  ASSERT_TRUE(tooling::runToolOnCode(Factory->create(), "int x = 1;"));
+  ASSERT_EQ(3u, Order.size());
+  EXPECT_EQ("first", Order[0]);
+  EXPECT_EQ("third", Order[1]);
+  EXPECT_EQ("second", Order[2]);
+}
+
+// Spends 'Seconds' of wall time on every match.
+class SpendTime : public MatchFinder::MatchCallback {
+public:
+  explicit SpendTime(double Seconds) : Seconds(Seconds) {}
+  virtual void run(const MatchFinder::MatchResult &Result) {
+    double Start = llvm::TimeRecord::getCurrentTime().getWallTime();
+    while (llvm::TimeRecord::getCurrentTime().getWallTime() - Start < Seconds)
+      ;
+  }
+  double Seconds;
+};
+
+TEST(MatchFinder, RecordsProfilePerMatcher) {
+  SpendTime Callback(0.02);
+  std::vector<llvm::TimeRecord> Records;
+  MatchFinder Finder;
+  Finder.enableProfiling(Records);
+  Finder.addMatcher(varDecl(), &Callback);
+  Finder.addMatcher(integerLiteral(equals(2)), &Callback);
+  Finder.addMatcher(integerLiteral(), &Callback);
+  OwningPtr<FrontendActionFactory> Factory(newFrontendActionFactory(&Finder));
+  ASSERT_TRUE(tooling::runToolOnCode(Factory->create(), "int x = 1;"));
+  ASSERT_EQ(3u, Records.size());
+  EXPECT_LE(0.01, Records[0].getWallTime());
+  EXPECT_GT(0.01, Records[1].getWallTime());
+  EXPECT_LE(0.01, Records[2].getWallTime());
+}
+
+class RecordMatchedNames : public MatchFinder::MatchCallback {
+public:
+  virtual void run(const MatchFinder::MatchResult &Result) {
+    Names.push_back(Result.Nodes.getNodeAs<NamedDecl>("d")->getName());
+  }
+  std::vector<std::string> Names;
+};
+
+TEST(MatchFinder, ShardsPartitionTopLevelDeclarations) {
+  const std::string Code =
+    "int a; namespace n { int b; int c; } int d; struct e { int f; };";
+  std::vector<std::string> Matched;
+  for (unsigned Shard = 0; Shard != 3; ++Shard) {
+    RecordMatchedNames Callback;
+    MatchFinder Finder;
+    Finder.addMatcher(namedDecl(anyOf(varDecl(), fieldDecl())).bind("d"),
+                      &Callback);
+    Finder.setShard(Shard, 3);
+    OwningPtr<FrontendActionFactory> Factory(newFrontendActionFactory(&Finder));
+    ASSERT_TRUE(tooling::runToolOnCode(Factory->create(), Code));
+    Matched.insert(Matched.end(), Callback.Names.begin(), Callback.Names.end());
+  }
+  std::sort(Matched.begin(), Matched.end());
+  ASSERT_EQ(5u, Matched.size());
+  EXPECT_EQ("a", Matched[0]);
+  EXPECT_EQ("b", Matched[1]);
+  EXPECT_EQ("c", Matched[2]);
+  EXPECT_EQ("d", Matched[3]);
+  EXPECT_EQ("f", Matched[4]);
+}
+
+// Records the names of the matched declarations, together with the name of
+// the function they are in, if any.
+class RecordMatchedNamesInFunctions : public MatchFinder::MatchCallback {
+public:
+  virtual void run(const MatchFinder::MatchResult &Result) {
+    std::string Name = Result.Nodes.getNodeAs<NamedDecl>("d")->getName();
+    if (const FunctionDecl *F = Result.Nodes.getNodeAs<FunctionDecl>("f"))
+      Name = F->getName().str() + "::" + Name;
+    Names.push_back(Name);
+  }
+  std::vector<std::string> Names;
+};
+
+static std::vector<std::string> matchOnThreads(const std::string &Code,
+                                               unsigned NumThreads) {
+  RecordMatchedNamesInFunctions Callback;
+  MatchFinder Finder;
+  Finder.addMatcher(
+    namedDecl(anyOf(varDecl(hasAncestor(functionDecl().bind("f"))),
+                    varDecl(),
+                    recordDecl(isDerivedFrom("Base"), isDefinition())))
+      .bind("d"),
+    &Callback);
+  Finder.setNumThreads(NumThreads);
+  OwningPtr<FrontendActionFactory> Factory(newFrontendActionFactory(&Finder));
+  EXPECT_TRUE(tooling::runToolOnCode(Factory->create(), Code));
+  return Callback.Names;
+}
+
+TEST(MatchFinder, MatchesOnThreadsInSourceOrder) {
+  const std::string Code =
+    "struct Base {}; typedef Base Alias;"
+    "int a; void f() { int b; } namespace n { int c; void g() { int d; } }"
+    "struct e : Alias {}; int h; template <typename T> void t() { T i; }"
+    "void u() { t<int>(); int j; }";
+  std::vector<std::string> Serial = matchOnThreads(Code, 1);
+  ASSERT_EQ(9u, Serial.size());
+  EXPECT_EQ("a", Serial[0]);
+  EXPECT_EQ("f::b", Serial[1]);
+  EXPECT_EQ("e", Serial[4]);
+  EXPECT_EQ("u::j", Serial[8]);
+  for (unsigned NumThreads = 2; NumThreads != 6; ++NumThreads)
+    EXPECT_EQ(Serial, matchOnThreads(Code, NumThreads));
+}
+
+TEST(MatchFinder, MatchesShardOnThreads) {
+  const std::string Code =
+    "int a; namespace n { int b; int c; } int d; struct e { int f; };";
+  std::vector<std::string> Matched;
+  for (unsigned Shard = 0; Shard != 2; ++Shard) {
+    RecordMatchedNames Callback;
+    MatchFinder Finder;
+    Finder.addMatcher(namedDecl(anyOf(varDecl(), fieldDecl())).bind("d"),
+                      &Callback);
+    Finder.setShard(Shard, 2);
+    Finder.setNumThreads(2);
+    OwningPtr<FrontendActionFactory> Factory(newFrontendActionFactory(&Finder));
+    ASSERT_TRUE(tooling::runToolOnCode(Factory->create(), Code));
+    Matched.insert(Matched.end(), Callback.Names.begin(), Callback.Names.end());
+  }
+  std::sort(Matched.begin(), Matched.end());
+  ASSERT_EQ(5u, Matched.size());
+  EXPECT_EQ("a", Matched[0]);
+  EXPECT_EQ("b", Matched[1]);
+  EXPECT_EQ("c", Matched[2]);
+  EXPECT_EQ("d", Matched[3]);
+  EXPECT_EQ("f", Matched[4]);
+}
+
+TEST(MatchFinder, RecordsProfileOnThreads) {
+  SpendTime Callback(0.02);
+  std::vector<llvm::TimeRecord> Records;
+  MatchFinder Finder;
+  Finder.addMatcher(varDecl(), &Callback);
+  Finder.addMatcher(integerLiteral(equals(2)), &Callback);
+  Finder.addMatcher(integerLiteral(equals(4)), &Callback);
+  Finder.enableProfiling(Records);
+  Finder.setNumThreads(3);
+  OwningPtr<FrontendActionFactory> Factory(newFrontendActionFactory(&Finder));
+  ASSERT_TRUE(tooling::runToolOnCode(Factory->create(),
+                                     "int x = 1; int y = 2; int z = 3;"));
+  ASSERT_EQ(3u, Records.size());
+  EXPECT_LE(0.03, Records[0].getWallTime());
+  EXPECT_LE(0.01, Records[1].getWallTime());
+  EXPECT_GT(0.01, Records[2].getWallTime());
+}
+
 } // end namespace ast_matchers
 } // end namespace clang
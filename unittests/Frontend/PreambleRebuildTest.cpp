@@ -0,0 +1,191 @@
+//===- unittests/Frontend/PreambleRebuildTest.cpp - Background preambles --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace clang;
+
+namespace {
+
+/// \brief Build the unsaved files for a main file that includes a header.
+/// The ASTUnit takes ownership of the buffers.
+void getRemappedFiles(const char *MainFile, const char *Source,
+                      const char *HeaderFile, const char *Header,
+                      std::vector<ASTUnit::RemappedFile> &Remapped) {
+  Remapped.clear();
+  Remapped.push_back(ASTUnit::RemappedFile(HeaderFile,
+                          MemoryBuffer::getMemBufferCopy(Header, HeaderFile)));
+  Remapped.push_back(ASTUnit::RemappedFile(MainFile,
+                          MemoryBuffer::getMemBufferCopy(Source, MainFile)));
+}
+
+/// \brief Parse \p MainFile with a precompiled preamble, reparse it once so
+/// that the preamble is built, and have it rebuilt in the background from
+/// then on.
+ASTUnit *parseWithPreamble(const char *MainFile, const char *Source,
+                           const char *HeaderFile, const char *Header) {
+  std::vector<const char *> Args;
+  Args.push_back("-fno-spell-checking");
+  Args.push_back(MainFile);
+
+  std::vector<ASTUnit::RemappedFile> Remapped;
+  getRemappedFiles(MainFile, Source, HeaderFile, Header, Remapped);
+
+  IntrusiveRefCntPtr<DiagnosticsEngine> Diags
+    = CompilerInstance::createDiagnostics(new DiagnosticOptions());
+  OwningPtr<ASTUnit> AST(ASTUnit::LoadFromCommandLine(
+                                      &Args[0], &Args[0] + Args.size(), Diags,
+                                      /*ResourceFilesPath=*/"",
+                                      /*OnlyLocalDecls=*/false,
+                                      /*CaptureDiagnostics=*/true,
+                                      &Remapped[0], Remapped.size(),
+                                      /*RemappedFilesKeepOriginalName=*/true,
+                                      /*PrecompilePreamble=*/true));
+  if (!AST)
+    return 0;
+
+  getRemappedFiles(MainFile, Source, HeaderFile, Header, Remapped);
+  if (AST->Reparse(&Remapped[0], Remapped.size()))
+    return 0;
+  AST->setRebuildPreambleInBackground(true);
+  return AST.take();
+}
+
+bool reparse(ASTUnit &AST, const char *MainFile, const char *Source,
+             const char *HeaderFile, const char *Header) {
+  std::vector<ASTUnit::RemappedFile> Remapped;
+  getRemappedFiles(MainFile, Source, HeaderFile, Header, Remapped);
+  return !AST.Reparse(&Remapped[0], Remapped.size());
+}
+
+bool usesPreamble(ASTUnit &AST) {
+  return !AST.getSourceManager().getPreambleFileID().isInvalid();
+}
+
+/// \brief Collect the errors of the last parse, as "line:column".
+std::vector<std::string> getErrorLocations(ASTUnit &AST) {
+  std::vector<std::string> Errors;
+  for (ASTUnit::stored_diag_iterator D = AST.stored_diag_begin(),
+                                     DEnd = AST.stored_diag_end();
+       D != DEnd; ++D) {
+    if (D->getLevel() < DiagnosticsEngine::Error)
+      continue;
+    FullSourceLoc Loc = D->getLocation();
+    Errors.push_back(std::string());
+    raw_string_ostream OS(Errors.back());
+    OS << Loc.getExpansionLineNumber() << ':'
+       << Loc.getExpansionColumnNumber();
+  }
+  return Errors;
+}
+
+TEST(PreambleRebuild, ParsesWithoutPreambleWhileHeadersAreRebuilt) {
+  const char *Source = "#include \"rebuild-headers.h\"\n"
+                       "int x = new_decl;\n";
+  OwningPtr<ASTUnit> AST(parseWithPreamble("rebuild-headers.cpp", Source,
+                                           "rebuild-headers.h",
+                                           "int old_decl;\n"));
+  ASSERT_TRUE(AST.get() != 0);
+  std::string OldPreamble = AST->getPrecompiledPreambleFile();
+  ASSERT_FALSE(OldPreamble.empty());
+
+  // The header changed, so the old preamble can't be used at all; the main
+  // file is parsed on its own while the new preamble is precompiled.
+  const char *NewHeader = "int old_decl;\nint new_decl;\n";
+  ASSERT_TRUE(reparse(*AST, "rebuild-headers.cpp", Source,
+                      "rebuild-headers.h", NewHeader));
+  EXPECT_FALSE(usesPreamble(*AST));
+  EXPECT_TRUE(getErrorLocations(*AST).empty());
+
+  AST->waitForPreambleRebuild();
+  ASSERT_TRUE(reparse(*AST, "rebuild-headers.cpp", Source,
+                      "rebuild-headers.h", NewHeader));
+  EXPECT_TRUE(usesPreamble(*AST));
+  EXPECT_NE(OldPreamble, AST->getPrecompiledPreambleFile().str());
+  EXPECT_TRUE(getErrorLocations(*AST).empty());
+}
+
+TEST(PreambleRebuild, UsesStalePreambleWhileMainFileIsRebuilt) {
+  const char *Header = "int stale_decl;\n";
+  OwningPtr<ASTUnit> AST(parseWithPreamble("rebuild-main.cpp",
+                                           "#include \"rebuild-main.h\"\n"
+                                           "int y = stale_decl;\n",
+                                           "rebuild-main.h", Header));
+  ASSERT_TRUE(AST.get() != 0);
+  std::string OldPreamble = AST->getPrecompiledPreambleFile();
+  ASSERT_FALSE(OldPreamble.empty());
+
+  // Only the preamble of the main file changed: the old preamble is used
+  // until the new one is ready, so NEW_MACRO is not defined yet. Everything
+  // after the preamble keeps its location.
+  const char *Source = "#include \"rebuild-main.h\"\n"
+                       "#define NEW_MACRO 1\n"
+                       "int y = stale_decl + undeclared + NEW_MACRO;\n";
+  ASSERT_TRUE(reparse(*AST, "rebuild-main.cpp", Source,
+                      "rebuild-main.h", Header));
+  EXPECT_TRUE(usesPreamble(*AST));
+  EXPECT_EQ(OldPreamble, AST->getPrecompiledPreambleFile().str());
+  std::vector<std::string> Errors = getErrorLocations(*AST);
+  ASSERT_EQ(2u, Errors.size());
+  EXPECT_EQ("3:22", Errors[0]);
+  EXPECT_EQ("3:35", Errors[1]);
+
+  AST->waitForPreambleRebuild();
+  ASSERT_TRUE(reparse(*AST, "rebuild-main.cpp", Source,
+                      "rebuild-main.h", Header));
+  EXPECT_TRUE(usesPreamble(*AST));
+  EXPECT_NE(OldPreamble, AST->getPrecompiledPreambleFile().str());
+  Errors = getErrorLocations(*AST);
+  ASSERT_EQ(1u, Errors.size());
+  EXPECT_EQ("3:22", Errors[0]);
+}
+
+TEST(PreambleRebuild, DropsRebuildOfOutdatedPreamble) {
+  const char *Header = "int dropped_decl;\n";
+  OwningPtr<ASTUnit> AST(parseWithPreamble("rebuild-drop.cpp",
+                                           "#include \"rebuild-drop.h\"\n"
+                                           "int z = dropped_decl;\n",
+                                           "rebuild-drop.h", Header));
+  ASSERT_TRUE(AST.get() != 0);
+
+  const char *First = "#include \"rebuild-drop.h\"\n"
+                      "#define FIRST 1\n"
+                      "int z = dropped_decl;\n";
+  ASSERT_TRUE(reparse(*AST, "rebuild-drop.cpp", First,
+                      "rebuild-drop.h", Header));
+  AST->waitForPreambleRebuild();
+
+  // The preamble changed again before the rebuild was picked up, so that
+  // rebuild is dropped and another one started.
+  const char *Second = "#include \"rebuild-drop.h\"\n"
+                       "#define SECOND 2\n"
+                       "int z = dropped_decl + SECOND;\n";
+  ASSERT_TRUE(reparse(*AST, "rebuild-drop.cpp", Second,
+                      "rebuild-drop.h", Header));
+  std::string StalePreamble = AST->getPrecompiledPreambleFile();
+  AST->waitForPreambleRebuild();
+  ASSERT_TRUE(reparse(*AST, "rebuild-drop.cpp", Second,
+                      "rebuild-drop.h", Header));
+  EXPECT_TRUE(usesPreamble(*AST));
+  EXPECT_NE(StalePreamble, AST->getPrecompiledPreambleFile().str());
+  EXPECT_TRUE(getErrorLocations(*AST).empty());
+}
+
+} // anonymous namespace
@@ -0,0 +1,129 @@
+//===- unittests/Frontend/PreambleSharingTest.cpp - Shared preamble tests -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+using namespace llvm;
+using namespace clang;
+
+namespace {
+
+const char *SharedHeader = "int shared_decl;\n";
+
+/// \brief Build the unsaved files for a unit whose main file includes the
+/// shared header. The ASTUnit takes ownership of the buffers.
+void getRemappedFiles(const char *MainFile, const char *Source,
+                      std::vector<ASTUnit::RemappedFile> &Remapped) {
+  Remapped.clear();
+  const MemoryBuffer *Header
+    = MemoryBuffer::getMemBufferCopy(SharedHeader, "shared.h");
+  Remapped.push_back(ASTUnit::RemappedFile("shared.h", Header));
+  const MemoryBuffer *Main = MemoryBuffer::getMemBufferCopy(Source, MainFile);
+  Remapped.push_back(ASTUnit::RemappedFile(MainFile, Main));
+}
+
+/// \brief Parse \p MainFile with a precompiled preamble, and reparse it once
+/// so that the preamble is built (or adopted from another unit).
+ASTUnit *parseWithPreamble(const char *MainFile, const char *Source,
+                           const char *ExtraArg = 0,
+                           bool SkipFunctionBodies = false) {
+  std::vector<const char *> Args;
+  if (ExtraArg)
+    Args.push_back(ExtraArg);
+  Args.push_back(MainFile);
+
+  std::vector<ASTUnit::RemappedFile> Remapped;
+  getRemappedFiles(MainFile, Source, Remapped);
+
+  IntrusiveRefCntPtr<DiagnosticsEngine> Diags
+    = CompilerInstance::createDiagnostics(new DiagnosticOptions());
+  OwningPtr<ASTUnit> AST(ASTUnit::LoadFromCommandLine(
+                                      &Args[0], &Args[0] + Args.size(), Diags,
+                                      /*ResourceFilesPath=*/"",
+                                      /*OnlyLocalDecls=*/false,
+                                      /*CaptureDiagnostics=*/true,
+                                      &Remapped[0], Remapped.size(),
+                                      /*RemappedFilesKeepOriginalName=*/true,
+                                      /*PrecompilePreamble=*/true,
+                                      TU_Complete,
+                                      /*CacheCodeCompletionResults=*/false,
+                                      /*IncludeBriefComments=*/false,
+                                      /*AllowPCHWithCompilerErrors=*/false,
+                                      SkipFunctionBodies));
+  if (!AST)
+    return 0;
+
+  getRemappedFiles(MainFile, Source, Remapped);
+  if (AST->Reparse(&Remapped[0], Remapped.size()))
+    return 0;
+  return AST.take();
+}
+
+TEST(PreambleSharing, SharedBetweenMainFiles) {
+  OwningPtr<ASTUnit> A(parseWithPreamble("a.cpp",
+                          "#include \"shared.h\"\nint a = shared_decl;\n"));
+  ASSERT_TRUE(A.get() != 0);
+  ASSERT_FALSE(A->getPrecompiledPreambleFile().empty());
+
+  OwningPtr<ASTUnit> B(parseWithPreamble("b.cpp",
+                          "#include \"shared.h\"\nint b = shared_decl + 1;\n"));
+  ASSERT_TRUE(B.get() != 0);
+  EXPECT_EQ(A->getPrecompiledPreambleFile(), B->getPrecompiledPreambleFile());
+  EXPECT_FALSE(B->getDiagnostics().hasErrorOccurred());
+
+  // The preamble was built from a.cpp, but B reads it as its own main file.
+  SourceManager &SM = B->getSourceManager();
+  FileID PreambleID = SM.getPreambleFileID();
+  ASSERT_FALSE(PreambleID.isInvalid());
+  EXPECT_EQ(StringRef("b.cpp"),
+            StringRef(SM.getFileEntryForID(PreambleID)->getName()));
+}
+
+TEST(PreambleSharing, NotSharedWithDifferentOptions) {
+  const char *Source = "#include \"shared.h\"\nint x = shared_decl;\n";
+  OwningPtr<ASTUnit> A(parseWithPreamble("opts-a.cpp", Source));
+  ASSERT_TRUE(A.get() != 0);
+  ASSERT_FALSE(A->getPrecompiledPreambleFile().empty());
+
+  OwningPtr<ASTUnit> Macro(parseWithPreamble("opts-b.cpp", Source,
+                                             "-DEXTRA_MACRO"));
+  ASSERT_TRUE(Macro.get() != 0);
+  EXPECT_FALSE(Macro->getPrecompiledPreambleFile().empty());
+  EXPECT_NE(A->getPrecompiledPreambleFile(),
+            Macro->getPrecompiledPreambleFile());
+
+  OwningPtr<ASTUnit> SkipBodies(parseWithPreamble("opts-c.cpp", Source, 0,
+                                                 /*SkipFunctionBodies=*/true));
+  ASSERT_TRUE(SkipBodies.get() != 0);
+  EXPECT_FALSE(SkipBodies->getPrecompiledPreambleFile().empty());
+  EXPECT_NE(A->getPrecompiledPreambleFile(),
+            SkipBodies->getPrecompiledPreambleFile());
+}
+
+TEST(PreambleSharing, NotSharedWithDifferentPreambleText) {
+  OwningPtr<ASTUnit> A(parseWithPreamble("text-a.cpp",
+                          "#include \"shared.h\"\nint a = shared_decl;\n"));
+  ASSERT_TRUE(A.get() != 0);
+  OwningPtr<ASTUnit> B(parseWithPreamble("text-b.cpp",
+                          "#include \"shared.h\"\n#define LOCAL 1\n"
+                          "int b = LOCAL;\n"));
+  ASSERT_TRUE(B.get() != 0);
+  EXPECT_FALSE(B->getPrecompiledPreambleFile().empty());
+  EXPECT_NE(A->getPrecompiledPreambleFile(), B->getPrecompiledPreambleFile());
+}
+
+} // anonymous namespace
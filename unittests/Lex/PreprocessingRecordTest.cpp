@@ -0,0 +1,125 @@
+//===- unittests/Lex/PreprocessingRecordTest.cpp - Preprocessing record ---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Lex/PreprocessingRecord.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/TargetInfo.h"
+#include "clang/Basic/TargetOptions.h"
+#include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/ModuleLoader.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace clang;
+
+namespace {
+
+// The test fixture.
+class PreprocessingRecordTest : public ::testing::Test {
+protected:
+  PreprocessingRecordTest()
+    : FileMgr(FileMgrOpts),
+      DiagID(new DiagnosticIDs()),
+      Diags(DiagID, new DiagnosticOptions, new IgnoringDiagConsumer()),
+      SourceMgr(Diags, FileMgr),
+      TargetOpts(new TargetOptions)
+  {
+    TargetOpts->Triple = "x86_64-apple-darwin11.1.0";
+    Target = TargetInfo::CreateTargetInfo(Diags, &*TargetOpts);
+  }
+
+  FileSystemOptions FileMgrOpts;
+  FileManager FileMgr;
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagID;
+  DiagnosticsEngine Diags;
+  SourceManager SourceMgr;
+  LangOptions LangOpts;
+  IntrusiveRefCntPtr<TargetOptions> TargetOpts;
+  IntrusiveRefCntPtr<TargetInfo> Target;
+};
+
+class VoidModuleLoader : public ModuleLoader {
+  virtual ModuleLoadResult loadModule(SourceLocation ImportLoc, 
+                                      ModuleIdPath Path,
+                                      Module::NameVisibilityKind Visibility,
+                                      bool IsInclusionDirective) {
+    return ModuleLoadResult();
+  }
+
+  virtual void makeModuleVisible(Module *Mod,
+                                 Module::NameVisibilityKind Visibility,
+                                 SourceLocation ImportLoc,
+                                 bool Complain) { }
+};
+
+TEST_F(PreprocessingRecordTest, RecordsEntitiesInSourceOrder) {
+  const char *source =
+      "#define M1 1\n"
+      "#define M2 2\n"
+      "#define FM(x,y) y x\n"
+      "M1 FM(M1, M2) __LINE__\n";
+
+  MemoryBuffer *buf = MemoryBuffer::getMemBuffer(source);
+  FileID MainFileID = SourceMgr.createMainFileIDForMemBuffer(buf);
+  SourceLocation Start = SourceMgr.getLocForStartOfFile(MainFileID);
+
+  VoidModuleLoader ModLoader;
+  HeaderSearch HeaderInfo(new HeaderSearchOptions, FileMgr, Diags, LangOpts, 
+                          Target.getPtr());
+  Preprocessor PP(new PreprocessorOptions(), Diags, LangOpts,Target.getPtr(),
+                  SourceMgr, HeaderInfo, ModLoader,
+                  /*IILookup =*/ 0,
+                  /*OwnsHeaderSearch =*/false,
+                  /*DelayInitialization =*/ false);
+  PP.createPreprocessingRecord();
+  PP.EnterMainSourceFile();
+
+  Token Tok;
+  do
+    PP.Lex(Tok);
+  while (Tok.isNot(tok::eof));
+
+  PreprocessingRecord &PPRec = *PP.getPreprocessingRecord();
+  ASSERT_EQ(8, PPRec.local_end() - PPRec.local_begin());
+
+  PreprocessingRecord::iterator I = PPRec.local_begin();
+  EXPECT_TRUE(isa<MacroDefinition>(I[0]));
+  EXPECT_TRUE(isa<MacroDefinition>(I[1]));
+  EXPECT_TRUE(isa<MacroDefinition>(I[2]));
+
+  // FM expands its second argument first, but the record is kept in order.
+  const char *Names[] = { "M1", "FM", "M1", "M2", "__LINE__" };
+  for (unsigned J = 0; J != 5; ++J) {
+    MacroExpansion *ME = dyn_cast<MacroExpansion>(I[J + 3]);
+    ASSERT_TRUE(ME != 0);
+    EXPECT_EQ(Names[J], ME->getName()->getName());
+    EXPECT_EQ(J == 4, ME->isBuiltinMacro());
+    // Asking again yields the same object.
+    EXPECT_EQ(ME, I[J + 3]);
+  }
+
+  MacroExpansion *FM = cast<MacroExpansion>(I[4]);
+  EXPECT_EQ(Start.getLocWithOffset(49), FM->getSourceRange().getBegin());
+  EXPECT_EQ(Start.getLocWithOffset(58), FM->getSourceRange().getEnd());
+  EXPECT_EQ(cast<MacroDefinition>(I[2]), FM->getDefinition());
+
+  std::pair<PreprocessingRecord::iterator, PreprocessingRecord::iterator>
+    InFM = PPRec.getPreprocessedEntitiesInRange(FM->getSourceRange());
+  EXPECT_EQ(4, InFM.first - PPRec.local_begin());
+  EXPECT_EQ(7, InFM.second - PPRec.local_begin());
+}
+
+} // anonymous namespace
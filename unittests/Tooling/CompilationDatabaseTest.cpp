@@ -14,9 +14,17 @@
 #include "clang/Tooling/FileMatchTrie.h"
 #include "clang/Tooling/JSONCompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/Config/config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PathV2.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
+#if defined(LLVM_ON_UNIX)
+#include <utime.h>
+#endif
+
 namespace clang {
 namespace tooling {
 
@@ -291,6 +299,192 @@ TEST(findCompileArgsInJsonDatabase, FindsEntry) {
   EXPECT_EQ("command4", FoundCommand.CommandLine[0]) << ErrorMessage;
 }
 
+TEST(findCompileArgsInJsonDatabase, UnescapesJSONStrings) {
+  std::string ErrorMessage;
+  CompileCommand FoundCommand = findCompileArgsInJsonDatabase(
+    "//net/dir/file",
+    "[{\"directory\":\"\\/\\/net\\/dir\",\"command\":\"a\\u0042\\u0020c\","
+    "\"file\":\"fil\\u0065\"}]",
+    ErrorMessage);
+  EXPECT_EQ("//net/dir", FoundCommand.Directory) << ErrorMessage;
+  ASSERT_EQ(2u, FoundCommand.CommandLine.size()) << ErrorMessage;
+  EXPECT_EQ("aB", FoundCommand.CommandLine[0]) << ErrorMessage;
+  EXPECT_EQ("c", FoundCommand.CommandLine[1]) << ErrorMessage;
+}
+
+TEST(findCompileArgsInJsonDatabase, ReadsYAMLExtensions) {
+  std::string ErrorMessage;
+  CompileCommand FoundCommand = findCompileArgsInJsonDatabase(
+    "//net/dir/file",
+    "[{directory: '//net/dir', command: 'a command', file: file}]",
+    ErrorMessage);
+  EXPECT_EQ("//net/dir", FoundCommand.Directory) << ErrorMessage;
+  ASSERT_EQ(2u, FoundCommand.CommandLine.size()) << ErrorMessage;
+  EXPECT_EQ("a", FoundCommand.CommandLine[0]) << ErrorMessage;
+  EXPECT_EQ("command", FoundCommand.CommandLine[1]) << ErrorMessage;
+}
+
+/// \brief Writes a compilation database and loads it with an index, in a
+/// temporary directory.
+class JSONCompilationDatabaseIndexTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    int FD;
+    ASSERT_FALSE(llvm::sys::fs::unique_file("cdb-index-test-%%-%%-%%-%%/anchor",
+                                            FD, Directory));
+    llvm::raw_fd_ostream Closer(FD, /*shouldClose=*/true);
+    Directory = llvm::sys::path::parent_path(Directory);
+    DatabasePath = Directory;
+    llvm::sys::path::append(DatabasePath, "compile_commands.json");
+    IndexPath = Directory;
+    llvm::sys::path::append(IndexPath, "compile_commands.index");
+  }
+
+  virtual void TearDown() {
+    uint32_t RemovedCount = 0;
+    llvm::sys::fs::remove_all(Directory.str(), RemovedCount);
+  }
+
+  void writeFile(StringRef Path, StringRef Content) {
+    std::string ErrorInfo;
+    llvm::raw_fd_ostream OS(Path.str().c_str(), ErrorInfo,
+                            llvm::raw_fd_ostream::F_Binary);
+    ASSERT_TRUE(ErrorInfo.empty()) << ErrorInfo;
+    OS << Content;
+  }
+
+  void writeDatabase(StringRef Content) {
+    writeFile(DatabasePath, Content);
+  }
+
+  JSONCompilationDatabase *load() {
+    std::string ErrorMessage;
+    JSONCompilationDatabase *Database =
+      JSONCompilationDatabase::loadFromFile(DatabasePath, IndexPath,
+                                            ErrorMessage);
+    EXPECT_TRUE(Database != NULL) << ErrorMessage;
+    return Database;
+  }
+
+  std::string readIndex() {
+    OwningPtr<llvm::MemoryBuffer> Buffer;
+    if (llvm::MemoryBuffer::getFile(IndexPath.str(), Buffer))
+      return std::string();
+    return Buffer->getBuffer();
+  }
+
+  SmallString<128> Directory;
+  SmallString<128> DatabasePath;
+  SmallString<128> IndexPath;
+};
+
+static const char IndexedDatabase[] =
+  "[{\"directory\":\"//net/dir\",\"command\":\"cc -c a.cc\","
+  "\"file\":\"a.cc\"},"
+  " {\"directory\":\"//net/dir\",\"command\":\"cc -DX -c a.cc\","
+  "\"file\":\"a.cc\"},"
+  " {\"directory\":\"//net/d\\u0069r\",\"command\":\"cc\\u0020-c b.cc\","
+  "\"file\":\"//net/dir/b.cc\"}]";
+
+static void expectIndexedCommands(const JSONCompilationDatabase &Database) {
+  std::vector<CompileCommand> A = Database.getCompileCommands("//net/dir/a.cc");
+  ASSERT_EQ(2u, A.size());
+  EXPECT_EQ("//net/dir", A[0].Directory);
+  ASSERT_EQ(3u, A[0].CommandLine.size());
+  EXPECT_EQ("a.cc", A[0].CommandLine[2]);
+  ASSERT_EQ(4u, A[1].CommandLine.size());
+  EXPECT_EQ("-DX", A[1].CommandLine[1]);
+
+  std::vector<CompileCommand> B = Database.getCompileCommands("//net/dir/b.cc");
+  ASSERT_EQ(1u, B.size());
+  EXPECT_EQ("//net/dir", B[0].Directory);
+  ASSERT_EQ(3u, B[0].CommandLine.size());
+  EXPECT_EQ("-c", B[0].CommandLine[1]);
+}
+
+TEST_F(JSONCompilationDatabaseIndexTest, WritesAndReadsIndex) {
+  writeDatabase(IndexedDatabase);
+  OwningPtr<JSONCompilationDatabase> Parsed(load());
+  ASSERT_TRUE(Parsed);
+  expectIndexedCommands(*Parsed);
+  std::string Index = readIndex();
+  ASSERT_FALSE(Index.empty());
+
+  OwningPtr<JSONCompilationDatabase> Indexed(load());
+  ASSERT_TRUE(Indexed);
+  expectIndexedCommands(*Indexed);
+  EXPECT_EQ(2u, Indexed->getAllFiles().size());
+  EXPECT_EQ(Index, readIndex());
+}
+
+TEST_F(JSONCompilationDatabaseIndexTest, IgnoresDamagedIndex) {
+  writeDatabase(IndexedDatabase);
+  OwningPtr<JSONCompilationDatabase> Parsed(load());
+  ASSERT_TRUE(Parsed);
+  std::string Index = readIndex();
+  ASSERT_LT(40u, Index.size());
+
+  // Truncated, and pointing past the end of the database.
+  writeFile(IndexPath, Index.substr(0, Index.size() - 1));
+  OwningPtr<JSONCompilationDatabase> Truncated(load());
+  ASSERT_TRUE(Truncated);
+  expectIndexedCommands(*Truncated);
+  EXPECT_EQ(Index, readIndex());
+
+  std::string OutOfBounds = Index;
+  OutOfBounds[32] = '\xff';
+  OutOfBounds[33] = '\xff';
+  writeFile(IndexPath, OutOfBounds);
+  OwningPtr<JSONCompilationDatabase> Damaged(load());
+  ASSERT_TRUE(Damaged);
+  expectIndexedCommands(*Damaged);
+  EXPECT_EQ(Index, readIndex());
+}
+
+TEST_F(JSONCompilationDatabaseIndexTest, DoesNotIndexYAML) {
+  writeDatabase("[{directory: '//net/dir', command: 'cc', file: a.cc}]");
+  OwningPtr<JSONCompilationDatabase> Database(load());
+  ASSERT_TRUE(Database);
+  EXPECT_EQ(1u, Database->getCompileCommands("//net/dir/a.cc").size());
+  EXPECT_EQ("", readIndex());
+}
+
+#if defined(LLVM_ON_UNIX)
+TEST_F(JSONCompilationDatabaseIndexTest, IsKeyedOnSizeAndModificationTime) {
+  struct utimbuf Times;
+  Times.actime = Times.modtime = 1000000000;
+  writeDatabase("[{\"directory\":\"//net/dir\",\"command\":\"cc\","
+                "\"file\":\"a.cc\"}]");
+  ASSERT_EQ(0, utime(DatabasePath.c_str(), &Times));
+  OwningPtr<JSONCompilationDatabase> Database(load());
+  ASSERT_TRUE(Database);
+
+  // Neither the size nor the modification time changed, so the index is
+  // used, and still finds the file the database no longer names.
+  writeDatabase("[{\"directory\":\"//net/dir\",\"command\":\"cc\","
+                "\"file\":\"b.cc\"}]");
+  ASSERT_EQ(0, utime(DatabasePath.c_str(), &Times));
+  Database.reset(load());
+  ASSERT_TRUE(Database);
+  EXPECT_EQ(1u, Database->getCompileCommands("//net/dir/a.cc").size());
+  EXPECT_EQ(0u, Database->getCompileCommands("//net/dir/b.cc").size());
+
+  Times.modtime += 1;
+  ASSERT_EQ(0, utime(DatabasePath.c_str(), &Times));
+  Database.reset(load());
+  ASSERT_TRUE(Database);
+  EXPECT_EQ(0u, Database->getCompileCommands("//net/dir/a.cc").size());
+  EXPECT_EQ(1u, Database->getCompileCommands("//net/dir/b.cc").size());
+
+  writeDatabase("[{\"directory\":\"//net/dir\",\"command\":\"cc\","
+                "\"file\":\"c.cpp\"}]");
+  ASSERT_EQ(0, utime(DatabasePath.c_str(), &Times));
+  Database.reset(load());
+  ASSERT_TRUE(Database);
+  EXPECT_EQ(1u, Database->getCompileCommands("//net/dir/c.cpp").size());
+}
+#endif
+
 static std::vector<std::string> unescapeJsonCommandLine(StringRef Command) {
   std::string JsonDatabase =
     ("[{\"directory\":\"//net/root\", \"file\":\"test\", \"command\": \"" +
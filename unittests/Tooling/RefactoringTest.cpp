@@ -25,7 +25,10 @@
 #include "clang/Tooling/Refactoring.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 namespace clang {
@@ -151,6 +154,97 @@ TEST_F(ReplacementTest, ApplyAllFailsIfOneApplyFails) {
   EXPECT_EQ("z", Context.getRewrittenText(IDz));
 }
 
+TEST_F(ReplacementTest, AppliesInsertionsBeforeReplacementAtSameOffset) {
+  FileID ID = Context.createInMemoryFile("input.cpp", "line1\nline2");
+  Replacements Replaces;
+  Replaces.insert(Replacement("input.cpp", 6, 5, "replaced"));
+  Replaces.insert(Replacement("input.cpp", 6, 0, "a"));
+  Replaces.insert(Replacement("input.cpp", 6, 0, "b"));
+  Replaces.insert(Replacement("input.cpp", 11, 0, "!"));
+  EXPECT_TRUE(applyAllReplacements(Replaces, Context.Rewrite));
+  EXPECT_EQ("line1\nabreplaced!", Context.getRewrittenText(ID));
+}
+
+TEST_F(ReplacementTest, SkipsConflictingReplacements) {
+  FileID ID = Context.createInMemoryFile("input.cpp",
+                                         "line1\nline2\nline3\nline4");
+  Replacements Replaces;
+  Replaces.insert(Replacement("input.cpp", 6, 5, "replaced"));
+  Replaces.insert(Replacement("input.cpp", 8, 5, "overlap"));
+  Replaces.insert(Replacement("input.cpp", 10, 0, "inside"));
+  Replaces.insert(Replacement("input.cpp", 18, 5, "other"));
+  EXPECT_FALSE(applyAllReplacements(Replaces, Context.Rewrite));
+  EXPECT_EQ("line1\nreplaced\nline3\nother", Context.getRewrittenText(ID));
+}
+
+TEST_F(ReplacementTest, SkipsReplacementsPastEndOfFile) {
+  FileID ID = Context.createInMemoryFile("input.cpp", "text");
+  Replacements Replaces;
+  Replaces.insert(Replacement("input.cpp", 0, 1, "T"));
+  Replaces.insert(Replacement("input.cpp", 3, 2, "x"));
+  Replaces.insert(Replacement("input.cpp", 5, 0, "y"));
+  EXPECT_FALSE(applyAllReplacements(Replaces, Context.Rewrite));
+  EXPECT_EQ("Text", Context.getRewrittenText(ID));
+}
+
+/// \brief Make a file of \p NumLines lines and two replacements for each,
+/// which turn \p Code into \p Expected.
+static void makeManyReplacements(unsigned NumLines, StringRef FileName,
+                                 std::string &Code, std::string &Expected,
+                                 Replacements &Replaces) {
+  for (unsigned i = 0; i < NumLines; ++i) {
+    Code += "int x;\n";
+    Expected += "long y;\n";
+    Replaces.insert(Replacement(FileName, i * 7, 3, "long"));
+    Replaces.insert(Replacement(FileName, i * 7 + 4, 1, "y"));
+  }
+}
+
+// The replacements of a file are applied in a single pass, including
+// adjacent ones.
+TEST_F(ReplacementTest, AppliesManyReplacementsToOneFile) {
+  std::string Code;
+  std::string Expected;
+  Replacements Replaces;
+  makeManyReplacements(100, "input.cpp", Code, Expected, Replaces);
+  FileID ID = Context.createInMemoryFile("input.cpp", Code);
+  EXPECT_TRUE(applyAllReplacements(Replaces, Context.Rewrite));
+  EXPECT_EQ(Expected, Context.getRewrittenText(ID));
+}
+
+// A benchmark rather than a test, so it is disabled; run it with
+//   ToolingTests --gtest_also_run_disabled_tests \
+//                --gtest_filter=*ApplyingReplacementsScalesLinearly
+// It prints the time applyAllReplacements takes per replacement for files of
+// growing size. Since each file is rewritten in a single pass, that time
+// should stay about the same; it fails if it grows as much as applying the
+// replacements one at a time, which is quadratic, would make it grow.
+TEST_F(ReplacementTest, DISABLED_ApplyingReplacementsScalesLinearly) {
+  const unsigned Sizes[] = { 25000, 50000, 100000, 200000 };
+  const unsigned NumSizes = sizeof(Sizes) / sizeof(Sizes[0]);
+  double PerReplacement[NumSizes];
+  for (unsigned i = 0; i != NumSizes; ++i) {
+    std::string FileName = "input" + llvm::utostr(Sizes[i]) + ".cpp";
+    std::string Code;
+    std::string Expected;
+    Replacements Replaces;
+    makeManyReplacements(Sizes[i], FileName, Code, Expected, Replaces);
+    FileID ID = Context.createInMemoryFile(FileName, Code);
+
+    llvm::TimeRecord Start = llvm::TimeRecord::getCurrentTime(/*Start=*/true);
+    EXPECT_TRUE(applyAllReplacements(Replaces, Context.Rewrite));
+    llvm::TimeRecord End = llvm::TimeRecord::getCurrentTime(/*Start=*/false);
+    EXPECT_EQ(Expected, Context.getRewrittenText(ID));
+
+    double Seconds = End.getWallTime() - Start.getWallTime();
+    PerReplacement[i] = Seconds / Replaces.size();
+    llvm::errs() << Replaces.size() << " replacements: " << Seconds << "s, "
+                 << PerReplacement[i] * 1e9 << "ns each\n";
+  }
+  // The largest file has 8 times as many replacements as the smallest.
+  EXPECT_LT(PerReplacement[NumSizes - 1], 4 * PerReplacement[0]);
+}
+
 class FlushRewrittenFilesTest : public ::testing::Test {
  public:
   FlushRewrittenFilesTest() {
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "RewriterTestContext.h"
+#include "llvm/ADT/SmallVector.h"
 #include "gtest/gtest.h"
 
 namespace clang {
@@ -34,4 +35,24 @@ TEST(Rewriter, ContinuesOverwritingFilesOnError) {
             Context.getFileContentFromDisk("working.cpp")); 
 }
 
+TEST(Rewriter, ReplacesManyTextsAtOnce) {
+  RewriterTestContext Context;
+  FileID ID = Context.createInMemoryFile("t.cpp", "line1\nline2\nline3\nline4");
+  RewriteBuffer &Buffer = Context.Rewrite.getEditBuffer(ID);
+  Buffer.ReplaceText(0, 4, "first");
+
+  // Offsets are in the original text, as for ReplaceText.
+  SmallVector<RewriteBuffer::Edit, 4> Edits;
+  Edits.push_back(RewriteBuffer::Edit(6, 0, "<"));
+  Edits.push_back(RewriteBuffer::Edit(6, 5, "second"));
+  Edits.push_back(RewriteBuffer::Edit(12, 6, ""));
+  Edits.push_back(RewriteBuffer::Edit(23, 0, "!"));
+  Buffer.ReplaceTexts(Edits);
+  EXPECT_EQ("first1\n<second\nline4!", Context.getRewrittenText(ID));
+
+  // Later edits still map through the batch.
+  Buffer.ReplaceText(22, 1, "5");
+  EXPECT_EQ("first1\n<second\nline5!", Context.getRewrittenText(ID));
+}
+
 } // end namespace clang